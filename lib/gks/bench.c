@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "gks.h"
+
+/*
+ * Export a single polyline with a large number of vertices (10^7 by default)
+ * to the vector output drivers and report the time spent per format.
+ */
+
+static struct
+{
+  const char *name;
+  int wstype;
+} formats[] = {{"ps", 62}, {"pdf", 102}, {"pgf", 314}, {"svg", 382}};
+
+int main(int argc, char *argv[])
+{
+  int n = 10000000, i, k;
+  double *x, *y;
+  char path[32];
+  clock_t start;
+
+  if (argc > 1) n = atoi(argv[1]);
+
+  x = (double *)malloc(n * sizeof(double));
+  y = (double *)malloc(n * sizeof(double));
+  if (x == NULL || y == NULL)
+    {
+      fprintf(stderr, "out of virtual memory\n");
+      return 1;
+    }
+  for (i = 0; i < n; i++)
+    {
+      x[i] = (double)i / n;
+      y[i] = 0.5 + 0.4 * sin(x[i] * 200) * cos(x[i] * 13);
+    }
+
+  gks_open_gks(6);
+  gks_set_window(1, 0, 1, 0, 1);
+  gks_select_xform(1);
+
+  for (k = 0; k < (int)(sizeof(formats) / sizeof(formats[0])); k++)
+    {
+      sprintf(path, "bench.%s", formats[k].name);
+
+      start = clock();
+      gks_open_ws(1, path, formats[k].wstype);
+      gks_activate_ws(1);
+      gks_polyline(n, x, y);
+      gks_deactivate_ws(1);
+      gks_close_ws(1);
+
+      printf("%-4s %8d points: %.3f s\n", formats[k].name, n, (double)(clock() - start) / CLOCKS_PER_SEC);
+    }
+
+  gks_close_gks();
+
+  free(y);
+  free(x);
+
+  return 0;
+}
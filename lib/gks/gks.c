@@ -25,16 +25,19 @@
 #define OK 0
 #define MAX_POINTS 2048
 
-static gks_state_list_t *s = NULL, *seg_state = NULL;
+static GKS_THREAD_LOCAL gks_state_list_t *s = NULL, *seg_state = NULL;
 
-static int state = GKS_K_GKCL, api = 1;
+static GKS_THREAD_LOCAL int state = GKS_K_GKCL, api = 1;
 
-static int i_arr[13];
-static double f_arr_1[6], f_arr_2[6];
-static char c_arr[1];
-static int id = 0;
+static GKS_THREAD_LOCAL int i_arr[13];
+static GKS_THREAD_LOCAL double f_arr_1[6], f_arr_2[6];
+static GKS_THREAD_LOCAL char c_arr[1];
+static GKS_THREAD_LOCAL int id = 0;
 
-static gks_list_t *open_ws = NULL, *active_ws = NULL, *av_ws_types = NULL;
+static GKS_THREAD_LOCAL gks_list_t *open_ws = NULL, *active_ws = NULL, *av_ws_types = NULL;
+
+/* GKS state at the creation of each segment, keyed by the segment name */
+static GKS_THREAD_LOCAL gks_list_t *seg_states = NULL;
 
 static ws_descr_t ws_types[] = {{2, GKS_K_METERS, 1.00000, 1.00000, 65536, 65536, 4, "mf", NULL},
                                 {3, GKS_K_METERS, 1.00000, 1.00000, 65536, 65536, 5, "mf", NULL},
@@ -102,11 +105,11 @@ static int gksgral_fill_styles[6] = {7, 7, 1, 8, 8, 2};
 
 static int gddm_fill_styles[6] = {4, 10, 3, 9, 2, 1};
 
-extern int gks_errno;
+extern GKS_THREAD_LOCAL int gks_errno;
 
-static double *x = NULL, *y = NULL;
+static GKS_THREAD_LOCAL double *x = NULL, *y = NULL;
 
-static int max_points = 0;
+static GKS_THREAD_LOCAL int max_points = 0;
 
 static void gks_ddlk(int fctid, int dx, int dy, int dimx, int *i_arr, int len_f_arr_1, double *f_arr_1, int len_f_arr_2,
                      double *f_arr_2, int len_c_arr, char *c_arr, void **ptr)
@@ -563,6 +566,9 @@ void gks_close_gks(void)
       gks_close_font(s->fontfile);
 
       gks_list_free(av_ws_types);
+      gks_list_free(seg_states);
+      seg_states = NULL;
+      seg_state = NULL;
       gks_free((void *)s);
       s = NULL;
 
@@ -955,7 +961,7 @@ void gks_redraw_seg_on_ws(int wkid)
                 {
                   /* save GKS state, restore segment state */
                   memmove(&sl, s, sizeof(gks_state_list_t));
-                  memmove(s, seg_state, sizeof(gks_state_list_t));
+                  if (seg_state != NULL) memmove(s, seg_state, sizeof(gks_state_list_t));
 
                   id = wkid;
 
@@ -2016,8 +2022,10 @@ void gks_create_seg(int segn)
       state = GKS_K_SGOP;
 
       /* save segment state */
+      seg_states = gks_list_del(seg_states, segn);
       seg_state = (gks_state_list_t *)gks_malloc(sizeof(gks_state_list_t));
       memmove(seg_state, s, sizeof(gks_state_list_t));
+      seg_states = gks_list_add(seg_states, segn, seg_state);
     }
   else
     /* GKS not in proper state. GKS must be either in the state WSAC */
@@ -2041,12 +2049,17 @@ void gks_close_seg(void)
 
 void gks_delete_seg(int segn)
 {
+  gks_list_t *element;
+
   if (state >= GKS_K_WSAC)
     {
       i_arr[0] = segn;
 
       /* call the device driver link routine */
       gks_ddlk(DELETE_SEG, 1, 1, 1, i_arr, 0, f_arr_1, 0, f_arr_2, 0, c_arr, NULL);
+
+      if ((element = gks_list_find(seg_states, segn)) != NULL && element->ptr == seg_state) seg_state = NULL;
+      seg_states = gks_list_del(seg_states, segn);
     }
   else
     /* GKS not in proper state. GKS must be in one of the
@@ -2057,6 +2070,7 @@ void gks_delete_seg(int segn)
 void gks_assoc_seg_with_ws(int wkid, int segn)
 {
   gks_state_list_t sl;
+  gks_list_t *element;
 
   if (state >= GKS_K_WSOP)
     {
@@ -2068,7 +2082,8 @@ void gks_assoc_seg_with_ws(int wkid, int segn)
                 {
                   /* save GKS state, restore segment state */
                   memmove(&sl, s, sizeof(gks_state_list_t));
-                  memmove(s, seg_state, sizeof(gks_state_list_t));
+                  if ((element = gks_list_find(seg_states, segn)) != NULL)
+                    memmove(s, element->ptr, sizeof(gks_state_list_t));
 
                   id = wkid;
 
@@ -2101,6 +2116,7 @@ void gks_assoc_seg_with_ws(int wkid, int segn)
 void gks_copy_seg_to_ws(int wkid, int segn)
 {
   gks_state_list_t sl;
+  gks_list_t *element;
 
   if (state >= GKS_K_WSOP)
     {
@@ -2112,7 +2128,8 @@ void gks_copy_seg_to_ws(int wkid, int segn)
                 {
                   /* save GKS state, restore segment state */
                   memmove(&sl, s, sizeof(gks_state_list_t));
-                  memmove(s, seg_state, sizeof(gks_state_list_t));
+                  if ((element = gks_list_find(seg_states, segn)) != NULL)
+                    memmove(s, element->ptr, sizeof(gks_state_list_t));
 
                   id = wkid;
 
@@ -2927,7 +2944,7 @@ void gks_inq_max_ds_size(int wtype, int *errind, int *dcunit, double *rx, double
 
 void gks_emergency_close(void)
 {
-  static int closing = 0;
+  static GKS_THREAD_LOCAL int closing = 0;
 
   if (!closing)
     {
@@ -533,6 +533,17 @@ typedef struct
   Gint length; /* item length */
 } Ggksmit;
 
+typedef struct
+{                           /* memory target of the cairo memory workstation (143) */
+  int width;                /* width of the buffers in pixels */
+  int height;               /* height of the buffers in pixels */
+  int dpi;                  /* resolution used to scale the output */
+  unsigned char *buffer[2]; /* caller-owned RGBA buffers, the second one is optional */
+  int index;                /* index of the buffer the next page is written to */
+  void (*completed)(void *arg, unsigned char *rgba, int width, int height); /* page callback */
+  void *arg;                                                                 /* callback argument */
+} gks_memory_target_t;
+
 /* GKS function prototypes */
 
 DLLEXPORT void gks_init_gks(void);
@@ -24,6 +24,21 @@ extern "C" {
 
 #define FEPS 1.0E-09
 
+/* Storage class of state which is kept separately for every thread. This is only enabled for builds with
+ * GKS_THREAD_LOCAL_STATE, as a program which initializes GR on one thread and draws from another one would
+ * otherwise get a fresh, uninitialized GR on the second thread. */
+#if !defined(GKS_THREAD_LOCAL_STATE)
+#define GKS_THREAD_LOCAL
+#elif defined(_MSC_VER)
+#define GKS_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define GKS_THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define GKS_THREAD_LOCAL _Thread_local
+#else
+#define GKS_THREAD_LOCAL
+#endif
+
 #define GRALGKS 3
 #define GLIGKS 4
 #define GKS5 5
@@ -31,6 +46,7 @@ extern "C" {
 #define MAX_WS 16      /* maximum number of workstations */
 #define MAX_TNR 9      /* maximum number of normalization transformations */
 #define MAX_COLOR 1256 /* maximum number of predefined colors */
+#define MAX_DTOA 330   /* maximum length of a number formatted by gks_dtoa */
 
 #define FIX_COLORIND(c) (c) < 0 ? 0 : (c) < MAX_COLOR ? (c) : MAX_COLOR - 1
 
@@ -240,6 +256,7 @@ void gks_set_norm_xform(int tnr, double *window, double *viewport);
 void gks_set_xform_matrix(double tran[3][2]);
 void gks_seg_xform(double *x, double *y);
 void gks_WC_to_NDC(int tnr, double *x, double *y);
+void gks_WC_to_NDC_points(int n, double *px, double *py, int tnr, double *x, double *y);
 void gks_NDC_to_WC(int tnr, double *x, double *y);
 void gks_set_dev_xform(gks_state_list_t *s, double *window, double *viewport);
 void gks_inq_dev_xform(double *window, double *viewport);
@@ -261,6 +278,7 @@ void gks_util_inq_text_extent(double px, double py, char *chars, int nchars, dou
                               double ty[4]);
 int gks_get_ws_type(void);
 int gks_base64(unsigned char *src, size_t srclength, char *target, size_t targsize);
+int gks_dtoa(char *s, double x, int prec, int conv);
 DLLEXPORT const char *gks_getenv(const char *env);
 void gks_iso2utf(unsigned char c, char *utf, size_t *len);
 void gks_symbol2utf(unsigned char c, char *utf, size_t *len);
@@ -10,11 +10,25 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include <zlib.h>
+
 #include "gkscore.h"
 #include "gks.h"
 
 #define SEGM_SIZE 262144 /* 256K */
 
+#define BLOCK_SIZE 1048576          /* 1M of metafile items per compressed block */
+#define QUEUE_LIMIT (64 * BLOCK_SIZE) /* pending bytes before the plotting thread waits for the writer */
+
+#define HEADER_MAGIC "GKSMZ01"  /* 8 bytes including the terminating zero */
+#define TRAILER_MAGIC "GKSMZIX" /* 8 bytes including the terminating zero */
+#define INDEX_ENTRY_SIZE 24
+#define TRAILER_SIZE 24
+
 #define COPY(s, n)                              \
   memmove(p->buffer + p->nbytes, (void *)s, n); \
   p->nbytes += n
@@ -24,12 +38,56 @@
   sp += nbytes
 
 
+/*
+ * If GKS_MF_COMPRESSION is set to a zlib compression level (1-9), the
+ * metafile output driver hands the items to a writer thread, which collects
+ * them in blocks of BLOCK_SIZE bytes and writes each block deflated. The file
+ * layout is (all numbers little-endian):
+ *
+ *   header   HEADER_MAGIC
+ *   blocks   u32 item bytes, u32 deflated bytes, deflated items
+ *   index    per block: u64 file offset, u64 item offset, u32 deflated bytes,
+ *            u32 item bytes
+ *   trailer  u64 file offset of the index, u32 number of blocks, u32 0,
+ *            TRAILER_MAGIC
+ *
+ * The index allows to seek to any item offset. The input driver inflates such
+ * files transparently, also without the index if a recording was cut short.
+ */
+
+typedef struct chunk_struct
+{
+  struct chunk_struct *next;
+  int nbytes;
+  char data[1];
+} chunk_t;
+
+typedef struct recorder_struct
+{
+  int fd, level;
+  char *block;
+  int nblock;
+  unsigned char *zbuf;
+  unsigned long zsize, offset, item_offset;
+  unsigned char *index;
+  int nblocks, index_size;
+  int threaded;
+#ifndef _WIN32
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  chunk_t *head, *tail;
+  int queued, finishing;
+#endif
+} recorder_t;
+
 typedef struct ws_state_list_struct
 {
   int conid, state;
   int empty;
   char *buffer;
   int size, nbytes, position;
+  recorder_t *recorder;
 } ws_state_list;
 
 
@@ -46,6 +104,221 @@ static void reallocate(int len)
   p->buffer = (char *)gks_realloc(p->buffer, p->size + 1);
 }
 
+static void put_u32(unsigned char *s, unsigned long value)
+{
+  s[0] = value & 0xff;
+  s[1] = (value >> 8) & 0xff;
+  s[2] = (value >> 16) & 0xff;
+  s[3] = (value >> 24) & 0xff;
+}
+
+static void put_u64(unsigned char *s, unsigned long value)
+{
+  put_u32(s, value & 0xffffffffUL);
+  put_u32(s + 4, (value >> 16) >> 16);
+}
+
+static unsigned long get_u32(const unsigned char *s)
+{
+  return s[0] | ((unsigned long)s[1] << 8) | ((unsigned long)s[2] << 16) | ((unsigned long)s[3] << 24);
+}
+
+static unsigned long get_u64(const unsigned char *s)
+{
+  return get_u32(s) | ((get_u32(s + 4) << 16) << 16);
+}
+
+static void write_bytes(int fd, const void *buffer, int nbytes)
+{
+  int offset = 0, bufsiz, cc;
+
+  while (offset < nbytes)
+    {
+      bufsiz = (nbytes - offset <= BUFSIZ) ? nbytes - offset : BUFSIZ;
+      if ((cc = gks_write_file(fd, (char *)buffer + offset, bufsiz)) <= 0)
+        {
+          gks_perror("can't write GKSM metafile");
+          perror("write");
+          break;
+        }
+      offset += cc;
+    }
+}
+
+static void write_block(recorder_t *r)
+{
+  uLongf zsize = r->zsize;
+  unsigned char header[8], *entry;
+  int err;
+
+  if ((err = compress2(r->zbuf, &zsize, (Bytef *)r->block, r->nblock, r->level)) != Z_OK)
+    {
+      gks_perror("compression failed (err=%d)", err);
+      r->nblock = 0;
+      return;
+    }
+  put_u32(header, r->nblock);
+  put_u32(header + 4, zsize);
+  write_bytes(r->fd, header, 8);
+  write_bytes(r->fd, r->zbuf, zsize);
+
+  if ((r->nblocks + 1) * INDEX_ENTRY_SIZE > r->index_size)
+    {
+      r->index_size += 256 * INDEX_ENTRY_SIZE;
+      r->index = (unsigned char *)gks_realloc(r->index, r->index_size);
+    }
+  entry = r->index + r->nblocks * INDEX_ENTRY_SIZE;
+  put_u64(entry, r->offset);
+  put_u64(entry + 8, r->item_offset);
+  put_u32(entry + 16, zsize);
+  put_u32(entry + 20, r->nblock);
+  r->nblocks++;
+
+  r->offset += 8 + zsize;
+  r->item_offset += r->nblock;
+  r->nblock = 0;
+}
+
+static void append_items(recorder_t *r, const char *data, int nbytes)
+{
+  int n;
+
+  while (nbytes > 0)
+    {
+      n = BLOCK_SIZE - r->nblock < nbytes ? BLOCK_SIZE - r->nblock : nbytes;
+      memcpy(r->block + r->nblock, data, n);
+      r->nblock += n;
+      data += n;
+      nbytes -= n;
+      if (r->nblock == BLOCK_SIZE) write_block(r);
+    }
+}
+
+static void finish_recording(recorder_t *r)
+{
+  unsigned char trailer[TRAILER_SIZE];
+
+  if (r->nblock > 0) write_block(r);
+  write_bytes(r->fd, r->index, r->nblocks * INDEX_ENTRY_SIZE);
+  put_u64(trailer, r->offset);
+  put_u32(trailer + 8, r->nblocks);
+  put_u32(trailer + 12, 0);
+  memcpy(trailer + 16, TRAILER_MAGIC, 8);
+  write_bytes(r->fd, trailer, TRAILER_SIZE);
+}
+
+#ifndef _WIN32
+
+static void *writer_thread(void *arg)
+{
+  recorder_t *r = (recorder_t *)arg;
+  chunk_t *chunk;
+
+  pthread_mutex_lock(&r->mutex);
+  for (;;)
+    {
+      while (r->head == NULL && !r->finishing) pthread_cond_wait(&r->cond, &r->mutex);
+      if (r->head == NULL) break;
+      chunk = r->head;
+      r->head = chunk->next;
+      if (r->head == NULL) r->tail = NULL;
+      pthread_mutex_unlock(&r->mutex);
+
+      append_items(r, chunk->data, chunk->nbytes);
+
+      pthread_mutex_lock(&r->mutex);
+      r->queued -= chunk->nbytes;
+      free(chunk);
+      pthread_cond_broadcast(&r->cond);
+    }
+  pthread_mutex_unlock(&r->mutex);
+
+  finish_recording(r);
+
+  return NULL;
+}
+
+#endif
+
+static recorder_t *open_recorder(int fd, int level)
+{
+  recorder_t *r = (recorder_t *)gks_malloc(sizeof(recorder_t));
+
+  r->fd = fd;
+  r->level = level;
+  r->block = (char *)gks_malloc(BLOCK_SIZE);
+  r->zsize = compressBound(BLOCK_SIZE);
+  r->zbuf = (unsigned char *)gks_malloc(r->zsize);
+  r->offset = 8;
+  write_bytes(fd, HEADER_MAGIC, 8);
+#ifndef _WIN32
+  pthread_mutex_init(&r->mutex, NULL);
+  pthread_cond_init(&r->cond, NULL);
+  r->threaded = pthread_create(&r->thread, NULL, writer_thread, (void *)r) == 0;
+  if (!r->threaded)
+    {
+      pthread_cond_destroy(&r->cond);
+      pthread_mutex_destroy(&r->mutex);
+    }
+#else
+  /* without a writer thread the items are compressed on the plotting thread */
+  r->threaded = 0;
+#endif
+
+  return r;
+}
+
+static void record(recorder_t *r, const char *data, int nbytes)
+{
+#ifndef _WIN32
+  chunk_t *chunk;
+
+  if (r->threaded)
+    {
+      chunk = (chunk_t *)gks_malloc(sizeof(chunk_t) + nbytes);
+      chunk->next = NULL;
+      chunk->nbytes = nbytes;
+      memcpy(chunk->data, data, nbytes);
+
+      pthread_mutex_lock(&r->mutex);
+      while (r->queued > QUEUE_LIMIT) pthread_cond_wait(&r->cond, &r->mutex);
+      if (r->tail != NULL)
+        r->tail->next = chunk;
+      else
+        r->head = chunk;
+      r->tail = chunk;
+      r->queued += nbytes;
+      pthread_cond_broadcast(&r->cond);
+      pthread_mutex_unlock(&r->mutex);
+      return;
+    }
+#endif
+  append_items(r, data, nbytes);
+}
+
+static void close_recorder(recorder_t *r)
+{
+#ifndef _WIN32
+  if (r->threaded)
+    {
+      pthread_mutex_lock(&r->mutex);
+      r->finishing = 1;
+      pthread_cond_broadcast(&r->cond);
+      pthread_mutex_unlock(&r->mutex);
+      pthread_join(r->thread, NULL);
+      pthread_cond_destroy(&r->cond);
+      pthread_mutex_destroy(&r->mutex);
+    }
+  else
+#endif
+    finish_recording(r);
+
+  free(r->index);
+  free(r->zbuf);
+  free(r->block);
+  free(r);
+}
+
 static void write_item(int fctid, int dx, int dy, int dimx, int *i_arr, int len_farr_1, double *f_arr_1, int len_farr_2,
                        double *f_arr_2, int len_c_arr, char *c_arr)
 {
@@ -245,26 +518,18 @@ static void write_gksm(int stream)
 
   if (fd >= 0)
     {
-      int offset = 0, bufsiz, cc;
-
-      while (offset < nbytes)
-        {
-          bufsiz = (nbytes - offset <= BUFSIZ) ? nbytes - offset : BUFSIZ;
-          if ((cc = gks_write_file(fd, buffer + offset, bufsiz)) <= 0)
-            {
-              gks_perror("can't write GKSM metafile");
-              perror("write");
-              break;
-            }
-          offset += cc;
-        }
+      if (p->recorder != NULL)
+        record(p->recorder, buffer, nbytes);
+      else
+        write_bytes(fd, buffer, nbytes);
     }
 }
 
 void gks_drv_mo(int fctid, int dx, int dy, int dimx, int *i_arr, int len_farr_1, double *f_arr_1, int len_farr_2,
                 double *f_arr_2, int len_c_arr, char *c_arr, void **ptr)
 {
-  int gksm = 2;
+  int gksm = 2, fd, level;
+  const char *env;
   p = (ws_state_list *)*ptr;
 
   switch (fctid)
@@ -281,6 +546,15 @@ void gks_drv_mo(int fctid, int dx, int dy, int dimx, int *i_arr, int len_farr_1,
       p->size = SEGM_SIZE;
       p->nbytes = p->position = 0;
 
+      p->recorder = NULL;
+      fd = p->conid > 100 ? p->conid - 100 : p->conid;
+      if ((env = gks_getenv("GKS_MF_COMPRESSION")) != NULL && *env && fd >= 0)
+        {
+          level = atoi(env);
+          if (level < 1 || level > 9) level = 1;
+          p->recorder = open_recorder(fd, level);
+        }
+
       gkss = (gks_state_list_t *)*ptr;
 
       *ptr = (void *)p;
@@ -289,6 +563,7 @@ void gks_drv_mo(int fctid, int dx, int dy, int dimx, int *i_arr, int len_farr_1,
     case 3: /* close workstation */
 
       if (p->position < p->nbytes && !p->empty) write_gksm(p->conid);
+      if (p->recorder != NULL) close_recorder(p->recorder);
 
       free(p->buffer);
       free(p);
@@ -378,6 +653,56 @@ void gks_drv_mo(int fctid, int dx, int dy, int dimx, int *i_arr, int len_farr_1,
     }
 }
 
+static char *inflate_items(char *s, int size)
+{
+  /* Walk the blocks up to the index (or up to the end of a recording which was cut short) twice, first to sum up
+   * the item bytes and then to inflate the blocks */
+  const unsigned char *u = (const unsigned char *)s;
+  unsigned long end = size, offset, nbytes = 0, zsize;
+  uLongf len;
+  char *items;
+  int pass, err, item_len;
+
+  if (size >= 8 + TRAILER_SIZE && memcmp(s + size - 8, TRAILER_MAGIC, 8) == 0)
+    end = get_u64(u + size - TRAILER_SIZE);
+  if (end > (unsigned long)size) end = size;
+
+  items = NULL;
+  for (pass = 0; pass < 2; pass++)
+    {
+      if (pass == 1) items = (char *)gks_malloc(nbytes + 2 * sizeof(int) + 1);
+      nbytes = 0;
+      for (offset = 8; offset + 8 <= end; offset += 8 + zsize)
+        {
+          len = get_u32(u + offset);
+          zsize = get_u32(u + offset + 4);
+          if (zsize > end - offset - 8) break;
+          if (pass == 1)
+            {
+              if ((err = uncompress((Bytef *)items + nbytes, &len, u + offset + 8, zsize)) != Z_OK)
+                {
+                  gks_perror("metafile is corrupted (err=%d)", err);
+                  break;
+                }
+            }
+          nbytes += len;
+        }
+    }
+  free(s);
+
+  /* Blocks are cut at arbitrary item positions, so the inflated data of a recording which was cut short usually ends
+   * inside of an item. The items are terminated after the last complete one by a zero length and function id, as the
+   * item readers look at both. */
+  for (offset = 0; offset + sizeof(int) <= nbytes; offset += item_len)
+    {
+      memcpy(&item_len, items + offset, sizeof(int));
+      if (item_len < 2 * (int)sizeof(int) || item_len > (long)(nbytes - offset)) break;
+    }
+  memset(items + offset, 0, 2 * sizeof(int));
+
+  return items;
+}
+
 static char *readfile(int fd)
 {
   int cc;
@@ -392,7 +717,11 @@ static char *readfile(int fd)
       size = (buf.st_size > 0) ? buf.st_size : 1000000;
       s = (char *)gks_malloc(size + 1);
 
-      if ((cc = read(fd, s, size)) != -1) s[cc] = '\0';
+      if ((cc = read(fd, s, size)) != -1)
+        {
+          s[cc] = '\0';
+          if (cc >= 8 && memcmp(s, HEADER_MAGIC, 8) == 0) s = inflate_items(s, cc);
+        }
     }
   else
     gks_perror("invalid file descriptor (%d)", fd);
@@ -768,10 +1097,11 @@ void gks_drv_mi(int fctid, int dx, int dy, int dimx, int *i_arr, int len_farr_1,
       s = c_arr;
 
       len = *(int *)(p->buffer + p->position);
-      if (len < i_arr[2] * 80)
+      if (len + (int)sizeof(int) <= i_arr[2] * 80)
         {
           memmove(s, p->buffer + p->position, len);
-          s[len] = '\0';
+          /* interp expects a zero length after the item */
+          memset(s + len, 0, sizeof(int));
         }
       else
         {
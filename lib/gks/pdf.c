@@ -77,12 +77,12 @@ typedef unsigned long uLong;
 #define pdf_save(p) pdf_printf(p->content, "q\n")
 #define pdf_restore(p) pdf_printf(p->content, "Q\n")
 #define pdf_clip(p) pdf_printf(p->content, "W n\n")
-#define pdf_moveto(p, x, y) pdf_printf(p->content, "%.2f %.2f m\n", x, y)
-#define pdf_lineto(p, x, y) pdf_printf(p->content, "%.2f %.2f l\n", x, y)
+#define pdf_moveto(p, x, y) pdf_coords(p->content, x, y, " m\n")
+#define pdf_lineto(p, x, y) pdf_coords(p->content, x, y, " l\n")
 #define pdf_closepath(p) pdf_printf(p->content, "h\n")
 #define pdf_stroke(p) pdf_printf(p->content, "S\n")
 #define pdf_eofill(p) pdf_printf(p->content, "f*\n")
-#define pdf_point(p, x, y) pdf_printf(p->content, "%.2f %.2f ", x, y)
+#define pdf_point(p, x, y) pdf_coords(p->content, x, y, " ")
 #define pdf_curveto(p) pdf_printf(p->content, "c\n")
 #define pdf_setdash(p, dash) pdf_printf(p->content, "%s 0 d\n", dash)
 
@@ -153,11 +153,11 @@ typedef struct ws_state_list_t
   int images, max_images;
 } ws_state_list;
 
-static ws_state_list *p;
+static GKS_THREAD_LOCAL ws_state_list *p;
 
-static gks_state_list_t *gkss;
+static GKS_THREAD_LOCAL gks_state_list_t *gkss;
 
-static double a[MAX_TNR], b[MAX_TNR], c[MAX_TNR], d[MAX_TNR];
+static GKS_THREAD_LOCAL double a[MAX_TNR], b[MAX_TNR], c[MAX_TNR], d[MAX_TNR];
 
 static const char *fonts[MAX_FONT] = {"Times-Roman",
                                       "Times-Italic",
@@ -224,7 +224,7 @@ static int map[32] = {22, 9,  5, 14, 18, 26, 13, 1, 24, 11, 7, 16, 20, 28, 13, 3
 static int rmap[29] = {8,  24, 16, 32, 3,  19, 11, 27, 2, 18, 10, 26, 23, 4, 20,
                        12, 28, 5,  21, 13, 29, 1,  17, 9, 25, 6,  22, 14, 30};
 
-static char bitmap[PATTERNS][17];
+static GKS_THREAD_LOCAL char bitmap[PATTERNS][17];
 
 static int predef_font[] = {1, 1, 1, -2, -3, -4};
 
@@ -240,8 +240,8 @@ static double yfac[6] = {0, -1.2, -1, -0.5, 0, 0.2};
 
 static void fill_routine(int n, double *px, double *py, int tnr);
 
-static char buf_array[NO_OF_BUFS][20];
-static int current_buf = 0;
+static GKS_THREAD_LOCAL char buf_array[NO_OF_BUFS][MAX_DTOA];
+static GKS_THREAD_LOCAL int current_buf = 0;
 
 static const char *pdf_double(double f)
 {
@@ -249,7 +249,7 @@ static const char *pdf_double(double f)
 
   if (fabs(f) < 0.00001) return "0";
 
-  sprintf(buf, "%.4g", f);
+  gks_dtoa(buf, f, 4, 'g');
   if (strchr(buf, 'e'))
     {
       if (fabs(f) < 1)
@@ -287,7 +287,7 @@ static void pdf_memcpy(PDF_stream *p, char *s, size_t n)
 {
   if (p->length + n >= p->size)
     {
-      while (p->length + n >= p->size) p->size += MEMORY_INCREMENT;
+      while (p->length + n >= p->size) p->size += p->size > MEMORY_INCREMENT ? p->size : MEMORY_INCREMENT;
       p->buffer = (Byte *)pdf_realloc(p->buffer, p->size);
     }
 
@@ -309,6 +309,19 @@ static void pdf_printf(PDF_stream *p, const char *args, ...)
   pdf_memcpy(p, s, strlen(s));
 }
 
+static void pdf_coords(PDF_stream *p, double x, double y, const char *op)
+{
+  char s[2 * MAX_DTOA + 16];
+  size_t len;
+
+  len = gks_dtoa(s, x, 2, 'f');
+  s[len++] = ' ';
+  len += gks_dtoa(s + len, y, 2, 'f');
+  strcpy(s + len, op);
+
+  pdf_memcpy(p, s, len + strlen(op));
+}
+
 static PDF_stream *pdf_alloc_stream(void)
 {
   PDF_stream *p;
@@ -1660,7 +1673,7 @@ static void draw_path(int n, double *px, double *py, int nc, int *codes)
           start_x = cur_x = x[0];
           start_y = cur_y = y[0];
           to_DC(1, x, y);
-          pdf_printf(p->content, "%.2f %.2f m\n", x[0], y[0]);
+          pdf_coords(p->content, x[0], y[0], " m\n");
           j += 1;
           break;
         case 'L':
@@ -1675,7 +1688,7 @@ static void draw_path(int n, double *px, double *py, int nc, int *codes)
           cur_x = x[0];
           cur_y = y[0];
           to_DC(1, x, y);
-          pdf_printf(p->content, "%.2f %.2f l\n", x[0], y[0]);
+          pdf_coords(p->content, x[0], y[0], " l\n");
           j += 1;
           break;
         case 'Q':
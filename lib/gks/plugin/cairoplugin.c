@@ -142,6 +142,7 @@ typedef struct ws_state_list_t
   char *path;
   void *mem;
   int mem_resizable;
+  gks_memory_target_t *target;
   double a, b, c, d;
   double window[4], viewport[4];
   double rgb[MAX_COLOR][3];
@@ -855,34 +856,66 @@ static void create_window(void)
 
 #endif
 
+/**
+ * Return the buffer that the next page of memory output is written to.
+ *
+ * For resizable memory the caller-owned buffer is reallocated to the current
+ * surface size, for a memory target the buffer selected by its index is used.
+ */
+static unsigned char *get_mem_buffer(int width, int height)
+{
+  if (p->target)
+    {
+      if (p->target->index != 0 && p->target->buffer[1] == NULL) p->target->index = 0;
+      return p->target->buffer[p->target->index];
+    }
+  else if (p->mem_resizable)
+    {
+      int *mem_info_ptr = (int *)p->mem;
+      unsigned char **mem_ptr_ptr = (unsigned char **)(mem_info_ptr + 3);
+      mem_info_ptr[0] = width;
+      mem_info_ptr[1] = height;
+      *mem_ptr_ptr = (unsigned char *)gks_realloc(*mem_ptr_ptr, width * height * 4);
+      return *mem_ptr_ptr;
+    }
+  return (unsigned char *)p->mem;
+}
+
+/**
+ * Hand a finished buffer over to the owner of a memory target and switch to
+ * the other buffer, so that the next page can be rendered while the owner is
+ * still processing this one.
+ */
+static void release_mem_buffer(unsigned char *mem, int width, int height)
+{
+  if (p->target)
+    {
+      if (p->target->buffer[1] != NULL) p->target->index = 1 - p->target->index;
+      if (p->target->completed != NULL) p->target->completed(p->target->arg, mem, width, height);
+    }
+}
+
 /**
  * Write an empty page or image.
  *
  * This is currently being ignored for most workstation types, but for memory
  * output this will ensure that the memory is initialized to white and, if
- * resizable memory is used, that the size is set correctly.
+ * resizable memory is used, that the size is set correctly. If `publish` is
+ * set, an empty page of a memory target is handed over to its owner like a
+ * rendered page. This is only done on update, not when a page is opened.
  */
-static void write_empty_page(void)
+static void write_empty_page(int publish)
 {
   if (p->wtype == 143 && p->mem)
     {
       int width = cairo_image_surface_get_width(p->surface);
       int height = cairo_image_surface_get_height(p->surface);
-      unsigned char *mem;
-      if (p->mem_resizable)
-        {
-          int *mem_info_ptr = (int *)p->mem;
-          unsigned char **mem_ptr_ptr = (unsigned char **)(mem_info_ptr + 3);
-          mem_info_ptr[0] = width;
-          mem_info_ptr[1] = height;
-          *mem_ptr_ptr = (unsigned char *)gks_realloc(*mem_ptr_ptr, width * height * 4);
-          mem = *mem_ptr_ptr;
-        }
-      else
+      unsigned char *mem = get_mem_buffer(width, height);
+      if (mem != NULL)
         {
-          mem = p->mem;
+          memset(mem, 255, height * width * 4);
+          if (publish) release_mem_buffer(mem, width, height);
         }
-      memset(mem, 255, height * width * 4);
     }
 }
 
@@ -923,7 +956,7 @@ static void open_page(void)
   else
     p->cr = cairo_create(p->surface);
 
-  write_empty_page();
+  write_empty_page(0);
 }
 
 static void close_page(void)
@@ -1296,47 +1329,37 @@ static void write_page(void)
       stride = cairo_image_surface_get_stride(p->surface);
       if (p->mem)
         {
-          unsigned char *mem;
-          if (p->mem_resizable)
-            {
-              int *mem_info_ptr = (int *)p->mem;
-              unsigned char **mem_ptr_ptr = (unsigned char **)(mem_info_ptr + 3);
-              mem_info_ptr[0] = width;
-              mem_info_ptr[1] = height;
-              *mem_ptr_ptr = (unsigned char *)gks_realloc(*mem_ptr_ptr, width * height * 4);
-              mem = *mem_ptr_ptr;
-            }
-          else
-            {
-              mem = p->mem;
-            }
+          unsigned char *mem = get_mem_buffer(width, height), *src, *dst;
+          unsigned int a;
+          if (mem == NULL) return;
           for (j = 0; j < height; j++)
             {
-              for (i = 0; i < width; i++)
+              src = data + j * stride;
+              dst = mem + j * width * 4;
+              for (i = 0; i < width; i++, src += 4, dst += 4)
                 {
-                  /* Reverse alpha pre-multiplication */
-                  double alpha = data[j * stride + i * 4 + 3];
-                  double red = data[j * stride + i * 4 + 2] * 255.0 / alpha;
-                  double green = data[j * stride + i * 4 + 1] * 255.0 / alpha;
-                  double blue = data[j * stride + i * 4 + 0] * 255.0 / alpha;
-                  if (red > 255)
+                  /* Reverse alpha pre-multiplication (BGRA -> RGBA) */
+                  a = src[3];
+                  if (a == 255)
                     {
-                      red = 255;
+                      dst[0] = src[2];
+                      dst[1] = src[1];
+                      dst[2] = src[0];
                     }
-                  if (green > 255)
+                  else if (a == 0)
                     {
-                      green = 255;
+                      dst[0] = dst[1] = dst[2] = 0;
                     }
-                  if (blue > 255)
+                  else
                     {
-                      blue = 255;
+                      dst[0] = (unsigned char)min(src[2] * 255u / a, 255u);
+                      dst[1] = (unsigned char)min(src[1] * 255u / a, 255u);
+                      dst[2] = (unsigned char)min(src[0] * 255u / a, 255u);
                     }
-                  mem[j * width * 4 + i * 4 + 0] = (unsigned char)red;
-                  mem[j * width * 4 + i * 4 + 1] = (unsigned char)green;
-                  mem[j * width * 4 + i * 4 + 2] = (unsigned char)blue;
-                  mem[j * width * 4 + i * 4 + 3] = (unsigned char)alpha;
+                  dst[3] = (unsigned char)a;
                 }
             }
+          release_mem_buffer(mem, width, height);
         }
     }
   else if (p->wtype == 144)
@@ -1824,6 +1847,7 @@ void gks_cairoplugin(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doub
       p->path = chars;
       p->wtype = ia[2];
       p->mem = NULL;
+      p->target = NULL;
 
       if (p->wtype == 140 || p->wtype == 144 || p->wtype == 145 || p->wtype == 146)
         {
@@ -1849,8 +1873,23 @@ void gks_cairoplugin(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doub
               fprintf(stderr, "Missing mem path. Expected !<width>x<height>@<pointer>.mem\n");
               exit(1);
             }
-          symbols_read = sscanf(path, "!resizable@%p.mem%n", &mem_ptr, &characters_read);
+          symbols_read = sscanf(path, "!target@%p.mem%n", &mem_ptr, &characters_read);
           if (symbols_read == 1 && path[characters_read] == 0 && mem_ptr != NULL)
+            {
+              p->mem_resizable = 0;
+              p->target = (gks_memory_target_t *)mem_ptr;
+              width = p->target->width;
+              height = p->target->height;
+              p->dpi = p->target->dpi > 0 ? p->target->dpi : 600;
+              if (width <= 0 || height <= 0 || p->target->buffer[0] == NULL)
+                {
+                  fprintf(stderr, "Invalid memory target. Expected a size and at least one buffer\n");
+                  exit(1);
+                }
+              if (p->target->index != 0 && p->target->buffer[1] == NULL) p->target->index = 0;
+            }
+          else if ((symbols_read = sscanf(path, "!resizable@%p.mem%n", &mem_ptr, &characters_read)) == 1 &&
+                   path[characters_read] == 0 && mem_ptr != NULL)
             {
               p->mem_resizable = 1;
               width = ((int *)mem_ptr)[0];
@@ -1968,7 +2007,7 @@ void gks_cairoplugin(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doub
             }
           else
             {
-              write_empty_page();
+              write_empty_page(1);
             }
           unlock();
         }
@@ -16,8 +16,10 @@
 #include <GL/glx.h>
 #endif
 PFNGLBUFFERDATAPROC glBufferData;
+PFNGLBUFFERSUBDATAPROC glBufferSubData;
 PFNGLBINDBUFFERPROC glBindBuffer;
 PFNGLGENBUFFERSPROC glGenBuffers;
+PFNGLDELETEBUFFERSPROC glDeleteBuffers;
 #endif
 
 #endif
@@ -46,6 +48,8 @@ DLLEXPORT void gks_glplugin(int fctid, int dx, int dy, int dimx, int *i_arr, int
 #ifndef NO_GLFW
 
 #define MAX_POINTS 2048
+#define MAX_VERTICES 65536
+#define MAX_BATCHES 1024
 #define MAX_SELECTIONS 100
 #define PATTERNS 120
 #define HATCH_STYLE 108
@@ -98,6 +102,17 @@ static gks_state_list_t *gkss;
 
 static double a[MAX_TNR], b[MAX_TNR], c[MAX_TNR], d[MAX_TNR];
 
+typedef struct
+{
+  GLenum mode;
+  int first, count;
+  float rgba[4];
+  float linewidth;
+  GLint factor;
+  GLushort pattern;
+  int start;
+} gl_batch;
+
 typedef struct ws_state_list_t
 {
   int state;
@@ -112,6 +127,13 @@ typedef struct ws_state_list_t
   float rgb[MAX_COLOR][3];
   float transparency;
   int rect[MAX_TNR][4];
+  GLfloat *vertices;
+  int nvertices, max_vertices;
+  GLuint vbo;
+  int vbo_size, uploaded;
+  gl_batch *batches;
+  int nbatches, max_batches, batch_open, drawn;
+  int item, cached;
 } ws_state_list;
 
 static ws_state_list *p;
@@ -218,12 +240,17 @@ static void init_colors(void)
     }
 }
 
+static void set_rgba(int index, float *rgba)
+{
+  memmove(rgba, p->rgb[index], 3 * sizeof(float));
+  rgba[3] = p->transparency;
+}
+
 static void set_color(int index)
 {
   float rgba[4];
 
-  memmove(rgba, p->rgb[index], 3 * sizeof(float));
-  rgba[3] = p->transparency;
+  set_rgba(index, rgba);
 
   glColor4fv(rgba);
 }
@@ -234,12 +261,16 @@ static void gl_init(void)
 #define _P (const GLubyte *)
 #ifdef _WIN32
   glBufferData = (PFNGLBUFFERDATAPROC)wglGetProcAddress(_P "glBufferData");
+  glBufferSubData = (PFNGLBUFFERSUBDATAPROC)wglGetProcAddress(_P "glBufferSubData");
   glBindBuffer = (PFNGLBINDBUFFERPROC)wglGetProcAddress(_P "glBindBuffer");
   glGenBuffers = (PFNGLGENBUFFERSPROC)wglGetProcAddress(_P "glGenBuffers");
+  glDeleteBuffers = (PFNGLDELETEBUFFERSPROC)wglGetProcAddress(_P "glDeleteBuffers");
 #else
   glBufferData = (PFNGLBUFFERDATAPROC)glXGetProcAddress(_P "glBufferData");
+  glBufferSubData = (PFNGLBUFFERSUBDATAPROC)glXGetProcAddress(_P "glBufferSubData");
   glBindBuffer = (PFNGLBINDBUFFERPROC)glXGetProcAddress(_P "glBindBuffer");
   glGenBuffers = (PFNGLGENBUFFERSPROC)glXGetProcAddress(_P "glGenBuffers");
+  glDeleteBuffers = (PFNGLDELETEBUFFERSPROC)glXGetProcAddress(_P "glDeleteBuffers");
 #endif
 #undef _P
 #endif
@@ -317,24 +348,170 @@ static void update(void)
     }
 }
 
-static void line_routine(int num_points, double *x, double *y, int linetype, int tnr)
+static void open_batch(GLenum mode, int color, float linewidth, GLint factor, GLushort pattern)
+{
+  gl_batch *batch;
+  float rgba[4];
+
+  set_rgba(color, rgba);
+
+  if (p->batch_open && mode != GL_LINE_STRIP)
+    {
+      batch = p->batches + p->nbatches - 1;
+      if (batch->mode == mode && memcmp(batch->rgba, rgba, sizeof(rgba)) == 0 && batch->linewidth == linewidth &&
+          batch->factor == factor && batch->pattern == pattern)
+        return;
+    }
+
+  if (p->nbatches == p->max_batches)
+    {
+      p->max_batches += MAX_BATCHES;
+      p->batches = (gl_batch *)gks_realloc(p->batches, p->max_batches * sizeof(gl_batch));
+    }
+  batch = p->batches + p->nbatches++;
+  batch->mode = mode;
+  batch->first = p->nvertices;
+  batch->count = 0;
+  memmove(batch->rgba, rgba, sizeof(rgba));
+  batch->linewidth = linewidth;
+  batch->factor = factor;
+  batch->pattern = pattern;
+  batch->start = p->item;
+
+  p->batch_open = 1;
+}
+
+static void add_vertex(double x, double y)
+{
+  if (p->nvertices == p->max_vertices)
+    {
+      p->max_vertices = p->max_vertices ? 2 * p->max_vertices : MAX_VERTICES;
+      p->vertices = (GLfloat *)gks_realloc(p->vertices, p->max_vertices * 2 * sizeof(GLfloat));
+    }
+  p->vertices[2 * p->nvertices] = (GLfloat)x;
+  p->vertices[2 * p->nvertices + 1] = (GLfloat)y;
+  p->nvertices++;
+  p->batches[p->nbatches - 1].count++;
+}
+
+static void add_triangle(double x0, double y0, double x1, double y1, double x2, double y2)
+{
+  /* degenerate triangles (e.g. from closing vertices) don't cover any pixels */
+  if ((x1 - x0) * (y2 - y0) == (x2 - x0) * (y1 - y0)) return;
+
+  add_vertex(x0, y0);
+  add_vertex(x1, y1);
+  add_vertex(x2, y2);
+}
+
+static void add_triangle_fan(int n, double *x, double *y)
+{
+  int i;
+
+  for (i = 1; i < n - 1; i++) add_triangle(x[0], y[0], x[i], y[i], x[i + 1], y[i + 1]);
+}
+
+static void add_line_loop(int n, double *x, double *y)
 {
   int i;
-  double xn, yn, xd, yd;
+
+  for (i = 0; i < n; i++)
+    {
+      add_vertex(x[i], y[i]);
+      add_vertex(x[(i + 1) % n], y[(i + 1) % n]);
+    }
+}
+
+static void reset_batches(void)
+{
+  p->nvertices = 0;
+  p->uploaded = 0;
+  p->nbatches = 0;
+  p->batch_open = 0;
+  p->drawn = 0;
+  p->cached = 0;
+}
+
+static void draw_batches(int offset)
+/*
+   Draw the batches of all primitives which precede the display list item at
+   the given offset and have not been drawn yet
+ */
+{
   const double modelview_matrix[16] = {2.0 / p->width, 0, 0, -1, 0, -2.0 / p->height, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1};
+  gl_batch *batch;
+
+  p->batch_open = 0;
+
+  if (p->drawn == p->nbatches || p->batches[p->drawn].start >= offset) return;
+
+  if (!p->vbo) glGenBuffers(1, &p->vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, p->vbo);
+
+  /* only transfer the vertices of primitives that were added since the last upload */
+  if (p->vbo_size < p->nvertices)
+    {
+      p->vbo_size = p->max_vertices;
+      glBufferData(GL_ARRAY_BUFFER, p->vbo_size * 2 * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+      p->uploaded = 0;
+    }
+  if (p->uploaded < p->nvertices)
+    {
+      glBufferSubData(GL_ARRAY_BUFFER, p->uploaded * 2 * sizeof(GLfloat),
+                      (p->nvertices - p->uploaded) * 2 * sizeof(GLfloat), p->vertices + 2 * p->uploaded);
+      p->uploaded = p->nvertices;
+    }
 
   glMatrixMode(GL_MODELVIEW);
   glLoadTransposeMatrixd(modelview_matrix);
-  glBegin(GL_LINE_STRIP);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, 0);
+
+  while (p->drawn < p->nbatches && p->batches[p->drawn].start < offset)
+    {
+      batch = p->batches + p->drawn++;
+
+      glColor4fv(batch->rgba);
+      glLineWidth(batch->linewidth);
+      if (batch->pattern)
+        {
+          glLineStipple(batch->factor, batch->pattern);
+          glEnable(GL_LINE_STIPPLE);
+        }
+      glDrawArrays(batch->mode, batch->first, batch->count);
+      if (batch->pattern) glDisable(GL_LINE_STIPPLE);
+    }
+
+  glLineWidth(1.0);
+  set_color(1);
+  glLoadIdentity();
+}
+
+static void line_routine(int num_points, double *x, double *y, int linetype, int tnr)
+{
+  int i;
+  double xn, yn, xd, yd, x0 = 0, y0 = 0;
+
   for (i = 0; i < num_points; ++i)
     {
       WC_to_NDC(x[i], y[i], gkss->cntnr, xn, yn);
       seg_xform(&xn, &yn);
       NDC_to_DC(xn, yn, xd, yd);
-      glVertex2d(xd, yd);
+      if (p->batches[p->nbatches - 1].mode == GL_LINES)
+        {
+          /* solid lines are decomposed into segments, so that they can be merged into one batch */
+          if (i > 0)
+            {
+              add_vertex(x0, y0);
+              add_vertex(xd, yd);
+            }
+          x0 = xd;
+          y0 = yd;
+        }
+      else
+        add_vertex(xd, yd);
     }
-  glEnd();
-  glLoadIdentity();
 }
 
 static void polyline(int num_points, double *x, double *y)
@@ -351,16 +528,12 @@ static void polyline(int num_points, double *x, double *y)
 
   ln_width = max(1, nint(ln_width));
 
-  glLineWidth(ln_width);
-  glLineStipple(nint(ln_width * factor[ln_type + 8]), pattern[ln_type + 8]);
-  glEnable(GL_LINE_STIPPLE);
-  set_color(ln_color);
+  if (pattern[ln_type + 8] == 0xFFFF)
+    open_batch(GL_LINES, ln_color, ln_width, 0, 0);
+  else
+    open_batch(GL_LINE_STRIP, ln_color, ln_width, nint(ln_width * factor[ln_type + 8]), pattern[ln_type + 8]);
 
   line_routine(num_points, x, y, ln_type, gkss->cntnr);
-
-  set_color(1);
-  glDisable(GL_LINE_STIPPLE);
-  glLineWidth(1.0);
 }
 
 static void draw_marker(double xn, double yn, int mtype, double mscale, int mcolor)
@@ -371,11 +544,10 @@ static void draw_marker(double xn, double yn, int mtype, double mscale, int mcol
   static int is_concav[37] = {0, 0, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0,
                               0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-  const double modelview_matrix[16] = {2.0 / p->width, 0, 0, -1, 0, -2.0 / p->height, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1};
-
-  int r, i, num_segments;
+  int r, i, n, num_segments;
   int pc, op;
   double scale, x, y, xr, yr, c, s, tmp;
+  double px[MAX_POINTS], py[MAX_POINTS];
 
   r = (int)(3 * mscale);
   scale = 0.01 * mscale / 3.0;
@@ -390,60 +562,55 @@ static void draw_marker(double xn, double yn, int mtype, double mscale, int mcol
   pc = 0;
   mtype = (2 * r > 1) ? mtype + marker_off : marker_off + 1;
 
-  glMatrixMode(GL_MODELVIEW);
-  glLoadTransposeMatrixd(modelview_matrix);
-  set_color(mcolor);
-
   do
     {
       op = marker[mtype][pc];
       switch (op)
         {
         case 1: /* point */
-          glBegin(GL_POINTS);
-          glVertex2d(x, y);
-          glEnd();
+          open_batch(GL_POINTS, mcolor, 1, 0, 0);
+          add_vertex(x, y);
           break;
 
         case 2: /* line */
-          glBegin(GL_LINES);
+          open_batch(GL_LINES, mcolor, 1, 0, 0);
           for (i = 0; i < 2; i++)
             {
               xr = scale * marker[mtype][pc + 2 * i + 1];
               yr = -scale * marker[mtype][pc + 2 * i + 2];
               seg_xform_rel(&xr, &yr);
-              glVertex2d(x - xr, y + yr);
+              add_vertex(x - xr, y + yr);
             }
-          glEnd();
           pc += 4;
           break;
 
         case 3: /* polygon */
         case 4: /* filled polygon */
         case 5: /* hollow polygon */
-          if (op == 4)
-            {
-              glBegin(GL_TRIANGLE_FAN);
-            }
-          else if (op == 5)
-            {
-              set_color(0);
-              glBegin(GL_TRIANGLE_FAN);
-            }
-          else
+          n = 0;
+          if (op != 3 && is_concav[mtype])
             {
-              glBegin(GL_LINE_LOOP);
+              px[n] = x;
+              py[n++] = y;
             }
-          if (op != 3 && is_concav[mtype]) glVertex2d(x, y);
           for (i = 0; i < marker[mtype][pc + 1]; i++)
             {
               xr = scale * marker[mtype][pc + 2 + 2 * i];
               yr = -scale * marker[mtype][pc + 3 + 2 * i];
               seg_xform_rel(&xr, &yr);
-              glVertex2d(x - xr, y + yr);
+              px[n] = x - xr;
+              py[n++] = y + yr;
+            }
+          if (op == 3)
+            {
+              open_batch(GL_LINES, mcolor, 1, 0, 0);
+              add_line_loop(n, px, py);
+            }
+          else
+            {
+              open_batch(GL_TRIANGLES, op == 4 ? mcolor : 0, 1, 0, 0);
+              add_triangle_fan(n, px, py);
             }
-          glEnd();
-          if (op == 5) set_color(mcolor);
           pc += 1 + 2 * marker[mtype][pc + 1];
           break;
 
@@ -451,41 +618,35 @@ static void draw_marker(double xn, double yn, int mtype, double mscale, int mcol
         case 7: /* filled arc */
         case 8: /* hollow arc */
           {
-            num_segments = 4 * r;
+            num_segments = min(4 * r, MAX_POINTS);
             c = cosf(2 * M_PI / (num_segments - 1));
             s = sinf(2 * M_PI / (num_segments - 1));
             xr = r;
             yr = 0;
-            if (op == 7)
+            for (i = 0; i < num_segments; i++)
               {
-                glBegin(GL_TRIANGLE_FAN);
+                px[i] = x + xr;
+                py[i] = y + yr;
+                tmp = xr;
+                xr = c * xr - s * yr;
+                yr = s * tmp + c * yr;
               }
-            else if (op == 8)
+            if (op == 6)
               {
-                set_color(0);
-                glBegin(GL_TRIANGLE_FAN);
+                open_batch(GL_LINES, mcolor, 1, 0, 0);
+                add_line_loop(num_segments, px, py);
               }
             else
               {
-                glBegin(GL_LINE_LOOP);
+                open_batch(GL_TRIANGLES, op == 7 ? mcolor : 0, 1, 0, 0);
+                add_triangle_fan(num_segments, px, py);
               }
-            for (i = 0; i < num_segments; i++)
-              {
-                glVertex2d(x + xr, y + yr);
-                tmp = xr;
-                xr = c * xr - s * yr;
-                yr = s * tmp + c * yr;
-              }
-            glEnd();
-            if (op == 8) set_color(mcolor);
           }
           break;
         }
       pc++;
     }
   while (op != 0);
-
-  glLoadIdentity();
 }
 
 static void polymarker(int n, double *px, double *py)
@@ -499,8 +660,6 @@ static void polymarker(int n, double *px, double *py)
   mk_size = gkss->asf[4] ? gkss->mszsc : 1;
   mk_color = gkss->asf[5] ? gkss->pmcoli : 1;
 
-  glLineWidth(1);
-
   clrt = gkss->viewport[gkss->cntnr];
 
   for (i = 0; i < n; i++)
@@ -512,7 +671,6 @@ static void polymarker(int n, double *px, double *py)
           draw_marker(x, y, mk_type, mk_size, mk_color);
         }
     }
-  glLineWidth(1.0);
 }
 
 static void fill_routine(int n, double *px, double *py, int tnr)
@@ -603,16 +761,60 @@ static void fill_routine(int n, double *px, double *py, int tnr)
   glLoadIdentity();
 }
 
+static int fill_pattern(void)
+{
+  int fl_inter;
+
+  fl_inter = gkss->asf[10] ? gkss->ints : predef_ints[gkss->findex - 1];
+
+  return fl_inter == GKS_K_INTSTYLE_PATTERN || fl_inter == GKS_K_INTSTYLE_HATCH;
+}
+
 static void fillarea(int n, double *px, double *py)
 {
-  int fl_color;
+  int fl_inter, fl_color, i;
+  double x, y, xd, yd, x0 = 0, y0 = 0, x1 = 0, y1 = 0;
 
+  fl_inter = gkss->asf[10] ? gkss->ints : predef_ints[gkss->findex - 1];
   fl_color = gkss->asf[12] ? gkss->facoli : 1;
-  set_color(fl_color);
 
-  fill_routine(n, px, py, gkss->cntnr);
+  if (fl_inter == GKS_K_INTSTYLE_HOLLOW || fl_inter == GKS_K_INTSTYLE_SOLID)
+    {
+      open_batch(fl_inter == GKS_K_INTSTYLE_SOLID ? GL_TRIANGLES : GL_LINES, fl_color, 1, 0, 0);
+      for (i = 0; i < n; i++)
+        {
+          WC_to_NDC(px[i], py[i], gkss->cntnr, x, y);
+          seg_xform(&x, &y);
+          NDC_to_DC(x, y, xd, yd);
+          if (i == 0)
+            {
+              x0 = xd;
+              y0 = yd;
+            }
+          else if (fl_inter == GKS_K_INTSTYLE_HOLLOW)
+            {
+              add_vertex(x1, y1);
+              add_vertex(xd, yd);
+            }
+          else if (i > 1)
+            add_triangle(x0, y0, x1, y1, xd, yd);
+          x1 = xd;
+          y1 = yd;
+        }
+      if (fl_inter == GKS_K_INTSTYLE_HOLLOW && n > 1)
+        {
+          add_vertex(x1, y1);
+          add_vertex(x0, y0);
+        }
+    }
+  else
+    {
+      set_color(fl_color);
+
+      fill_routine(n, px, py, gkss->cntnr);
 
-  set_color(1);
+      set_color(1);
+    }
 }
 
 static void cellarray(double xmin, double xmax, double ymin, double ymax, int dx, int dy, int dimx, int *colia,
@@ -822,6 +1024,28 @@ static void text(double x_pos, double y_pos, int nchars, char *text)
 #endif
 }
 
+static int is_barrier(int fctid)
+{
+  switch (fctid)
+    {
+    case 2:
+    case 14:
+    case 16:
+    case 17:
+    case 50:
+    case 52:
+    case 53:
+    case 54:
+    case 55:
+    case 201:
+      return 1;
+
+    case 15:
+      return fill_pattern();
+    }
+  return 0;
+}
+
 static void interp(char *str)
 {
   char *s;
@@ -835,9 +1059,13 @@ static void interp(char *str)
 
   s = str;
 
+  p->drawn = 0;
+  p->batch_open = 0;
+
   RESOLVE(len, int, sizeof(int));
   while (*len)
     {
+      p->item = sp - sizeof(int);
       RESOLVE(f, int, sizeof(int));
 
       switch (*f)
@@ -948,6 +1176,9 @@ static void interp(char *str)
           exit(1);
         }
 
+      /* items which draw directly or change the GL state have to be preceded by all pending primitives */
+      if (is_barrier(*f)) draw_batches(p->item);
+
       switch (*f)
         {
         case 2:
@@ -970,11 +1201,12 @@ static void interp(char *str)
           break;
 
         case 12:
-          polyline(i_arr[0], f_arr_1, f_arr_2);
+          /* primitives interpreted before are still kept in the vertex buffer */
+          if (p->item >= p->cached) polyline(i_arr[0], f_arr_1, f_arr_2);
           break;
 
         case 13:
-          polymarker(i_arr[0], f_arr_1, f_arr_2);
+          if (p->item >= p->cached) polymarker(i_arr[0], f_arr_1, f_arr_2);
           break;
 
         case 14:
@@ -982,7 +1214,7 @@ static void interp(char *str)
           break;
 
         case 15:
-          fillarea(i_arr[0], f_arr_1, f_arr_2);
+          if (p->item >= p->cached || fill_pattern()) fillarea(i_arr[0], f_arr_1, f_arr_2);
           break;
 
         case 16:
@@ -1139,6 +1371,9 @@ static void interp(char *str)
 
       RESOLVE(len, int, sizeof(int));
     }
+  draw_batches(sp);
+  p->cached = sp - sizeof(int);
+
   memmove(gkss, &saved_gkss, sizeof(gks_state_list_t));
 }
 
@@ -1167,6 +1402,9 @@ void gks_glplugin(int fctid, int dx, int dy, int dimx, int *i_arr, int len_f_arr
       break;
 
     case 3:
+      if (p->vbo) glDeleteBuffers(1, &p->vbo);
+      if (p->vertices) free(p->vertices);
+      if (p->batches) free(p->batches);
       close_window();
       gks_free(p);
       p = NULL;
@@ -1176,6 +1414,7 @@ void gks_glplugin(int fctid, int dx, int dy, int dimx, int *i_arr, int len_f_arr
       /* set display list length to zero */
       memset(p->dl.buffer, 0, sizeof(int));
       p->dl.nbytes = 0;
+      reset_batches();
       glClear(GL_COLOR_BUFFER_BIT);
       break;
 
@@ -143,7 +143,7 @@ static void pgf_memcpy(PGF_stream *p, char *s, size_t n)
 {
   if (p->length + n >= p->size)
     {
-      while (p->length + n >= p->size) p->size += MEMORY_INCREMENT;
+      while (p->length + n >= p->size) p->size += p->size > MEMORY_INCREMENT ? p->size : MEMORY_INCREMENT;
       p->buffer = (unsigned char *)gks_realloc(p->buffer, p->size);
     }
 
@@ -165,6 +165,23 @@ static void pgf_printf(PGF_stream *p, const char *args, ...)
   pgf_memcpy(p, s, strlen(s));
 }
 
+static void pgf_point(PGF_stream *p, const char *op, double x, const char *sep, double y)
+{
+  char s[2 * MAX_DTOA + 32];
+  size_t len;
+
+  len = strlen(op);
+  memcpy(s, op, len);
+  s[len++] = '(';
+  len += gks_dtoa(s + len, x, 6, 'f');
+  strcpy(s + len, sep);
+  len += strlen(sep);
+  len += gks_dtoa(s + len, y, 6, 'f');
+  s[len++] = ')';
+
+  pgf_memcpy(p, s, len);
+}
+
 static PGF_stream *pgf_alloc_stream(void)
 {
   PGF_stream *p;
@@ -384,7 +401,7 @@ static void stroke(void)
 
   for (i = 1; i < p->npoints; i++)
     {
-      pgf_printf(p->stream, " -- (%f, %f)", p->points[i].x, p->points[i].y);
+      pgf_point(p->stream, " -- ", p->points[i].x, ", ", p->points[i].y);
     }
 
   p->npoints = 0;
@@ -422,7 +439,7 @@ static void line_routine(int n, double *px, double *py, int linetype, int tnr)
       seg_xform(&x, &y);
       NDC_to_DC(x, y, xi, yi);
 
-      pgf_printf(p->stream, " -- (%f,%f)", xi, yi);
+      pgf_point(p->stream, " -- ", xi, ",", yi);
     }
   pgf_printf(p->stream, ";\n");
 }
@@ -468,12 +485,12 @@ static void fill_routine(int n, double *px, double *py, int tnr)
 
       if (nan_found)
         {
-          pgf_printf(p->stream, " (%f,%f)", ix, iy);
+          pgf_point(p->stream, " ", ix, ",", iy);
           nan_found = 0;
         }
       else
         {
-          pgf_printf(p->stream, " -- (%f,%f)", ix, iy);
+          pgf_point(p->stream, " -- ", ix, ",", iy);
         }
     }
 
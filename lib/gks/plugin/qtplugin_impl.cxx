@@ -103,6 +103,7 @@ typedef struct ws_state_list_t
   double alpha, angle;
   QPixmap *pattern[PATTERNS];
   int empty, resized_by_user, resize_requested_by_application;
+  gks_state_list_t dl_state;
 } ws_state_list;
 
 static ws_state_list p_, *p = &p_;
@@ -1004,6 +1005,11 @@ static void interp(char *str)
 
   s = str;
 
+  memmove(&saved_gkss, gkss, sizeof(gks_state_list_t));
+
+  /* a display list not starting with an open workstation item continues the previously interpreted one */
+  if (*(int *)s != 0 && *(int *)(s + sizeof(int)) != 2) memmove(gkss, &p->dl_state, sizeof(gks_state_list_t));
+
   RESOLVE(len, int, sizeof(int));
   while (*len)
     {
@@ -1121,7 +1127,6 @@ static void interp(char *str)
       switch (*f)
         {
         case 2:
-          memmove(&saved_gkss, gkss, sizeof(gks_state_list_t));
           memmove(gkss, sl, sizeof(gks_state_list_t));
 
           gkss->fontfile = saved_gkss.fontfile;
@@ -1330,6 +1335,7 @@ static void interp(char *str)
       RESOLVE(len, int, sizeof(int));
     }
 
+  memmove(&p->dl_state, gkss, sizeof(gks_state_list_t));
   memmove(gkss, &saved_gkss, sizeof(gks_state_list_t));
 }
 
@@ -161,7 +161,7 @@ static void svg_memcpy(SVG_stream *p, char *s, size_t n)
 {
   if (p->length + n >= p->size)
     {
-      while (p->length + n >= p->size) p->size += MEMORY_INCREMENT;
+      while (p->length + n >= p->size) p->size += p->size > MEMORY_INCREMENT ? p->size : MEMORY_INCREMENT;
       p->buffer = (unsigned char *)realloc(p->buffer, p->size);
     }
 
@@ -183,6 +183,21 @@ static void svg_printf(SVG_stream *p, const char *args, ...)
   svg_memcpy(p, s, strlen(s));
 }
 
+static void svg_point(SVG_stream *p, const char *op, double x, char sep, double y)
+{
+  char s[2 * MAX_DTOA + 16];
+  size_t len;
+
+  len = strlen(op);
+  memcpy(s, op, len);
+  len += gks_dtoa(s + len, x, 6, 'g');
+  s[len++] = sep;
+  len += gks_dtoa(s + len, y, 6, 'g');
+  s[len++] = ' ';
+
+  svg_memcpy(p, s, len);
+}
+
 static SVG_stream *svg_alloc_stream(void)
 {
   SVG_stream *p;
@@ -453,7 +468,7 @@ static void draw_marker(double xn, double yn, int mtype, double mscale, int mcol
               xr = scale * marker[mtype][pc + 2 + 2 * i];
               yr = -scale * marker[mtype][pc + 3 + 2 * i];
               seg_xform_rel(&xr, &yr);
-              svg_printf(p->stream, "%g,%g ", x - xr, y + yr);
+              svg_point(p->stream, "", x - xr, ',', y + yr);
               if (!((i + 1) % 10))
                 {
                   svg_printf(p->stream, "\n  ");
@@ -472,7 +487,7 @@ static void draw_marker(double xn, double yn, int mtype, double mscale, int mcol
               xr = scale * marker[mtype][pc + 2 + 2 * i];
               yr = -scale * marker[mtype][pc + 3 + 2 * i];
               seg_xform_rel(&xr, &yr);
-              svg_printf(p->stream, "%c%g %g ", i == 0 ? 'M' : 'L', x - xr, y + yr);
+              svg_point(p->stream, i == 0 ? "M" : "L", x - xr, ' ', y + yr);
             }
           svg_printf(p->stream, "Z\" fill=\"#%02x%02x%02x\" fill-rule=\"evenodd\" fill-opacity=\"%g\" ",
                      p->rgb[color][0], p->rgb[color][1], p->rgb[color][2], p->transparency);
@@ -564,7 +579,7 @@ static void stroke(void)
   svg_printf(p->stream, "points=\"\n  ");
   for (i = 0; i < p->npoints; i++)
     {
-      svg_printf(p->stream, "%g,%g ", p->points[i].x, p->points[i].y);
+      svg_point(p->stream, "", p->points[i].x, ',', p->points[i].y);
       if (!((i + 1) % 10))
         {
           svg_printf(p->stream, "\n  ");
@@ -604,7 +619,7 @@ static void line_routine(int n, double *px, double *py, int linetype, int tnr)
         }
       svg_printf(p->stream, "stroke-dasharray=\"%s\" ", s);
     }
-  svg_printf(p->stream, "points=\"\n  %g,%g ", x0, y0);
+  svg_point(p->stream, "points=\"\n  ", x0, ',', y0);
 
   xim1 = x0;
   yim1 = y0;
@@ -616,7 +631,7 @@ static void line_routine(int n, double *px, double *py, int linetype, int tnr)
 
       if (i == 1 || xi != xim1 || yi != yim1)
         {
-          svg_printf(p->stream, "%g,%g ", xi, yi);
+          svg_point(p->stream, "", xi, ',', yi);
           xim1 = xi;
           yim1 = yi;
         }
@@ -721,12 +736,12 @@ static void fill_routine(int n, double *px, double *py, int tnr)
 
       if (i == 0 || nan_found)
         {
-          svg_printf(p->stream, "M%g %g ", ix, iy);
+          svg_point(p->stream, "M", ix, ' ', iy);
           nan_found = 0;
         }
       else
         {
-          svg_printf(p->stream, "L%g %g ", ix, iy);
+          svg_point(p->stream, "L", ix, ' ', iy);
         }
       if (!((i + 1) % 10))
         {
@@ -1105,7 +1120,7 @@ static void draw_path(int n, double *px, double *py, int nc, int *codes)
           start_x = cur_x = x[0];
           start_y = cur_y = y[0];
           to_DC(1, x, y);
-          svg_printf(p->stream, "M%g %g ", x[0], y[0]);
+          svg_point(p->stream, "M", x[0], ' ', y[0]);
           j += 1;
           break;
         case 'L':
@@ -1120,7 +1135,7 @@ static void draw_path(int n, double *px, double *py, int nc, int *codes)
           cur_x = x[0];
           cur_y = y[0];
           to_DC(1, x, y);
-          svg_printf(p->stream, "L%g %g ", x[0], y[0]);
+          svg_point(p->stream, "L", x[0], ' ', y[0]);
           j += 1;
           break;
         case 'Q':
@@ -37,7 +37,7 @@ static void encode_frame(movie_t movie)
     }
 }
 
-void vc_movie_append_frame(movie_t movie, frame_t frame)
+static void encode_image(movie_t movie, frame_t frame)
 {
   int is_gif = movie->cdc_ctx->pix_fmt == AV_PIX_FMT_PAL8;
   int height = movie->cdc_ctx->height;
@@ -87,13 +87,88 @@ void vc_movie_append_frame(movie_t movie, frame_t frame)
     }
   else
     {
+      /* with frame threading the codec may still reference the buffers of the previous frame */
+      if (av_frame_make_writable(movie->frame) < 0)
+        {
+          fprintf(stderr, "Could not make video frame writable\n");
+          return;
+        }
       sws_scale(movie->sws_ctx, src_slice, src_stride, 0, frame->height, movie->frame->data, movie->frame->linesize);
     }
   encode_frame(movie);
   movie->frame->pts++;
 }
 
-movie_t vc_movie_create(const char *path, int framerate, int bitrate, int width, int height)
+static void *encoder_thread(void *arg)
+{
+  movie_t movie = (movie_t)arg;
+  frame_t frame;
+
+  pthread_mutex_lock(&movie->mutex);
+  for (;;)
+    {
+      while (movie->queue_count == 0 && !movie->finishing) pthread_cond_wait(&movie->frame_ready, &movie->mutex);
+      if (movie->queue_count == 0) break;
+
+      /* the frame stays in the queue while it is encoded, so the plotting thread cannot reuse its buffer */
+      frame = movie->queue + movie->queue_head;
+      pthread_mutex_unlock(&movie->mutex);
+
+      encode_image(movie, frame);
+
+      pthread_mutex_lock(&movie->mutex);
+      movie->queue_head = (movie->queue_head + 1) % VC_QUEUE_SIZE;
+      movie->queue_count--;
+      pthread_cond_signal(&movie->frame_done);
+    }
+  pthread_mutex_unlock(&movie->mutex);
+
+  return NULL;
+}
+
+/*
+ * Return a pooled frame with a buffer for an RGBA image of the given size. The caller fills the buffer and passes the
+ * frame to `vc_movie_append_frame`. If all frames are waiting for the encoder, the call blocks until one is free.
+ */
+frame_t vc_movie_next_frame(movie_t movie, int width, int height)
+{
+  frame_t frame;
+
+  pthread_mutex_lock(&movie->mutex);
+  while (movie->queue_count == VC_QUEUE_SIZE) pthread_cond_wait(&movie->frame_done, &movie->mutex);
+  frame = movie->queue + (movie->queue_head + movie->queue_count) % VC_QUEUE_SIZE;
+  pthread_mutex_unlock(&movie->mutex);
+
+  if (frame->size < width * height * 4)
+    {
+      gks_free(frame->data);
+      frame->size = width * height * 4;
+      frame->data = (unsigned char *)gks_malloc(frame->size);
+    }
+  frame->width = width;
+  frame->height = height;
+
+  return frame;
+}
+
+/*
+ * Queue a frame obtained from `vc_movie_next_frame` for encoding. Scaling, color quantization and encoding run on the
+ * encoder thread, so the caller can render the next frame in the meantime.
+ */
+void vc_movie_append_frame(movie_t movie, frame_t frame)
+{
+  pthread_mutex_lock(&movie->mutex);
+  if (frame == movie->queue + (movie->queue_head + movie->queue_count) % VC_QUEUE_SIZE)
+    {
+      movie->queue_count++;
+      pthread_cond_signal(&movie->frame_ready);
+    }
+  else
+    fprintf(stderr, "Frame was not obtained from vc_movie_next_frame\n");
+  pthread_mutex_unlock(&movie->mutex);
+}
+
+movie_t vc_movie_create(const char *path, int framerate, int bitrate, int width, int height, int threads)
 {
   const AVCodec *codec;
   int ret;
@@ -145,6 +220,9 @@ movie_t vc_movie_create(const char *path, int framerate, int bitrate, int width,
   movie->cdc_ctx->height = height;
   movie->cdc_ctx->time_base = (AVRational){1, framerate};
   movie->cdc_ctx->framerate = (AVRational){framerate, 1};
+  /* a thread count of 0 lets the codec choose the number of threads */
+  movie->cdc_ctx->thread_count = threads;
+  movie->cdc_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
 
   if (movie->fmt_ctx->oformat->video_codec == AV_CODEC_ID_GIF)
     {
@@ -228,11 +306,48 @@ movie_t vc_movie_create(const char *path, int framerate, int bitrate, int width,
       return NULL;
     }
 
+  pthread_mutex_init(&movie->mutex, NULL);
+  pthread_cond_init(&movie->frame_ready, NULL);
+  pthread_cond_init(&movie->frame_done, NULL);
+  if (pthread_create(&movie->encoder, NULL, encoder_thread, (void *)movie) != 0)
+    {
+      fprintf(stderr, "Could not start the encoder thread\n");
+      pthread_cond_destroy(&movie->frame_done);
+      pthread_cond_destroy(&movie->frame_ready);
+      pthread_mutex_destroy(&movie->mutex);
+      vc_movie_finish(movie);
+      gks_free(movie);
+      return NULL;
+    }
+  movie->encoder_running = 1;
+
   return movie;
 }
 
 void vc_movie_finish(movie_t movie)
 {
+  int i;
+
+  if (movie->encoder_running)
+    {
+      /* let the encoder thread process the queued frames, then stop it */
+      pthread_mutex_lock(&movie->mutex);
+      movie->finishing = 1;
+      pthread_cond_signal(&movie->frame_ready);
+      pthread_mutex_unlock(&movie->mutex);
+      pthread_join(movie->encoder, NULL);
+      pthread_cond_destroy(&movie->frame_done);
+      pthread_cond_destroy(&movie->frame_ready);
+      pthread_mutex_destroy(&movie->mutex);
+      movie->encoder_running = 0;
+    }
+  for (i = 0; i < VC_QUEUE_SIZE; i++)
+    {
+      gks_free(movie->queue[i].data);
+      movie->queue[i].data = NULL;
+      movie->queue[i].size = 0;
+    }
+
   if (movie->frame)
     {
       /* drain encoder */
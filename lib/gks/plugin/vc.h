@@ -15,10 +15,16 @@ extern "C" {
 #include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 
+#include <pthread.h>
+
+/* number of rendered frames which may wait for the encoder thread */
+#define VC_QUEUE_SIZE 4
+
 struct frame_t_
 {
   unsigned char *data;
   int width, height;
+  int size;
 };
 
 struct movie_t_
@@ -34,12 +40,22 @@ struct movie_t_
   unsigned char *gif_scaled_image;
   unsigned char *gif_scaled_image_copy;
   unsigned char *gif_palette;
+
+  /* ring buffer of pooled frames, the encoder thread consumes them in the order they were appended */
+  struct frame_t_ queue[VC_QUEUE_SIZE];
+  int queue_head, queue_count;
+  int finishing;
+  int encoder_running;
+  pthread_t encoder;
+  pthread_mutex_t mutex;
+  pthread_cond_t frame_ready, frame_done;
 };
 
 typedef struct movie_t_ *movie_t;
 typedef struct frame_t_ *frame_t;
 
-movie_t vc_movie_create(const char *path, int framerate, int bitrate, int width, int height);
+movie_t vc_movie_create(const char *path, int framerate, int bitrate, int width, int height, int threads);
+frame_t vc_movie_next_frame(movie_t movie, int width, int height);
 void vc_movie_append_frame(movie_t movie, frame_t frame);
 void vc_movie_finish(movie_t movie);
 
@@ -45,10 +45,9 @@ typedef struct ws_state_list_t
   char *path;
   char *mem_path;
   int *mem;
-  int width, height, framerate;
+  int width, height, framerate, threads;
   int wtype;
   movie_t movie;
-  frame_t frame;
   void *cairo_ws_state_list;
   int video_plugin_initialized;
   int user_defined_resolution;
@@ -63,7 +62,6 @@ static void close_page(void)
       vc_movie_finish(p->movie);
     }
   gks_free(p->movie);
-  gks_free(p->frame);
 }
 
 static void open_page()
@@ -93,8 +91,7 @@ static void open_page()
     {
       gks_filepath(path, p->path, "ogg", 0, 0);
     }
-  p->movie = vc_movie_create(path, p->framerate, 4000000, width, height);
-  p->frame = (frame_t)gks_malloc(sizeof(struct frame_t_));
+  p->movie = vc_movie_create(path, p->framerate, 4000000, width, height, p->threads);
 }
 
 static void write_page(void)
@@ -102,7 +99,8 @@ static void write_page(void)
   int bg[3] = {255, 255, 255};
   int i, j, k;
   int width, height;
-  unsigned char *mem;
+  unsigned char *mem, *data;
+  frame_t frame;
 
   if (!p->movie)
     {
@@ -112,6 +110,15 @@ static void write_page(void)
   width = p->mem[0];
   height = p->mem[1];
 
+  if (!p->movie)
+    {
+      fprintf(stderr, "Failed to append video frame\n");
+      return;
+    }
+
+  /* blend the page onto the background directly into a pooled frame, the encoder thread takes it from there */
+  frame = vc_movie_next_frame(p->movie, width, height);
+  data = frame->data;
   mem = *((unsigned char **)(p->mem + 3));
   for (i = 0; i < height; i++)
     {
@@ -126,21 +133,12 @@ static void write_page(void)
                 {
                   col = 255;
                 }
-              mem[ind + k] = (unsigned char)col;
+              data[ind + k] = (unsigned char)col;
             }
+          data[ind + 3] = mem[ind + 3];
         }
     }
-  if (p->movie)
-    {
-      p->frame->data = mem;
-      p->frame->width = width;
-      p->frame->height = height;
-      vc_movie_append_frame(p->movie, p->frame);
-    }
-  else
-    {
-      fprintf(stderr, "Failed to append video frame\n");
-    }
+  vc_movie_append_frame(p->movie, frame);
 }
 
 void gks_videoplugin(int fctid, int dx, int dy, int dimx, int *ia, int lr1, double *r1, int lr2, double *r2, int lc,
@@ -164,19 +162,26 @@ void gks_videoplugin(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doub
       p->path = chars;
       *ptr = p;
 
-      long width, height, framerate, num_args;
-      char *env;
-      width = height = framerate = -1;
+      long width, height, framerate, threads, num_args;
+      char *env, *sep;
+      width = height = framerate = threads = -1;
       env = (char *)gks_getenv("GKS_VIDEO_OPTS");
       if (env)
         {
+          /* GKS_VIDEO_OPTS=...:<threads> sets the number of encoder threads, 0 chooses it automatically */
+          sep = strchr(env, ':');
+          if (sep && (sscanf(sep + 1, "%ld", &threads) != 1 || threads < 0))
+            {
+              fprintf(stderr, "Failed to parse the number of threads in GKS_VIDEO_OPTS. Expected ':<threads>'\n");
+              exit(1);
+            }
           /* GKS_VIDEO_OPTS=<width>x<height>@<framerate> */
-          num_args = sscanf(env, "%ldx%ld@%ld", &width, &height, &framerate);
+          num_args = sep != env ? sscanf(env, "%ldx%ld@%ld", &width, &height, &framerate) : -1;
           if (num_args == 0)
             {
               /* GKS_VIDEO_OPTS invalid */
               fprintf(stderr, "Failed to parse GKS_VIDEO_OPTS. Expected '<width>x<height>@<framerate>', "
-                              "'<width>x<height>' or '<framerate>'\n");
+                              "'<width>x<height>' or '<framerate>', optionally followed by ':<threads>'\n");
               exit(1);
             }
           else if (num_args == 1)
@@ -194,6 +199,7 @@ void gks_videoplugin(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doub
         }
 
       p->framerate = 24;
+      p->threads = threads > 0 ? (int)threads : 0;
       p->width = 720;
       p->height = 720;
       p->user_defined_resolution = 0;
@@ -31,6 +31,7 @@ DLLEXPORT void gks_x11plugin(int fctid, int dx, int dy, int dimx, int *i_arr, in
 #include <stdlib.h>
 #include <ctype.h>
 #include <math.h>
+#include <limits.h>
 #include <errno.h>
 #include <signal.h>
 
@@ -93,6 +94,7 @@ int usleep(useconds_t);
 #define MAX_SIZE 1000
 
 #define MAX_POINTS 2048
+#define MAX_BATCH 1024
 #define MAX_SELECTIONS 100
 #define PATTERNS 120
 #define HATCH_STYLE 108
@@ -288,6 +290,29 @@ typedef struct
   short x1, y1, x2, y2;
 } Segment;
 
+typedef enum
+{
+  BatchNone,
+  BatchPoints,
+  BatchSegments,
+  BatchArcs,
+  BatchFilledArcs,
+  BatchClearedArcs
+} batch_type;
+
+typedef struct
+{
+  batch_type type;
+  int n;
+  XPoint points[MAX_BATCH];
+  XSegment segments[MAX_BATCH];
+  XArc arcs[MAX_BATCH];
+  struct
+  {
+    int x1, y1, x2, y2;
+  } extent;
+} marker_batch;
+
 typedef struct ws_state_list_struct
 {
   pthread_t thread;
@@ -485,6 +510,7 @@ static gks_state_list_t *gksl;
 static double a[MAX_TNR], b[MAX_TNR], c[MAX_TNR], d[MAX_TNR];
 
 static ws_state_list *p;
+static marker_batch batch;
 static int error_code, request_code, function_id;
 
 
@@ -1558,9 +1584,66 @@ static void init_norm_xform(void)
 }
 
 
+static void draw_marker_batch(Drawable drawable)
+{
+  switch (batch.type)
+    {
+    case BatchPoints:
+      XDrawPoints(p->dpy, drawable, p->gc, batch.points, batch.n, CoordModeOrigin);
+      break;
+    case BatchSegments:
+      XDrawSegments(p->dpy, drawable, p->gc, batch.segments, batch.n);
+      break;
+    case BatchArcs:
+      XDrawArcs(p->dpy, drawable, p->gc, batch.arcs, batch.n);
+      break;
+    case BatchFilledArcs:
+      XFillArcs(p->dpy, drawable, p->gc, batch.arcs, batch.n);
+      break;
+    case BatchClearedArcs:
+      XFillArcs(p->dpy, drawable, p->clear, batch.arcs, batch.n);
+      break;
+    case BatchNone:
+      break;
+    }
+}
+
+
+static void flush_marker_batch(void)
+{
+  if (batch.n > 0)
+    {
+      if (p->pixmap) draw_marker_batch(p->pixmap);
+      if (p->selection) draw_marker_batch(p->drawable);
+      if (!p->double_buf && !p->pixmap) draw_marker_batch(p->win);
+    }
+  batch.type = BatchNone;
+  batch.n = 0;
+}
+
+
+static int marker_batch_slot(batch_type type)
+{
+  if (batch.type != type || batch.n == MAX_BATCH) flush_marker_batch();
+  batch.type = type;
+
+  return batch.n++;
+}
+
+
+static void fill_marker_polygon(GC gc, XPoint *points, int npoints)
+{
+  flush_marker_batch();
+
+  if (p->pixmap) XFillPolygon(p->dpy, p->pixmap, gc, points, npoints, Complex, CoordModeOrigin);
+  if (p->selection) XFillPolygon(p->dpy, p->drawable, gc, points, npoints, Complex, CoordModeOrigin);
+  if (!p->double_buf && !p->pixmap) XFillPolygon(p->dpy, p->win, gc, points, npoints, Complex, CoordModeOrigin);
+}
+
+
 static void draw_marker(double xn, double yn, int mtype, double mscale)
 {
-  int r, d, x, y, i;
+  int r, d, x, y, i, k;
   int pc, op;
   XPoint points[16];
   double scale, xr, yr;
@@ -1581,6 +1664,12 @@ static void draw_marker(double xn, double yn, int mtype, double mscale)
   update_bbox(x - r, y - r);
   update_bbox(x + r, y + r);
 
+  /* marker vertices may extend up to sqrt(2) * 10/9 * r from the center */
+  batch.extent.x1 = min(batch.extent.x1, x - 2 * r - 2);
+  batch.extent.y1 = min(batch.extent.y1, y - 2 * r - 2);
+  batch.extent.x2 = max(batch.extent.x2, x + 2 * r + 2);
+  batch.extent.y2 = max(batch.extent.y2, y + 2 * r + 2);
+
   pc = 0;
   mtype = (d > 1) ? mtype + marker_off : marker_off + 1;
 
@@ -1591,9 +1680,9 @@ static void draw_marker(double xn, double yn, int mtype, double mscale)
         {
 
         case 1: /* point */
-          if (p->pixmap) XDrawPoint(p->dpy, p->pixmap, p->gc, x, y);
-          if (p->selection) XDrawPoint(p->dpy, p->drawable, p->gc, x, y);
-          if (!p->double_buf) XDrawPoint(p->dpy, p->win, p->gc, x, y);
+          k = marker_batch_slot(BatchPoints);
+          batch.points[k].x = x;
+          batch.points[k].y = y;
           break;
 
         case 2: /* line */
@@ -1605,9 +1694,11 @@ static void draw_marker(double xn, double yn, int mtype, double mscale)
               points[i].x = nint(x - xr);
               points[i].y = nint(y + yr);
             }
-          if (p->pixmap) XDrawLines(p->dpy, p->pixmap, p->gc, points, 2, CoordModeOrigin);
-          if (p->selection) XDrawLines(p->dpy, p->drawable, p->gc, points, 2, CoordModeOrigin);
-          if (!p->double_buf) XDrawLines(p->dpy, p->win, p->gc, points, 2, CoordModeOrigin);
+          k = marker_batch_slot(BatchSegments);
+          batch.segments[k].x1 = points[0].x;
+          batch.segments[k].y1 = points[0].y;
+          batch.segments[k].x2 = points[1].x;
+          batch.segments[k].y2 = points[1].y;
           pc += 4;
           break;
 
@@ -1620,30 +1711,19 @@ static void draw_marker(double xn, double yn, int mtype, double mscale)
               points[i].x = nint(x - xr);
               points[i].y = nint(y + yr);
             }
-          if (p->pixmap) XDrawLines(p->dpy, p->pixmap, p->gc, points, marker[mtype][pc + 1], CoordModeOrigin);
-          if (p->selection) XDrawLines(p->dpy, p->drawable, p->gc, points, marker[mtype][pc + 1], CoordModeOrigin);
-          if (!p->double_buf) XDrawLines(p->dpy, p->win, p->gc, points, marker[mtype][pc + 1], CoordModeOrigin);
-          pc += 1 + 2 * marker[mtype][pc + 1];
-          break;
-
-        case 4: /* filled polygon */
-          for (i = 0; i < marker[mtype][pc + 1]; i++)
+          /* markers are drawn with thin lines, so joining segments gives the same pixels as XDrawLines */
+          for (i = 1; i < marker[mtype][pc + 1]; i++)
             {
-              xr = scale * marker[mtype][pc + 2 + 2 * i];
-              yr = -scale * marker[mtype][pc + 3 + 2 * i];
-              seg_xform_rel(&xr, &yr);
-              points[i].x = nint(x - xr);
-              points[i].y = nint(y + yr);
+              k = marker_batch_slot(BatchSegments);
+              batch.segments[k].x1 = points[i - 1].x;
+              batch.segments[k].y1 = points[i - 1].y;
+              batch.segments[k].x2 = points[i].x;
+              batch.segments[k].y2 = points[i].y;
             }
-          if (p->pixmap)
-            XFillPolygon(p->dpy, p->pixmap, p->gc, points, marker[mtype][pc + 1], Complex, CoordModeOrigin);
-          if (p->selection)
-            XFillPolygon(p->dpy, p->drawable, p->gc, points, marker[mtype][pc + 1], Complex, CoordModeOrigin);
-          if (!p->double_buf)
-            XFillPolygon(p->dpy, p->win, p->gc, points, marker[mtype][pc + 1], Complex, CoordModeOrigin);
           pc += 1 + 2 * marker[mtype][pc + 1];
           break;
 
+        case 4: /* filled polygon */
         case 5: /* hollow polygon */
           for (i = 0; i < marker[mtype][pc + 1]; i++)
             {
@@ -1653,31 +1733,20 @@ static void draw_marker(double xn, double yn, int mtype, double mscale)
               points[i].x = nint(x - xr);
               points[i].y = nint(y + yr);
             }
-          if (p->pixmap)
-            XFillPolygon(p->dpy, p->pixmap, p->clear, points, marker[mtype][pc + 1], Complex, CoordModeOrigin);
-          if (p->selection)
-            XFillPolygon(p->dpy, p->drawable, p->clear, points, marker[mtype][pc + 1], Complex, CoordModeOrigin);
-          if (!p->double_buf)
-            XFillPolygon(p->dpy, p->win, p->clear, points, marker[mtype][pc + 1], Complex, CoordModeOrigin);
+          fill_marker_polygon(op == 4 ? p->gc : p->clear, points, marker[mtype][pc + 1]);
           pc += 1 + 2 * marker[mtype][pc + 1];
           break;
 
         case 6: /* arc */
-          if (p->pixmap) XDrawArc(p->dpy, p->pixmap, p->gc, x - r, y - r, d, d, 0, 360 * 64);
-          if (p->selection) XDrawArc(p->dpy, p->drawable, p->gc, x - r, y - r, d, d, 0, 360 * 64);
-          if (!p->double_buf) XDrawArc(p->dpy, p->win, p->gc, x - r, y - r, d, d, 0, 360 * 64);
-          break;
-
         case 7: /* filled arc */
-          if (p->pixmap) XFillArc(p->dpy, p->pixmap, p->gc, x - r, y - r, d, d, 0, 360 * 64);
-          if (p->selection) XFillArc(p->dpy, p->drawable, p->gc, x - r, y - r, d, d, 0, 360 * 64);
-          if (!p->double_buf) XFillArc(p->dpy, p->win, p->gc, x - r, y - r, d, d, 0, 360 * 64);
-          break;
-
         case 8: /* hollow arc */
-          if (p->pixmap) XFillArc(p->dpy, p->pixmap, p->clear, x - r, y - r, d, d, 0, 360 * 64);
-          if (p->selection) XFillArc(p->dpy, p->drawable, p->clear, x - r, y - r, d, d, 0, 360 * 64);
-          if (!p->double_buf) XFillArc(p->dpy, p->win, p->clear, x - r, y - r, d, d, 0, 360 * 64);
+          k = marker_batch_slot(op == 6 ? BatchArcs : op == 7 ? BatchFilledArcs : BatchClearedArcs);
+          batch.arcs[k].x = x - r;
+          batch.arcs[k].y = y - r;
+          batch.arcs[k].width = d;
+          batch.arcs[k].height = d;
+          batch.arcs[k].angle1 = 0;
+          batch.arcs[k].angle2 = 360 * 64;
           break;
         }
       pc++;
@@ -1726,6 +1795,8 @@ static void marker_routine(int n, double *px, double *py, int tnr, int mtype, do
           seg_xform(&clrt[1], &clrt[3]);
         }
       set_clipping(False);
+      batch.extent.x1 = batch.extent.y1 = SHRT_MAX;
+      batch.extent.x2 = batch.extent.y2 = SHRT_MIN;
       for (i = 0; i < n; i++)
         {
           WC_to_NDC(px[i], py[i], tnr, x, y);
@@ -1739,6 +1810,16 @@ static void marker_routine(int n, double *px, double *py, int tnr, int mtype, do
 
           if (draw) draw_marker(x, y, mtype, mscale);
         }
+      flush_marker_batch();
+      /* markers have only been drawn into the backing pixmap */
+      if (p->pixmap && !p->double_buf && batch.extent.x1 <= batch.extent.x2)
+        {
+          xd = max(batch.extent.x1, 0);
+          yd = max(batch.extent.y1, 0);
+          if (xd < p->width && yd < p->height)
+            XCopyArea(p->dpy, p->pixmap, p->win, p->gc, xd, yd, min(batch.extent.x2, p->width - 1) - xd + 1,
+                      min(batch.extent.y2, p->height - 1) - yd + 1, xd, yd);
+        }
       set_clipping(True);
     }
   else
@@ -53,9 +53,9 @@
 
 #define nint(a) ((int)(a + 0.5))
 
-static gks_state_list_t *gkss;
+static GKS_THREAD_LOCAL gks_state_list_t *gkss;
 
-static double a[MAX_TNR], b[MAX_TNR], c[MAX_TNR], d[MAX_TNR];
+static GKS_THREAD_LOCAL double a[MAX_TNR], b[MAX_TNR], c[MAX_TNR], d[MAX_TNR];
 
 static const char *show[] = {"lj", "lj", "ct", "rj"};
 static double yfac[] = {0., -1.2, -1.0, -0.5, 0., 0.2};
@@ -138,7 +138,7 @@ typedef struct ws_state_list_t
   double width, height, nominal_size;
 } ws_state_list;
 
-static ws_state_list *p;
+static GKS_THREAD_LOCAL ws_state_list *p;
 
 static void set_norm_xform(int tnr, double *wn, double *vp)
 {
@@ -212,7 +212,7 @@ static void packb(const char *buff)
 
   if (len + 2 > p->size - p->len)
     {
-      p->size += SIZE_INCREMENT;
+      p->size += p->size > SIZE_INCREMENT ? p->size : SIZE_INCREMENT;
       p->buffer = (char *)realloc(p->buffer, p->size);
     }
 
@@ -235,9 +235,43 @@ static void packb(const char *buff)
     }
 }
 
+static int format_int(char *s, int i)
+{
+  unsigned int u = i < 0 ? 0u - (unsigned int)i : (unsigned int)i;
+  char digits[12];
+  int ndigits = 0, len = 0;
+
+  do
+    {
+      digits[ndigits++] = (char)('0' + u % 10);
+      u /= 10;
+    }
+  while (u != 0);
+
+  if (i < 0) s[len++] = '-';
+  while (ndigits > 0) s[len++] = digits[--ndigits];
+
+  return len;
+}
+
+static void packc(const char *prefix, int x, int y, const char *op)
+{
+  char buffer[64];
+  int len;
+
+  len = strlen(prefix);
+  memcpy(buffer, prefix, len);
+  len += format_int(buffer + len, x);
+  buffer[len++] = ' ';
+  len += format_int(buffer + len, y);
+  strcpy(buffer + len, op);
+
+  packb(buffer);
+}
+
 static char *Ascii85Tuple(unsigned char *data)
 {
-  static char tuple[6];
+  static GKS_THREAD_LOCAL char tuple[6];
   long i, x;
   unsigned long code, quantum;
 
@@ -481,8 +515,6 @@ static void bounding_box(int landscape, double magstep)
 
 static void move(double x, double y)
 {
-  char buffer[50];
-
   p->ix = NINT(p->a * x + p->b);
   p->iy = NINT(p->c * y + p->d);
 
@@ -491,14 +523,12 @@ static void move(double x, double y)
       packb("sk");
       p->stroke = 0;
     }
-  sprintf(buffer, "np %d %d m", p->ix, p->iy);
-  packb(buffer);
+  packc("np ", p->ix, p->iy, " m");
   p->np = 1;
 }
 
 static void draw(double x, double y)
 {
-  char buffer[50];
   int jx, jy, rx, ry;
 
   jx = p->ix;
@@ -512,8 +542,7 @@ static void draw(double x, double y)
       ry = p->iy - jy;
       if (abs(rx) > 1 || abs(ry) > 1)
         {
-          sprintf(buffer, "%d %d rl", rx, ry);
-          packb(buffer);
+          packc("", rx, ry, " rl");
         }
       else
         packb(dc[rx + 1][ry + 1]);
@@ -525,8 +554,7 @@ static void draw(double x, double y)
             {
               packb("sk");
               p->stroke = 0;
-              sprintf(buffer, "%d %d m", p->ix, p->iy);
-              packb(buffer);
+              packc("", p->ix, p->iy, " m");
               p->np = 1;
             }
           else
@@ -1407,7 +1435,6 @@ static void fill_routine(int n, double *px, double *py, int tnr)
 {
   int clsw;
   double clrt[4], x, y;
-  char buffer[50];
   int i, jx, jy, rx, ry, nan_found = 0;
 
   packb("gsave");
@@ -1420,8 +1447,7 @@ static void fill_routine(int n, double *px, double *py, int tnr)
   WC_to_NDC(px[0], py[0], tnr, x, y);
   NDC_to_DC(x, y, p->ix, p->iy);
 
-  sprintf(buffer, "np %d %d m", p->ix, p->iy);
-  packb(buffer);
+  packc("np ", p->ix, p->iy, " m");
   p->np = 1;
 
   for (i = 1; i < n; i++)
@@ -1444,14 +1470,13 @@ static void fill_routine(int n, double *px, double *py, int tnr)
                 }
               if (nan_found)
                 {
-                  sprintf(buffer, "%d %d m", p->ix, p->iy);
+                  packc("", p->ix, p->iy, " m");
                   nan_found = 0;
                 }
               else
                 {
-                  sprintf(buffer, "%d %d rl", rx, ry);
+                  packc("", rx, ry, " rl");
                 }
-              packb(buffer);
             }
           else
             packb(dc[rx + 1][ry + 1]);
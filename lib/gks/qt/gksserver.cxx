@@ -13,13 +13,16 @@
 const int GKSConnection::window_shift = 30;
 unsigned int GKSConnection::index = 0;
 const unsigned int GKSServer::port = 8410;
+// Protocol features announced to the client: display list deltas with a negative size
+const int GKSConnection::features = 1;
 
 
-GKSConnection::GKSConnection(QTcpSocket *socket) : socket(socket), widget(NULL), dl(NULL), dl_size(0)
+GKSConnection::GKSConnection(QTcpSocket *socket) : socket(socket), widget(NULL), dl(NULL), dl_size(0), dl_append(false)
 {
   ++index;
   connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
   connect(socket, SIGNAL(disconnected()), this, SLOT(disconnectedSocket()));
+  socket->write((const char *)&features, sizeof(int));
 }
 
 GKSConnection::~GKSConnection()
@@ -38,8 +41,12 @@ void GKSConnection::readClient()
     {
       if (dl_size == 0)
         {
+          int nbytes;
           if (socket->bytesAvailable() < (long)sizeof(int)) return;
-          socket->read((char *)&dl_size, sizeof(unsigned int));
+          socket->read((char *)&nbytes, sizeof(int));
+          // A negative size announces items which extend the previously received display list
+          dl_append = nbytes < 0;
+          dl_size = dl_append ? -nbytes : nbytes;
         }
       if (socket->bytesAvailable() < dl_size) return;
       dl = new char[dl_size + sizeof(int)];
@@ -50,7 +57,14 @@ void GKSConnection::readClient()
         {
           newWidget();
         }
-      emit(data(dl));
+      if (dl_append)
+        {
+          emit(delta(dl, dl_size));
+        }
+      else
+        {
+          emit(data(dl, dl_size));
+        }
       dl_size = 0;
     }
 }
@@ -83,7 +97,8 @@ void GKSConnection::newWidget()
   QPoint desktop_center = QApplication::desktop()->screenGeometry().center();
   widget->move((desktop_center.x() - widget->width() / 2 + index * window_shift),
                (desktop_center.y() - widget->height() / 2 + index * window_shift));
-  connect(this, SIGNAL(data(char *)), widget, SLOT(interpret(char *)));
+  connect(this, SIGNAL(data(char *, unsigned int)), widget, SLOT(interpret(char *, unsigned int)));
+  connect(this, SIGNAL(delta(char *, unsigned int)), widget, SLOT(append(char *, unsigned int)));
 
   widget->setAttribute(Qt::WA_QuitOnClose, false);
   widget->setAttribute(Qt::WA_DeleteOnClose);
@@ -24,16 +24,19 @@ public slots:
   void disconnectedSocket();
 
 signals:
-  void data(char *);
+  void data(char *, unsigned int);
+  void delta(char *, unsigned int);
   void close(GKSConnection &connection);
 
 private:
   static unsigned int index;
   static const int window_shift;
+  static const int features;
   QTcpSocket *socket;
   GKSWidget *widget;
   char *dl;
   unsigned int dl_size;
+  bool dl_append;
 };
 
 
@@ -25,6 +25,9 @@
 
 #include "gkswidget.h"
 
+/* the widget whose display list was interpreted last into the pixmap and GKS state shared by all widgets */
+static GKSWidget *pixmap_owner = NULL;
+
 static void create_pixmap(ws_state_list *p)
 {
   p->pm = new QPixmap(p->width, p->height);
@@ -65,6 +68,8 @@ GKSWidget::GKSWidget(QWidget *parent) : QWidget(parent)
 {
   is_mapped = 0;
   dl = NULL;
+  dl_size = dl_capacity = 0;
+  interpreted = 0;
 
   gkss->fontfile = gks_open_font();
 
@@ -94,6 +99,7 @@ GKSWidget::GKSWidget(QWidget *parent) : QWidget(parent)
 
 GKSWidget::~GKSWidget()
 {
+  if (pixmap_owner == this) pixmap_owner = NULL;
   delete[] dl;
 }
 
@@ -103,8 +109,23 @@ void GKSWidget::paintEvent(QPaintEvent *)
   if (dl)
     {
       QPainter painter(this);
-      p->pm->fill(Qt::white);
-      interp(dl);
+      /* another widget has drawn into the shared pixmap in the meantime */
+      if (pixmap_owner != this)
+        {
+          pixmap_owner = this;
+          interpreted = 0;
+        }
+      if (interpreted == 0)
+        {
+          p->pm->fill(Qt::white);
+          interp(dl);
+        }
+      else if (interpreted < dl_size)
+        {
+          /* the pixmap still holds the items interpreted before, so only render the new ones */
+          interp(dl + interpreted);
+        }
+      interpreted = dl_size;
 
       if (!prevent_resize)
         {
@@ -130,11 +151,12 @@ void GKSWidget::resizeEvent(QResizeEvent *event)
   p->nominal_size = min(width_, height_) / 500.0;
   resize_pixmap(nint(width_), nint(height_));
   p->resize_requested_by_application = 0;
+  interpreted = 0;
 }
 
-static void set_window_size(char *s)
+static int set_window_size(char *s)
 {
-  int sp = 0, *len, *f;
+  int sp = 0, *len, *f, found = 0;
   double *vp;
   len = (int *)(s + sp);
   while (*len)
@@ -158,18 +180,55 @@ static void set_window_size(char *s)
               p->height = 2;
               p->mheight = (double)p->height / p->device_dpi_y * 0.0254;
             }
+          found = 1;
         }
       sp += *len;
       len = (int *)(s + sp);
     }
+  return found;
 }
 
-void GKSWidget::interpret(char *dl)
+void GKSWidget::interpret(char *dl, unsigned int size)
 {
   delete[] this->dl;
   this->dl = dl;
+  dl_size = size;
+  dl_capacity = size + sizeof(int);
+  interpreted = 0;
 
   set_window_size(this->dl);
+  update_window();
+}
+
+void GKSWidget::append(char *dl, unsigned int size)
+{
+  char *buffer;
+
+  if (this->dl == NULL)
+    {
+      interpret(dl, size);
+      return;
+    }
+  if (dl_size + size + sizeof(int) > dl_capacity)
+    {
+      dl_capacity = 2 * dl_capacity + size;
+      buffer = new char[dl_capacity];
+      memcpy(buffer, this->dl, dl_size);
+      delete[] this->dl;
+      this->dl = buffer;
+    }
+  /* copy the new items including the terminating zero integer */
+  memcpy(this->dl + dl_size, dl, size + sizeof(int));
+  delete[] dl;
+
+  /* a changed workstation viewport invalidates the pixmap contents */
+  if (set_window_size(this->dl + dl_size)) interpreted = 0;
+  dl_size += size;
+  update_window();
+}
+
+void GKSWidget::update_window()
+{
   if (!prevent_resize)
     {
       p->resize_requested_by_application = 1;
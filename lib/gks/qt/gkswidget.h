@@ -18,16 +18,21 @@ public:
   virtual ~GKSWidget();
 
 public slots:
-  void interpret(char *dl);
+  void interpret(char *dl, unsigned int size);
+  void append(char *dl, unsigned int size);
 
 protected:
   void paintEvent(QPaintEvent *event);
   void resizeEvent(QResizeEvent *event);
 
 private:
+  void update_window();
+
   int is_mapped;
   bool prevent_resize;
   char *dl;
+  unsigned int dl_size, dl_capacity;
+  unsigned int interpreted;
 };
 
 #endif
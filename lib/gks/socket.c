@@ -25,11 +25,14 @@
 
 #define PORT 8410
 
+#define GKS_SOCKET_DELTAS 1
+
 typedef struct
 {
   int s;
   int wstype;
   gks_display_list_t dl;
+  int sent, deltas;
 } ws_state_list;
 
 static gks_state_list_t *gkss;
@@ -211,6 +214,24 @@ static int send_socket(int s, char *buf, int size)
   return sent;
 }
 
+static int poll_socket(int s)
+{
+  fd_set fds;
+  struct timeval timeout;
+  int features = 0;
+
+  /* gksqt announces the protocol features it supports right after accepting the connection */
+  FD_ZERO(&fds);
+  FD_SET(s, &fds);
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 0;
+  if (select(s + 1, &fds, NULL, NULL, &timeout) > 0)
+    {
+      if (recv(s, (char *)&features, sizeof(int), 0) != sizeof(int)) features = 0;
+    }
+  return features;
+}
+
 static int close_socket(int s)
 {
 #if defined(_WIN32)
@@ -228,6 +249,7 @@ void gks_drv_socket(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doubl
                     char *chars, void **ptr)
 {
   ws_state_list *wss;
+  int nbytes;
 
   wss = (ws_state_list *)*ptr;
 
@@ -239,6 +261,8 @@ void gks_drv_socket(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doubl
 
       wss->wstype = ia[2];
       wss->s = open_socket(ia[2]);
+      wss->sent = 0;
+      wss->deltas = 0;
       if (wss->s == -1)
         {
           gks_perror("can't connect to GKS socket application\n");
@@ -262,6 +286,11 @@ void gks_drv_socket(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doubl
       wss = NULL;
       break;
 
+    case 6:
+      /* the display list is rebuilt, so the next update has to send it completely */
+      wss->sent = 0;
+      break;
+
     case 8:
       if (ia[1] & GKS_K_PERFORM_FLAG)
         {
@@ -269,9 +298,23 @@ void gks_drv_socket(int fctid, int dx, int dy, int dimx, int *ia, int lr1, doubl
             {
               close_socket(wss->s);
               wss->s = open_socket(wss->wstype);
+              wss->sent = 0;
+              wss->deltas = 0;
+            }
+          if (!wss->deltas) wss->deltas = poll_socket(wss->s) & GKS_SOCKET_DELTAS;
+          if (wss->sent == 0 || !wss->deltas)
+            {
+              send_socket(wss->s, (char *)&wss->dl.nbytes, sizeof(int));
+              send_socket(wss->s, wss->dl.buffer, wss->dl.nbytes);
+            }
+          else if (wss->dl.nbytes > wss->sent)
+            {
+              /* a negative size announces items to be appended to the previous display list */
+              nbytes = wss->sent - wss->dl.nbytes;
+              send_socket(wss->s, (char *)&nbytes, sizeof(int));
+              send_socket(wss->s, wss->dl.buffer + wss->sent, wss->dl.nbytes - wss->sent);
             }
-          send_socket(wss->s, (char *)&wss->dl.nbytes, sizeof(int));
-          send_socket(wss->s, wss->dl.buffer, wss->dl.nbytes);
+          wss->sent = wss->dl.nbytes;
         }
       break;
     }
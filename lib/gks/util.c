@@ -46,6 +46,8 @@
 #define BOTTOM (1 << 2)
 #define TOP (1 << 3)
 
+#define POINT_BLOCK 256
+
 #define WC_to_NDC(xw, yw, tnr, xn, yn)     \
   xn = gkss->a[tnr] * (xw) + gkss->b[tnr]; \
   yn = gkss->c[tnr] * (yw) + gkss->d[tnr]
@@ -74,7 +76,7 @@ static struct wstypes_t wstypes[] = {
 
 static int num_wstypes = sizeof(wstypes) / sizeof(wstypes[0]);
 
-static int pattern[120][33] = {
+static GKS_THREAD_LOCAL int pattern[120][33] = {
     {4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
     {4, 255, 255, 187, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
     {4, 238, 255, 187, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
@@ -196,7 +198,7 @@ static int pattern[120][33] = {
     {8, 254, 253, 251, 247, 239, 223, 191, 127, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
     {8, 247, 247, 247, 247, 0, 247, 247, 247, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
 
-static double rgb[MAX_COLOR][3] = {
+static GKS_THREAD_LOCAL double rgb[MAX_COLOR][3] = {
     {1.00000, 1.00000, 1.00000}, {0.00000, 0.00000, 0.00000}, {1.00000, 0.00000, 0.00000}, {0.00000, 1.00000, 0.00000},
     {0.00000, 0.00000, 1.00000}, {0.00000, 1.00000, 1.00000}, {1.00000, 1.00000, 0.00000}, {1.00000, 0.00000, 1.00000},
     {0.12500, 0.12500, 0.87500}, {0.18750, 0.12500, 0.87500}, {0.25000, 0.12500, 0.87500}, {0.31250, 0.12500, 0.87500},
@@ -488,9 +490,9 @@ static const char *symbol2utf[256] = {
     "\xef\xa3\xbc", "\xef\xa3\xbd", "\xef\xa3\xbe", "\x3f",
 };
 
-static double rx = 0, ry = 0, seglen = 0;
+static GKS_THREAD_LOCAL double rx = 0, ry = 0, seglen = 0;
 
-static int newseg = 0, idash = 0, dtype = 0;
+static GKS_THREAD_LOCAL int newseg = 0, idash = 0, dtype = 0;
 
 static int dash_table[35][10] = {
     {8, 4, 2, 4, 2, 4, 2, 4, 6, 0},  {6, 4, 2, 4, 2, 4, 6, 0, 0, 0}, {4, 4, 2, 4, 6, 0, 0, 0, 0, 0},
@@ -506,7 +508,7 @@ static int dash_table[35][10] = {
     {0, 0, 0, 0, 0, 0, 0, 0, 0, 0},  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, {2, 8, 5, 0, 0, 0, 0, 0, 0, 0},
     {2, 1, 2, 0, 0, 0, 0, 0, 0, 0},  {4, 8, 4, 1, 4, 0, 0, 0, 0, 0}};
 
-static int dash_list[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+static GKS_THREAD_LOCAL int dash_list[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
 static int roman[4] = {3, 12, 16, 11};
 
@@ -518,15 +520,15 @@ static double yfac[4] = {0, 0, 1, -1};
 
 static char Base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-static double cxl, cxr, cyb, cyt;
+static GKS_THREAD_LOCAL double cxl, cxr, cyb, cyt;
 
-static double bx = 1, by = 0, ux = 0, uy = 1;
+static GKS_THREAD_LOCAL double bx = 1, by = 0, ux = 0, uy = 1;
 
-static double sin_f = 0, cos_f = 1;
+static GKS_THREAD_LOCAL double sin_f = 0, cos_f = 1;
 
-static double cur_wn[4], cur_vp[4];
+static GKS_THREAD_LOCAL double cur_wn[4], cur_vp[4];
 
-static gks_state_list_t *gkss = NULL;
+static GKS_THREAD_LOCAL gks_state_list_t *gkss = NULL;
 
 void gks_init_core(gks_state_list_t *list)
 {
@@ -716,6 +718,28 @@ void gks_seg_xform(double *x, double *y)
   *x = xx;
 }
 
+/*
+ * Transform whole arrays of world coordinates to normalized device coordinates including the segment transformation.
+ * The coefficients are loaded once per call, which lets the compiler vectorize the loop; the results are identical to
+ * those of `WC_to_NDC` followed by `gks_seg_xform`.
+ */
+void gks_WC_to_NDC_points(int n, double *px, double *py, int tnr, double *x, double *y)
+{
+  double a = gkss->a[tnr], b = gkss->b[tnr], c = gkss->c[tnr], d = gkss->d[tnr];
+  double m00 = gkss->mat[0][0], m01 = gkss->mat[0][1], m10 = gkss->mat[1][0], m11 = gkss->mat[1][1];
+  double m20 = gkss->mat[2][0], m21 = gkss->mat[2][1];
+  double xn, yn;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      xn = a * px[i] + b;
+      yn = c * py[i] + d;
+      x[i] = xn * m00 + yn * m01 + m20;
+      y[i] = xn * m10 + yn * m11 + m21;
+    }
+}
+
 static void gks_seg_xform_rel(double *x, double *y)
 {
   double xx;
@@ -1017,9 +1041,10 @@ static int clip_line(double *x0, double *y0, double *x1, double *y1)
 void gks_emul_polyline(int n, double *px, double *py, int ltype, int tnr, void (*move)(double x, double y),
                        void (*draw)(double x, double y))
 {
-  double x0, y0, x, y, x1, y1;
+  double x0, y0, x, y, x1, y1, xs, ys;
+  double xb[POINT_BLOCK], yb[POINT_BLOCK];
   int clip = 1, visible;
-  int i, j, m;
+  int i, k, m, start, len;
 
   dtype = ltype;
   seglen = 0;
@@ -1028,17 +1053,30 @@ void gks_emul_polyline(int n, double *px, double *py, int ltype, int tnr, void (
 
   gks_get_dash_list(ltype, gkss->lwidth, dash_list);
 
-  WC_to_NDC(px[0], py[0], tnr, x0, y0);
-  gks_seg_xform(&x0, &y0);
+  gks_WC_to_NDC_points(1, px, py, tnr, &x0, &y0);
+  xs = x0;
+  ys = y0;
 
   m = ltype == 0 ? n + 1 : n;
 
-  for (i = 1; i < m; i++)
+  /* transform the points block by block, the last point of a closed line is the first one again */
+  len = 0;
+  for (i = 1, start = 1; i < m; i++)
     {
-      j = i < n ? i : 0;
-
-      WC_to_NDC(px[j], py[j], tnr, x1, y1);
-      gks_seg_xform(&x1, &y1);
+      if (i - start == len)
+        {
+          start = i;
+          len = MIN(POINT_BLOCK, m - start);
+          k = MIN(len, n - start);
+          gks_WC_to_NDC_points(k, px + start, py + start, tnr, xb, yb);
+          if (k < len)
+            {
+              xb[k] = xs;
+              yb[k] = ys;
+            }
+        }
+      x1 = xb[i - start];
+      y1 = yb[i - start];
 
       x = x1;
       y = y1;
@@ -1062,19 +1100,20 @@ void gks_emul_polyline(int n, double *px, double *py, int ltype, int tnr, void (
 
 void gks_emul_polymarker(int n, double *px, double *py, void (*marker)(double x, double y, int mtype))
 {
-  int i;
+  int i, j, len;
   int tnr, mtype;
-  double xn, yn;
+  double xb[POINT_BLOCK], yb[POINT_BLOCK];
 
   tnr = gkss->cntnr;
   mtype = gkss->mtype;
 
-  for (i = 0; i < n; i++)
+  for (i = 0; i < n; i += POINT_BLOCK)
     {
-      WC_to_NDC(px[i], py[i], tnr, xn, yn);
-      gks_seg_xform(&xn, &yn);
+      len = MIN(POINT_BLOCK, n - i);
+      gks_WC_to_NDC_points(len, px + i, py + i, tnr, xb, yb);
 
-      if (cxl <= xn && xn <= cxr && cyb <= yn && yn <= cyt) marker(xn, yn, mtype);
+      for (j = 0; j < len; j++)
+        if (cxl <= xb[j] && xb[j] <= cxr && cyb <= yb[j] && yb[j] <= cyt) marker(xb[j], yb[j], mtype);
     }
 }
 
@@ -1859,6 +1898,126 @@ int gks_base64(unsigned char *src, size_t srclen, char *dest, size_t destsize)
   return (len);
 }
 
+static double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13};
+
+/* rounding error of the floating point product p = a * b (Dekker) */
+
+static double product_error(double a, double b, double p)
+{
+  double c, ah, al, bh, bl;
+
+  c = 134217729.0 * a;
+  ah = c - (c - a);
+  al = a - ah;
+  c = 134217729.0 * b;
+  bh = c - (c - b);
+  bl = b - bh;
+
+  return ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+}
+
+static int dtoa_fallback(char *s, double x, int prec, int conv)
+{
+  char fmt[8];
+  int len, i;
+
+  sprintf(fmt, "%%.%d%c", prec, conv);
+  len = sprintf(s, fmt, x);
+
+  /* replace a locale dependent decimal separator */
+  for (i = 0; i < len; i++)
+    if (!isalnum((unsigned char)s[i]) && s[i] != '-' && s[i] != '+') s[i] = '.';
+
+  return len;
+}
+
+/*
+ * Format a double like printf("%.<prec>g") or printf("%.<prec>f") (conv is 'g'
+ * or 'f'), but always with '.' as decimal separator. Values of moderate
+ * magnitude, as they occur for device coordinates, are converted with integer
+ * arithmetic; everything else is passed on to sprintf. The buffer must hold at
+ * least MAX_DTOA characters. Returns the length of the formatted string.
+ */
+
+int gks_dtoa(char *s, double x, int prec, int conv)
+{
+  double ax = fabs(x), v, r, err;
+  unsigned long u;
+  int exp10, ndec, ndigits, len = 0, i;
+  char digits[16];
+
+  if (prec < 0 || prec > 9 || !(ax < 1e9)) return dtoa_fallback(s, x, prec, conv);
+  /* negative zero keeps its sign in printf */
+  if (ax == 0 && 1 / x < 0) return dtoa_fallback(s, x, prec, conv);
+
+  if (conv == 'g')
+    {
+      if (prec == 0) prec = 1;
+      if (ax == 0)
+        {
+          strcpy(s, "0");
+          return 1;
+        }
+      if (ax < 1e-4 || ax >= powers_of_ten[prec]) return dtoa_fallback(s, x, prec, conv);
+
+      exp10 = 0;
+      if (ax >= 1)
+        {
+          while (ax >= powers_of_ten[exp10 + 1]) exp10++;
+        }
+      else
+        {
+          while (ax * powers_of_ten[-exp10] < 1) exp10--;
+        }
+      ndec = prec - 1 - exp10;
+    }
+  else
+    {
+      ndec = prec;
+      if (ax * powers_of_ten[ndec] >= 1e9) return dtoa_fallback(s, x, prec, conv);
+    }
+
+  /* round to nearest, resolving apparent ties with the exact rounding error of the product */
+  v = ax * powers_of_ten[ndec];
+  r = floor(v);
+  u = (unsigned long)r;
+  if (v - r > 0.5)
+    u++;
+  else if (v - r == 0.5)
+    {
+      err = product_error(ax, powers_of_ten[ndec], v);
+      if (err > 0 || (err == 0 && (u & 1))) u++;
+    }
+
+  /* a carry into the next decade switches %g to exponential notation */
+  if (conv == 'g' && ndec == 0 && u >= (unsigned long)powers_of_ten[prec]) return dtoa_fallback(s, x, prec, conv);
+
+  ndigits = 0;
+  do
+    {
+      digits[ndigits++] = (char)('0' + u % 10);
+      u /= 10;
+    }
+  while (u != 0);
+  while (ndigits <= ndec) digits[ndigits++] = '0';
+
+  if (x < 0) s[len++] = '-';
+  for (i = ndigits - 1; i >= 0; i--)
+    {
+      s[len++] = digits[i];
+      if (i == ndec && i != 0) s[len++] = '.';
+    }
+
+  if (conv == 'g' && ndec > 0)
+    {
+      while (s[len - 1] == '0') len--;
+      if (s[len - 1] == '.') len--;
+    }
+  s[len] = '\0';
+
+  return len;
+}
+
 #ifdef _WIN32
 
 LPSTR FAR PASCAL DLLGetEnv(LPSTR lpszVariableName)
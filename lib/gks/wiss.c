@@ -65,7 +65,10 @@ static void copy(char *s, int nmemb, int size)
 
 static void reallocate(int len)
 {
-  while (p->nbytes + len >= p->size) p->size += SEGM_SIZE;
+  int size = p->size;
+
+  /* keep room for the terminating zero length */
+  while (p->nbytes + len + (int)sizeof(int) > p->size) p->size += SEGM_SIZE;
 
   p->buffer = (char *)gks_realloc(p->buffer, p->size);
   if (p->buffer == NULL)
@@ -73,6 +76,7 @@ static void reallocate(int len)
       gks_perror("memory allocation failed");
       exit(1);
     }
+  memset(p->buffer + size, 0, p->size - size);
 }
 
 #if 0
@@ -106,7 +110,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 15: /* fill area */
 
       len = 4 * sizeof(int) + 2 * i_arr[0] * sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -119,11 +123,12 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 14: /* text */
 
       len = 4 * sizeof(int) + 2 * sizeof(double) + 132;
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       memset((void *)s, 0, 132);
       slen = strlen(c_arr);
-      strncpy(s, c_arr, slen);
+      if (slen > 131) slen = 131;
+      memcpy(s, c_arr, slen);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -138,7 +143,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 201: /* draw image */
 
       len = (6 + dimx * dy) * sizeof(int) + 4 * sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -152,10 +157,11 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
       break;
 
     case 17: /* GDP */
-      len = (2 + 3 + i_arr[2]) * sizeof(int) + 2 * i_arr[0] * sizeof(double);
-      if (p->nbytes + len > p->size) reallocate(len);
+      len = (3 + 3 + i_arr[2]) * sizeof(int) + 2 * i_arr[0] * sizeof(double);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
+      COPY(&sgnum, 1, sizeof(int));
       COPY(&fctid, 1, sizeof(int));
       COPY(i_arr, (3 + i_arr[2]), sizeof(int));
       COPY(f_arr_1, i_arr[0], sizeof(double));
@@ -176,7 +182,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 207: /* set border color index */
 
       len = 4 * sizeof(int);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -188,7 +194,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 34: /* set text alignment */
 
       len = 5 * sizeof(int);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -206,7 +212,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 206: /* set border width */
 
       len = 3 * sizeof(int) + sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -217,7 +223,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 32: /* set character up vector */
 
       len = 3 * sizeof(int) + 2 * sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -229,7 +235,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 41: /* set aspect source flags */
 
       len = 3 * sizeof(int) + 13 * sizeof(int);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -240,7 +246,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 48: /* set color representation */
 
       len = 4 * sizeof(int) + 3 * sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -253,7 +259,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 50: /* set viewport */
 
       len = 4 * sizeof(int) + 4 * sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -266,7 +272,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 202: /* set shadow */
 
       len = 3 * sizeof(int) + 3 * sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -277,7 +283,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
     case 204: /* set coord xform */
 
       len = 3 * sizeof(int) + 6 * sizeof(double);
-      if (p->nbytes + len >= p->size) reallocate(len);
+      if (p->nbytes + len + (int)sizeof(int) > p->size) reallocate(len);
 
       COPY(&len, 1, sizeof(int));
       COPY(&sgnum, 1, sizeof(int));
@@ -290,7 +296,7 @@ static void write_item(int sgnum, int fctid, int dx, int dy, int dimx, int *i_ar
 static void delete_seg(char *str, int segn)
 {
   char *s, *d;
-  int sp = 0, *len, *sgnum, dp = 0, saved_sp;
+  int sp = 0, *len, *sgnum, dp = 0, saved_sp, item_len;
 
   s = d = str;
 
@@ -302,12 +308,14 @@ static void delete_seg(char *str, int segn)
       RESOLVE(sgnum, int, sizeof(int));
       sp = saved_sp;
 
-      if (*sgnum != 0 && segn != *sgnum)
+      /* the move may overwrite the length word of this item */
+      item_len = *len;
+      if (segn != *sgnum)
         {
-          if (sp > dp) memmove(d + dp, s + sp, *len);
-          dp += *len;
+          if (sp > dp) memmove(d + dp, s + sp, item_len);
+          dp += item_len;
         }
-      sp += *len;
+      sp += item_len;
 
       saved_sp = sp;
       RESOLVE(len, int, sizeof(int));
@@ -729,7 +737,9 @@ static void interp(char *str, int segn)
     }
 }
 
-void gks_wiss_dispatch(int fctid, int wkid, int segn)
+void gks_wiss_dispatch(int fctid, int target_wkid, int segn)
 {
+  /* color representations in the segment are set on the target workstation */
+  wkid = target_wkid;
   interp(p->buffer, segn);
 }
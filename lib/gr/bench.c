@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
+#include "gr.h"
+
+/*
+ * Render the same number of figures (8 by default) once one after another and
+ * once concurrently with one thread per figure, and report the wall clock time
+ * of both runs. Every figure is written to its own PostScript file. The
+ * concurrent run requires a build with GR_THREAD_LOCAL_STATE.
+ */
+
+#define NPOINTS 200000
+
+typedef struct
+{
+  int index;
+  const char *prefix;
+} figure_t;
+
+static double *x, *y;
+
+static double wall_time(void)
+{
+#ifdef _WIN32
+  return GetTickCount() / 1000.0;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+#endif
+}
+
+static void render(figure_t *figure)
+{
+  char path[64], title[32];
+  double *ys;
+  int i;
+
+  ys = (double *)malloc(NPOINTS * sizeof(double));
+  if (ys == NULL) return;
+  for (i = 0; i < NPOINTS; i++) ys[i] = y[i] * (1 + 0.1 * figure->index);
+
+  sprintf(path, "%s%d.ps", figure->prefix, figure->index);
+  sprintf(title, "figure %d", figure->index);
+
+  gr_opengks();
+  gr_beginprint(path);
+  gr_setviewport(0.1, 0.95, 0.1, 0.95);
+  gr_setwindow(0, 1, -1, 1);
+  gr_setlinecolorind(1 + figure->index % 8);
+  for (i = 0; i < 10; i++) gr_polyline(NPOINTS, x, ys);
+  gr_setlinecolorind(1);
+  gr_axes(0.05, 0.1, 0, -1, 2, 5, -0.01);
+  gr_settextalign(2, 1);
+  gr_text(0.525, 0.99, title);
+  gr_endprint();
+  gr_closegks();
+
+  free(ys);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg)
+#else
+static void *thread_main(void *arg)
+#endif
+{
+  render((figure_t *)arg);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int n = 8, i;
+  figure_t *figures;
+#ifdef _WIN32
+  HANDLE *threads;
+#else
+  pthread_t *threads;
+#endif
+  double start;
+
+  if (argc > 1) n = atoi(argv[1]);
+
+  x = (double *)malloc(NPOINTS * sizeof(double));
+  y = (double *)malloc(NPOINTS * sizeof(double));
+  figures = (figure_t *)malloc(2 * n * sizeof(figure_t));
+#ifdef _WIN32
+  threads = (HANDLE *)malloc(n * sizeof(HANDLE));
+#else
+  threads = (pthread_t *)malloc(n * sizeof(pthread_t));
+#endif
+  if (x == NULL || y == NULL || figures == NULL || threads == NULL)
+    {
+      fprintf(stderr, "out of virtual memory\n");
+      return 1;
+    }
+  for (i = 0; i < NPOINTS; i++)
+    {
+      x[i] = (double)i / NPOINTS;
+      y[i] = 0.8 * sin(x[i] * 200) * cos(x[i] * 13);
+    }
+
+  start = wall_time();
+  for (i = 0; i < n; i++)
+    {
+      figures[i].index = i;
+      figures[i].prefix = "serial";
+      render(figures + i);
+    }
+  printf("serial   %3d figures: %.3f s\n", n, wall_time() - start);
+
+  start = wall_time();
+  for (i = 0; i < n; i++)
+    {
+      figures[n + i].index = i;
+      figures[n + i].prefix = "threaded";
+#ifdef _WIN32
+      threads[i] = CreateThread(NULL, 0, thread_main, figures + n + i, 0, NULL);
+#else
+      pthread_create(threads + i, NULL, thread_main, figures + n + i);
+#endif
+    }
+  for (i = 0; i < n; i++)
+    {
+#ifdef _WIN32
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+#else
+      pthread_join(threads[i], NULL);
+#endif
+    }
+  printf("threaded %3d figures: %.3f s\n", n, wall_time() - start);
+
+  free(threads);
+  free(figures);
+  free(y);
+  free(x);
+
+  return 0;
+}
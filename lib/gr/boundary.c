@@ -4,42 +4,40 @@
 #include <inttypes.h>
 
 #include "boundary.h"
+#include "parallel.h"
 
 #define FIND_BOUNDARY_BALL_TOO_SMALL -1
 #define FIND_BOUNDARY_BALL_TOO_LARGE -2
 #define FIND_BOUNDARY_MEMORY_EXCEEDED -3
 #define FIND_BOUNDARY_INVALID_POINTS -4
 
+/* average number of points per grid cell */
+#define POINTS_PER_CELL 2
+
+#define NEAREST_NEIGHBOR_MIN_POINTS_PER_THREAD 16384
+
 typedef struct
 {
   double x;
   double y;
-  int index;
 } double2;
 
-typedef struct
+struct boundary_finder_t
 {
-  int x;
-  int y;
-} int2;
-
-typedef struct
-{
-  double2 *points;
-  int2 num_cells;
+  /*
+   * The points are sorted by their grid cell and stored as separate coordinate arrays, so that the points of a
+   * row of cells are a contiguous part of `x` and `y`. `index` maps the sorted positions to the original indices.
+   */
+  int n;
+  double *x;
+  double *y;
+  int *index;
+  int num_cells_x, num_cells_y;
   double cell_size;
   int *cell_offsets;
   double2 bounding_box[2];
-} grid;
-
-typedef struct
-{
-  int current_index;
-  double2 current_point;
-  double2 center_point;
-  double r;
-  void *user_data;
-} grid_callback_data;
+  double radius;
+};
 
 typedef struct
 {
@@ -50,34 +48,45 @@ typedef struct
   int *point_list;
 } neighbor_point_list;
 
-static grid *current_grid = NULL; /* grid pointer used in compare callback of qsort */
+typedef struct
+{
+  const boundary_finder_t *finder;
+  double *nearest_neighbor;
+} nearest_neighbor_job;
+
+typedef struct
+{
+  double x;
+  double y;
+  int k;
+} sorted_point;
 
-static void calculate_bounding_box(int n, const double2 *points, double2 *min, double2 *max)
+static void calculate_bounding_box(int n, const double *x, const double *y, double2 *min, double2 *max)
 {
   /*
    * Calculate the smallest box containing all points. A small offset is subtracted from the bottom left
    * point to assure that the closest data point has a positive distance to the point min.
    */
   int i;
-  min->x = max->x = points[0].x;
-  min->y = max->y = points[0].y;
+  min->x = max->x = x[0];
+  min->y = max->y = y[0];
   for (i = 1; i < n; i++)
     {
-      if (points[i].x < min->x)
+      if (x[i] < min->x)
         {
-          min->x = points[i].x;
+          min->x = x[i];
         }
-      else if (points[i].x > max->x)
+      else if (x[i] > max->x)
         {
-          max->x = points[i].x;
+          max->x = x[i];
         }
-      if (points[i].y < min->y)
+      if (y[i] < min->y)
         {
-          min->y = points[i].y;
+          min->y = y[i];
         }
-      else if (points[i].y > max->y)
+      else if (y[i] > max->y)
         {
-          max->y = points[i].y;
+          max->y = y[i];
         }
     }
   min->x -= 0.0001;
@@ -94,168 +103,257 @@ static double distance_sq(double2 position1, double2 position2)
   return dx * dx + dy * dy;
 }
 
-static int2 grid_get_cell(grid *grid, const double2 *position)
+static int cell_coordinate(double position, double origin, double cell_size, int num_cells)
 {
   /*
-   * Calculate the cell index (row / column) of the cell containing the coordinate position.
-   * Row and column indices are both clipped to [0, num_cells).
+   * Calculate the row or column index of the cell containing the coordinate `position`, clipped to [0, num_cells).
    */
-  int2 result;
-  result.x = (int)((position->x - grid->bounding_box[0].x) / (grid->cell_size));
-  result.y = (int)((position->y - grid->bounding_box[0].y) / (grid->cell_size));
-  if (result.x < 0)
+  double c = (position - origin) / cell_size;
+  if (c < 0)
     {
-      result.x = 0;
+      return 0;
     }
-  else if (result.x >= grid->num_cells.x)
+  else if (c >= num_cells)
     {
-      result.x = grid->num_cells.x - 1;
+      return num_cells - 1;
     }
-  if (result.y < 0)
+  return (int)c;
+}
+
+static int cell_number(const boundary_finder_t *finder, double x, double y)
+{
+  /*
+   * Calculate the consecutive cell index of the cell containing the coordinate position.
+   */
+  return cell_coordinate(x, finder->bounding_box[0].x, finder->cell_size, finder->num_cells_x) +
+         cell_coordinate(y, finder->bounding_box[0].y, finder->cell_size, finder->num_cells_y) * finder->num_cells_x;
+}
+
+static int compare_sorted_points(const void *a, const void *b)
+{
+  const sorted_point *p = (const sorted_point *)a;
+  const sorted_point *q = (const sorted_point *)b;
+  if (p->x != q->x)
     {
-      result.y = 0;
+      return p->x < q->x ? -1 : 1;
     }
-  else if (result.y >= grid->num_cells.y)
+  if (p->y != q->y)
     {
-      result.y = grid->num_cells.y - 1;
+      return p->y < q->y ? -1 : 1;
     }
-  return result;
+  return p->k - q->k;
 }
 
-static int grid_get_cell_number(grid *grid, const double2 *position)
+static void remove_coincident_points(boundary_finder_t *finder, int *duplicate)
 {
   /*
-   * Calculate the consecutive cell index of the cell containing the coordinate position.
+   * Keep only the first of several points at the same position, as a ball cannot pivot around two coincident
+   * points. Coincident points are in the same cell, so the points of each cell are sorted by their position to
+   * find them. The remaining points keep their order.
    */
-  int2 c = grid_get_cell(grid, position);
-  return c.x + c.y * grid->num_cells.x;
+  int num_cells = finder->num_cells_x * finder->num_cells_y;
+  int i, j, k, m, start, max_points = 0, num_points = 0;
+  sorted_point *points;
+
+  for (i = 0; i < num_cells; i++)
+    {
+      m = finder->cell_offsets[i + 1] - finder->cell_offsets[i];
+      if (m > max_points)
+        {
+          max_points = m;
+        }
+    }
+  points = malloc(max_points * sizeof(sorted_point));
+  assert(points);
+
+  for (k = 0; k < finder->n; k++)
+    {
+      duplicate[k] = 0;
+    }
+  for (i = 0; i < num_cells; i++)
+    {
+      m = finder->cell_offsets[i + 1] - finder->cell_offsets[i];
+      if (m < 2)
+        {
+          continue;
+        }
+      for (j = 0; j < m; j++)
+        {
+          k = finder->cell_offsets[i] + j;
+          points[j].x = finder->x[k];
+          points[j].y = finder->y[k];
+          points[j].k = k;
+        }
+      qsort(points, m, sizeof(sorted_point), compare_sorted_points);
+      for (j = 1; j < m; j++)
+        {
+          if (points[j].x == points[j - 1].x && points[j].y == points[j - 1].y)
+            {
+              duplicate[points[j].k] = 1;
+            }
+        }
+    }
+  free(points);
+
+  start = 0;
+  for (i = 0; i < num_cells; i++)
+    {
+      int end = finder->cell_offsets[i + 1];
+      for (k = start; k < end; k++)
+        {
+          if (!duplicate[k])
+            {
+              finder->x[num_points] = finder->x[k];
+              finder->y[num_points] = finder->y[k];
+              finder->index[num_points] = finder->index[k];
+              num_points++;
+            }
+        }
+      finder->cell_offsets[i + 1] = num_points;
+      start = end;
+    }
+  finder->n = num_points;
 }
 
-static double2 grid_get_elem(grid *grid, int k)
+static double2 get_point(const boundary_finder_t *finder, int k)
 {
-  return grid->points[k];
+  double2 p;
+  p.x = finder->x[k];
+  p.y = finder->y[k];
+  return p;
 }
 
-static int compare_element_fun(const void *position1, const void *position2)
+static void cell_range(const boundary_finder_t *finder, double2 center, double radius, int *x0, int *y0, int *x1,
+                       int *y1)
 {
   /*
-   * Comparator function to sort positions by their cell index using qsort function.
+   * Calculate the range of cells covering the square with the half edge length `radius` around `center`.
    */
-  return grid_get_cell_number(current_grid, (const double2 *)position1) >
-         grid_get_cell_number(current_grid, (const double2 *)position2);
+  *x0 = cell_coordinate(center.x - radius, finder->bounding_box[0].x, finder->cell_size, finder->num_cells_x);
+  *x1 = cell_coordinate(center.x + radius, finder->bounding_box[0].x, finder->cell_size, finder->num_cells_x);
+  *y0 = cell_coordinate(center.y - radius, finder->bounding_box[0].y, finder->cell_size, finder->num_cells_y);
+  *y1 = cell_coordinate(center.y + radius, finder->bounding_box[0].y, finder->cell_size, finder->num_cells_y);
 }
 
-static grid *grid_create(int n, double2 *points, double cell_size)
+boundary_finder_t *boundary_finder_create(int n, const double *x, const double *y)
 {
   /*
-   * Create a grid data structure containing n points in square cells of the size `cell_size`.
-   * The cells are sorted by their cell number internally, so that the points of each cell are
-   * in a continuous part of the `points` array.
+   * Create a grid data structure containing the `n` points located at `x` and `y`. The cell size is chosen from
+   * the point density, so that the grid does not depend on the ball radius and can be reused for any radius.
+   * The points are copied and sorted by their cell number with a counting sort, and coincident points are
+   * removed.
    */
-  int i;
-  int cur_cell = 0;
+  boundary_finder_t *finder;
+  double width, height, cell_size;
+  int *cell, *offset;
+  int i, num_cells;
 
-  grid *grid_ptr;
-  assert(n > 0);
-  grid_ptr = malloc(sizeof(grid));
-  assert(grid_ptr);
-
-  calculate_bounding_box(n, points, grid_ptr->bounding_box, grid_ptr->bounding_box + 1);
-  grid_ptr->num_cells.x = (int)((grid_ptr->bounding_box[1].x - grid_ptr->bounding_box[0].x) / cell_size) + 1;
-  grid_ptr->num_cells.y = (int)((grid_ptr->bounding_box[1].y - grid_ptr->bounding_box[0].y) / cell_size) + 1;
-  grid_ptr->cell_offsets = malloc((grid_ptr->num_cells.x * grid_ptr->num_cells.y + 1) * sizeof(int));
-  assert(grid_ptr->cell_offsets);
+  if (n < 2)
+    {
+      return NULL;
+    }
 
-  grid_ptr->points = points;
-  grid_ptr->cell_size = cell_size;
+  finder = malloc(sizeof(boundary_finder_t));
+  assert(finder);
+  calculate_bounding_box(n, x, y, finder->bounding_box, finder->bounding_box + 1);
+  width = finder->bounding_box[1].x - finder->bounding_box[0].x;
+  height = finder->bounding_box[1].y - finder->bounding_box[0].y;
 
-  assert(current_grid == NULL);
-  current_grid = grid_ptr;
-  qsort(points, (size_t)n, sizeof(double2), compare_element_fun);
-  current_grid = NULL;
+  /* Degenerate (e.g. collinear) point sets are limited to a few cells per point. */
+  cell_size = sqrt(width * height * POINTS_PER_CELL / n);
+  while ((width / cell_size + 1) * (height / cell_size + 1) > 4.0 * n + 16)
+    {
+      cell_size *= 1.5;
+    }
+  finder->cell_size = cell_size;
+  finder->num_cells_x = (int)(width / cell_size) + 1;
+  finder->num_cells_y = (int)(height / cell_size) + 1;
+  num_cells = finder->num_cells_x * finder->num_cells_y;
+  finder->radius = -1;
+
+  finder->n = n;
+  finder->x = malloc(n * sizeof(double));
+  finder->y = malloc(n * sizeof(double));
+  finder->index = malloc(n * sizeof(int));
+  finder->cell_offsets = calloc(num_cells + 1, sizeof(int));
+  cell = malloc(n * sizeof(int));
+  offset = malloc(num_cells * sizeof(int));
+  assert(finder->x && finder->y && finder->index && finder->cell_offsets && cell && offset);
 
   for (i = 0; i < n; i++)
     {
-      while (grid_get_cell_number(grid_ptr, points + i) >= cur_cell)
-        {
-          grid_ptr->cell_offsets[cur_cell++] = i;
-        }
+      cell[i] = cell_number(finder, x[i], y[i]);
+      finder->cell_offsets[cell[i] + 1]++;
     }
-  while (cur_cell <= grid_ptr->num_cells.x * grid_ptr->num_cells.y)
+  for (i = 0; i < num_cells; i++)
     {
-      grid_ptr->cell_offsets[cur_cell++] = n;
+      finder->cell_offsets[i + 1] += finder->cell_offsets[i];
+      offset[i] = finder->cell_offsets[i];
     }
-  return grid_ptr;
+  for (i = 0; i < n; i++)
+    {
+      int k = offset[cell[i]]++;
+      finder->x[k] = x[i];
+      finder->y[k] = y[i];
+      finder->index[k] = i;
+    }
+  remove_coincident_points(finder, cell);
+
+  free(offset);
+  free(cell);
+
+  return finder;
 }
 
-static void grid_apply_function(grid *grid_ptr, double2 center, double radius,
-                                int (*cb_fun)(grid *, grid_callback_data), void *user_data, int n_excluded,
-                                const int *excluded_indices)
+void boundary_finder_delete(boundary_finder_t *finder)
+{
+  if (finder)
+    {
+      free(finder->x);
+      free(finder->y);
+      free(finder->index);
+      free(finder->cell_offsets);
+      free(finder);
+    }
+}
+
+static int ball_empty(const boundary_finder_t *finder, double2 center, double r, int excluded1, int excluded2)
 {
   /*
-   * Apply a callback function `cb_fun` to all points with a distance less than `radius` to the point `center`
-   * except for those that are contained in `excluded_indices`. The information about the search position and the
-   * current point are passed to the callback function using the `grid_callback_data` struct.
-   * Returns if all points are processed or the callback function returns a non-zero value.
+   * Check if no point except for `excluded1` and `excluded2` is located inside the ball with radius `r` around
+   * `center`. The cells of a row are stored consecutively, so each row is scanned as one contiguous range.
+   * Most balls are not empty and the cell at the center is usually covered by the ball completely, so it is
+   * checked first.
    */
-  int i, j, k, l;
-  double2 top_right_position, bottom_left_position;
-  int2 top_right_cell, bottom_left_cell;
-  grid_callback_data callback_data;
-  top_right_position.x = center.x + radius;
-  top_right_position.y = center.y + radius;
-  bottom_left_position.x = center.x - radius;
-  bottom_left_position.y = center.y - radius;
-  top_right_cell = grid_get_cell(grid_ptr, &top_right_position);
-  bottom_left_cell = grid_get_cell(grid_ptr, &bottom_left_position);
-
-  callback_data.center_point = center;
-  callback_data.r = radius;
-  callback_data.user_data = user_data;
-
-  for (i = bottom_left_cell.y; i <= top_right_cell.y; i++)
+  int i, k, x0, y0, x1, y1;
+  double r_sq = r * r;
+  int cell = cell_number(finder, center.x, center.y);
+
+  for (k = finder->cell_offsets[cell]; k < finder->cell_offsets[cell + 1]; k++)
     {
-      for (j = bottom_left_cell.x; j <= top_right_cell.x; j++)
+      double dx = finder->x[k] - center.x;
+      double dy = finder->y[k] - center.y;
+      if (dx * dx + dy * dy < r_sq && k != excluded1 && k != excluded2)
         {
-          int cell_index = i * grid_ptr->num_cells.x + j;
-          for (k = grid_ptr->cell_offsets[cell_index]; k < grid_ptr->cell_offsets[cell_index + 1]; k++)
-            {
-              for (l = 0; l < n_excluded; l++)
-                {
-                  if (excluded_indices[l] == k)
-                    {
-                      break;
-                    }
-                }
-              if (l < n_excluded)
-                {
-                  continue;
-                }
-              if (distance_sq(center, grid_ptr->points[k]) >= radius * radius)
-                {
-                  continue;
-                }
-              callback_data.current_index = k;
-              callback_data.current_point = grid_ptr->points[k];
-              if (cb_fun(grid_ptr, callback_data))
-                {
-                  return;
-                }
-            }
+          return 0;
         }
     }
-}
 
-static void grid_destroy(grid *grid_ptr)
-{
-  if (grid_ptr)
+  cell_range(finder, center, r, &x0, &y0, &x1, &y1);
+  for (i = y0; i <= y1; i++)
     {
-      if (grid_ptr->cell_offsets)
+      int end = finder->cell_offsets[i * finder->num_cells_x + x1 + 1];
+      for (k = finder->cell_offsets[i * finder->num_cells_x + x0]; k < end; k++)
         {
-          free(grid_ptr->cell_offsets);
+          double dx = finder->x[k] - center.x;
+          double dy = finder->y[k] - center.y;
+          if (dx * dx + dy * dy < r_sq && k != excluded1 && k != excluded2)
+            {
+              return 0;
+            }
         }
-      free(grid_ptr);
     }
+  return 1;
 }
 
 static double2 calculate_ball_center(double2 point1, double2 point2, double r)
@@ -277,92 +375,131 @@ static double2 calculate_ball_center(double2 point1, double2 point2, double r)
   return center;
 }
 
-static int grid_cb_ball_empty(grid *grid_ptr, grid_callback_data callback_data)
+static void find_possible_neighbors(const boundary_finder_t *finder, double r, neighbor_point_list *data)
 {
   /*
-   * Callback function to check if a point is located inside a ball. If this function is called (and
-   * both points on the circumference are excluded) at least one point is located inside the ball.
+   * Find all possible neighbor points of the point `data->current`. There must be a ball (sphere) with radius r
+   * that has the current point and the new neighbor point on its circumference. This is only possible for points
+   * with a distance less than 2*r. For each of those points the ball center is calculated using
+   * `calculate_ball_center` and checked if the ball is empty.
+   * Afterwards `data` contains the number of points which have a distance < 2*r (if there are none, the ball radius
+   * is too small) and the number and indices of those points that resulted in an empty ball and can be used as the
+   * next point in the contour.
    */
-  (void)grid_ptr;
-  *(int *)(callback_data.user_data) = 0;
-  return 1;
+  int i, k, x0, y0, x1, y1;
+  double2 current_point = get_point(finder, data->current);
+  double r_sq = 4 * r * r;
+
+  cell_range(finder, current_point, 2 * r, &x0, &y0, &x1, &y1);
+  for (i = y0; i <= y1; i++)
+    {
+      int end = finder->cell_offsets[i * finder->num_cells_x + x1 + 1];
+      for (k = finder->cell_offsets[i * finder->num_cells_x + x0]; k < end; k++)
+        {
+          double2 p;
+          double dx = finder->x[k] - current_point.x;
+          double dy = finder->y[k] - current_point.y;
+          if (dx * dx + dy * dy >= r_sq || k == data->current)
+            {
+              continue;
+            }
+          data->num_points_reachable++;
+          p.x = finder->x[k];
+          p.y = finder->y[k];
+          if (!ball_empty(finder, calculate_ball_center(current_point, p, r), r, data->current, k))
+            {
+              continue;
+            }
+          if (data->size + 1 > data->capacity)
+            {
+              data->capacity *= 2;
+              data->point_list = realloc(data->point_list, data->capacity * sizeof(int));
+              assert(data->point_list);
+            }
+          data->point_list[data->size++] = k;
+        }
+    }
 }
 
-static int grid_cb_find_possible_neighbors(grid *grid_ptr, grid_callback_data callback_data)
+static int find_nearest_neighbor(const boundary_finder_t *finder, double2 position, int index, double *distance)
 {
   /*
-   * Callback function to find all possible neighbor points. There must be a ball (sphere) with radius r
-   * that has the current point (`callback_data.center_point`) and the new neighbor point on its circumference.
-   * This is only possible for points with a distance less (or equal) 2*r. For each of those points the ball
-   * center is calculated using `calculate_ball_center` and checked if the ball is empty using the
-   * `grid_cb_ball_empty` callback in the `grid_apply_function` method.
-   * After all points are processed the `neighbor_point_list` struct provided via `callback_data.user_data`
-   * contains the number of points which have a distance <= 2*r (if there are none, the ball radius is too small)
-   * and the number and indices of those points that resulted in an empty ball and can be used as the next
-   * point in the contour.
+   * Find the nearest point with a positive distance to `position`. If `index` is greater or equal 0, this point
+   * is excluded. The search starts in the cells next to `position` and is extended until a point is found.
+   * Returns the index of that point and stores its squared distance in `distance`, or returns -1 if all points
+   * coincide with `position`.
    */
-  neighbor_point_list *data = (neighbor_point_list *)(callback_data.user_data);
-  double r = callback_data.r / 2;
-  double2 center = callback_data.center_point;
-  double2 p = callback_data.current_point;
-  int index = callback_data.current_index;
-
-  double2 ball_center = calculate_ball_center(center, p, r);
-  int ball_empty = 1;
-  int excluded_indices[2];
-  excluded_indices[0] = data->current;
-  excluded_indices[1] = index;
-  grid_apply_function(grid_ptr, ball_center, r, grid_cb_ball_empty, (void *)&ball_empty, 2, excluded_indices);
-  data->num_points_reachable++;
-  if (!ball_empty)
-    {
-      return 0;
-    }
-  if (data->size + 1 > data->capacity)
+  double max_radius = 2 * ((finder->bounding_box[1].x - finder->bounding_box[0].x) +
+                           (finder->bounding_box[1].y - finder->bounding_box[0].y) + finder->cell_size);
+  double radius = finder->cell_size;
+  int result = -1;
+
+  *distance = -1;
+  while (result < 0 && radius <= 2 * max_radius)
     {
-      data->capacity *= 2;
-      data->point_list = realloc(data->point_list, data->capacity * sizeof(int));
-      assert(data->point_list);
+      int i, k, x0, y0, x1, y1;
+      double r_sq = radius * radius;
+
+      cell_range(finder, position, radius, &x0, &y0, &x1, &y1);
+      for (i = y0; i <= y1; i++)
+        {
+          int end = finder->cell_offsets[i * finder->num_cells_x + x1 + 1];
+          for (k = finder->cell_offsets[i * finder->num_cells_x + x0]; k < end; k++)
+            {
+              double dx = finder->x[k] - position.x;
+              double dy = finder->y[k] - position.y;
+              double d = dx * dx + dy * dy;
+              if (d < r_sq && d > 0 && (d < *distance || *distance < 0) && k != index)
+                {
+                  *distance = d;
+                  result = k;
+                }
+            }
+        }
+      radius *= 2;
     }
-  data->point_list[data->size++] = index;
-  return 0;
+  return result;
 }
 
-static int grid_cb_nearest_neighbor(grid *grid_ptr, grid_callback_data callback_data)
+static void nearest_neighbor_distances(void *arg, int start, int end)
 {
-  /*
-   * Callback function to find the index and distance of the nearest neighbor to `center`.
-   */
-  double distance;
-  double2 *data = (double2 *)callback_data.user_data;
-  double2 center = callback_data.center_point;
-  double2 point = callback_data.current_point;
-  (void)grid_ptr;
+  nearest_neighbor_job *job = (nearest_neighbor_job *)arg;
+  int i;
 
-  distance = distance_sq(center, point);
-  if (distance > 0 && (distance < data->x || data->x < 0))
+  for (i = start; i < end; i++)
     {
-      data->x = distance_sq(center, point);
-      data->index = callback_data.current_index;
+      find_nearest_neighbor(job->finder, get_point(job->finder, i), i, job->nearest_neighbor + i);
     }
-  return 0;
 }
 
-static double2 grid_find_nearest_neighbor(grid *grid_ptr, double2 position, int index, double r)
+double boundary_finder_radius(boundary_finder_t *finder)
 {
   /*
-   * Find the nearest point in the grid `grid_ptr` to `position`. If `index` is greater or equal 0, this
-   * point of the grid is excluded. The start search radius around `position` is `r`. If no points are
-   * found within this radius, it will be doubled until a point is found.
+   * Estimate a ball radius as 1.2 times the largest distance from a point to its nearest neighbor. This makes sure
+   * that at least one neighbor can be reached from each point. The nearest neighbors are searched in parallel and
+   * the result is kept in the finder.
    */
-  double2 result = {-1, -1, -1};
-  double scale = 1;
-  while (result.index < 0)
+  if (finder->radius < 0)
     {
-      grid_apply_function(grid_ptr, position, scale * r, grid_cb_nearest_neighbor, (void *)&result, 1, &index);
-      scale *= 2;
+      nearest_neighbor_job job;
+      double r = 0;
+      int i;
+
+      job.finder = finder;
+      job.nearest_neighbor = malloc(finder->n * sizeof(double));
+      assert(job.nearest_neighbor);
+      gr_parallel_for(finder->n, NEAREST_NEIGHBOR_MIN_POINTS_PER_THREAD, nearest_neighbor_distances, &job);
+      for (i = 0; i < finder->n; i++)
+        {
+          if (job.nearest_neighbor[i] > r)
+            {
+              r = job.nearest_neighbor[i];
+            }
+        }
+      free(job.nearest_neighbor);
+      finder->radius = 1.2 * sqrt(r);
     }
-  return result;
+  return finder->radius;
 }
 
 static double angle(double2 c, double2 p1, double2 p2)
@@ -375,54 +512,31 @@ static double angle(double2 c, double2 p1, double2 p2)
   return acos(v1.x * v2.x + v1.y * v2.y);
 }
 
-static int in_contour(int index, int n_contour, const int *contour)
+int boundary_finder_find(boundary_finder_t *finder, double r, double (*r_function)(double, double), int n_contour,
+                         int *contour)
 {
   /*
-   * Check if `index` is already contained in the `contour` consisting of `n_contour` points.
-   */
-  int i;
-  for (i = n_contour - 1; i >= 0; i--)
-    {
-      if (contour[i] == index)
-        {
-          return i;
-        }
-    }
-  return -1;
-}
-
-int find_boundary(int n, double *x, double *y, double r, double (*r_function)(double, double), int n_contour,
-                  int *contour)
-{
-  /*
-   * Find the boundary of the `n` 2-dimensional points located at `x` and `y` using a ballpivot approach.
-   * The indices of the contour points are stored in the `contour` array. There are several possibilities
-   * to provide the ball radius used in the ballpivot algorithm:
-   * - As a callback function (`r_function`) that returns the ball radius for the current position.
-   * - As a constant ball radius `r`
-   * - Automatically calculated / estimated from the data points
+   * Find the boundary of the points of `finder` using a ballpivot approach. The indices of the contour points are
+   * stored in the `contour` array. If `r_function` is different from NULL it will be used to calculate the ball
+   * radius for each position. Otherwise `r` is used as a constant ball radius if it is greater 0, or the radius is
+   * estimated with `boundary_finder_radius`.
    *
-   * If `r_function` is different from NULL it will be used to calculate the ball radius for each position.
-   * In that case the parameter `r` is only used to set the cell size of the internal grid data structure storing
-   * the points if it has a value greater 0.
-   * If `r_function` is NULL and `r` is greater 0 it is used as a constant ball radius and determines the cell
-   * size of the internal grid. Otherwise a (constant) ball radius is automatically calculated as 1.2 times the
-   * the largest distance from a point to its nearest neighbor.
+   * The finder is not modified if the radius is given or has been estimated before, so several boundaries can be
+   * computed concurrently with the same finder in that case.
    *
    * If the algorithm is successful it returns the number of contour points that were written in `contour`.
    * Otherwise the return value is less than 0 indicating a too small (`FIND_BOUNDARY_BALL_TOO_SMALL`) or too
    * large (`FIND_BOUNDARY_BALL_TOO_LARGE`) ball radius, an invalid number of points (`FIND_BOUNDARY_INVALID_POINTS`)
    * or that the number of contour points exceed the available memory in `contour` given by `n_contour`.
    */
-  double2 bb_bottom_left, bb_top_right;
-  double2 *points;
-  double cell_size;
   neighbor_point_list data;
-  grid *grid_ptr;
+  double distance;
+  int *contour_position;
   int i, start_point, current_index;
   int num_contour_points = 0;
+  int result = 0;
 
-  if (n < 2)
+  if (finder == NULL)
     {
       return FIND_BOUNDARY_INVALID_POINTS;
     }
@@ -432,46 +546,13 @@ int find_boundary(int n, double *x, double *y, double r, double (*r_function)(do
       return FIND_BOUNDARY_MEMORY_EXCEEDED;
     }
 
-  points = malloc(n * sizeof(double2));
-  assert(points);
-  for (i = 0; i < n; i++)
-    {
-      points[i].x = x[i];
-      points[i].y = y[i];
-      points[i].index = i;
-    }
-  calculate_bounding_box(n, points, &bb_bottom_left, &bb_top_right);
-  if (r <= 0)
-    {
-      /* If no radius is given, estimate the cell size as 1/10 of the average of width and height of the data's
-       * bounding box. */
-      cell_size = ((bb_top_right.x - bb_bottom_left.x) + (bb_top_right.y - bb_bottom_left.y)) / 2. / 10.;
-    }
-  else
-    {
-      /* Scale radius by 1.1 to make sure that only direct neighbor cells have to be checked. */
-      cell_size = r * 1.1;
-    }
-  grid_ptr = grid_create(n, points, cell_size);
-
   /* Start from the point closest to the bottom left corner of the bounding box*/
-  start_point = grid_find_nearest_neighbor(grid_ptr, grid_ptr->bounding_box[0], -1, cell_size).index;
+  start_point = find_nearest_neighbor(finder, finder->bounding_box[0], -1, &distance);
   contour[num_contour_points] = start_point;
 
   if (r <= 0 && r_function == NULL)
     { /* No radius given, calculate from data */
-      for (i = 0; i < n; i++)
-        {
-          double nearest_neighbor = grid_find_nearest_neighbor(grid_ptr, grid_get_elem(grid_ptr, i), i, cell_size).x;
-          if (nearest_neighbor > r)
-            {
-              /* Calculate r as the largest distance from one point to its nearest neighbor. This makes sure, that
-               * at least one neighbor can be reached from each point. */
-              r = nearest_neighbor;
-            }
-        }
-      r = sqrt(r);
-      r *= 1.2;
+      r = boundary_finder_radius(finder);
     }
 
   /* Initialize list structure that stores the possible neighbors in each step. */
@@ -479,6 +560,15 @@ int find_boundary(int n, double *x, double *y, double r, double (*r_function)(do
   data.point_list = malloc(data.capacity * sizeof(int));
   assert(data.point_list);
 
+  /* Latest position of each point in the contour, or -1 if it has not been visited yet. */
+  contour_position = malloc(finder->n * sizeof(int));
+  assert(contour_position);
+  for (i = 0; i < finder->n; i++)
+    {
+      contour_position[i] = -1;
+    }
+  contour_position[start_point] = 0;
+
   current_index = start_point;
   while (num_contour_points == 0 || contour[num_contour_points] != contour[0])
     {
@@ -486,11 +576,12 @@ int find_boundary(int n, double *x, double *y, double r, double (*r_function)(do
       data.current = current_index;
       data.size = 0;
       data.num_points_reachable = 0;
-      current_point = grid_get_elem(grid_ptr, current_index);
+      current_point = get_point(finder, current_index);
 
-      if (num_contour_points >= n_contour)
+      if (num_contour_points + 1 >= n_contour)
         {
-          return FIND_BOUNDARY_MEMORY_EXCEEDED;
+          result = FIND_BOUNDARY_MEMORY_EXCEEDED;
+          break;
         }
 
       if (r_function)
@@ -498,17 +589,16 @@ int find_boundary(int n, double *x, double *y, double r, double (*r_function)(do
           r = r_function(current_point.x, current_point.y);
           if (r <= 0)
             {
-              return FIND_BOUNDARY_BALL_TOO_SMALL;
+              result = FIND_BOUNDARY_BALL_TOO_SMALL;
+              break;
             }
         }
 
       /* Find the possible neighbors of `current_point` using the grid structure. */
-      grid_apply_function(grid_ptr, current_point, 2 * r, grid_cb_find_possible_neighbors, (void *)&data, 1,
-                          &current_index);
+      find_possible_neighbors(finder, r, &data);
       if (data.size == 1)
         { /* Only one neighbor is possible */
           current_index = data.point_list[0];
-          contour[++num_contour_points] = current_index;
         }
       else if (data.size > 1)
         { /* More than one point is a possible neighbor */
@@ -516,16 +606,26 @@ int find_boundary(int n, double *x, double *y, double r, double (*r_function)(do
           double best_angle = 0;
           int oldest = num_contour_points + 1;
           int unvisited_points = 0;
+          double2 previous_contour_point;
+
+          /* The walk starts as if coming from the bottom left corner of the bounding box. */
+          if (num_contour_points > 0)
+            {
+              previous_contour_point = get_point(finder, contour[num_contour_points - 1]);
+            }
+          else
+            {
+              previous_contour_point = finder->bounding_box[0];
+            }
 
           /* If at least one possible neighbor is not included in the contour until now use the (unvisited) one
            * with the smallest angle. Otherwise use the one that was visited first to avoid (infinite) loops. */
           for (i = 0; i < (int)data.size; i++)
             {
-              int contour_point_index = in_contour(data.point_list[i], num_contour_points, contour);
+              int contour_point_index = contour_position[data.point_list[i]];
               if (contour_point_index < 0)
                 {
-                  double2 previous_contour_point = grid_get_elem(grid_ptr, contour[num_contour_points - 1]);
-                  double2 possible_contour_point = grid_get_elem(grid_ptr, data.point_list[i]);
+                  double2 possible_contour_point = get_point(finder, data.point_list[i]);
                   double a = angle(current_point, previous_contour_point, possible_contour_point);
                   if (a > best_angle)
                     {
@@ -544,29 +644,70 @@ int find_boundary(int n, double *x, double *y, double r, double (*r_function)(do
                 }
             }
           current_index = data.point_list[best_neighbor];
-          contour[++num_contour_points] = current_index;
         }
       else
         { /* No possible neighbor is found. */
           if (data.num_points_reachable == 0)
             { /* No point was reachable -> ball too small */
-              return FIND_BOUNDARY_BALL_TOO_SMALL;
+              result = FIND_BOUNDARY_BALL_TOO_SMALL;
             }
           else
             { /* No reachable point resulted in an empty ball -> ball too large */
-              return FIND_BOUNDARY_BALL_TOO_LARGE;
+              result = FIND_BOUNDARY_BALL_TOO_LARGE;
             }
+          break;
         }
+      contour[++num_contour_points] = current_index;
+      contour_position[current_index] = num_contour_points;
     }
-  /* The grid data structure reorders the points. Restore original indices of the contour points. */
-  for (i = 0; i < num_contour_points; i++)
+
+  free(contour_position);
+  free(data.point_list);
+
+  if (result < 0)
     {
-      contour[i] = points[contour[i]].index;
+      return result;
     }
 
-  free(points);
-  free(data.point_list);
-  grid_destroy(grid_ptr);
+  /* The grid data structure reorders the points. Restore original indices of the contour points. */
+  for (i = 0; i <= num_contour_points; i++)
+    {
+      contour[i] = finder->index[contour[i]];
+    }
 
   return num_contour_points;
 }
+
+int find_boundary(int n, double *x, double *y, double r, double (*r_function)(double, double), int n_contour,
+                  int *contour)
+{
+  /*
+   * Find the boundary of the `n` 2-dimensional points located at `x` and `y` using a ballpivot approach.
+   * The indices of the contour points are stored in the `contour` array. There are several possibilities
+   * to provide the ball radius used in the ballpivot algorithm:
+   * - As a callback function (`r_function`) that returns the ball radius for the current position.
+   * - As a constant ball radius `r`
+   * - Automatically calculated / estimated from the data points
+   *
+   * If `r_function` is different from NULL it will be used to calculate the ball radius for each position.
+   * If `r_function` is NULL and `r` is greater 0 it is used as a constant ball radius. Otherwise a (constant)
+   * ball radius is automatically calculated as 1.2 times the the largest distance from a point to its nearest
+   * neighbor.
+   *
+   * The return value is the one of `boundary_finder_find`. To compute several boundaries of the same points,
+   * e.g. with different radii, create a finder with `boundary_finder_create` and reuse it instead.
+   */
+  boundary_finder_t *finder;
+  int result;
+
+  if (n < 2)
+    {
+      return FIND_BOUNDARY_INVALID_POINTS;
+    }
+
+  finder = boundary_finder_create(n, x, y);
+  result = boundary_finder_find(finder, r, r_function, n_contour, contour);
+  boundary_finder_delete(finder);
+
+  return result;
+}
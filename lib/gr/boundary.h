@@ -5,6 +5,14 @@
 extern "C" {
 #endif
 
+typedef struct boundary_finder_t boundary_finder_t;
+
+boundary_finder_t *boundary_finder_create(int n, const double *x, const double *y);
+void boundary_finder_delete(boundary_finder_t *finder);
+double boundary_finder_radius(boundary_finder_t *finder);
+int boundary_finder_find(boundary_finder_t *finder, double r, double (*r_function)(double x, double y), int n_contour,
+                         int *contour);
+
 int find_boundary(int n, double *x, double *y, double r, double (*r_function)(double x, double y), int n_contour,
                   int *contour);
 
@@ -8,6 +8,7 @@
 #include "gkscore.h"
 #include "gr.h"
 #include "contour.h"
+#include "parallel.h"
 
 #ifndef min
 #define min(a, b) ((a) < (b) ? (a) : (b))
@@ -24,6 +25,8 @@
 #define contour_max_length 1.2  /* maximum length of a labelled line */
 #define contour_min_length 0.15 /* minimum length of a labelled line */
 #define contour_max_pts 1000    /* maximum number of points */
+#define contour_min_rows_per_thread 256
+#define tricont_min_triangles_per_thread 65536
 
 enum contour_op
 {
@@ -57,17 +60,10 @@ typedef struct
   double x_map_factor, y_map_factor;
 } contour_vars_t;
 
-static contour_vars_t contour_vars;
+static GKS_THREAD_LOCAL contour_vars_t contour_vars;
 
 #define Z(i, j) (contour_vars.z[(i) + contour_vars.xdim * (j)])
 
-typedef struct
-{
-  int npoints;
-  double *x;
-  double *y;
-} polyline_t;
-
 static int lookup_table[6][3][2] = {{{0, 1}, {0, 2}}, {{0, 1}, {1, 2}}, {{0, 2}, {1, 2}},
                                     {{0, 2}, {1, 2}}, {{0, 1}, {1, 2}}, {{0, 1}, {0, 2}}};
 
@@ -93,14 +89,14 @@ static char *xmalloc(int bytes)
 static void gradient(int ind, int n, double *xpts, double *ypts, enum contour_op op)
 {
   int i, j;
-  static int count;
+  static GKS_THREAD_LOCAL int count;
   double t;
   double xg1, yg1, xg2, yg2;
   double xgrad, ygrad;
   double txpt, typt;
-  static double *magnitude = NULL;
-  static double sum;
-  static double max_mag;
+  static GKS_THREAD_LOCAL double *magnitude = NULL;
+  static GKS_THREAD_LOCAL double sum;
+  static GKS_THREAD_LOCAL double max_mag;
 
   /* Since DRAW_CONTOURS is called with different values than     */
   /* xmin=ymin=0 and dx=dy=1, the computed contour-lines must be  */
@@ -207,9 +203,9 @@ static void variance(int ind, int n, double *xpts, double *ypts, enum contour_op
 {
   double y;
   double Sxx, Syy, Sxy;
-  static double sigma_x, sigma_y, sigma_x2, sigma_y2, sigma_xy;
-  static double max_var;
-  static int count;
+  static GKS_THREAD_LOCAL double sigma_x, sigma_y, sigma_x2, sigma_y2, sigma_xy;
+  static GKS_THREAD_LOCAL double max_var;
+  static GKS_THREAD_LOCAL int count;
 
   switch (op)
     {
@@ -590,12 +586,12 @@ static void label_line(int n, double *xpts, double *ypts, double *zpts, char *la
 
 static void draw(double x, double y, double z, int iflag)
 {
-  static int n = 0;
-  static double xpts[contour_max_pts];
-  static double ypts[contour_max_pts];
-  static double zpts[contour_max_pts];
-  static double line_length = 0;
-  static int z_exept_flag = 0;
+  static GKS_THREAD_LOCAL int n = 0;
+  static GKS_THREAD_LOCAL double xpts[contour_max_pts];
+  static GKS_THREAD_LOCAL double ypts[contour_max_pts];
+  static GKS_THREAD_LOCAL double zpts[contour_max_pts];
+  static GKS_THREAD_LOCAL double line_length = 0;
+  static GKS_THREAD_LOCAL int z_exept_flag = 0;
   double dx, dy;
   int linetype, colorind;
   char label[20];
@@ -728,8 +724,51 @@ static void draw(double x, double y, double z, int iflag)
     }
 }
 
-static void calc_contours(double *z, int nrz, int nx, int ny, double *cv, int ncv, double zmax, int *bitmap,
-                          double xmin, double ymin, double dx, double dy)
+typedef struct
+{
+  double *z;
+  int nrz, nx;
+  double *cv;
+  int ncv;
+  int *levels;
+} contour_levels_t;
+
+static void classify_rows(void *arg, int start, int end)
+{
+  /*
+   * Store the number of contour values less than or equal to every point of z (-1 for NAN values). As the contour
+   * values are sorted, the contours crossing the line segment between two points are exactly the ones with indices
+   * from the smaller up to (excluding) the larger of the two numbers.
+   */
+  contour_levels_t *cl = (contour_levels_t *)arg;
+  int i, j, lo, hi, mid;
+  double zij;
+
+  for (j = start; j < end; j++)
+    for (i = 0; i < cl->nx; i++)
+      {
+        zij = cl->z[i + j * cl->nrz];
+        if (zij != zij)
+          {
+            cl->levels[i + j * cl->nrz] = -1;
+            continue;
+          }
+        lo = 0;
+        hi = cl->ncv;
+        while (lo < hi)
+          {
+            mid = (lo + hi) / 2;
+            if (cl->cv[mid] <= zij)
+              lo = mid + 1;
+            else
+              hi = mid;
+          }
+        cl->levels[i + j * cl->nrz] = lo;
+      }
+}
+
+static void calc_contours(double *z, int nrz, int nx, int ny, double *cv, int ncv, double zmax, unsigned char *bitmap,
+                          int *levels, double xmin, double ymin, double dx, double dy)
 {
   /*
       This subroutine draws a contour through equal values of an array.
@@ -761,6 +800,11 @@ static void calc_contours(double *z, int nrz, int nx, int ny, double *cv, int nc
 
       BITMAP is a work area large enough to hold NX*NY*NCV*2 bits.
 
+      LEVELS is either NULL or holds the number of contour values less
+      than or equal to every element of Z (-1 for NAN values), if the
+      contour values are sorted in ascending order. It is used to skip
+      the contours which do not cross a line segment.
+
       ******************************************************************
 
       DRAW is a subroutine used to draw contours.  The calling sequence
@@ -812,7 +856,7 @@ static void calc_contours(double *z, int nrz, int nx, int ny, double *cv, int nc
       XY is used to compute coordinates for the draw subroutine.
    */
 
-  static int l1[4] = {0, 0, -1, -1};
+  static GKS_THREAD_LOCAL int l1[4] = {0, 0, -1, -1};
   static int i1[2] = {1, 0};
   static int i2[2] = {1, -1};
   static int i3[6] = {1, 0, 0, 1, 1, 0};
@@ -822,9 +866,13 @@ static void calc_contours(double *z, int nrz, int nx, int ny, double *cv, int nc
   double xy[2];
   int ij[2], l2[4];
   int ii, jj, ni, ks = 0, ix, nxidir, icv = 0;
+  int lv1, lv2, lvmax;
 
 #define Z(i, j) z[(i)-1 + ((j)-1) * nrz]
-#define BITMAP(i, j, k, l) bitmap[(i)-1 + ((j)-1 + ((k)-1 + ((l)-1) * ncv) * ny) * nx]
+#define BITMAP_INDEX(i, j, k, l) (((size_t)(i)-1 + ((size_t)(j)-1) * nx) * 2 * ncv + ((l)-1) * ncv + (k)-1)
+#define BITMAP(i, j, k, l) (bitmap[BITMAP_INDEX(i, j, k, l) >> 3] & (1 << (BITMAP_INDEX(i, j, k, l) & 7)))
+#define SET_BITMAP(i, j, k, l) (bitmap[BITMAP_INDEX(i, j, k, l) >> 3] |= (1 << (BITMAP_INDEX(i, j, k, l) & 7)))
+#define LEVEL(i, j) levels[(i)-1 + ((j)-1) * nrz]
 
   l1[0] = nx;
   l1[1] = ny;
@@ -839,7 +887,7 @@ static void calc_contours(double *z, int nrz, int nx, int ny, double *cv, int nc
 
   /*  Clear the bitmap. */
 
-  memset(bitmap, 0, nx * ny * ncv * 2 * sizeof(int));
+  memset(bitmap, 0, ((size_t)nx * ny * ncv * 2 + 7) / 8);
 
   /*  Search along a rectangular spiral path for a line segment having
       the following properties:
@@ -959,6 +1007,21 @@ L100:
   jj = ij[1] + i1[3 - l - 1];
   z1 = Z(ij[0], ij[1]);
   z2 = Z(ii, jj);
+  if (levels != NULL && (lv1 = LEVEL(ij[0], ij[1])) >= 0 && (lv2 = LEVEL(ii, jj)) >= 0)
+    {
+      /*  Only the contours with min(z1, z2) < cv <= max(z1, z2) cross the
+          line segment, the marks for the other contours are never read. */
+
+      lvmax = max(lv1, lv2);
+      for (icv = min(lv1, lv2) + 1; icv <= lvmax; ++icv)
+        {
+          if (BITMAP(ij[0], ij[1], icv, l) == 0)
+            {
+              goto L190;
+            }
+        }
+      goto L130;
+    }
   for (icv = 1; icv <= ncv; ++icv)
     {
       if (BITMAP(ij[0], ij[1], icv, l) != 0)
@@ -974,7 +1037,7 @@ L100:
           goto L190;
         }
     L110:
-      BITMAP(ij[0], ij[1], icv, l) = 1;
+      SET_BITMAP(ij[0], ij[1], icv, l);
     L120:;
     }
 L130:
@@ -1044,7 +1107,7 @@ L190:
 L200:
   xy[l - 1] = ij[l - 1] + xint[iedge - 1];
   xy[3 - l - 1] = ij[3 - l - 1];
-  BITMAP(ij[0], ij[1], icv, l) = 1;
+  SET_BITMAP(ij[0], ij[1], icv, l);
   draw(xmin + (xy[0] - 1.0) * dx, ymin + (xy[1] - 1.0) * dy, cval, iflag + 10 * icv);
   if (iflag < 4)
     {
@@ -1167,13 +1230,18 @@ L290:
   goto L200;
 }
 
+#undef LEVEL
+#undef SET_BITMAP
 #undef BITMAP
+#undef BITMAP_INDEX
 #undef Z
 
 void gr_draw_contours(int nx, int ny, int nh, double *px, double *py, double *h, double *z, int major_h)
 {
   double mmin, mmax, *cv;
-  int ncv, *bitmap;
+  int ncv, *levels = NULL;
+  unsigned char *bitmap;
+  contour_levels_t cl;
   int i, j, k, n = 0;
   int precision, max_precision;
   char *s, buffer[80];
@@ -1293,21 +1361,60 @@ void gr_draw_contours(int nx, int ny, int nh, double *px, double *py, double *h,
       sprintf(contour_vars.lblfmt, "%%.%d%c", max_precision, eflag ? 'e' : 'f');
     }
 
-  bitmap = (int *)xmalloc(nx * ny * ncv * 2 * sizeof(int));
+  bitmap = (unsigned char *)xmalloc(((size_t)nx * ny * ncv * 2 + 7) / 8);
+
+  for (i = 1; i < ncv; i++)
+    if (!(cv[i - 1] <= cv[i])) break;
+  if (i >= ncv)
+    {
+      levels = (int *)xmalloc(nx * ny * sizeof(int));
+      cl.z = contour_vars.z;
+      cl.nrz = nx;
+      cl.nx = nx;
+      cl.cv = cv;
+      cl.ncv = ncv;
+      cl.levels = levels;
+      gr_parallel_for(ny, contour_min_rows_per_thread, classify_rows, &cl);
+    }
+
   contour_vars.xmin = px[0];
   contour_vars.ymin = py[0];
   contour_vars.dx = px[1] - contour_vars.xmin;
   contour_vars.dy = py[1] - contour_vars.ymin;
 
-  calc_contours(contour_vars.z, nx, nx, ny, cv, ncv, mmax, bitmap, contour_vars.xmin, contour_vars.ymin,
+  calc_contours(contour_vars.z, nx, nx, ny, cv, ncv, mmax, bitmap, levels, contour_vars.xmin, contour_vars.ymin,
                 contour_vars.dx, contour_vars.dy);
 
+  if (levels != NULL) free(levels);
   free(bitmap);
 
   if (contour_vars.label_map != NULL) free(contour_vars.label_map);
   if (cv != h) free(cv);
 }
 
+typedef struct
+{
+  int npoints, points_capacity;
+  double *x, *y;
+  int nlines, lines_capacity;
+  int *line_start;
+} tricont_level_t;
+
+typedef struct
+{
+  double *x, *y, *z;
+  int ntri;
+  int *triangles;
+  int *vertex_start;
+  int *vertex_triangles;
+  int *neighbors;
+  double *levels;
+  int *level_position;
+  size_t *bucket_start;
+  int *buckets;
+  tricont_level_t *results;
+} tricont_t;
+
 static int get_lookup_table_index(int *triangle, double *z, double isolevel)
 {
   int index, i;
@@ -1320,224 +1427,326 @@ static int get_lookup_table_index(int *triangle, double *z, double isolevel)
   return index;
 }
 
-static void interpolate_line_segment(double *x, double *y, double *z, int *triangle, double isolevel, int *nlines,
-                                     vertex_t *lines)
+static int lookup_table_edge(int index, int i)
+{
+  /*
+   * Return the edge of the triangle (0: vertices 0 and 1, 1: vertices 0 and 2, 2: vertices 1 and 2) which contains
+   * the end point `i` of the line segment for the given lookup table index.
+   */
+  return lookup_table[index - 1][i][0] + lookup_table[index - 1][i][1] - 1;
+}
+
+static void interpolate_point(tricont_t *tc, int *triangle, int index, int i, double isolevel, double *px, double *py)
 {
   int indices[2];
-  int index, i, j;
+  int j;
 
-  index = get_lookup_table_index(triangle, z, isolevel);
-  if (index > 0 && index < 7)
+  for (j = 0; j < 2; ++j)
     {
-      for (i = 0; i < 2; ++i)
-        {
-          for (j = 0; j < 2; ++j)
-            {
-              indices[j] = triangle[lookup_table[index - 1][i][j]];
-            }
-          lines[i].x = x[indices[0]] +
-                       (x[indices[1]] - x[indices[0]]) * ((isolevel - z[indices[0]]) / (z[indices[1]] - z[indices[0]]));
-          lines[i].y = y[indices[0]] +
-                       (y[indices[1]] - y[indices[0]]) * ((isolevel - z[indices[0]]) / (z[indices[1]] - z[indices[0]]));
-        }
-      *nlines = 1;
-    }
-  else
-    {
-      *nlines = 0;
+      indices[j] = triangle[lookup_table[index - 1][i][j]];
     }
+  *px = tc->x[indices[0]] + (tc->x[indices[1]] - tc->x[indices[0]]) *
+                                ((isolevel - tc->z[indices[0]]) / (tc->z[indices[1]] - tc->z[indices[0]]));
+  *py = tc->y[indices[0]] + (tc->y[indices[1]] - tc->y[indices[0]]) *
+                                ((isolevel - tc->z[indices[0]]) / (tc->z[indices[1]] - tc->z[indices[0]]));
 }
 
-static void convert_segments_to_polylines(int nsegments, vertex_t *segments, int *nlines, polyline_t **lines)
+static void find_neighbors(void *arg, int start, int end)
 {
-  polyline_t *lin;
-  int nlin;
-  polyline_t *cur_lin;
-  vertex_t *points;
-  int start;
-  int end;
-  int capacity;
-  vertex_t *start_point = NULL;
-  vertex_t *end_point = NULL;
-  int *used_segments;
-  int nfree_segments;
-  int found_point;
-  int i;
+  /*
+   * Find the triangle sharing each edge of the triangles in [start, end) by searching the (few) triangles which
+   * contain the first vertex of the edge, -1 marks an edge on the border.
+   */
+  tricont_t *tc = (tricont_t *)arg;
+  int t, e, a, b, k, u, *tri;
+
+  for (t = start; t < end; t++)
+    for (e = 0; e < 3; e++)
+      {
+        a = tc->triangles[3 * t + (e == 2 ? 1 : 0)];
+        b = tc->triangles[3 * t + (e == 0 ? 1 : 2)];
+        tc->neighbors[3 * t + e] = -1;
+        for (k = tc->vertex_start[a]; k < tc->vertex_start[a + 1]; k++)
+          {
+            u = tc->vertex_triangles[k];
+            tri = tc->triangles + 3 * u;
+            if (u != t && (tri[0] == b || tri[1] == b || tri[2] == b))
+              {
+                tc->neighbors[3 * t + e] = u;
+                break;
+              }
+          }
+      }
+}
 
-  lin = (polyline_t *)malloc(nsegments * sizeof(polyline_t));
-  if (lin == NULL)
-    {
-      fprintf(stderr, "out of virtual memory\n");
-      return;
-    }
-  cur_lin = lin;
-  points = (vertex_t *)malloc((nsegments + 2) * sizeof(vertex_t));
-  if (points == NULL)
-    {
-      fprintf(stderr, "out of virtual memory\n");
-      free(lin);
-      return;
-    }
-  nlin = 0;
-  start = -1;
-  end = 0;
-  capacity = nsegments + 2;
-  used_segments = calloc(nsegments, sizeof(int));
-  if (used_segments == NULL)
+static int lower_bound(const double *values, int n, double value)
+{
+  int lo = 0, hi = n, mid;
+
+  while (lo < hi)
     {
-      fprintf(stderr, "out of virtual memory\n");
-      free(lin);
-      free(points);
-      return;
+      mid = (lo + hi) / 2;
+      if (values[mid] < value)
+        lo = mid + 1;
+      else
+        hi = mid;
     }
-  nfree_segments = nsegments;
+  return lo;
+}
+
+static int compare_levels(const void *a, const void *b)
+{
+  double da = *(const double *)a, db = *(const double *)b;
+
+  return da < db ? -1 : (da > db ? 1 : 0);
+}
 
-  while (nfree_segments > 0)
+static void add_point(tricont_level_t *result, double x, double y)
+{
+  if (result->npoints == result->points_capacity)
     {
-      /* each iteration generates a new polyline */
-      found_point = 1;
-      while (found_point)
-        {
-          /* each iteration adds a new point to the polyline */
-          found_point = 0;
-          for (i = 0; i < nsegments; i++)
-            {
-              /* each iteration tests if a line segment can be added to the current
-                 polyline */
-              if (!used_segments[i])
-                {
-                  if (start >= 0)
-                    {
-                      if (fabs(segments[2 * i].x - start_point->x) < FEPS &&
-                          fabs(segments[2 * i].y - start_point->y) < FEPS)
-                        { /* start of segment fits at start of polyline */
-                          points[start] = segments[2 * i + 1];
-                          start = (start - 1 + capacity) % capacity;
-                        }
-                      else if (fabs(segments[2 * i + 1].x - start_point->x) < FEPS &&
-                               fabs(segments[2 * i + 1].y - start_point->y) < FEPS)
-                        { /* end of segment fits at start of polyline */
-                          points[start] = segments[2 * i];
-                          start = (start - 1 + capacity) % capacity;
-                        }
-                      else if (fabs(segments[2 * i].x - end_point->x) < FEPS &&
-                               fabs(segments[2 * i].y - end_point->y) < FEPS)
-                        { /* start of segment fits at end of polyline */
-                          points[end] = segments[2 * i + 1];
-                          end = (end + 1 + capacity) % capacity;
-                        }
-                      else if (fabs(segments[2 * i + 1].x - end_point->x) < FEPS &&
-                               fabs(segments[2 * i + 1].y - end_point->y) < FEPS)
-                        { /* end of segment fits at end of polyline */
-                          points[end] = segments[2 * i];
-                          end = (end + 1 + capacity) % capacity;
-                        }
-                      else
-                        {
-                          continue;
-                        }
-                      used_segments[i] = 1;
-                      --nfree_segments;
-                      found_point = 1;
-                      break;
-                    }
-                  else
-                    {
-                      /* empty polyline */
-                      start = (start + capacity) % capacity;
-                      points[start] = segments[2 * i];
-                      points[end] = segments[2 * i + 1];
-                      start_point = points + start;
-                      end_point = points + end;
-                      start = (start - 1 + capacity) % capacity;
-                      end = (end + 1 + capacity) % capacity;
-                      used_segments[i] = 1;
-                      --nfree_segments;
-                      found_point = 1;
-                      break;
-                    }
-                }
-            }
-        }
-      cur_lin->npoints = 0;
-      cur_lin->x = (double *)malloc((end - start + capacity - 1) * sizeof(double));
-      cur_lin->y = (double *)malloc((end - start + capacity - 1) * sizeof(double));
-      if (cur_lin->x == NULL || cur_lin->y == NULL)
+      result->points_capacity = result->points_capacity ? 2 * result->points_capacity : 1024;
+      result->x = (double *)realloc(result->x, result->points_capacity * sizeof(double));
+      result->y = (double *)realloc(result->y, result->points_capacity * sizeof(double));
+      if (result->x == NULL || result->y == NULL)
         {
           fprintf(stderr, "out of virtual memory\n");
-          free(cur_lin->x);
-          free(cur_lin->y);
-          return;
+          abort();
         }
-      for (i = start + 1; i != end; i = (i + 1) % capacity)
+    }
+  result->x[result->npoints] = x;
+  result->y[result->npoints] = y;
+  result->npoints++;
+}
+
+static void add_line(tricont_level_t *result)
+{
+  if (result->nlines == result->lines_capacity)
+    {
+      result->lines_capacity = result->lines_capacity ? 2 * result->lines_capacity : 64;
+      result->line_start = (int *)realloc(result->line_start, (result->lines_capacity + 1) * sizeof(int));
+      if (result->line_start == NULL)
         {
-          cur_lin->x[cur_lin->npoints] = points[i].x;
-          cur_lin->y[cur_lin->npoints] = points[i].y;
-          ++(cur_lin->npoints);
+          fprintf(stderr, "out of virtual memory\n");
+          abort();
         }
-      ++nlin;
-      ++cur_lin;
-      start = -1;
-      end = 0;
     }
+  result->line_start[result->nlines++] = result->npoints;
+}
 
-  lin = realloc(lin, nlin * sizeof(polyline_t));
-  free(points);
-  free(used_segments);
+static void reverse_points(tricont_level_t *result, int start, int end)
+{
+  double tmp;
+  int i;
 
-  *nlines = nlin;
-  *lines = lin;
+  for (i = 0; i < (end - start) / 2; i++)
+    {
+      tmp = result->x[start + i];
+      result->x[start + i] = result->x[end - 1 - i];
+      result->x[end - 1 - i] = tmp;
+      tmp = result->y[start + i];
+      result->y[start + i] = result->y[end - 1 - i];
+      result->y[end - 1 - i] = tmp;
+    }
 }
 
-static void march_triangles(double *x, double *y, double *z, int ntri, int *triangles, double isolevel, int *nlines,
-                            polyline_t **lines)
+static int follow_line(tricont_t *tc, int t, int edge, double isolevel, int *visited, int stamp,
+                       tricont_level_t *result)
 {
-  int i, j;
-  vertex_t cur_line[2];
-  int cur_nlines;
-  vertex_t *lin;
-  double nlin;
-  int cur_lin_index;
-
-  lin = (vertex_t *)malloc(ntri * 2 * sizeof(vertex_t));
-  if (lin == NULL)
+  /*
+   * Follow a contour line from triangle t through the given edge into the neighboring triangles and add the points
+   * of the line until it reaches the border or an already visited triangle. Return the last triangle reached (the
+   * first triangle of a closed line) or -1 at the border.
+   */
+  int u, index, i;
+  double px, py;
+
+  while ((u = tc->neighbors[3 * t + edge]) >= 0)
     {
-      fprintf(stderr, "out of virtual memory\n");
-      return;
+      if (visited[u] == stamp) return u;
+      visited[u] = stamp;
+      index = get_lookup_table_index(tc->triangles + 3 * u, tc->z, isolevel);
+      if (index == 0 || index == 7) return -1;
+      /* the line leaves through the end point which is not on the edge shared with t */
+      i = tc->neighbors[3 * u + lookup_table_edge(index, 0)] == t ? 1 : 0;
+      interpolate_point(tc, tc->triangles + 3 * u, index, i, isolevel, &px, &py);
+      add_point(result, px, py);
+      edge = lookup_table_edge(index, i);
+      t = u;
     }
-  cur_lin_index = 0;
-  for (i = 0; i < ntri; ++i)
+  return -1;
+}
+
+static void trace_level(tricont_t *tc, int l, int *visited)
+{
+  /*
+   * Join the line segments of all triangles crossing the iso level l into polylines by walking from triangle to
+   * triangle. Lines which are not closed are followed in both directions from the first triangle found.
+   */
+  tricont_level_t *result = tc->results + l;
+  double isolevel = tc->levels[l];
+  int stamp = l + 1;
+  int t, index, first, n;
+  size_t k;
+  double px, py;
+
+  if (tc->level_position[l] < 0) return;
+
+  for (k = tc->bucket_start[tc->level_position[l]]; k < tc->bucket_start[tc->level_position[l] + 1]; k++)
     {
-      interpolate_line_segment(x, y, z, &triangles[3 * i], isolevel, &cur_nlines, cur_line);
-      for (j = 0; j < 2 * cur_nlines; (j++, cur_lin_index++))
+      t = tc->buckets[k];
+      if (visited[t] == stamp) continue;
+      visited[t] = stamp;
+      index = get_lookup_table_index(tc->triangles + 3 * t, tc->z, isolevel);
+
+      add_line(result);
+      first = result->npoints;
+      interpolate_point(tc, tc->triangles + 3 * t, index, 0, isolevel, &px, &py);
+      add_point(result, px, py);
+      interpolate_point(tc, tc->triangles + 3 * t, index, 1, isolevel, &px, &py);
+      add_point(result, px, py);
+      if (follow_line(tc, t, lookup_table_edge(index, 1), isolevel, visited, stamp, result) == t)
         {
-          lin[cur_lin_index].x = cur_line[j].x;
-          lin[cur_lin_index].y = cur_line[j].y;
+          add_point(result, result->x[first], result->y[first]);
         }
+      else
+        {
+          /* append the other half of the line, then move it to the front in reverse order */
+          n = result->npoints - first;
+          follow_line(tc, t, lookup_table_edge(index, 0), isolevel, visited, stamp, result);
+          reverse_points(result, first, result->npoints);
+          reverse_points(result, result->npoints - n, result->npoints);
+        }
+      result->line_start[result->nlines] = result->npoints;
     }
-  lin = realloc(lin, cur_lin_index * sizeof(vertex_t));
-  nlin = cur_lin_index / 2;
+}
+
+static void trace_levels(void *arg, int start, int end)
+{
+  tricont_t *tc = (tricont_t *)arg;
+  int *visited, l;
 
-  convert_segments_to_polylines(nlin, lin, nlines, lines);
+  visited = (int *)calloc(tc->ntri, sizeof(int));
+  if (visited == NULL)
+    {
+      fprintf(stderr, "out of virtual memory\n");
+      abort();
+    }
+  for (l = start; l < end; l++) trace_level(tc, l, visited);
+  free(visited);
 }
 
 void gr_draw_tricont(int npoints, double *x, double *y, double *z, int nlevels, double *levels, int *colors)
 {
-  int i, l;
-  int ntri, *triangles;
-  int nlines = 0;
-  polyline_t *lines = NULL;
+  tricont_t tc;
+  double *sorted, zmin, zmax, zi;
+  int *lo, *hi, *count;
+  int i, l, p, t, nsorted;
+  size_t *fill;
+
+  tc.x = x;
+  tc.y = y;
+  tc.z = z;
+  tc.levels = levels;
+
+  gr_delaunay(npoints, x, y, &tc.ntri, &tc.triangles);
+  if (tc.triangles == NULL) return;
+
+  /* index the triangles by their vertices to find the neighbors of every triangle */
+  tc.vertex_start = (int *)xmalloc((npoints + 1) * sizeof(int));
+  tc.vertex_triangles = (int *)xmalloc(3 * tc.ntri * sizeof(int));
+  tc.neighbors = (int *)xmalloc(3 * tc.ntri * sizeof(int));
+  count = (int *)xmalloc(npoints * sizeof(int));
+  memset(tc.vertex_start, 0, (npoints + 1) * sizeof(int));
+  for (i = 0; i < 3 * tc.ntri; i++) tc.vertex_start[tc.triangles[i] + 1]++;
+  for (i = 0; i < npoints; i++) tc.vertex_start[i + 1] += tc.vertex_start[i];
+  memcpy(count, tc.vertex_start, npoints * sizeof(int));
+  for (i = 0; i < 3 * tc.ntri; i++) tc.vertex_triangles[count[tc.triangles[i]]++] = i / 3;
+  free(count);
+  gr_parallel_for(tc.ntri, tricont_min_triangles_per_thread, find_neighbors, &tc);
+
+  /* sort the iso levels, equal levels get consecutive positions and NAN levels none */
+  sorted = (double *)xmalloc((nlevels + 1) * sizeof(double));
+  tc.level_position = (int *)xmalloc(nlevels * sizeof(int));
+  nsorted = 0;
+  for (l = 0; l < nlevels; l++)
+    if (levels[l] == levels[l]) sorted[nsorted++] = levels[l];
+  qsort(sorted, nsorted, sizeof(double), compare_levels);
+  for (l = 0; l < nlevels; l++)
+    {
+      tc.level_position[l] = -1;
+      if (levels[l] == levels[l])
+        {
+          tc.level_position[l] = lower_bound(sorted, nsorted, levels[l]);
+          for (i = 0; i < l; i++)
+            if (levels[i] == levels[l]) tc.level_position[l]++;
+        }
+    }
 
-  gr_delaunay(npoints, x, y, &ntri, &triangles);
+  /*
+   * Put every triangle into the buckets of the iso levels it crosses, which are the levels L with
+   * min(z) <= L < max(z) for the z values of its vertices. NAN values are never above an iso level.
+   */
+  lo = (int *)xmalloc(tc.ntri * sizeof(int));
+  hi = (int *)xmalloc(tc.ntri * sizeof(int));
+  count = (int *)xmalloc((nsorted + 1) * sizeof(int));
+  memset(count, 0, (nsorted + 1) * sizeof(int));
+  for (t = 0; t < tc.ntri; t++)
+    {
+      zmin = huge_value;
+      zmax = -huge_value;
+      for (i = 0; i < 3; i++)
+        {
+          zi = z[tc.triangles[3 * t + i]];
+          if (zi != zi) zi = -huge_value;
+          if (zi < zmin) zmin = zi;
+          if (zi > zmax) zmax = zi;
+        }
+      lo[t] = lower_bound(sorted, nsorted, zmin);
+      hi[t] = lower_bound(sorted, nsorted, zmax);
+      count[lo[t]]++;
+      count[hi[t]]--;
+    }
+  tc.bucket_start = (size_t *)xmalloc((nsorted + 1) * sizeof(size_t));
+  fill = (size_t *)xmalloc((nsorted + 1) * sizeof(size_t));
+  tc.bucket_start[0] = 0;
+  for (p = 0; p < nsorted; p++)
+    {
+      if (p > 0) count[p] += count[p - 1];
+      tc.bucket_start[p + 1] = tc.bucket_start[p] + count[p];
+    }
+  memcpy(fill, tc.bucket_start, (nsorted + 1) * sizeof(size_t));
+  tc.buckets = (int *)xmalloc((tc.bucket_start[nsorted] + 1) * sizeof(int));
+  for (t = 0; t < tc.ntri; t++)
+    for (p = lo[t]; p < hi[t]; p++) tc.buckets[fill[p]++] = t;
+  free(fill);
+  free(count);
+  free(hi);
+  free(lo);
+
+  /* trace the levels in parallel, drawing has to be done in order */
+  tc.results = (tricont_level_t *)xmalloc(nlevels * sizeof(tricont_level_t));
+  memset(tc.results, 0, nlevels * sizeof(tricont_level_t));
+  gr_parallel_for(nlevels, 1, trace_levels, &tc);
 
   for (l = 0; l < nlevels; l++)
     {
-      march_triangles(x, y, z, ntri, triangles, levels[l], &nlines, &lines);
-
       gr_setlinecolorind(colors[l]);
-      for (i = 0; i < nlines; i++) gr_polyline(lines[i].npoints, lines[i].x, lines[i].y);
-
-      free(lines);
+      for (i = 0; i < tc.results[l].nlines; i++)
+        gr_polyline(tc.results[l].line_start[i + 1] - tc.results[l].line_start[i],
+                    tc.results[l].x + tc.results[l].line_start[i], tc.results[l].y + tc.results[l].line_start[i]);
+      free(tc.results[l].x);
+      free(tc.results[l].y);
+      free(tc.results[l].line_start);
     }
-  free(triangles);
+
+  free(tc.results);
+  free(tc.buckets);
+  free(tc.bucket_start);
+  free(tc.level_position);
+  free(sorted);
+  free(tc.neighbors);
+  free(tc.vertex_triangles);
+  free(tc.vertex_start);
+  free(tc.triangles);
 }
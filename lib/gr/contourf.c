@@ -3,9 +3,11 @@
 #include <assert.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 
 #include "gr.h"
 #include "contour.h"
+#include "parallel.h"
 
 #ifndef NAN
 #define NAN (0.0 / 0.0)
@@ -17,6 +19,11 @@
 
 #define DEFAULT_CONTOUR_LINES 16 /* default number of contour lines */
 
+#define CONTOUR_TILE_SIZE 64            /* edge length of the tiles of cells which are skipped as a whole */
+#define CONTOUR_MIN_ROWS_PER_THREAD 256 /* minimum number of rows classified by each thread */
+
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
 #define EDGE_N (1 << 0)
 #define EDGE_E (1 << 1)
 #define EDGE_S (1 << 2)
@@ -129,19 +136,6 @@ static double padded_array_lookup_1d(const double *z, size_t nx, long i)
   return z[i];
 }
 
-static unsigned char get_bitmask(const double *z, size_t nx, size_t ny, long i, long j, double contour)
-{
-  /*
-   * Calculate the bitmask for cell (i, j) of z and contour used for the marching squares algorithm.
-   */
-  unsigned char result = 0;
-  result |= (padded_array_lookup(z, nx, ny, i, j) >= contour) << 3;
-  result |= (padded_array_lookup(z, nx, ny, i + 1, j) >= contour) << 2;
-  result |= (padded_array_lookup(z, nx, ny, i + 1, j + 1) >= contour) << 1;
-  result |= (padded_array_lookup(z, nx, ny, i, j + 1) >= contour);
-  return result;
-}
-
 static double interpolate(double v1, double v2, double contour)
 {
   double d = v2 - v1;
@@ -256,110 +250,213 @@ static unsigned char check_saddle(const unsigned char edges)
   return ALL_EDGES;
 }
 
-static void marching_squares(const double *x, const double *y, const double *z, size_t nx, size_t ny,
-                             const double *contours, size_t nc, int first_color, int last_color, int draw_polylines)
+typedef struct
+{
+  _list_t *polylines_x;
+  _list_t *polylines_y;
+  _list_t *line_indices;
+} contour_level_t;
+
+typedef struct
+{
+  const double *x;
+  const double *y;
+  const double *z;
+  size_t nx;
+  size_t ny;
+  const double *contours;
+  size_t nc;
+  int *levels;
+  size_t tiles_x;
+  size_t tiles_y;
+  int *tile_min;
+  int *tile_max;
+  contour_level_t *results;
+} marching_squares_t;
+
+static int level_index(const double *contours, size_t nc, double value)
 {
   /*
-   * Calculate and fill / draw contours using the marching squares algorithm.
-   *
-   * In this implementation the array z is padded twice. 1 cell outside of z the border value
-   * is repeated and 2 cells outside of z NAN. This assures that contour lines that cross the
-   * border of z are also closed (outside of z).
+   * Return the number of contours that are less than or equal to value (contours must be sorted in ascending
+   * order), so that `value >= contours[k]` holds exactly if the result is greater than k.
    */
-  double x_step = x[1] - x[0];
-  double y_step = y[1] - y[0];
+  size_t lo = 0, hi = nc, mid;
+  if (value != value)
+    {
+      return 0;
+    }
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (value >= contours[mid])
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  return (int)lo;
+}
 
-  double x_pos, y_pos;
-  long i, j, fillarea_start_index;
-  size_t contour_index;
-  double color_step = 0;
-  if (nc > 1)
+static void classify_rows(void *arg, int start, int end)
+{
+  /*
+   * Store the level index of every point of the padded z array. The level indices have one more row and column
+   * than the padded array (filled with 0 like the NAN values outside of it), so that the corners of every cell can
+   * be looked up without bounds checks.
+   */
+  marching_squares_t *ms = (marching_squares_t *)arg;
+  size_t stride = ms->nx + 5;
+  long i, j;
+
+  for (j = start; j < end; j++)
     {
-      color_step = 1.0 * (last_color - first_color) / (nc - 1);
+      for (i = 0; i < (long)stride; i++)
+        {
+          ms->levels[j * stride + i] =
+              level_index(ms->contours, ms->nc, padded_array_lookup(ms->z, ms->nx, ms->ny, i, j));
+        }
     }
-  else if (nc == 1)
+}
+
+static void classify_tiles(void *arg, int start, int end)
+{
+  /*
+   * Store the range of level indices in every tile, a tile contains cells of the contour `k` only if
+   * `tile_min <= k < tile_max`.
+   */
+  marching_squares_t *ms = (marching_squares_t *)arg;
+  size_t stride = ms->nx + 5;
+  size_t tx, ty, i, j, i_end, j_end;
+  int level, level_min, level_max;
+
+  for (ty = start; ty < (size_t)end; ty++)
     {
-      color_step = 0;
+      for (tx = 0; tx < ms->tiles_x; tx++)
+        {
+          level_min = INT_MAX;
+          level_max = 0;
+          i_end = min((tx + 1) * CONTOUR_TILE_SIZE, ms->nx + 4);
+          j_end = min((ty + 1) * CONTOUR_TILE_SIZE, ms->ny + 4);
+          for (j = ty * CONTOUR_TILE_SIZE; j <= j_end; j++)
+            {
+              for (i = tx * CONTOUR_TILE_SIZE; i <= i_end; i++)
+                {
+                  level = ms->levels[j * stride + i];
+                  if (level < level_min) level_min = level;
+                  if (level > level_max) level_max = level;
+                }
+            }
+          ms->tile_min[ty * ms->tiles_x + tx] = level_min;
+          ms->tile_max[ty * ms->tiles_x + tx] = level_max;
+        }
     }
+}
 
-  /* Create list structures to store the polyline's vertices and the start index of each individual polyline */
-  _list_t *polylines_x = list_create(nx * ny / 4, sizeof(double));
-  _list_t *polylines_y = list_create(nx * ny / 4, sizeof(double));
-  _list_t *line_indices = list_create(100, sizeof(size_t));
+static int tile_has_contour(const marching_squares_t *ms, size_t tx, size_t ty, int contour_index)
+{
+  return ms->tile_min[ty * ms->tiles_x + tx] <= contour_index && contour_index < ms->tile_max[ty * ms->tiles_x + tx];
+}
 
+static void trace_contour(const marching_squares_t *ms, unsigned char *edges, size_t contour_index)
+{
+  /*
+   * Calculate the closed polylines of a single contour. Only the tiles which contain the contour are visited.
+   */
+  static const unsigned char cell_edges[16] = {0,
+                                               EDGE_W | EDGE_S,
+                                               EDGE_E | EDGE_S,
+                                               EDGE_W | EDGE_E,
+                                               EDGE_N | EDGE_E,
+                                               ALL_EDGES,
+                                               EDGE_N | EDGE_S,
+                                               EDGE_N | EDGE_W,
+                                               EDGE_N | EDGE_W,
+                                               EDGE_N | EDGE_S,
+                                               ALL_EDGES,
+                                               EDGE_N | EDGE_E,
+                                               EDGE_W | EDGE_E,
+                                               EDGE_E | EDGE_S,
+                                               EDGE_W | EDGE_S,
+                                               0};
+  const double *x = ms->x, *y = ms->y, *z = ms->z;
+  size_t nx = ms->nx, ny = ms->ny;
   size_t nx_padded = nx + 4;
   size_t ny_padded = ny + 4;
-  unsigned char *edges = calloc(nx_padded * ny_padded, sizeof(unsigned char));
-  assert(edges);
+  size_t stride = nx + 5;
+  double x_step = x[1] - x[0];
+  double y_step = y[1] - y[0];
+  double contour = ms->contours[contour_index];
+  int k = (int)contour_index;
+  _list_t *polylines_x = ms->results[contour_index].polylines_x;
+  _list_t *polylines_y = ms->results[contour_index].polylines_y;
+  _list_t *line_indices = ms->results[contour_index].line_indices;
+  const int *levels;
+  double x_pos, y_pos;
+  long i, j, i_end;
+  size_t tx, ty;
 
-  gr_setfillintstyle(1);
-  for (contour_index = 0; contour_index < nc; contour_index++)
+  /*
+   * Calculate the binary index of the marching squares algorithm for each cell of the padded z array
+   * and store it in `edges`.
+   */
+  for (ty = 0; ty < ms->tiles_y; ty++)
     {
-      double contour = contours[contour_index];
-      fillarea_start_index = polylines_x->size;
-
-      /*
-       * Calculate the binary index of the marching squares algorithm for each cell of the padded z array\
-       * and store it in `edges`.
-       */
-      for (j = 0; j < ny_padded; j++)
+      for (tx = 0; tx < ms->tiles_x; tx++)
         {
-          for (i = 0; i < nx_padded; i++)
+          if (!tile_has_contour(ms, tx, ty, k))
             {
-              unsigned char bitmask = get_bitmask(z, nx, ny, i, j, contour);
-              assert((edges[j * nx_padded + i] & ALL_EDGES) == 0 && "edge bit not cleared for previous iso value.");
-              edges[j * nx_padded + i] = 0;
-              if (bitmask == 1 || bitmask == 10 || bitmask == 14) /* bottom \ */
-                {
-                  edges[j * nx_padded + i] |= EDGE_W | EDGE_S;
-                }
-              if (bitmask == 2 || bitmask == 5 || bitmask == 13) /* bottom / */
-                {
-                  edges[j * nx_padded + i] |= EDGE_E | EDGE_S;
-                }
-              if (bitmask == 3 || bitmask == 12) /*         - */
-                {
-                  edges[j * nx_padded + i] |= EDGE_W | EDGE_E;
-                }
-              if (bitmask == 6 || bitmask == 9) /*         | */
-                {
-                  edges[j * nx_padded + i] |= EDGE_N | EDGE_S;
-                }
-              if (bitmask == 7 || bitmask == 8 || bitmask == 5) /* top     / */
-                {
-                  edges[j * nx_padded + i] |= EDGE_N | EDGE_W;
-                }
-              if (bitmask == 4 || bitmask == 10 || bitmask == 11) /* top     \ */
-                {
-                  edges[j * nx_padded + i] |= EDGE_N | EDGE_E;
-                }
-              if (bitmask == 5 || bitmask == 10)
+              continue;
+            }
+          for (j = ty * CONTOUR_TILE_SIZE; j < (long)min((ty + 1) * CONTOUR_TILE_SIZE, ny_padded); j++)
+            {
+              levels = ms->levels + j * stride;
+              i_end = min((tx + 1) * CONTOUR_TILE_SIZE, nx_padded);
+              for (i = tx * CONTOUR_TILE_SIZE; i < i_end; i++)
                 {
-                  /*
-                   * Handle saddle points (ambiguous case) depending on average value of
-                   * the four corner points of the cell.
-                   */
-                  double midpoint =
-                      (padded_array_lookup(z, nx, ny, i, j) + padded_array_lookup(z, nx, ny, i + 1, j) +
-                       padded_array_lookup(z, nx, ny, i + 1, j + 1) + padded_array_lookup(z, nx, ny, i, j + 1)) /
-                          4.0 >=
-                      contour;
-                  if ((bitmask == 5 && midpoint) || (bitmask == 10 && !midpoint))
-                    {
-                      edges[j * nx_padded + i] |= SADDLE1;
-                    }
-                  else
+                  unsigned char bitmask = (levels[i] > k) << 3 | (levels[i + 1] > k) << 2 |
+                                          (levels[i + stride + 1] > k) << 1 | (levels[i + stride] > k);
+                  assert((edges[j * nx_padded + i] & ALL_EDGES) == 0 && "edge bit not cleared for previous iso value.");
+                  edges[j * nx_padded + i] = cell_edges[bitmask];
+                  if (bitmask == 5 || bitmask == 10)
                     {
-                      edges[j * nx_padded + i] |= SADDLE2;
+                      /*
+                       * Handle saddle points (ambiguous case) depending on average value of
+                       * the four corner points of the cell.
+                       */
+                      double midpoint =
+                          (padded_array_lookup(z, nx, ny, i, j) + padded_array_lookup(z, nx, ny, i + 1, j) +
+                           padded_array_lookup(z, nx, ny, i + 1, j + 1) + padded_array_lookup(z, nx, ny, i, j + 1)) /
+                              4.0 >=
+                          contour;
+                      if ((bitmask == 5 && midpoint) || (bitmask == 10 && !midpoint))
+                        {
+                          edges[j * nx_padded + i] |= SADDLE1;
+                        }
+                      else
+                        {
+                          edges[j * nx_padded + i] |= SADDLE2;
+                        }
                     }
                 }
             }
         }
+    }
 
-      /* Find and follow connected polylines */
-      for (j = 0; j < ny_padded; j++)
+  /* Find and follow connected polylines, the start points are searched in the same row-major order as before */
+  for (j = 0; j < (long)ny_padded; j++)
+    {
+      ty = j / CONTOUR_TILE_SIZE;
+      for (tx = 0; tx < ms->tiles_x; tx++)
         {
-          for (i = 0; i < nx_padded; i++)
+          if (!tile_has_contour(ms, tx, ty, k))
+            {
+              continue;
+            }
+          i_end = min((tx + 1) * CONTOUR_TILE_SIZE, nx_padded);
+          for (i = tx * CONTOUR_TILE_SIZE; i < i_end; i++)
             {
               if (edges[j * nx_padded + i] & ALL_EDGES) /* Start of a new polyline found */
                 {
@@ -434,40 +531,126 @@ static void marching_squares(const double *x, const double *y, const double *z,
                 }
             }
         }
-      /* Fill all areas for the current contour. Filling must use Even-Odd-Rule. */
-      long n = polylines_x->size - fillarea_start_index;
-      if (n > 2)
-        {
-          gr_setfillcolorind(first_color + (int)floor(color_step * contour_index));
-          gr_fillarea(n, (double *)list_get(polylines_x, fillarea_start_index),
-                      (double *)list_get(polylines_y, fillarea_start_index));
-        }
+    }
+}
+
+static void trace_contours(void *arg, int start, int end)
+{
+  /*
+   * Trace a range of contours. Every thread uses its own `edges` array, cells without edges are only written in
+   * tiles which contain the current contour, so the array does not need to be cleared between contours.
+   */
+  marching_squares_t *ms = (marching_squares_t *)arg;
+  unsigned char *edges = calloc((ms->nx + 4) * (ms->ny + 4), sizeof(unsigned char));
+  int contour_index;
+  assert(edges);
+
+  for (contour_index = start; contour_index < end; contour_index++)
+    {
+      trace_contour(ms, edges, contour_index);
     }
   free(edges);
+}
 
-  long num_lines = line_indices->size;
-  if (!draw_polylines)
+static void marching_squares(const double *x, const double *y, const double *z, size_t nx, size_t ny,
+                             const double *contours, size_t nc, int first_color, int last_color, int draw_polylines)
+{
+  /*
+   * Calculate and fill / draw contours using the marching squares algorithm.
+   *
+   * In this implementation the array z is padded twice. 1 cell outside of z the border value
+   * is repeated and 2 cells outside of z NAN. This assures that contour lines that cross the
+   * border of z are also closed (outside of z).
+   *
+   * All contours are classified in a single pass over z: every point stores the number of contours below or at
+   * its value and every tile of cells the range of these numbers, so a contour only visits the tiles it passes
+   * through. The contours are traced in parallel and drawn afterwards in their original order.
+   */
+  marching_squares_t ms;
+  size_t contour_index, line;
+  double color_step = 0;
+  if (nc > 1)
+    {
+      color_step = 1.0 * (last_color - first_color) / (nc - 1);
+    }
+  else if (nc == 1)
+    {
+      color_step = 0;
+    }
+
+  ms.x = x;
+  ms.y = y;
+  ms.z = z;
+  ms.nx = nx;
+  ms.ny = ny;
+  ms.contours = contours;
+  ms.nc = nc;
+  ms.tiles_x = (nx + 4 + CONTOUR_TILE_SIZE - 1) / CONTOUR_TILE_SIZE;
+  ms.tiles_y = (ny + 4 + CONTOUR_TILE_SIZE - 1) / CONTOUR_TILE_SIZE;
+  ms.levels = malloc((nx + 5) * (ny + 5) * sizeof(int));
+  ms.tile_min = malloc(ms.tiles_x * ms.tiles_y * sizeof(int));
+  ms.tile_max = malloc(ms.tiles_x * ms.tiles_y * sizeof(int));
+  ms.results = malloc(nc * sizeof(contour_level_t));
+  assert(ms.levels && ms.tile_min && ms.tile_max && ms.results);
+
+  /* Create list structures to store the polyline's vertices and the start index of each individual polyline */
+  for (contour_index = 0; contour_index < nc; contour_index++)
     {
-      num_lines = 0;
+      ms.results[contour_index].polylines_x = list_create(1024, sizeof(double));
+      ms.results[contour_index].polylines_y = list_create(1024, sizeof(double));
+      ms.results[contour_index].line_indices = list_create(16, sizeof(size_t));
     }
 
-  size_t polylines_end_indices = polylines_x->size;
-  list_append(line_indices, &(polylines_end_indices));
-  size_t *line_ind = (size_t *)line_indices->list;
+  gr_parallel_for(ny + 5, CONTOUR_MIN_ROWS_PER_THREAD, classify_rows, &ms);
+  gr_parallel_for(ms.tiles_y, 1, classify_tiles, &ms);
+  gr_parallel_for(nc, 1, trace_contours, &ms);
+
+  /* Fill all areas for the current contour. Filling must use Even-Odd-Rule. */
+  gr_setfillintstyle(1);
+  for (contour_index = 0; contour_index < nc; contour_index++)
+    {
+      _list_t *polylines_x = ms.results[contour_index].polylines_x;
+      _list_t *polylines_y = ms.results[contour_index].polylines_y;
+      long n = polylines_x->size;
+      if (n > 2)
+        {
+          gr_setfillcolorind(first_color + (int)floor(color_step * contour_index));
+          gr_fillarea(n, (double *)polylines_x->list, (double *)polylines_y->list);
+        }
+    }
 
   /* Draw contour lines for all `contour` values */
-  for (i = 0; i < num_lines; i++)
+  for (contour_index = 0; draw_polylines && contour_index < nc; contour_index++)
     {
-      long n =
-          line_ind[i + 1] - line_ind[i] - 1; /* Remove (0, 0) points which are required for filling from polyline. */
-      if (n >= 2)
+      _list_t *polylines_x = ms.results[contour_index].polylines_x;
+      _list_t *polylines_y = ms.results[contour_index].polylines_y;
+      _list_t *line_indices = ms.results[contour_index].line_indices;
+      size_t polylines_end_index = polylines_x->size;
+      list_append(line_indices, &polylines_end_index);
+      size_t *line_ind = (size_t *)line_indices->list;
+
+      for (line = 0; line + 1 < line_indices->size; line++)
         {
-          gr_polyline(n, (double *)list_get(polylines_x, line_ind[i]), (double *)list_get(polylines_y, line_ind[i]));
+          /* Remove (0, 0) points which are required for filling from polyline. */
+          long n = line_ind[line + 1] - line_ind[line] - 1;
+          if (n >= 2)
+            {
+              gr_polyline(n, (double *)list_get(polylines_x, line_ind[line]),
+                          (double *)list_get(polylines_y, line_ind[line]));
+            }
         }
     }
-  list_destroy(polylines_x);
-  list_destroy(polylines_y);
-  list_destroy(line_indices);
+
+  for (contour_index = 0; contour_index < nc; contour_index++)
+    {
+      list_destroy(ms.results[contour_index].polylines_x);
+      list_destroy(ms.results[contour_index].polylines_y);
+      list_destroy(ms.results[contour_index].line_indices);
+    }
+  free(ms.results);
+  free(ms.tile_max);
+  free(ms.tile_min);
+  free(ms.levels);
 }
 
 void gr_draw_contourf(int nx, int ny, int nh, double *px, double *py, double *h, double *pz, int first_color,
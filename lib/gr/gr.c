@@ -41,6 +41,9 @@ typedef __int64 int64_t;
 #include "md5.h"
 #include "cm.h"
 #include "boundary.h"
+#include "parallel.h"
+#include "pyramid.h"
+#include "shade.h"
 
 #ifndef R_OK
 #define R_OK 4
@@ -142,54 +145,56 @@ typedef struct
   int bcoli;
 } state_list;
 
-static norm_xform nx = {1, 0, 1, 0};
+static GKS_THREAD_LOCAL norm_xform nx = {1, 0, 1, 0};
 
-static linear_xform lx = {0, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0};
+static GKS_THREAD_LOCAL linear_xform lx = {0, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0};
 
-static world_xform wx = {0, 1, 60, 60, 0, 0, 0, 0, 0, 0, 0};
+static GKS_THREAD_LOCAL world_xform wx = {0, 1, 60, 60, 0, 0, 0, 0, 0, 0, 0};
 
-static transformation_xform tx = {0, 2, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1, 1};
+static GKS_THREAD_LOCAL transformation_xform tx = {0, 2, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1, 1};
 
-static projection_xform gpx = {-1, 1, -1, 1, 1, 0, 45, GR_PROJECTION_DEFAULT};
+static GKS_THREAD_LOCAL projection_xform gpx = {-1, 1, -1, 1, 1, 0, 45, GR_PROJECTION_DEFAULT};
 
-static interaction_xform ix = {-1, 1, -1, 1, -1, 1};
+static GKS_THREAD_LOCAL interaction_xform ix = {-1, 1, -1, 1, -1, 1};
 
-static hlr_t hlr = {1, 0, 1, 0, 1, 0, 1, 0, 1, 1, NULL, NULL, NULL};
+static GKS_THREAD_LOCAL hlr_t hlr = {1, 0, 1, 0, 1, 0, 1, 0, 1, 1, NULL, NULL, NULL};
 
 static int predef_colors[20] = {9, 2, 0, 1, 16, 3, 15, 8, 6, 10, 11, 4, 12, 13, 14, 7, 5, 17, 18, 19};
 
 #define MAX_SAVESTATE 16
 
-static state_list *state = NULL;
+static GKS_THREAD_LOCAL state_list *state = NULL;
 
 #define MAX_CONTEXT 8
 
-static state_list *ctx, *app_context[MAX_CONTEXT] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+static GKS_THREAD_LOCAL state_list *ctx, *app_context[MAX_CONTEXT] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
 
 static void (*previous_handler)(int);
 
-static int autoinit = 1, double_buf = 0, state_saved = 0, def_color = 0;
+static GKS_THREAD_LOCAL int autoinit = 1, double_buf = 0, state_saved = 0, def_color = 0;
 
-static const char *display = NULL;
+static GKS_THREAD_LOCAL const char *display = NULL;
 
-static double vxmin = 0.2, vxmax = 0.9, vymin = 0.2, vymax = 0.9;
+static GKS_THREAD_LOCAL double vxmin = 0.2, vxmax = 0.9, vymin = 0.2, vymax = 0.9;
 
-static double cxl, cxr, cyf, cyb, czb, czt;
+static GKS_THREAD_LOCAL double cxl, cxr, cyf, cyb, czb, czt;
 
-static int arrow_style = 0;
+static GKS_THREAD_LOCAL int arrow_style = 0;
 
-static double arrow_size = 1;
+static GKS_THREAD_LOCAL double arrow_size = 1;
 
-static int flag_printing = 0, flag_graphics = 0;
+static GKS_THREAD_LOCAL int flag_printing = 0, flag_graphics = 0;
+
+static GKS_THREAD_LOCAL int stream_base64 = 0;
 
 #define DEFAULT_FIRST_COLOR 8
 #define DEFAULT_LAST_COLOR 79
 
-static int first_color = DEFAULT_FIRST_COLOR, last_color = DEFAULT_LAST_COLOR;
+static GKS_THREAD_LOCAL int first_color = DEFAULT_FIRST_COLOR, last_color = DEFAULT_LAST_COLOR;
 
 #define MAX_COLOR 1256
 
-static unsigned int rgb[MAX_COLOR], used[MAX_COLOR];
+static GKS_THREAD_LOCAL unsigned int rgb[MAX_COLOR], used[MAX_COLOR];
 
 #define MAX_TICKS 500
 
@@ -258,6 +263,7 @@ static unsigned int rgb[MAX_COLOR], used[MAX_COLOR];
 #define XML_HEADER "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
 #define GR_HEADER "<gr>\n"
 #define GR_TRAILER "</gr>\n"
+#define GR_HEADER_BASE64 "<gr encoding=\"base64\">\n"
 
 typedef enum
 {
@@ -293,13 +299,13 @@ typedef struct
 #define arc(angle) (M_PI * (angle) / 180.0)
 #define deg(rad) ((rad)*180.0 / M_PI)
 
-static unsigned char *opcode = NULL;
+static GKS_THREAD_LOCAL unsigned char *opcode = NULL;
 
-static double *xpath = NULL, *xpoint = NULL, *ypath = NULL, *ypoint = NULL, *zpoint = NULL;
+static GKS_THREAD_LOCAL double *xpath = NULL, *xpoint = NULL, *ypath = NULL, *ypoint = NULL, *zpoint = NULL;
 
-static int npoints = 0, maxpath = 0, npath = 0;
+static GKS_THREAD_LOCAL int npoints = 0, maxpath = 0, npath = 0;
 
-static int *code = NULL;
+static GKS_THREAD_LOCAL int *code = NULL;
 
 /*  0 - 20    21 - 45    46 - 70    71 - 90           rot/  */
 static int rep_table[16][3] = {
@@ -344,7 +350,7 @@ static int vertex_list[18][25] = {
     {3, -10, 80, 0, 100, 10, 80, 2, -1, 98, -1, -100, 2, 1, 98, 1, -100, 0},
     {3, -10, 80, 0, 100, 10, 80, 2, -1, 98, -1, -98, 3, -10, -80, 0, -100, 10, -80, 2, 1, 98, 1, -98, 0}};
 
-static int colormap = 0;
+static GKS_THREAD_LOCAL int colormap = 0;
 
 static int cmap[48][72] = {
     {/* COLORMAP_UNIFORM */
@@ -779,9 +785,39 @@ static int cmap[48][72] = {
      0xfd9367, 0xfd9a6a, 0xfea06e, 0xfea872, 0xfeae77, 0xfeb57b, 0xfebb81, 0xfec286, 0xfec98c, 0xfecf92, 0xfed698,
      0xfddc9e, 0xfde3a4, 0xfdeaaa, 0xfcf0b2, 0xfcf6b8, 0xfcfdbf}};
 
-static double sizex = 0;
+static GKS_THREAD_LOCAL double sizex = 0;
+
+#define IMAGE_PYRAMID_CACHE_TILES 512
+
+#define CELLARRAY_MAX_IMAGE_SIZE 2000
+
+#define CELLARRAY_MIN_ROWS_PER_THREAD 64
+
+static GKS_THREAD_LOCAL image_pyramid_t **image_pyramids = NULL;
+
+static GKS_THREAD_LOCAL int num_image_pyramids = 0;
+
+static GKS_THREAD_LOCAL boundary_finder_t **boundary_finders = NULL;
+
+static GKS_THREAD_LOCAL int num_boundary_finders = 0;
 
-static int regeneration_flags = 0;
+static GKS_THREAD_LOCAL shade_canvas_t **shade_canvases = NULL;
+
+static GKS_THREAD_LOCAL int num_shade_canvases = 0;
+
+typedef struct
+{
+  const double *x, *y;
+  int n;
+  int lines;
+  uint64_t checksum;
+  shade_canvas_t *canvas;
+  shade_pyramid_t *pyramid;
+} shade_cache_t;
+
+static GKS_THREAD_LOCAL shade_cache_t shade_cache = {NULL, NULL, 0, 0, 0, NULL, NULL};
+
+static GKS_THREAD_LOCAL int regeneration_flags = 0;
 
 static char *xcalloc(int count, int size)
 {
@@ -829,6 +865,18 @@ static void reallocate(int npoints)
   code = (int *)xrealloc(code, maxpath * sizeof(int));
 }
 
+static double pixels_per_ndc(void)
+{
+  int wkid = 1, errind, conid, wtype, dcunit, width, height;
+  double mwidth, mheight;
+
+  gks_inq_ws_conntype(wkid, &errind, &conid, &wtype);
+  gks_inq_max_ds_size(wtype, &errind, &dcunit, &mwidth, &mheight, &width, &height);
+  if (sizex > 0) return sizex / mwidth * width;
+
+  return max(width, height);
+}
+
 static double x_lin(double x)
 {
   double result;
@@ -867,6 +915,40 @@ static double y_lin(double y)
   return (result);
 }
 
+/*
+ * Apply the logarithmic and flip options of one axis to a whole coordinate array. The options are tested once per
+ * array, so the inner loops are free of branches (apart from the domain check of the logarithm) and can be vectorized.
+ * The results are the same as those of `x_lin` and `y_lin`.
+ */
+static void lin_array(int n, const double *v, double *result, int log_scale, int flip, double a, double b,
+                      double vmin, double vmax)
+{
+  int i;
+
+  if (log_scale && flip)
+    {
+      for (i = 0; i < n; i++) result[i] = vmax - (v[i] > 0 ? a * log10(v[i]) + b : -FLT_MAX) + vmin;
+    }
+  else if (log_scale)
+    {
+      for (i = 0; i < n; i++) result[i] = v[i] > 0 ? a * log10(v[i]) + b : -FLT_MAX;
+    }
+  else if (flip)
+    {
+      for (i = 0; i < n; i++) result[i] = vmax - v[i] + vmin;
+    }
+  else if (result != v)
+    memcpy(result, v, n * sizeof(double));
+}
+
+static void lin_points(int n, const double *x, const double *y, double *px, double *py)
+{
+  lin_array(n, x, px, OPTION_X_LOG & lx.scale_options, OPTION_FLIP_X & lx.scale_options, lx.a, lx.b, lx.xmin,
+            lx.xmax);
+  lin_array(n, y, py, OPTION_Y_LOG & lx.scale_options, OPTION_FLIP_Y & lx.scale_options, lx.c, lx.d, lx.ymin,
+            lx.ymax);
+}
+
 static double z_lin(double z)
 {
   double result;
@@ -1189,7 +1271,7 @@ static void initialize(int state)
 
 static void resetgks(int sig)
 {
-  static int exiting = 0;
+  static GKS_THREAD_LOCAL int exiting = 0;
 
   if (sig == SIGUSR1)
     {
@@ -1209,7 +1291,7 @@ static void resetgks(int sig)
 
 static void resetgks(void)
 {
-  static int exiting = 0;
+  static GKS_THREAD_LOCAL int exiting = 0;
 
   if (!exiting)
     {
@@ -1222,10 +1304,23 @@ static void resetgks(void)
 #endif
 
 
+static void begin_stream(void)
+{
+  const char *encoding = gks_getenv("GR_STREAM_ENCODING");
+
+  stream_base64 = encoding != NULL && strcmp(encoding, "base64") == 0;
+  gr_writestream(XML_HEADER);
+  gr_writestream(stream_base64 ? GR_HEADER_BASE64 : GR_HEADER);
+  flag_graphics = 1;
+}
+
 static void initgks(void)
 {
   int state, errfil = 0, wkid = 1, errind, conid, wtype, color;
   double r, g, b;
+#ifdef SIGUSR1
+  void (*handler)(int);
+#endif
 
   gks_inq_operating_state(&state);
   if (state == GKS_K_GKCL) gks_open_gks(errfil);
@@ -1247,11 +1342,7 @@ static void initgks(void)
   if (display)
     {
       if (gr_openstream(display) == 0)
-        {
-          gr_writestream(XML_HEADER);
-          gr_writestream(GR_HEADER);
-          flag_graphics = 1;
-        }
+        begin_stream();
       else
         fprintf(stderr, "%s: open failed\n", display);
     }
@@ -1264,7 +1355,9 @@ static void initgks(void)
     }
 
 #ifdef SIGUSR1
-  previous_handler = signal(SIGUSR1, resetgks);
+  handler = signal(SIGUSR1, resetgks);
+  /* GR may be initialized by several threads, keep the handler which was installed before the first one */
+  if (handler != resetgks) previous_handler = handler;
 #else
   atexit(resetgks);
 #endif
@@ -1289,9 +1382,18 @@ void gr_opengks(void)
   initialize(GKS_K_GKCL);
 }
 
+static void release_shade_cache(void)
+{
+  if (shade_cache.canvas) shade_canvas_delete(shade_cache.canvas);
+  if (shade_cache.pyramid) shade_pyramid_delete(shade_cache.pyramid);
+  shade_cache.canvas = NULL;
+  shade_cache.pyramid = NULL;
+}
+
 void gr_closegks(void)
 {
   gks_close_gks();
+  release_shade_cache();
   autoinit = 1;
 }
 
@@ -1448,7 +1550,7 @@ void gr_clearws(void)
       gr_writestream(GR_TRAILER);
       gr_flushstream(1);
       gr_writestream(XML_HEADER);
-      gr_writestream(GR_HEADER);
+      gr_writestream(stream_base64 ? GR_HEADER_BASE64 : GR_HEADER);
     }
 
   def_color = 0;
@@ -1478,14 +1580,13 @@ void gr_updatews(void)
       {
         gr_writestream(GR_TRAILER);
         gr_flushstream(0);
-        gr_writestream(GR_HEADER);
+        gr_writestream(stream_base64 ? GR_HEADER_BASE64 : GR_HEADER);
       }
 }
 
 #define gks(primitive)                             \
   int npoints = n;                                 \
   double *px = x, *py = y;                         \
-  int i;                                           \
                                                    \
   check_autoinit;                                  \
                                                    \
@@ -1495,11 +1596,7 @@ void gr_updatews(void)
                                                    \
       px = xpoint;                                 \
       py = ypoint;                                 \
-      for (i = 0; i < npoints; i++)                \
-        {                                          \
-          px[i] = x_lin(x[i]);                     \
-          py[i] = y_lin(y[i]);                     \
-        }                                          \
+      lin_points(npoints, x, y, px, py);           \
     }                                              \
                                                    \
   primitive(npoints, px, py)
@@ -1529,11 +1626,7 @@ static void fillarea(int n, double *x, double *y)
 
       px = xpoint;
       py = ypoint;
-      for (i = 0; i < npoints; i++)
-        {
-          px[i] = x_lin(x[i]);
-          py[i] = y_lin(y[i]);
-        }
+      lin_points(npoints, x, y, px, py);
     }
 
   gks_inq_fill_int_style(&errind, &style);
@@ -1554,56 +1647,169 @@ static void fillarea(int n, double *x, double *y)
     }
 }
 
-static void print_int_array(char *name, int n, int *data)
+/*
+ * Arrays are written to the graphics stream either as text or, if the
+ * environment variable GR_STREAM_ENCODING is set to "base64", as base64
+ * encoded little-endian binary data (doubles as IEEE 754 binary64, ints as
+ * 32 bit two's complement). The encoding is announced in the <gr> element, so
+ * gr_drawgraphics detects it. Both variants collect the output in a local
+ * buffer and pass it to the stream in large blocks.
+ */
+
+#define STREAM_BYTES (3 * 1024) /* a multiple of 3 and 8, base64 padding only occurs at the end of an array */
+#define STREAM_TEXT 4096
+
+typedef struct
 {
-  int i;
+  int count, nbytes, len;
+  unsigned char bytes[STREAM_BYTES];
+  char text[STREAM_TEXT + 64];
+} array_writer_t;
 
-  gr_writestream(" %s=\"", name);
-  for (i = 0; i < n; i++)
+static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void flush_array(array_writer_t *w)
+{
+  int i, j;
+  unsigned int bits;
+
+  if (w->nbytes > 0)
+    {
+      for (i = 0, j = 0; i < w->nbytes; i += 3)
+        {
+          bits = w->bytes[i] << 16;
+          if (i + 1 < w->nbytes) bits |= w->bytes[i + 1] << 8;
+          if (i + 2 < w->nbytes) bits |= w->bytes[i + 2];
+          w->text[j++] = base64_table[(bits >> 18) & 0x3f];
+          w->text[j++] = base64_table[(bits >> 12) & 0x3f];
+          w->text[j++] = i + 1 < w->nbytes ? base64_table[(bits >> 6) & 0x3f] : '=';
+          w->text[j++] = i + 2 < w->nbytes ? base64_table[bits & 0x3f] : '=';
+        }
+      gr_appendstream(w->text, j);
+      w->nbytes = 0;
+    }
+  else if (w->len > 0)
     {
-      if (i > 0) gr_writestream(" ");
-      gr_writestream("%d", data[i]);
+      gr_appendstream(w->text, w->len);
+      w->len = 0;
     }
+}
+
+static void begin_array(array_writer_t *w, char *name)
+{
+  w->count = w->nbytes = w->len = 0;
+  gr_writestream(" %s=\"", name);
+}
+
+static void end_array(array_writer_t *w)
+{
+  flush_array(w);
   gr_writestream("\"");
 }
 
-static void print_float_array(char *name, int n, double *data)
+static void write_bytes(array_writer_t *w, const unsigned char *bytes, int n)
 {
   int i;
 
-  gr_writestream(" %s=\"", name);
   for (i = 0; i < n; i++)
     {
-      if (i > 0) gr_writestream(" ");
-      gr_writestream("%g", data[i]);
+      w->bytes[w->nbytes++] = bytes[i];
+      if (w->nbytes == STREAM_BYTES) flush_array(w);
     }
-  gr_writestream("\"");
 }
 
-static void print_vertex_array(char *name, int n, vertex_t *vertices)
+static void write_int(array_writer_t *w, int value)
+{
+  unsigned int bits = (unsigned int)value;
+  unsigned char bytes[4];
+
+  if (stream_base64)
+    {
+      bytes[0] = bits & 0xff;
+      bytes[1] = (bits >> 8) & 0xff;
+      bytes[2] = (bits >> 16) & 0xff;
+      bytes[3] = (bits >> 24) & 0xff;
+      write_bytes(w, bytes, 4);
+    }
+  else
+    {
+      w->len += sprintf(w->text + w->len, w->count++ > 0 ? " %d" : "%d", value);
+      if (w->len >= STREAM_TEXT) flush_array(w);
+    }
+}
+
+static void write_double(array_writer_t *w, double value)
 {
+  static const int one = 1;
+  unsigned char bytes[sizeof(double)], tmp;
   int i;
 
-  gr_writestream(" %s=\"", name);
-  for (i = 0; i < n; i++)
+  if (stream_base64)
     {
-      if (i > 0) gr_writestream(" ");
-      gr_writestream("%g %g", vertices[i].x, vertices[i].y);
+      memcpy(bytes, &value, sizeof(double));
+      if (*(const char *)&one == 0)
+        {
+          for (i = 0; i < (int)sizeof(double) / 2; i++)
+            {
+              tmp = bytes[i];
+              bytes[i] = bytes[sizeof(double) - 1 - i];
+              bytes[sizeof(double) - 1 - i] = tmp;
+            }
+        }
+      write_bytes(w, bytes, sizeof(double));
+    }
+  else
+    {
+      w->len += sprintf(w->text + w->len, w->count++ > 0 ? " %g" : "%g", value);
+      if (w->len >= STREAM_TEXT) flush_array(w);
     }
-  gr_writestream("\"");
 }
 
-static void print_byte_array(char *name, int n, unsigned char *data)
+static void print_int_array(char *name, int n, int *data)
 {
+  array_writer_t w;
   int i;
 
-  gr_writestream(" %s=\"", name);
+  begin_array(&w, name);
+  for (i = 0; i < n; i++) write_int(&w, data[i]);
+  end_array(&w);
+}
+
+static void print_float_array(char *name, int n, double *data)
+{
+  array_writer_t w;
+  int i;
+
+  begin_array(&w, name);
+  for (i = 0; i < n; i++) write_double(&w, data[i]);
+  end_array(&w);
+}
+
+static void print_vertex_array(char *name, int n, vertex_t *vertices)
+{
+  array_writer_t w;
+  int i;
+
+  begin_array(&w, name);
   for (i = 0; i < n; i++)
     {
-      if (i > 0) gr_writestream(" ");
-      gr_writestream("%d", data[i]);
+      write_double(&w, vertices[i].x);
+      write_double(&w, vertices[i].y);
     }
-  gr_writestream("\"");
+  end_array(&w);
+}
+
+static void print_byte_array(char *name, int n, unsigned char *data)
+{
+  array_writer_t w;
+  int i;
+
+  begin_array(&w, name);
+  if (stream_base64)
+    write_bytes(&w, data, n);
+  else
+    for (i = 0; i < n; i++) write_int(&w, data[i]);
+  end_array(&w);
 }
 
 static void primitive(char *name, int n, double *x, double *y)
@@ -1886,6 +2092,129 @@ void gr_cellarray(double xmin, double xmax, double ymin, double ymax, int dimx,
     }
 }
 
+typedef struct
+{
+  int *color;
+  int stride;
+  int width;
+  const int *col_offset;
+  const int *row_offset;
+  int *img;
+} cellarray_job_t;
+
+typedef struct
+{
+  int *color;
+  int stride;
+  int width;
+  int height;
+  double xmin, xmax, ymin, ymax;
+  double phimin, phimax, rmin, rmax;
+  int dimphi, dimr, r_reverse, phi_reverse;
+  int *img;
+} polarcellarray_job_t;
+
+/*
+ * Determine the part of the rectangle [xmin, xmax] x [ymin, ymax] that is inside of the clipping window and the
+ * number of device pixels it covers. Returns 0 if nothing is visible.
+ */
+static int cellarray_raster(double *xmin, double *xmax, double *ymin, double *ymax, int *width, int *height)
+{
+  int errind, clsw;
+  double clrt[4], nx[2], ny[2], pixels;
+
+  gks_inq_clip(&errind, &clsw, clrt);
+  if (clsw == GKS_K_CLIP)
+    {
+      *xmin = max(*xmin, lx.xmin);
+      *xmax = min(*xmax, lx.xmax);
+      *ymin = max(*ymin, lx.ymin);
+      *ymax = min(*ymax, lx.ymax);
+    }
+  if (!(*xmin < *xmax && *ymin < *ymax)) return 0;
+
+  nx[0] = *xmin;
+  ny[0] = *ymin;
+  nx[1] = *xmax;
+  ny[1] = *ymax;
+  gr_wctondc(nx, ny);
+  gr_wctondc(nx + 1, ny + 1);
+  pixels = pixels_per_ndc();
+  *width = (int)min(max(ceil(fabs(nx[1] - nx[0]) * pixels), 1), CELLARRAY_MAX_IMAGE_SIZE);
+  *height = (int)min(max(ceil(fabs(ny[1] - ny[0]) * pixels), 1), CELLARRAY_MAX_IMAGE_SIZE);
+
+  return 1;
+}
+
+static void cellarray_rows(void *arg, int start, int end)
+{
+  cellarray_job_t *job = (cellarray_job_t *)arg;
+  const int *color;
+  int *img, i, j, color_ind;
+
+  for (j = start; j < end; j++)
+    {
+      color = job->color + job->row_offset[j];
+      img = job->img + j * job->width;
+      for (i = 0; i < job->width; i++)
+        {
+          color_ind = color[job->col_offset[i]];
+          /* invalid color indices in input data result in transparent pixel */
+          img[i] = (color_ind >= 0 && color_ind < MAX_COLOR) ? (255 << 24) + rgb[color_ind] : 0;
+        }
+    }
+}
+
+static void polarcellarray_rows(void *arg, int start, int end)
+{
+  polarcellarray_job_t *job = (polarcellarray_job_t *)arg;
+  int *img, x, y, r_ind, phi_ind, color_ind;
+  double px, py, r, phi;
+
+  for (y = start; y < end; y++)
+    {
+      img = job->img + y * job->width;
+      py = (job->ymin + (y + 0.5) * (job->ymax - job->ymin) / job->height) / job->rmax;
+      for (x = 0; x < job->width; x++)
+        {
+          px = (job->xmin + (x + 0.5) * (job->xmax - job->xmin) / job->width) / job->rmax;
+          r = sqrt(px * px + py * py);
+          if (r * job->rmax < job->rmin || r >= 1)
+            {
+              img[x] = 0;
+              continue;
+            }
+          phi = atan2(py, px);
+          if (phi < min(job->phimin, job->phimax))
+            {
+              phi += 2 * M_PI;
+            }
+
+          /* map phi from [phimin, phimax] to [0, 1] */
+          phi = (phi - job->phimin) / (job->phimax - job->phimin);
+          if (phi < 0 || phi > 1)
+            {
+              img[x] = 0;
+              continue;
+            }
+          r = (r * job->rmax - job->rmin) / (job->rmax - job->rmin);
+          r_ind = min((int)(r * job->dimr), job->dimr - 1);
+          phi_ind = (int)(phi * job->dimphi) % job->dimphi;
+          if (job->r_reverse)
+            {
+              r_ind = job->dimr - r_ind - 1;
+            }
+          if (job->phi_reverse)
+            {
+              phi_ind = job->dimphi - phi_ind - 1;
+            }
+          color_ind = job->color[r_ind * job->stride + phi_ind];
+          /* invalid color indices in input data result in transparent pixel */
+          img[x] = (color_ind >= 0 && color_ind < MAX_COLOR) ? (255 << 24) + rgb[color_ind] : 0;
+        }
+    }
+}
+
 /*!
  * Display a two dimensional color index array with nonuniform cell sizes.
  *
@@ -1914,9 +2243,10 @@ void gr_cellarray(double xmin, double xmax, double ymin, double ymax, int dimx,
 void gr_nonuniformcellarray(double *x, double *y, int dimx, int dimy, int scol, int srow, int ncol, int nrow,
                             int *color)
 {
-  int img_data_x, img_data_y, color_x_ind, color_y_ind, color_ind, size = 2000;
-  int *img_data;
-  double x_pos, y_pos, x_size, y_size;
+  int width, height, i, color_x_ind, color_y_ind;
+  int *img_data, *col_offset, *row_offset;
+  double xmin, xmax, ymin, ymax, pos;
+  cellarray_job_t job;
 
   if (scol < 1 || srow < 1 || scol + ncol - 1 > dimx || srow + nrow - 1 > dimy)
     {
@@ -1949,41 +2279,50 @@ void gr_nonuniformcellarray(double *x, double *y, int dimx, int dimy, int scol,
         }
     }
 
-  x_size = x[ncol] - x[scol];
-  y_size = y[nrow] - y[srow];
-  img_data = (int *)xmalloc(size * size * sizeof(int));
+  /* only the visible part is rasterized, with one pixel per device pixel */
+  xmin = x[scol];
+  xmax = x[ncol];
+  ymin = y[srow];
+  ymax = y[nrow];
+  if (!cellarray_raster(&xmin, &xmax, &ymin, &ymax, &width, &height)) return;
 
-  color_y_ind = srow;
-  for (img_data_y = 0; img_data_y < size; img_data_y++)
+  /* the cells are separable, so the cell of each pixel column and row is looked up once with a monotone cursor */
+  col_offset = (int *)xmalloc(width * sizeof(int));
+  row_offset = (int *)xmalloc(height * sizeof(int));
+  color_x_ind = scol;
+  for (i = 0; i < width; i++)
     {
-      y_pos = y[srow] + img_data_y * y_size / size;
-      while (color_y_ind < nrow && y[color_y_ind + 1] <= y_pos)
+      pos = xmin + (i + 0.5) * (xmax - xmin) / width;
+      while (color_x_ind < ncol - 1 && x[color_x_ind + 1] <= pos)
         {
-          color_y_ind++;
+          color_x_ind++;
         }
-      color_x_ind = scol;
-      for (img_data_x = 0; img_data_x < size; img_data_x++)
+      col_offset[i] = color_x_ind;
+    }
+  color_y_ind = srow;
+  for (i = 0; i < height; i++)
+    {
+      pos = ymin + (i + 0.5) * (ymax - ymin) / height;
+      while (color_y_ind < nrow - 1 && y[color_y_ind + 1] <= pos)
         {
-          x_pos = x[scol] + img_data_x * x_size / size;
-          while (color_x_ind < ncol && x[color_x_ind + 1] <= x_pos)
-            {
-              color_x_ind++;
-            }
-          color_ind = color[color_y_ind * dimx + color_x_ind];
-          if (color_ind >= 0 && color_ind < MAX_COLOR)
-            {
-              img_data[img_data_y * size + img_data_x] = (255 << 24) + rgb[color_ind];
-            }
-          else
-            {
-              /* invalid color indices in input data result in transparent pixel */
-              img_data[img_data_y * size + img_data_x] = 0;
-            }
+          color_y_ind++;
         }
+      row_offset[i] = color_y_ind * dimx;
     }
+  img_data = (int *)xmalloc(width * height * sizeof(int));
+
+  job.color = color;
+  job.stride = dimx;
+  job.width = width;
+  job.col_offset = col_offset;
+  job.row_offset = row_offset;
+  job.img = img_data;
+  gr_parallel_for(height, CELLARRAY_MIN_ROWS_PER_THREAD, cellarray_rows, &job);
 
-  gr_drawimage(x[scol], x[ncol], y[nrow], y[srow], size, size, img_data, 0);
+  gr_drawimage(xmin, xmax, ymax, ymin, width, height, img_data, 0);
   free(img_data);
+  free(row_offset);
+  free(col_offset);
 }
 
 /*!
@@ -2051,9 +2390,10 @@ void gr_nonuniformcellarray(double *x, double *y, int dimx, int dimy, int scol,
 void gr_polarcellarray(double x_org, double y_org, double phimin, double phimax, double rmin, double rmax, int dimphi,
                        int dimr, int scol, int srow, int ncol, int nrow, int *color)
 {
-  int x, y, color_ind, r_ind, phi_ind, phi_reverse, phi_wrapped_reverse, r_reverse, size = 2000;
+  int width, height, phi_reverse, phi_wrapped_reverse, r_reverse;
   int *img_data;
-  double r, phi, tmp, center = size / 2.;
+  double xmin, xmax, ymin, ymax, tmp;
+  polarcellarray_job_t job;
 
   phimin = arc(phimin);
   phimax = arc(phimax);
@@ -2115,54 +2455,34 @@ void gr_polarcellarray(double x_org, double y_org, double phimin, double phimax,
       phimin += 2 * M_PI;
     }
 
-  img_data = (int *)xmalloc(size * size * sizeof(int));
-
-  for (y = 0; y < size; y++)
-    {
-      for (x = 0; x < size; x++)
-        {
-          double px = (x - center) / center;
-          double py = (y - center) / center;
-          r = sqrt(px * px + py * py);
-          phi = atan2(py, px);
-          if (phi < min(phimin, phimax))
-            {
-              phi += 2 * M_PI;
-            }
-
-          /* map phi from [phimin, phimax] to [0, 1] */
-          phi = (phi - phimin) / (phimax - phimin);
-
-          if (r * rmax < rmin || r >= 1 || phi < 0 || phi > 1)
-            {
-              img_data[y * size + x] = 0;
-              continue;
-            }
-          r = (r * rmax - rmin) / (rmax - rmin);
-          r_ind = (int)(r * dimr);
-          phi_ind = (int)(phi * dimphi) % dimphi;
-          if (r_reverse)
-            {
-              r_ind = dimr - r_ind - 1;
-            }
-          if (phi_wrapped_reverse)
-            {
-              phi_ind = dimphi - phi_ind - 1;
-            }
-          color_ind = color[(r_ind + srow - 1) * ncol + phi_ind + scol - 1];
-          if (color_ind >= 0 && color_ind < MAX_COLOR)
-            {
-              img_data[y * size + x] = (255 << 24) + rgb[color_ind];
-            }
-          else
-            {
-              /* invalid color indices in input data result in transparent pixel */
-              img_data[y * size + x] = 0;
-            }
-        }
-    }
-
-  gr_drawimage(x_org - rmax, x_org + rmax, y_org + rmax, y_org - rmax, size, size, img_data, 0);
+  /* only the visible part of the disk is rasterized, with one pixel per device pixel */
+  xmin = x_org - rmax;
+  xmax = x_org + rmax;
+  ymin = y_org - rmax;
+  ymax = y_org + rmax;
+  if (!cellarray_raster(&xmin, &xmax, &ymin, &ymax, &width, &height)) return;
+  img_data = (int *)xmalloc(width * height * sizeof(int));
+
+  job.color = color + (srow - 1) * ncol + scol - 1;
+  job.stride = ncol;
+  job.width = width;
+  job.height = height;
+  job.xmin = xmin - x_org;
+  job.xmax = xmax - x_org;
+  job.ymin = ymin - y_org;
+  job.ymax = ymax - y_org;
+  job.phimin = phimin;
+  job.phimax = phimax;
+  job.rmin = rmin;
+  job.rmax = rmax;
+  job.dimphi = dimphi;
+  job.dimr = dimr;
+  job.r_reverse = r_reverse;
+  job.phi_reverse = phi_wrapped_reverse;
+  job.img = img_data;
+  gr_parallel_for(height, CELLARRAY_MIN_ROWS_PER_THREAD, polarcellarray_rows, &job);
+
+  gr_drawimage(xmin, xmax, ymax, ymin, width, height, img_data, 0);
   free(img_data);
 }
 
@@ -2170,7 +2490,6 @@ void gr_gdp(int n, double *x, double *y, int primid, int ldr, int *datrec)
 {
   int npoints = n;
   double *px = x, *py = y;
-  int i;
 
   check_autoinit;
 
@@ -2180,11 +2499,7 @@ void gr_gdp(int n, double *x, double *y, int primid, int ldr, int *datrec)
 
       px = xpoint;
       py = ypoint;
-      for (i = 0; i < npoints; i++)
-        {
-          px[i] = x_lin(x[i]);
-          py[i] = y_lin(y[i]);
-        }
+      lin_points(npoints, x, y, px, py);
     }
 
   gks_gdp(npoints, px, py, primid, ldr, datrec);
@@ -7236,7 +7551,7 @@ void gr_surface(int nx, int ny, double *px, double *py, double *pz, int option)
     }
 }
 
-static const double *xp, *yp;
+static GKS_THREAD_LOCAL const double *xp, *yp;
 
 static int compar(const void *a, const void *b)
 {
@@ -9244,43 +9559,12 @@ void gr_drawarrow(double x1, double y1, double x2, double y2)
   if (flag_graphics) gr_writestream("<drawarrow x1=\"%g\" y1=\"%g\" x2=\"%g\" y2=\"%g\"/>\n", x1, y1, x2, y2);
 }
 
-/*!
- * Draw an image into a given rectangular area.
- *
- * \param[in] xmin X coordinate of the lower left point of the rectangle
- * \param[in] ymin Y coordinate of the lower left point of the rectangle
- * \param[in] xmax X coordinate of the upper right point of the rectangle
- * \param[in] ymax Y coordinate of the upper right point of the rectangle
- * \param[in] width X dimension of the color index array
- * \param[in] height Y dimension of the color index array
- * \param[in] data color array
- * \param[in] model color model
- *
- * The points (xmin, ymin) and (xmax, ymax) are world coordinates defining
- * diagonally opposite corner points of a rectangle. This rectangle is divided
- * into width by height cells. The two-dimensional array data specifies colors
- * for each cell.
- *
- * \verbatim embed:rst:leading-asterisk
- *
- * The available color models are:
- *
- * +-----------------------+---+-----------+
- * |MODEL_RGB              |  0|   AABBGGRR|
- * +-----------------------+---+-----------+
- * |MODEL_HSV              |  1|   AAVVSSHH|
- * +-----------------------+---+-----------+
- *
- * \endverbatim
- */
-void gr_drawimage(double xmin, double xmax, double ymin, double ymax, int width, int height, int *data, int model)
+static void drawimage(double xmin, double xmax, double ymin, double ymax, int width, int height, int *data, int model)
 {
   int *img = data, *imgT;
   int n, i, j, w, h;
   double hue, saturation, value, red, green, blue, x, y;
 
-  check_autoinit;
-
   if (model == MODEL_HSV)
     {
       n = width * height;
@@ -9355,17 +9639,238 @@ void gr_drawimage(double xmin, double xmax, double ymin, double ymax, int width,
   else
     gks_draw_image(xmin, ymax, xmax, ymin, width, height, img);
 
-  if (flag_graphics)
-    {
-      n = width * height;
-      gr_writestream("<drawimage xmin=\"%g\" xmax=\"%g\" ymin=\"%g\" ymax=\"%g\" "
-                     "width=\"%d\" height=\"%d\"",
-                     xmin, xmax, ymin, ymax, width, height);
-      print_int_array("data", n, data);
-      gr_writestream("model=\"%d\"/>\n", model);
+  if (model == MODEL_HSV) free(img);
+}
+
+/*!
+ * Draw an image into a given rectangular area.
+ *
+ * \param[in] xmin X coordinate of the lower left point of the rectangle
+ * \param[in] ymin Y coordinate of the lower left point of the rectangle
+ * \param[in] xmax X coordinate of the upper right point of the rectangle
+ * \param[in] ymax Y coordinate of the upper right point of the rectangle
+ * \param[in] width X dimension of the color index array
+ * \param[in] height Y dimension of the color index array
+ * \param[in] data color array
+ * \param[in] model color model
+ *
+ * The points (xmin, ymin) and (xmax, ymax) are world coordinates defining
+ * diagonally opposite corner points of a rectangle. This rectangle is divided
+ * into width by height cells. The two-dimensional array data specifies colors
+ * for each cell.
+ *
+ * \verbatim embed:rst:leading-asterisk
+ *
+ * The available color models are:
+ *
+ * +-----------------------+---+-----------+
+ * |MODEL_RGB              |  0|   AABBGGRR|
+ * +-----------------------+---+-----------+
+ * |MODEL_HSV              |  1|   AAVVSSHH|
+ * +-----------------------+---+-----------+
+ *
+ * \endverbatim
+ */
+void gr_drawimage(double xmin, double xmax, double ymin, double ymax, int width, int height, int *data, int model)
+{
+  check_autoinit;
+
+  drawimage(xmin, xmax, ymin, ymax, width, height, data, model);
+
+  if (flag_graphics)
+    {
+      gr_writestream("<drawimage xmin=\"%g\" xmax=\"%g\" ymin=\"%g\" ymax=\"%g\" "
+                     "width=\"%d\" height=\"%d\"",
+                     xmin, xmax, ymin, ymax, width, height);
+      print_int_array("data", width * height, data);
+      gr_writestream("model=\"%d\"/>\n", model);
     }
+}
 
-  if (model == MODEL_HSV) free(img);
+/*!
+ * Register an image for drawing with `gr_drawimagepyramid`.
+ *
+ * \param[in] width X dimension of the color array
+ * \param[in] height Y dimension of the color array
+ * \param[in] data color array
+ * \param[in] model color model (see `gr_drawimage`)
+ * \returns The id of the image pyramid
+ *
+ * The image is split into tiles of 256 by 256 pixels and reduced versions of
+ * it (each halving the resolution of the previous one) are computed on demand
+ * while drawing. The color array is not copied, it must stay valid and
+ * unchanged until the pyramid is destroyed with `gr_destroyimagepyramid`.
+ * Computed tiles are cached, the cache holds at most 512 tiles per pyramid.
+ */
+int gr_createimagepyramid(int width, int height, int *data, int model)
+{
+  int id;
+
+  if (width < 1 || height < 1 || data == NULL)
+    {
+      fprintf(stderr, "invalid image dimensions\n");
+      return 0;
+    }
+
+  for (id = 0; id < num_image_pyramids; id++)
+    if (image_pyramids[id] == NULL) break;
+
+  if (id == num_image_pyramids)
+    {
+      num_image_pyramids++;
+      image_pyramids = (image_pyramid_t **)xrealloc(image_pyramids, num_image_pyramids * sizeof(image_pyramid_t *));
+    }
+  image_pyramids[id] = pyramid_create(width, height, data, model == MODEL_HSV, IMAGE_PYRAMID_CACHE_TILES);
+
+  return id + 1;
+}
+
+static double ndc_x(double x, double y)
+{
+  gr_wctondc(&x, &y);
+  return x;
+}
+
+static double ndc_y(double x, double y)
+{
+  gr_wctondc(&x, &y);
+  return y;
+}
+
+/*!
+ * Draw a registered image into a given rectangular area.
+ *
+ * \param[in] pyramid the id of the image pyramid
+ * \param[in] xmin X coordinate of the lower left point of the rectangle
+ * \param[in] xmax X coordinate of the upper right point of the rectangle
+ * \param[in] ymin Y coordinate of the lower left point of the rectangle
+ * \param[in] ymax Y coordinate of the upper right point of the rectangle
+ *
+ * The image is placed like in `gr_drawimage`, but only the part inside of the
+ * current window is drawn, using the coarsest reduction of the image that
+ * still has at least the resolution of the output device. Thus the amount of
+ * data passed to the workstations depends on the size of the output and not
+ * on the size of the image.
+ */
+void gr_drawimagepyramid(int pyramid, double xmin, double xmax, double ymin, double ymax)
+{
+  image_pyramid_t *p;
+  int errind, clsw, width, height, level, levels, lw, lh, x0, x1, y0, y1, flip_x, flip_y, *img;
+  double clrt[4], wxmin, wxmax, wymin, wymax, dx, dy, tmp, size_x, size_y, scale;
+  double x_first, x_last, y_first, y_last, ixmin, ixmax, iymin, iymax;
+
+  check_autoinit;
+
+  if (pyramid < 1 || pyramid > num_image_pyramids || image_pyramids[pyramid - 1] == NULL)
+    {
+      fprintf(stderr, "invalid image pyramid id\n");
+      return;
+    }
+  p = image_pyramids[pyramid - 1];
+  pyramid_level_size(p, 0, &width, &height);
+
+  /* like in `gr_drawimage`, reversed coordinates mirror the image */
+  flip_x = xmin > xmax;
+  flip_y = ymin > ymax;
+  if (flip_x)
+    {
+      tmp = xmin;
+      xmin = xmax;
+      xmax = tmp;
+    }
+  if (flip_y)
+    {
+      tmp = ymin;
+      ymin = ymax;
+      ymax = tmp;
+    }
+
+  wxmin = xmin;
+  wxmax = xmax;
+  wymin = ymin;
+  wymax = ymax;
+  gks_inq_clip(&errind, &clsw, clrt);
+  if (clsw == GKS_K_CLIP)
+    {
+      wxmin = max(xmin, lx.xmin);
+      wxmax = min(xmax, lx.xmax);
+      wymin = max(ymin, lx.ymin);
+      wymax = min(ymax, lx.ymax);
+    }
+  if (wxmin >= wxmax || wymin >= wymax) return;
+
+  /* visible columns and rows of the image, counted from its first column and its first (top) row */
+  dx = (xmax - xmin) / width;
+  dy = (ymax - ymin) / height;
+  x0 = max((int)floor((flip_x ? xmax - wxmax : wxmin - xmin) / dx), 0);
+  x1 = min((int)ceil((flip_x ? xmax - wxmin : wxmax - xmin) / dx), width);
+  y0 = max((int)floor((flip_y ? wymin - ymin : ymax - wymax) / dy), 0);
+  y1 = min((int)ceil((flip_y ? wymax - ymin : ymax - wymin) / dy), height);
+  if (x0 >= x1 || y0 >= y1) return;
+
+#define column_x(c) (flip_x ? xmax - (c)*dx : xmin + (c)*dx)
+#define row_y(r) (flip_y ? ymin + (r)*dy : ymax - (r)*dy)
+
+  /* Measure the pixels in NDC, so that log and flipped axes are taken into account. The outermost visible pixels
+   * are compared, as log scales stretch one end of the image the most. */
+  x_first = fabs(ndc_x(column_x(x0 + 1), wymin) - ndc_x(column_x(x0), wymin));
+  x_last = fabs(ndc_x(column_x(x1), wymin) - ndc_x(column_x(x1 - 1), wymin));
+  y_first = fabs(ndc_y(wxmin, row_y(y0 + 1)) - ndc_y(wxmin, row_y(y0)));
+  y_last = fabs(ndc_y(wxmin, row_y(y1)) - ndc_y(wxmin, row_y(y1 - 1)));
+  size_x = max(x_first, x_last) * pixels_per_ndc();
+  size_y = max(y_first, y_last) * pixels_per_ndc();
+  scale = 1 / max(size_x, size_y);
+
+  levels = pyramid_levels(p);
+  level = 0;
+  while (level + 1 < levels && (double)(1 << (level + 1)) <= scale) level++;
+
+  pyramid_level_size(p, level, &lw, &lh);
+  x1 = min((x1 + (1 << level) - 1) >> level, lw);
+  y1 = min((y1 + (1 << level) - 1) >> level, lh);
+  x0 >>= level;
+  y0 >>= level;
+
+  img = (int *)xmalloc((x1 - x0) * (y1 - y0) * sizeof(int));
+  pyramid_read(p, level, x0, y0, x1 - x0, y1 - y0, img);
+
+  /* the first column and row of the read part keep their side, so mirrored images stay mirrored */
+  ixmin = column_x(x0 << level);
+  ixmax = column_x(min(x1 << level, width));
+  iymin = row_y(min(y1 << level, height));
+  iymax = row_y(y0 << level);
+
+#undef column_x
+#undef row_y
+
+  drawimage(ixmin, ixmax, iymin, iymax, x1 - x0, y1 - y0, img, MODEL_RGB);
+
+  if (flag_graphics)
+    {
+      gr_writestream("<drawimage xmin=\"%g\" xmax=\"%g\" ymin=\"%g\" ymax=\"%g\" "
+                     "width=\"%d\" height=\"%d\"",
+                     ixmin, ixmax, iymin, iymax, x1 - x0, y1 - y0);
+      print_int_array("data", (x1 - x0) * (y1 - y0), img);
+      gr_writestream("model=\"%d\"/>\n", MODEL_RGB);
+    }
+
+  free(img);
+}
+
+/*!
+ * Destroy an image pyramid and free its cached tiles.
+ *
+ * \param[in] pyramid the id of the image pyramid
+ */
+void gr_destroyimagepyramid(int pyramid)
+{
+  if (pyramid < 1 || pyramid > num_image_pyramids || image_pyramids[pyramid - 1] == NULL)
+    {
+      fprintf(stderr, "invalid image pyramid id\n");
+      return;
+    }
+  pyramid_delete(image_pyramids[pyramid - 1]);
+  image_pyramids[pyramid - 1] = NULL;
 }
 
 /*!
@@ -9418,18 +9923,17 @@ void gr_setcoordxform(double mat[3][2])
  *
  * gr_begingraphics allows to write all graphics output into a XML-formatted
  * file until the gr_endgraphics functions is called. The resulting file may
- * later be imported with the gr_importgraphics function.
+ * later be imported with the gr_importgraphics function. If the environment
+ * variable GR_STREAM_ENCODING is set to "base64", arrays are stored as base64
+ * encoded binary data, which is faster to write and read and keeps all values
+ * exactly.
  */
 void gr_begingraphics(char *path)
 {
   if (!flag_graphics)
     {
       if (gr_openstream(path) == 0)
-        {
-          gr_writestream(XML_HEADER);
-          gr_writestream(GR_HEADER);
-          flag_graphics = 1;
-        }
+        begin_stream();
       else
         fprintf(stderr, "%s: open failed\n", path);
     }
@@ -10251,6 +10755,53 @@ void gr_reducepoints(int n, const double *x, const double *y, int points, double
     }
 }
 
+static void shade_cached(int n, double *x, double *y, int lines, int xform, double *roi, int w, int h, int *bins)
+{
+  /*
+   * Aggregate like `gr_shade`, but keep the aggregation of the last data set. The data is identified by its
+   * pointers, its length and a checksum of its content. Drawing the same data again with another transfer function
+   * or colormap only shades the cached aggregation. Points drawn again with another region or resolution are
+   * aggregated from a binning pyramid, which is built on the first such call.
+   */
+  double cached_roi[4];
+  int cached_w, cached_h;
+  uint64_t checksum = shade_checksum(n, x, y);
+  shade_canvas_t *canvas;
+
+  if (shade_cache.canvas == NULL || shade_cache.x != x || shade_cache.y != y || shade_cache.n != n ||
+      shade_cache.lines != lines || shade_cache.checksum != checksum)
+    {
+      release_shade_cache();
+      shade_cache.x = x;
+      shade_cache.y = y;
+      shade_cache.n = n;
+      shade_cache.lines = lines;
+      shade_cache.checksum = checksum;
+    }
+  else
+    {
+      shade_canvas_size(shade_cache.canvas, cached_roi, &cached_w, &cached_h);
+      if (memcmp(cached_roi, roi, sizeof(cached_roi)) == 0 && cached_w == w && cached_h == h)
+        {
+          shade_canvas_render(shade_cache.canvas, xform, bins);
+          return;
+        }
+    }
+
+  canvas = shade_canvas_create(roi, w, h, GR_SHADE_COUNT);
+  if (lines || shade_cache.canvas == NULL)
+    shade_canvas_add(canvas, n, x, y, NULL, lines);
+  else
+    {
+      if (shade_cache.pyramid == NULL) shade_cache.pyramid = shade_pyramid_create(n, x, y);
+      shade_pyramid_aggregate(shade_cache.pyramid, canvas);
+    }
+  if (shade_cache.canvas) shade_canvas_delete(shade_cache.canvas);
+  shade_cache.canvas = canvas;
+
+  shade_canvas_render(canvas, xform, bins);
+}
+
 /*!
  * Display a point set as a aggregated and rasterized image.
  *
@@ -10263,6 +10814,10 @@ void gr_reducepoints(int n, const double *x, const double *y, int points, double
  *
  * The values for `x` and `y` are in world coordinates.
  *
+ * The aggregation of the last point set is kept, so drawing the same data with another transformation only shades
+ * it again. After a change of the window or resolution the points are binned from a multi-resolution index of the
+ * data, which makes zooming and panning cheap. The data is recognized by its arrays and their content.
+ *
  * \verbatim embed:rst:leading-asterisk
  *
  * The available transformation types are:
@@ -10314,7 +10869,7 @@ void gr_shadepoints(int n, double *x, double *y, int xform, int w, int h)
   roi[3] = lx.ymax;
   bins = (int *)xcalloc(w * h, sizeof(int));
 
-  gr_shade(n, x, y, 0, xform, roi, w, h, bins);
+  shade_cached(n, x, y, 0, xform, roi, w, h, bins);
 
   gks_cellarray(lx.xmin, lx.ymax, lx.xmax, lx.ymin, w, h, 1, 1, w, h, bins);
 
@@ -10342,6 +10897,9 @@ void gr_shadepoints(int n, double *x, double *y, int xform, int w, int h)
  * The values for `x` and `y` are in world coordinates.
  * NaN values can be used to separate the point set into line segments.
  *
+ * The aggregation of the last line set is kept, so drawing the same data with another transformation only shades it
+ * again.
+ *
  * \verbatim embed:rst:leading-asterisk
  *
  * The available transformation types are:
@@ -10393,7 +10951,7 @@ void gr_shadelines(int n, double *x, double *y, int xform, int w, int h)
   roi[3] = lx.ymax;
   bins = (int *)xcalloc(w * h, sizeof(int));
 
-  gr_shade(n, x, y, 1, xform, roi, w, h, bins);
+  shade_cached(n, x, y, 1, xform, roi, w, h, bins);
 
   gks_cellarray(lx.xmin, lx.ymax, lx.xmax, lx.ymin, w, h, 1, 1, w, h, bins);
 
@@ -10408,6 +10966,201 @@ void gr_shadelines(int n, double *x, double *y, int xform, int w, int h)
     }
 }
 
+/*!
+ * Create a canvas for aggregating point and line sets in batches.
+ *
+ * \param[in] xmin The left edge of the aggregated region in world coordinates
+ * \param[in] xmax The right edge of the aggregated region in world coordinates
+ * \param[in] ymin The bottom edge of the aggregated region in world coordinates
+ * \param[in] ymax The top edge of the aggregated region in world coordinates
+ * \param[in] w The width of the grid used for rasterization
+ * \param[in] h The height of the grid used for rasterization
+ * \param[in] reduction The reduction applied to the points of each grid cell
+ * \returns The id of the canvas
+ *
+ * Points and lines are added with `gr_shadecanvaspoints` and `gr_shadecanvaslines`. Only the grid is kept, so
+ * data sets too large for memory can be streamed into the canvas. The canvas can be drawn with
+ * `gr_drawshadecanvas` at any time.
+ *
+ * \verbatim embed:rst:leading-asterisk
+ *
+ * The available reductions are:
+ *
+ * +---------------+---+-----------------------------------+
+ * |GR_SHADE_COUNT |  0|number of points or line pixels    |
+ * +---------------+---+-----------------------------------+
+ * |GR_SHADE_SUM   |  1|sum of the weights                 |
+ * +---------------+---+-----------------------------------+
+ * |GR_SHADE_MEAN  |  2|mean of the weights                |
+ * +---------------+---+-----------------------------------+
+ * |GR_SHADE_MAX   |  3|maximum of the weights             |
+ * +---------------+---+-----------------------------------+
+ *
+ * \endverbatim
+ */
+int gr_createshadecanvas(double xmin, double xmax, double ymin, double ymax, int w, int h, int reduction)
+{
+  double roi[4];
+  int id;
+
+  if (xmin >= xmax || ymin >= ymax)
+    {
+      fprintf(stderr, "invalid region\n");
+      return 0;
+    }
+
+  if (w < 1 || h < 1)
+    {
+      fprintf(stderr, "invalid dimensions\n");
+      return 0;
+    }
+
+  if (reduction < GR_SHADE_COUNT || reduction > GR_SHADE_MAX)
+    {
+      fprintf(stderr, "invalid reduction\n");
+      return 0;
+    }
+
+  for (id = 0; id < num_shade_canvases; id++)
+    if (shade_canvases[id] == NULL) break;
+
+  if (id == num_shade_canvases)
+    {
+      num_shade_canvases++;
+      shade_canvases = (shade_canvas_t **)xrealloc(shade_canvases, num_shade_canvases * sizeof(shade_canvas_t *));
+    }
+  roi[0] = xmin;
+  roi[1] = xmax;
+  roi[2] = ymin;
+  roi[3] = ymax;
+  shade_canvases[id] = shade_canvas_create(roi, w, h, reduction);
+
+  return id + 1;
+}
+
+static shade_canvas_t *get_shade_canvas(int canvas)
+{
+  if (canvas < 1 || canvas > num_shade_canvases || shade_canvases[canvas - 1] == NULL)
+    {
+      fprintf(stderr, "invalid shade canvas id\n");
+      return NULL;
+    }
+  return shade_canvases[canvas - 1];
+}
+
+/*!
+ * Aggregate a batch of points into a canvas.
+ *
+ * \param[in] canvas The id of the canvas
+ * \param[in] n The number of points
+ * \param[in] x A pointer to the X coordinates
+ * \param[in] y A pointer to the Y coordinates
+ * \param[in] weights A pointer to the weights of the points or NULL
+ *
+ * Points outside of the region of the canvas are ignored. If `weights` is NULL, every point has the weight 1.
+ * Large batches are aggregated by multiple threads.
+ */
+void gr_shadecanvaspoints(int canvas, int n, double *x, double *y, double *weights)
+{
+  shade_canvas_t *c = get_shade_canvas(canvas);
+
+  if (c != NULL) shade_canvas_add(c, n, x, y, weights, 0);
+}
+
+/*!
+ * Aggregate a batch of lines into a canvas.
+ *
+ * \param[in] canvas The id of the canvas
+ * \param[in] n The number of points
+ * \param[in] x A pointer to the X coordinates
+ * \param[in] y A pointer to the Y coordinates
+ * \param[in] weights A pointer to the weights of the points or NULL
+ *
+ * The points are connected by line segments, NaN values can be used to separate the point set into lines.
+ * Segments with an end point outside of the region of the canvas are ignored. Each grid cell a segment passes
+ * is counted once with the weight of the segment's first point, or 1 if `weights` is NULL.
+ */
+void gr_shadecanvaslines(int canvas, int n, double *x, double *y, double *weights)
+{
+  shade_canvas_t *c = get_shade_canvas(canvas);
+
+  if (c != NULL) shade_canvas_add(c, n, x, y, weights, 1);
+}
+
+/*!
+ * Read the aggregated values of a canvas.
+ *
+ * \param[in] canvas The id of the canvas
+ * \param[out] values A pointer to allocated memory for `w` times `h` values
+ *
+ * The values are stored row by row starting with the top row. Cells without points have the value 0 for
+ * counts and sums and NaN for means and maxima.
+ */
+void gr_readshadecanvas(int canvas, double *values)
+{
+  shade_canvas_t *c = get_shade_canvas(canvas);
+
+  if (c != NULL) shade_canvas_values(c, values);
+}
+
+/*!
+ * Display the current state of a canvas as a rasterized image.
+ *
+ * \param[in] canvas The id of the canvas
+ * \param[in] xform The transformation type used for color mapping (see `gr_shadepoints`)
+ *
+ * The image is drawn into the region of the canvas. Reductions other than counts are mapped linearly to
+ * 65536 levels before the transformation is applied.
+ */
+void gr_drawshadecanvas(int canvas, int xform)
+{
+  shade_canvas_t *c = get_shade_canvas(canvas);
+  double roi[4];
+  int w, h, *bins;
+
+  if (c == NULL) return;
+
+  if (xform < 0 || xform > 5)
+    {
+      fprintf(stderr, "invalid transfer function\n");
+      return;
+    }
+
+  shade_canvas_size(c, roi, &w, &h);
+  bins = (int *)xcalloc(w * h, sizeof(int));
+  shade_canvas_render(c, xform, bins);
+
+  gr_cellarray(roi[0], roi[1], roi[2], roi[3], w, h, 1, 1, w, h, bins);
+
+  free(bins);
+}
+
+/*!
+ * Reset all cells of a canvas.
+ *
+ * \param[in] canvas The id of the canvas
+ */
+void gr_clearshadecanvas(int canvas)
+{
+  shade_canvas_t *c = get_shade_canvas(canvas);
+
+  if (c != NULL) shade_canvas_clear(c);
+}
+
+/*!
+ * Destroy a canvas and free its grid.
+ *
+ * \param[in] canvas The id of the canvas
+ */
+void gr_destroyshadecanvas(int canvas)
+{
+  shade_canvas_t *c = get_shade_canvas(canvas);
+
+  if (c == NULL) return;
+  shade_canvas_delete(c);
+  shade_canvases[canvas - 1] = NULL;
+}
+
 void gr_panzoom(double x, double y, double xzoom, double yzoom, double *xmin, double *xmax, double *ymin, double *ymax)
 {
   int errind, tnr;
@@ -10478,6 +11231,31 @@ void gr_panzoom(double x, double y, double xzoom, double yzoom, double *xmin, do
     }
 }
 
+static int check_boundary(int result)
+{
+  if (result < 0)
+    {
+      if (result == -1)
+        {
+          fprintf(stderr, "Ball radius is too small.\n");
+        }
+      else if (result == -2)
+        {
+          fprintf(stderr, "Ball radius is too large.\n");
+        }
+      else if (result == -3)
+        {
+          fprintf(stderr, "Not enough memory provided in contour array.\n");
+        }
+      else
+        {
+          fprintf(stderr, "An error occurred finding the boundary.\n");
+        }
+      result = 0;
+    }
+  return result;
+}
+
 /*!
  * Find a boundary around a given point set.
  *
@@ -10502,41 +11280,147 @@ void gr_panzoom(double x, double y, double xzoom, double yzoom, double *xmin, do
  *
  * The calculated boundary is represented as a list of indices in the given `x` and `y` arrays and is
  * stored in the `contour` array. `contour` must be a pointer to allocated memory for at least `n_contour`
- * integer indices. Normally less than `n` indices are needed for the boundary, in the worst case 2*`n`
- * indices are needed.
+ * integer indices. The first index is repeated after the last boundary point to close the contour, so
+ * `n_contour` must be greater than the number of boundary points. Normally less than `n` indices are needed
+ * for the boundary, in the worst case 2*`n` + 1 indices are needed. Of several points at the same position,
+ * only the first one can be part of the boundary.
  *
  */
 int gr_findboundary(int n, double *x, double *y, double r, double (*r_function)(double x, double y), int n_contour,
                     int *contour)
 {
-  int result;
   if (n < 2)
     {
       fprintf(stderr, "Not enough points provided.\n");
       return 0;
     }
-  result = find_boundary(n, x, y, r, r_function, n_contour, contour);
-  if (result < 0)
+  return check_boundary(find_boundary(n, x, y, r, r_function, n_contour, contour));
+}
+
+/*!
+ * Prepare a point set for repeated boundary calculations with `gr_findboundaries`.
+ *
+ * \param[in] n The number of points
+ * \param[in] x A pointer to the X coordinates
+ * \param[in] y A pointer to the Y coordinates
+ * \returns The id of the boundary finder
+ *
+ * The points are copied into a spatial grid, which is kept until the finder is destroyed with
+ * `gr_destroyboundaryfinder`. The grid does not depend on the ball radius, so boundaries with different
+ * radii can be computed without rebuilding it.
+ */
+int gr_createboundaryfinder(int n, double *x, double *y)
+{
+  int id;
+
+  if (n < 2)
     {
-      if (result == -1)
-        {
-          fprintf(stderr, "Ball radius is too small.\n");
-        }
-      else if (result == -2)
-        {
-          fprintf(stderr, "Ball radius is too large.\n");
-        }
-      else if (result == -3)
-        {
-          fprintf(stderr, "Not enough memory provided in contour array.\n");
-        }
-      else
+      fprintf(stderr, "Not enough points provided.\n");
+      return 0;
+    }
+
+  for (id = 0; id < num_boundary_finders; id++)
+    if (boundary_finders[id] == NULL) break;
+
+  if (id == num_boundary_finders)
+    {
+      num_boundary_finders++;
+      boundary_finders =
+          (boundary_finder_t **)xrealloc(boundary_finders, num_boundary_finders * sizeof(boundary_finder_t *));
+    }
+  boundary_finders[id] = boundary_finder_create(n, x, y);
+
+  return id + 1;
+}
+
+typedef struct
+{
+  boundary_finder_t **finders;
+  double r;
+  double (*r_function)(double, double);
+  int n_contour;
+  int *contour;
+  int *num_contour_points;
+} boundary_job_t;
+
+static void find_boundaries(void *arg, int start, int end)
+{
+  boundary_job_t *job = (boundary_job_t *)arg;
+  int i;
+
+  for (i = start; i < end; i++)
+    {
+      job->num_contour_points[i] = boundary_finder_find(job->finders[i], job->r, job->r_function, job->n_contour,
+                                                        job->contour + (size_t)i * job->n_contour);
+    }
+}
+
+/*!
+ * Find the boundaries of several point sets in parallel.
+ *
+ * \param[in] num_finders The number of boundary finders
+ * \param[in] finders The ids of the boundary finders (see `gr_createboundaryfinder`)
+ * \param[in] r A constant ball radius
+ * \param[in] r_function A ball radius callback function
+ * \param[in] n_contour The amount of memory allocated for the boundary points of each finder
+ * \param[out] contour A pointer to allocated memory for `num_finders` times `n_contour` indices
+ * \param[out] num_contour_points A pointer to allocated memory for `num_finders` boundary sizes
+ *
+ * The boundary of the i-th finder is stored at `contour + i * n_contour` and its number of points in
+ * `num_contour_points[i]`, which is 0 if no boundary was found. Like for `gr_findboundary`, each boundary is
+ * followed by its repeated first index. The ball radius is chosen as described for
+ * `gr_findboundary`, an automatically calculated radius is kept in the finder for later calls.
+ * The point sets are processed by separate threads, so `r_function` must be thread-safe.
+ */
+void gr_findboundaries(int num_finders, int *finders, double r, double (*r_function)(double x, double y),
+                       int n_contour, int *contour, int *num_contour_points)
+{
+  boundary_job_t job;
+  int i;
+
+  if (num_finders < 1) return;
+
+  job.finders = (boundary_finder_t **)xmalloc(num_finders * sizeof(boundary_finder_t *));
+  for (i = 0; i < num_finders; i++)
+    {
+      if (finders[i] < 1 || finders[i] > num_boundary_finders || boundary_finders[finders[i] - 1] == NULL)
         {
-          fprintf(stderr, "An error occurred finding the boundary.\n");
+          fprintf(stderr, "invalid boundary finder id\n");
+          memset(num_contour_points, 0, num_finders * sizeof(int));
+          free(job.finders);
+          return;
         }
-      result = 0;
+      job.finders[i] = boundary_finders[finders[i] - 1];
+      /* estimate missing radii beforehand, the finders are only read while the boundaries are traced */
+      if (r <= 0 && r_function == NULL) boundary_finder_radius(job.finders[i]);
     }
-  return result;
+  job.r = r;
+  job.r_function = r_function;
+  job.n_contour = n_contour;
+  job.contour = contour;
+  job.num_contour_points = num_contour_points;
+
+  gr_parallel_for(num_finders, 1, find_boundaries, &job);
+
+  for (i = 0; i < num_finders; i++) num_contour_points[i] = check_boundary(num_contour_points[i]);
+
+  free(job.finders);
+}
+
+/*!
+ * Destroy a boundary finder and free its spatial grid.
+ *
+ * \param[in] finder the id of the boundary finder
+ */
+void gr_destroyboundaryfinder(int finder)
+{
+  if (finder < 1 || finder > num_boundary_finders || boundary_finders[finder - 1] == NULL)
+    {
+      fprintf(stderr, "invalid boundary finder id\n");
+      return;
+    }
+  boundary_finder_delete(boundary_finders[finder - 1]);
+  boundary_finders[finder - 1] = NULL;
 }
 
 /*!
@@ -19,11 +19,19 @@ extern "C" {
 #define GR_PROJECTION_ORTHOGRAPHIC 1
 #define GR_PROJECTION_PERSPECTIVE 2
 
+#define GR_SHADE_COUNT 0
+#define GR_SHADE_SUM 1
+#define GR_SHADE_MEAN 2
+#define GR_SHADE_MAX 3
+
 typedef struct
 {
   double x, y;
 } vertex_t;
 
+/* If GR is built with GR_THREAD_LOCAL_STATE, every thread has its own GR and GKS state, which has to be initialized
+ * (and is only drawn to) from that thread. Otherwise the state is shared by all threads. */
+
 DLLEXPORT void gr_initgr(void);
 DLLEXPORT void gr_opengks(void);
 DLLEXPORT void gr_closegks(void);
@@ -140,6 +148,9 @@ DLLEXPORT void gr_setarrowsize(double);
 DLLEXPORT void gr_drawarrow(double, double, double, double);
 DLLEXPORT int gr_readimage(char *, int *, int *, int **);
 DLLEXPORT void gr_drawimage(double, double, double, double, int, int, int *, int);
+DLLEXPORT int gr_createimagepyramid(int, int, int *, int);
+DLLEXPORT void gr_drawimagepyramid(int, double, double, double, double);
+DLLEXPORT void gr_destroyimagepyramid(int);
 DLLEXPORT int gr_importgraphics(char *);
 DLLEXPORT void gr_setshadow(double, double, double);
 DLLEXPORT void gr_settransparency(double);
@@ -174,8 +185,18 @@ DLLEXPORT const char *gr_version(void);
 DLLEXPORT void gr_shade(int, double *, double *, int, int, double *, int, int, int *);
 DLLEXPORT void gr_shadepoints(int, double *, double *, int, int, int);
 DLLEXPORT void gr_shadelines(int, double *, double *, int, int, int);
+DLLEXPORT int gr_createshadecanvas(double, double, double, double, int, int, int);
+DLLEXPORT void gr_shadecanvaspoints(int, int, double *, double *, double *);
+DLLEXPORT void gr_shadecanvaslines(int, int, double *, double *, double *);
+DLLEXPORT void gr_readshadecanvas(int, double *);
+DLLEXPORT void gr_drawshadecanvas(int, int);
+DLLEXPORT void gr_clearshadecanvas(int);
+DLLEXPORT void gr_destroyshadecanvas(int);
 DLLEXPORT void gr_panzoom(double, double, double, double, double *, double *, double *, double *);
 DLLEXPORT int gr_findboundary(int, double *, double *, double, double (*)(double, double), int, int *);
+DLLEXPORT int gr_createboundaryfinder(int, double *, double *);
+DLLEXPORT void gr_findboundaries(int, int *, double, double (*)(double, double), int, int *, int *);
+DLLEXPORT void gr_destroyboundaryfinder(int);
 DLLEXPORT void gr_setresamplemethod(unsigned int);
 DLLEXPORT void gr_inqresamplemethod(unsigned int *);
 DLLEXPORT void gr_path(int, double *, double *, const char *);
@@ -114,6 +114,8 @@ static char *s_arg[3];
 
 static int i_argc, f_argc, s_argc, i_arrc, f_arrp, f_arrc, v_arrc, b_arrc;
 
+static int base64;
+
 static char *xmalloc(int size)
 {
   char *result = (char *)malloc(size);
@@ -164,9 +166,66 @@ static double ascii2double(const char *s)
     return atof(s);
 }
 
+static signed char base64_values[256];
+
+static int decode_base64(char *s)
+{
+  /* decode in place, the output never overtakes the input */
+  const unsigned char *in = (const unsigned char *)s;
+  unsigned char *out = (unsigned char *)s;
+  const char *table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  int n = 0, a, b, c, d, i;
+
+  if (base64_values['/'] == 0)
+    {
+      memset(base64_values, -1, sizeof(base64_values));
+      for (i = 0; i < 64; i++) base64_values[(unsigned char)table[i]] = i;
+    }
+  while ((a = base64_values[in[0]]) >= 0 && (b = base64_values[in[1]]) >= 0 && (c = base64_values[in[2]]) >= 0 &&
+         (d = base64_values[in[3]]) >= 0)
+    {
+      out[n++] = (a << 2) | (b >> 4);
+      out[n++] = ((b << 4) | (c >> 2)) & 0xff;
+      out[n++] = ((c << 6) | d) & 0xff;
+      in += 4;
+    }
+  /* a final group with padding */
+  if (a >= 0 && (b = base64_values[in[1]]) >= 0)
+    {
+      out[n++] = (a << 2) | (b >> 4);
+      if ((c = base64_values[in[2]]) >= 0) out[n++] = ((b << 4) | (c >> 2)) & 0xff;
+    }
+  return n;
+}
+
+static int unpack_int(const unsigned char *p)
+{
+  unsigned int bits = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+
+  return bits > 0x7fffffff ? -(int)(~bits) - 1 : (int)bits;
+}
+
+static double unpack_double(const unsigned char *p)
+{
+  static const int one = 1;
+  unsigned char bytes[sizeof(double)];
+  double value;
+  int i;
+
+  if (*(const char *)&one)
+    memcpy(&value, p, sizeof(double));
+  else
+    {
+      for (i = 0; i < (int)sizeof(double); i++) bytes[i] = p[sizeof(double) - 1 - i];
+      memcpy(&value, bytes, sizeof(double));
+    }
+  return value;
+}
+
 static char *xml(char *s, char *fmt)
 {
   char *attr, *p;
+  int n, k;
 
   i_argc = i_arrc = 0;
   f_argc = f_arrp = f_arrc = 0;
@@ -202,6 +261,17 @@ static char *xml(char *s, char *fmt)
                           s_arg[s_argc++] = attr;
                           break;
                         case 'I':
+                          if (base64)
+                            {
+                              n = decode_base64(attr) / 4;
+                              if (i_arrc + n > i_arr_size)
+                                {
+                                  while (i_arrc + n > i_arr_size) i_arr_size += BUFFSIZE;
+                                  i_arr = (int *)xrealloc(i_arr, sizeof(int) * i_arr_size);
+                                }
+                              for (k = 0; k < n; k++) i_arr[i_arrc++] = unpack_int((unsigned char *)attr + 4 * k);
+                              break;
+                            }
                           p = strtok(attr, " \t\"");
                           while (p != NULL)
                             {
@@ -215,6 +285,20 @@ static char *xml(char *s, char *fmt)
                             }
                           break;
                         case 'F':
+                          if (base64)
+                            {
+                              n = decode_base64(attr) / sizeof(double);
+                              if (n > f_arr_size[f_arrp])
+                                {
+                                  while (n > f_arr_size[f_arrp]) f_arr_size[f_arrp] += BUFFSIZE;
+                                  f_arr[f_arrp] =
+                                      (double *)xrealloc(f_arr[f_arrp], sizeof(double) * f_arr_size[f_arrp]);
+                                }
+                              for (k = 0; k < n; k++)
+                                f_arr[f_arrp][k] = unpack_double((unsigned char *)attr + sizeof(double) * k);
+                              f_arrp++;
+                              break;
+                            }
                           p = strtok(attr, " \t\"");
                           while (p != NULL)
                             {
@@ -231,6 +315,23 @@ static char *xml(char *s, char *fmt)
                           f_arrc = 0;
                           break;
                         case 'V':
+                          if (base64)
+                            {
+                              n = decode_base64(attr) / (2 * sizeof(double));
+                              if (v_arrc + n > v_arr_size)
+                                {
+                                  while (v_arrc + n > v_arr_size) v_arr_size += BUFFSIZE;
+                                  v_arr = (vertex_t *)xrealloc(v_arr, sizeof(vertex_t) * v_arr_size);
+                                }
+                              for (k = 0; k < n; k++)
+                                {
+                                  v_arr[v_arrc].x = unpack_double((unsigned char *)attr + 2 * sizeof(double) * k);
+                                  v_arr[v_arrc].y =
+                                      unpack_double((unsigned char *)attr + (2 * k + 1) * sizeof(double));
+                                  v_arrc++;
+                                }
+                              break;
+                            }
                           p = strtok(attr, " \t\"");
                           while (p != NULL)
                             {
@@ -247,6 +348,18 @@ static char *xml(char *s, char *fmt)
                             }
                           break;
                         case 'B':
+                          if (base64)
+                            {
+                              n = decode_base64(attr);
+                              if (b_arrc + n > b_arr_size)
+                                {
+                                  while (b_arrc + n > b_arr_size) b_arr_size += BUFFSIZE;
+                                  b_arr = (unsigned char *)xrealloc(b_arr, sizeof(unsigned char) * b_arr_size);
+                                }
+                              memcpy(b_arr + b_arrc, attr, n);
+                              b_arrc += n;
+                              break;
+                            }
                           p = strtok(attr, " \t\"");
                           while (p != NULL)
                             {
@@ -530,6 +643,7 @@ int gr_drawgraphics(char *string)
   v_arr_size = BUFFSIZE;
   b_arr = (unsigned char *)xmalloc(sizeof(unsigned char) * BUFFSIZE);
   b_arr_size = BUFFSIZE;
+  base64 = 0;
 
   while (*s)
     {
@@ -547,7 +661,13 @@ int gr_drawgraphics(char *string)
                   s = xml(s, fmt);
                   gr(id);
                 }
-              else if (strcmp(el, "gr") != 0)
+              else if (strcmp(el, "gr") == 0)
+                {
+                  /* arrays are base64 encoded binary data if the stream was written with GR_STREAM_ENCODING=base64 */
+                  while (*s == ' ') s++;
+                  base64 = strncmp(s, "encoding=\"base64\"", 17) == 0;
+                }
+              else
                 fprintf(stderr, "%s: unknown XML element\n", el);
             }
         }
@@ -21,19 +21,19 @@
 #include "io.h"
 #include "gkscore.h"
 
-static int status = EXIT_SUCCESS;
+static GKS_THREAD_LOCAL int status = EXIT_SUCCESS;
 
-static FILE *stream = NULL;
+static GKS_THREAD_LOCAL FILE *stream = NULL;
 
-static int s = -1;
+static GKS_THREAD_LOCAL int s = -1;
 
-static char *buffer = NULL, *static_buffer = NULL;
+static GKS_THREAD_LOCAL char *buffer = NULL, *static_buffer = NULL;
 
-static char *hostname = NULL;
+static GKS_THREAD_LOCAL char *hostname = NULL;
 
-static int port = PORT;
+static GKS_THREAD_LOCAL int port = PORT;
 
-static int nbytes = 0, size = 0, static_size = 0;
+static GKS_THREAD_LOCAL int nbytes = 0, size = 0, static_size = 0;
 
 static void close_socket(int s)
 {
@@ -162,10 +162,8 @@ static int sendstream(char *string)
   return status;
 }
 
-static void append(char *string)
+static void append(const char *string, int len)
 {
-  int len = strlen(string);
-
   if (buffer == NULL)
     {
       buffer = (char *)malloc(BUFSIZ + 1);
@@ -180,7 +178,7 @@ static void append(char *string)
       buffer = (char *)realloc(buffer, size + 1);
     }
 
-  strncpy(buffer + nbytes, string, len);
+  memcpy(buffer + nbytes, string, len);
   nbytes += len;
   buffer[nbytes] = '\0';
 }
@@ -235,11 +233,19 @@ void gr_writestream(char *string, ...)
   va_end(ap);
 
   if (stream != stdout)
-    append(s);
+    append(s, strlen(s));
   else
     fprintf(stdout, "%s", s);
 }
 
+void gr_appendstream(const char *data, int len)
+{
+  if (stream != stdout)
+    append(data, len);
+  else
+    fwrite(data, len, 1, stdout);
+}
+
 void gr_flushstream(int discard)
 {
   if (buffer != NULL)
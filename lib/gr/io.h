@@ -7,6 +7,7 @@ extern "C" {
 
 int gr_openstream(const char *path);
 void gr_writestream(char *string, ...);
+void gr_appendstream(const char *data, int len);
 void gr_flushstream(int discard);
 void gr_closestream(void);
 
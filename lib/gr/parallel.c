@@ -0,0 +1,103 @@
+/*
+ * Split a range of independent work items (e.g. image rows) between threads. The calling thread processes the first
+ * chunk itself, so small ranges run without creating any threads.
+ */
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "parallel.h"
+
+typedef struct
+{
+  parallel_func_t func;
+  void *arg;
+  int start;
+  int end;
+} parallel_job_t;
+
+#ifdef _WIN32
+static DWORD WINAPI parallel_worker(LPVOID arg)
+#else
+static void *parallel_worker(void *arg)
+#endif
+{
+  parallel_job_t *job = (parallel_job_t *)arg;
+
+  job->func(job->arg, job->start, job->end);
+
+  return 0;
+}
+
+int gr_parallel_threads(int n, int min_per_thread)
+{
+  long cpu_count = 1;
+  int threads;
+
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  cpu_count = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  threads = min_per_thread > 0 ? n / min_per_thread : n;
+  if (cpu_count > 0 && threads > cpu_count) threads = (int)cpu_count;
+  if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+
+  return threads > 1 ? threads : 1;
+}
+
+void gr_parallel_for(int n, int min_per_thread, parallel_func_t func, void *arg)
+{
+  parallel_job_t jobs[PARALLEL_MAX_THREADS];
+#ifdef _WIN32
+  HANDLE threads[PARALLEL_MAX_THREADS];
+#else
+  pthread_t threads[PARALLEL_MAX_THREADS];
+#endif
+  int started[PARALLEL_MAX_THREADS];
+  int num_threads, i;
+
+  if (n <= 0) return;
+
+  num_threads = gr_parallel_threads(n, min_per_thread);
+  for (i = 0; i < num_threads; i++)
+    {
+      jobs[i].func = func;
+      jobs[i].arg = arg;
+      jobs[i].start = (int)((double)n * i / num_threads);
+      jobs[i].end = (int)((double)n * (i + 1) / num_threads);
+    }
+  for (i = 1; i < num_threads; i++)
+    {
+#ifdef _WIN32
+      threads[i] = CreateThread(NULL, 0, parallel_worker, &jobs[i], 0, NULL);
+      started[i] = threads[i] != NULL;
+#else
+      started[i] = pthread_create(&threads[i], NULL, parallel_worker, &jobs[i]) == 0;
+#endif
+    }
+  func(arg, jobs[0].start, jobs[0].end);
+  for (i = 1; i < num_threads; i++)
+    {
+      if (started[i])
+        {
+#ifdef _WIN32
+          WaitForSingleObject(threads[i], INFINITE);
+          CloseHandle(threads[i]);
+#else
+          pthread_join(threads[i], NULL);
+#endif
+        }
+      else
+        /* the thread could not be created, so its share is processed here */
+        func(arg, jobs[i].start, jobs[i].end);
+    }
+}
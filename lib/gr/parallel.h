@@ -0,0 +1,27 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#ifndef DLLEXPORT
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PARALLEL_MAX_THREADS 64
+
+typedef void (*parallel_func_t)(void *arg, int start, int end);
+
+DLLEXPORT int gr_parallel_threads(int n, int min_per_thread);
+DLLEXPORT void gr_parallel_for(int n, int min_per_thread, parallel_func_t func, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Tiled multi-resolution image pyramid for `gr_drawimagepyramid`.
+ *
+ * Level 0 is the registered image, every further level halves both dimensions by averaging 2x2 pixel blocks of the
+ * previous level. Levels are split into square tiles which are computed on demand: a level 0 tile is copied from the
+ * image data, a tile of a higher level is reduced from the (up to) four tiles below it. Computed tiles are kept in a
+ * cache with a fixed number of slots, the least recently used tile is dropped when a slot is needed. Tiles which were
+ * only computed as an intermediate step count as used before the tiles that were actually read, and among tiles of the
+ * same age the ones of lower levels (which are cheaper to recompute) are dropped first.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gr.h"
+#include "pyramid.h"
+
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+
+typedef struct
+{
+  int *data;
+  int level;
+  int index;
+  unsigned long last_use;
+} tile_t;
+
+typedef struct
+{
+  int width;
+  int height;
+  int tiles_x;
+  int tiles_y;
+  tile_t **tiles;
+} level_t;
+
+struct image_pyramid_t
+{
+  const int *data;
+  int hsv;
+  int num_levels;
+  level_t *levels;
+  int max_tiles;
+  int num_cached;
+  tile_t **cached;
+  unsigned long clock;
+};
+
+static char *xcalloc(int count, int size)
+{
+  char *result = (char *)calloc(count, size);
+  if (!result)
+    {
+      fprintf(stderr, "out of virtual memory\n");
+      abort();
+    }
+  return (result);
+}
+
+static char *xmalloc(int size)
+{
+  char *result = (char *)malloc(size);
+  if (!result)
+    {
+      fprintf(stderr, "out of virtual memory\n");
+      abort();
+    }
+  return (result);
+}
+
+static int hsv_to_rgb(int hsv)
+{
+  double red, green, blue;
+
+  gr_hsvtorgb((hsv & 0xff) / 255.0, ((hsv & 0xff00) >> 8) / 255.0, ((hsv & 0xff0000) >> 16) / 255.0, &red, &green,
+              &blue);
+  return (hsv & 0xff000000) | ((int)(red * 255) << 16) | ((int)(green * 255) << 8) | ((int)(blue * 255));
+}
+
+image_pyramid_t *pyramid_create(int width, int height, const int *data, int hsv, int max_tiles)
+{
+  image_pyramid_t *pyramid;
+  level_t *level;
+  int w = width, h = height, i;
+
+  pyramid = (image_pyramid_t *)xcalloc(1, sizeof(image_pyramid_t));
+  pyramid->data = data;
+  pyramid->hsv = hsv;
+
+  pyramid->num_levels = 1;
+  while (w > PYRAMID_TILE_SIZE || h > PYRAMID_TILE_SIZE)
+    {
+      w = (w + 1) / 2;
+      h = (h + 1) / 2;
+      pyramid->num_levels++;
+    }
+  pyramid->levels = (level_t *)xcalloc(pyramid->num_levels, sizeof(level_t));
+  w = width;
+  h = height;
+  for (i = 0; i < pyramid->num_levels; i++)
+    {
+      level = pyramid->levels + i;
+      level->width = w;
+      level->height = h;
+      level->tiles_x = (w + PYRAMID_TILE_SIZE - 1) / PYRAMID_TILE_SIZE;
+      level->tiles_y = (h + PYRAMID_TILE_SIZE - 1) / PYRAMID_TILE_SIZE;
+      level->tiles = (tile_t **)xcalloc(level->tiles_x * level->tiles_y, sizeof(tile_t *));
+      w = (w + 1) / 2;
+      h = (h + 1) / 2;
+    }
+
+  /* at least the four tiles needed to reduce a tile of the next level have to fit into the cache */
+  pyramid->max_tiles = max_tiles > 4 ? max_tiles : 4;
+  pyramid->cached = (tile_t **)xcalloc(pyramid->max_tiles, sizeof(tile_t *));
+
+  return pyramid;
+}
+
+void pyramid_delete(image_pyramid_t *pyramid)
+{
+  int i;
+
+  if (pyramid == NULL) return;
+
+  for (i = 0; i < pyramid->num_cached; i++)
+    {
+      free(pyramid->cached[i]->data);
+      free(pyramid->cached[i]);
+    }
+  for (i = 0; i < pyramid->num_levels; i++) free(pyramid->levels[i].tiles);
+  free(pyramid->levels);
+  free(pyramid->cached);
+  free(pyramid);
+}
+
+int pyramid_levels(const image_pyramid_t *pyramid)
+{
+  return pyramid->num_levels;
+}
+
+void pyramid_level_size(const image_pyramid_t *pyramid, int level, int *width, int *height)
+{
+  *width = pyramid->levels[level].width;
+  *height = pyramid->levels[level].height;
+}
+
+static void cache_tile(image_pyramid_t *pyramid, tile_t *tile)
+{
+  tile_t *victim;
+  int i, oldest = 0;
+
+  if (pyramid->num_cached == pyramid->max_tiles)
+    {
+      for (i = 1; i < pyramid->num_cached; i++)
+        if (pyramid->cached[i]->last_use < pyramid->cached[oldest]->last_use ||
+            (pyramid->cached[i]->last_use == pyramid->cached[oldest]->last_use &&
+             pyramid->cached[i]->level < pyramid->cached[oldest]->level))
+          oldest = i;
+
+      victim = pyramid->cached[oldest];
+      pyramid->levels[victim->level].tiles[victim->index] = NULL;
+      free(victim->data);
+      free(victim);
+      pyramid->cached[oldest] = pyramid->cached[--pyramid->num_cached];
+    }
+  pyramid->cached[pyramid->num_cached++] = tile;
+  pyramid->levels[tile->level].tiles[tile->index] = tile;
+}
+
+static const int *get_tile(image_pyramid_t *pyramid, int l, int tx, int ty, unsigned long use);
+
+static void load_tile(image_pyramid_t *pyramid, level_t *level, int tx, int ty, int *data)
+{
+  const int *src;
+  int x0 = tx * PYRAMID_TILE_SIZE, y0 = ty * PYRAMID_TILE_SIZE;
+  int w = min(PYRAMID_TILE_SIZE, level->width - x0), h = min(PYRAMID_TILE_SIZE, level->height - y0);
+  int i, j;
+
+  for (j = 0; j < h; j++)
+    {
+      src = pyramid->data + (size_t)(y0 + j) * level->width + x0;
+      if (pyramid->hsv)
+        {
+          for (i = 0; i < w; i++) data[j * PYRAMID_TILE_SIZE + i] = hsv_to_rgb(src[i]);
+        }
+      else
+        memcpy(data + j * PYRAMID_TILE_SIZE, src, w * sizeof(int));
+    }
+}
+
+static void reduce_tile(image_pyramid_t *pyramid, int l, int tx, int ty, int *data)
+{
+  level_t *lower = pyramid->levels + l - 1;
+  const int *src;
+  int *dst, half = PYRAMID_TILE_SIZE / 2;
+  int cx, cy, w, h, i, j, di, dj, n, c;
+  unsigned int p[4], even, odd, pixel, sum[4];
+
+  /* every quarter of the tile is the reduction of one tile of the level below */
+  for (cy = 2 * ty; cy < min(2 * ty + 2, lower->tiles_y); cy++)
+    for (cx = 2 * tx; cx < min(2 * tx + 2, lower->tiles_x); cx++)
+      {
+        src = get_tile(pyramid, l - 1, cx, cy, pyramid->clock - 1);
+        w = min(PYRAMID_TILE_SIZE, lower->width - cx * PYRAMID_TILE_SIZE);
+        h = min(PYRAMID_TILE_SIZE, lower->height - cy * PYRAMID_TILE_SIZE);
+        for (j = 0; j < (h + 1) / 2; j++)
+          for (i = 0; i < (w + 1) / 2; i++)
+            {
+              dst = data + ((cy - 2 * ty) * half + j) * PYRAMID_TILE_SIZE + (cx - 2 * tx) * half + i;
+              if (2 * i + 1 < w && 2 * j + 1 < h)
+                {
+                  /* average all four channels at once, two channels per 32 bit word */
+                  p[0] = src[2 * j * PYRAMID_TILE_SIZE + 2 * i];
+                  p[1] = src[2 * j * PYRAMID_TILE_SIZE + 2 * i + 1];
+                  p[2] = src[(2 * j + 1) * PYRAMID_TILE_SIZE + 2 * i];
+                  p[3] = src[(2 * j + 1) * PYRAMID_TILE_SIZE + 2 * i + 1];
+                  even = (p[0] & 0xff00ff) + (p[1] & 0xff00ff) + (p[2] & 0xff00ff) + (p[3] & 0xff00ff) + 0x20002;
+                  odd = ((p[0] >> 8) & 0xff00ff) + ((p[1] >> 8) & 0xff00ff) + ((p[2] >> 8) & 0xff00ff) +
+                        ((p[3] >> 8) & 0xff00ff) + 0x20002;
+                  *dst = (int)(((even >> 2) & 0xff00ff) | ((odd >> 2) & 0xff00ff) << 8);
+                  continue;
+                }
+              sum[0] = sum[1] = sum[2] = sum[3] = 0;
+              n = 0;
+              for (dj = 0; dj < 2 && 2 * j + dj < h; dj++)
+                for (di = 0; di < 2 && 2 * i + di < w; di++)
+                  {
+                    pixel = src[(2 * j + dj) * PYRAMID_TILE_SIZE + 2 * i + di];
+                    for (c = 0; c < 4; c++) sum[c] += (pixel >> 8 * c) & 0xff;
+                    n++;
+                  }
+              *dst = (int)((sum[0] + n / 2) / n | (sum[1] + n / 2) / n << 8 | (sum[2] + n / 2) / n << 16 |
+                           (sum[3] + n / 2) / n << 24);
+            }
+      }
+}
+
+static const int *get_tile(image_pyramid_t *pyramid, int l, int tx, int ty, unsigned long use)
+{
+  level_t *level = pyramid->levels + l;
+  int index = ty * level->tiles_x + tx;
+  tile_t *tile = level->tiles[index];
+
+  if (tile == NULL)
+    {
+      tile = (tile_t *)xmalloc(sizeof(tile_t));
+      tile->data = (int *)xmalloc(PYRAMID_TILE_SIZE * PYRAMID_TILE_SIZE * sizeof(int));
+      tile->level = l;
+      tile->index = index;
+      tile->last_use = 0;
+      /* the tile is only added to the cache when it is complete, so reducing it cannot evict it */
+      if (l == 0)
+        load_tile(pyramid, level, tx, ty, tile->data);
+      else
+        reduce_tile(pyramid, l, tx, ty, tile->data);
+      cache_tile(pyramid, tile);
+    }
+  if (tile->last_use < use) tile->last_use = use;
+
+  return tile->data;
+}
+
+/*
+ * Copy the region with the upper left corner (x, y) and the given size from a pyramid level into `data`. The tiles
+ * intersecting the region are computed if they are not cached.
+ */
+void pyramid_read(image_pyramid_t *pyramid, int l, int x, int y, int width, int height, int *data)
+{
+  const int *src;
+  int tx, ty, x0, x1, y0, y1, j;
+
+  pyramid->clock += 2;
+  for (ty = y / PYRAMID_TILE_SIZE; ty <= (y + height - 1) / PYRAMID_TILE_SIZE; ty++)
+    for (tx = x / PYRAMID_TILE_SIZE; tx <= (x + width - 1) / PYRAMID_TILE_SIZE; tx++)
+      {
+        src = get_tile(pyramid, l, tx, ty, pyramid->clock);
+        x0 = max(x, tx * PYRAMID_TILE_SIZE);
+        x1 = min(x + width, (tx + 1) * PYRAMID_TILE_SIZE);
+        y0 = max(y, ty * PYRAMID_TILE_SIZE);
+        y1 = min(y + height, (ty + 1) * PYRAMID_TILE_SIZE);
+        for (j = y0; j < y1; j++)
+          memcpy(data + (size_t)(j - y) * width + (x0 - x),
+                 src + (j - ty * PYRAMID_TILE_SIZE) * PYRAMID_TILE_SIZE + (x0 - tx * PYRAMID_TILE_SIZE),
+                 (x1 - x0) * sizeof(int));
+      }
+}
@@ -0,0 +1,22 @@
+#ifndef _PYRAMID_H_
+#define _PYRAMID_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PYRAMID_TILE_SIZE 256
+
+typedef struct image_pyramid_t image_pyramid_t;
+
+image_pyramid_t *pyramid_create(int width, int height, const int *data, int hsv, int max_tiles);
+void pyramid_delete(image_pyramid_t *pyramid);
+int pyramid_levels(const image_pyramid_t *pyramid);
+void pyramid_level_size(const image_pyramid_t *pyramid, int level, int *width, int *height);
+void pyramid_read(image_pyramid_t *pyramid, int level, int x, int y, int width, int height, int *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,18 +8,23 @@ Link:
 
  */
 
+#ifdef __unix__
+#define _XOPEN_SOURCE 500 /* log1p */
+#endif
+
 #include <float.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "gr.h"
+#include "shade.h"
+#include "parallel.h"
 
-#ifdef _WIN32
-#define is_nan(a) _isnan(a)
-#else
-#define is_nan(a) isnan(a)
+#ifndef NAN
+#define NAN (0.0 / 0.0)
 #endif
 
 #define XFORM_BOOLEAN 0
@@ -29,6 +34,69 @@ Link:
 #define XFORM_CUBIC 4
 #define XFORM_EQUALIZED 5
 
+/* points whose bin indices are computed at once */
+#define SHADE_BLOCK_SIZE 1024
+
+#define SHADE_MIN_POINTS_PER_THREAD 262144
+
+#define SHADE_MIN_BINS_PER_THREAD 65536
+
+/* number of levels float reductions are quantized to for shading */
+#define SHADE_LEVELS 65536
+
+/* the finest level of a binning pyramid has about this many points per cell and at most 2^11 x 2^11 cells */
+#define PYRAMID_POINTS_PER_CELL 8
+
+#define PYRAMID_MAX_DEPTH 11
+
+struct shade_canvas_t
+{
+  /*
+   * The canvas only keeps the aggregation grid, the points of a batch are not stored. `count` holds the number of
+   * points or line pixels per bin as 32 bit integers (like the bins of `gr_shade`). Before a batch could overflow
+   * them, they are moved to `count_base`, which is allocated only then. `pending` is the largest count a bin could
+   * have reached since. `value` holds the sum or maximum of the weights (it is NULL for GR_SHADE_COUNT).
+   * Batches are split between threads and all but the first thread accumulate into partial grids, which are
+   * merged into the canvas and reset after each batch.
+   */
+  double roi[4];
+  int w, h;
+  int reduction;
+  unsigned int *count;
+  double *count_base;
+  double pending;
+  double *value;
+  int num_partials;
+  unsigned int **partial_count;
+  double **partial_value;
+};
+
+typedef struct
+{
+  shade_canvas_t *canvas;
+  int n;
+  const double *x;
+  const double *y;
+  const double *weights;
+  int lines;
+  int num_tasks;
+} shade_job_t;
+
+struct shade_pyramid_t
+{
+  /*
+   * The finite points of a data set sorted into a grid of 2^depth x 2^depth cells over their bounding box. Level l
+   * has 2^l x 2^l cells, each covering 2 x 2 cells of level l + 1, and `count[l]` holds their numbers of points.
+   * The points of the cells of the finest level are contiguous parts of `x` and `y`, starting at `offset`.
+   */
+  int depth;
+  double x0, y0, cell_width, cell_height;
+  double *x;
+  double *y;
+  int *offset;
+  int **count;
+};
+
 static char *xcalloc(int count, int size)
 {
   char *result = (char *)calloc(count, size);
@@ -40,27 +108,394 @@ static char *xcalloc(int count, int size)
   return (result);
 }
 
-static void rasterize(int n, double *x, double *y, double *roi, int w, int h, int *bins)
+static char *xrealloc(void *ptr, int size)
 {
-  double xl, xr, yb, yt;
-  int i, ix, iy, num_bins = w * h;
-
-  xl = roi[0];
-  xr = roi[1];
-  yb = roi[2];
-  yt = roi[3];
+  char *result = (char *)realloc(ptr, size);
+  if (!result)
+    {
+      fprintf(stderr, "out of virtual memory\n");
+      abort();
+    }
+  return (result);
+}
 
-  for (i = 0; i < num_bins; i++) bins[i] = 0;
+static void bin_indices(const shade_canvas_t *canvas, int n, const double *x, const double *y, int *index)
+{
+  /*
+   * Compute the bin index of each point. Points outside of the region of interest are put into an additional bin
+   * behind the grid. The loop has no branches and no calls, so the compiler can vectorize it.
+   */
+  double xl = canvas->roi[0], xr = canvas->roi[1], yb = canvas->roi[2], yt = canvas->roi[3];
+  int i, w = canvas->w, h = canvas->h;
 
   for (i = 0; i < n; i++)
     {
-      if (x[i] >= roi[0] && x[i] <= roi[1] && y[i] >= roi[2] && y[i] <= roi[3])
+      int inside = (x[i] >= xl) & (x[i] <= xr) & (y[i] >= yb) & (y[i] <= yt);
+      double fx = (x[i] - xl) / (xr - xl) * (w - 1) + 0.5;
+      double fy = (y[i] - yb) / (yt - yb) * (h - 1) + 0.5;
+      int ix, iy;
+      /* clip before the conversion, the results for points outside (or NaN) are not used */
+      fx = fx > 0 ? fx : 0;
+      fx = fx < w ? fx : 0;
+      fy = fy > 0 ? fy : 0;
+      fy = fy < h ? fy : 0;
+      ix = (int)fx;
+      iy = (int)fy;
+      index[i] = inside ? (h - iy - 1) * w + ix : w * h;
+    }
+}
+
+static void accumulate(const shade_canvas_t *canvas, unsigned int *count, double *value, int n, const int *index,
+                       const double *weights, double weight)
+{
+  /*
+   * Add `n` points with the bin indices `index` to a grid. If `weights` is NULL, all points have the weight `weight`.
+   */
+  int i;
+
+  /* the indices are read ahead of the increments, as the compiler has to assume that `count` aliases `index` */
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      int i0 = index[i], i1 = index[i + 1], i2 = index[i + 2], i3 = index[i + 3];
+      count[i0]++;
+      count[i1]++;
+      count[i2]++;
+      count[i3]++;
+    }
+  for (; i < n; i++) count[index[i]]++;
+  if (canvas->reduction == GR_SHADE_MAX)
+    {
+      for (i = 0; i < n; i++)
+        {
+          double v = weights ? weights[i] : weight;
+          if (v > value[index[i]]) value[index[i]] = v;
+        }
+    }
+  else if (canvas->reduction != GR_SHADE_COUNT)
+    {
+      for (i = 0; i < n; i++) value[index[i]] += weights ? weights[i] : weight;
+    }
+}
+
+static double bin_count(const shade_canvas_t *canvas, int i)
+{
+  return canvas->count_base ? canvas->count_base[i] + canvas->count[i] : canvas->count[i];
+}
+
+static void reset_values(const shade_canvas_t *canvas, double *value, int start, int end)
+{
+  /*
+   * Empty bins have the value 0, or -inf for maxima so that any weight replaces it.
+   */
+  int i;
+
+  for (i = start; i < end; i++) value[i] = canvas->reduction == GR_SHADE_MAX ? -HUGE_VAL : 0;
+}
+
+static int lineLow(int x0, int y0, int x1, int y1, int w, int h, int *bins)
+{
+  int dx = x1 - x0;
+  int dy = y1 - y0;
+  int yi = 1;
+  int y = y0;
+  int D, x, n = 0;
+
+  if (dy < 0)
+    {
+      yi = -1;
+      dy = -dy;
+    }
+  D = 2 * dy - dx;
+
+  for (x = x0; x <= x1; x++)
+    {
+      bins[n++] = (h - y - 1) * w + x;
+      if (D > 0)
+        {
+          y += yi;
+          D -= 2 * dx;
+        }
+      D += 2 * dy;
+    }
+  return n;
+}
+
+static int lineHigh(int x0, int y0, int x1, int y1, int w, int h, int *bins)
+{
+  int dx = x1 - x0;
+  int dy = y1 - y0;
+  int xi = 1;
+  int x = x0;
+  int D, y, n = 0;
+
+  if (dx < 0)
+    {
+      xi = -1;
+      dx = -dx;
+    }
+  D = 2 * dx - dy;
+
+  for (y = y0; y <= y1; y++)
+    {
+      bins[n++] = (h - y - 1) * w + x;
+      if (D > 0)
+        {
+          x += xi;
+          D -= 2 * dy;
+        }
+      D += 2 * dx;
+    }
+  return n;
+}
+
+static int line(int x0, int y0, int x1, int y1, int w, int h, int *bins)
+{
+  /*
+   * Store the indices of the bins covered by the line from (x0, y0) to (x1, y1) in `bins`, which must have room
+   * for max(w, h) indices, and return their number.
+   */
+  if (abs(y1 - y0) < abs(x1 - x0))
+    {
+      if (x0 > x1)
+        return lineLow(x1, y1, x0, y0, w, h, bins);
+      else
+        return lineLow(x0, y0, x1, y1, w, h, bins);
+    }
+  else
+    {
+      if (y0 > y1)
+        return lineHigh(x1, y1, x0, y0, w, h, bins);
+      else
+        return lineHigh(x0, y0, x1, y1, w, h, bins);
+    }
+}
+
+static void accumulate_points(const shade_canvas_t *canvas, unsigned int *count, double *value, int n, const double *x,
+                              const double *y, const double *weights)
+{
+  int index[SHADE_BLOCK_SIZE];
+  int i, m;
+
+  for (i = 0; i < n; i += SHADE_BLOCK_SIZE)
+    {
+      m = n - i < SHADE_BLOCK_SIZE ? n - i : SHADE_BLOCK_SIZE;
+      bin_indices(canvas, m, x + i, y + i, index);
+      accumulate(canvas, count, value, m, index, weights ? weights + i : NULL, 1);
+    }
+}
+
+static void accumulate_lines(const shade_canvas_t *canvas, unsigned int *count, double *value, int start, int end,
+                             const double *x, const double *y, const double *weights)
+{
+  /*
+   * Draw the segments from point i to point i + 1 for start <= i < end. Segments with an end point outside of the
+   * region of interest are skipped, this includes the NaN values separating the lines.
+   */
+  double xl = canvas->roi[0], xr = canvas->roi[1], yb = canvas->roi[2], yt = canvas->roi[3];
+  int w = canvas->w, h = canvas->h;
+  int *bins, i, m, x0, y0, x1, y1;
+
+  bins = (int *)xcalloc(w > h ? w : h, sizeof(int));
+  for (i = start; i < end; i++)
+    {
+      if (x[i] >= xl && x[i] <= xr && y[i] >= yb && y[i] <= yt && x[i + 1] >= xl && x[i + 1] <= xr &&
+          y[i + 1] >= yb && y[i + 1] <= yt)
+        {
+          x0 = (int)((x[i] - xl) / (xr - xl) * (w - 1) + 0.5);
+          y0 = (int)((y[i] - yb) / (yt - yb) * (h - 1) + 0.5);
+          x1 = (int)((x[i + 1] - xl) / (xr - xl) * (w - 1) + 0.5);
+          y1 = (int)((y[i + 1] - yb) / (yt - yb) * (h - 1) + 0.5);
+          m = line(x0, y0, x1, y1, w, h, bins);
+          accumulate(canvas, count, value, m, bins, NULL, weights ? weights[i] : 1);
+        }
+    }
+  free(bins);
+}
+
+static void accumulate_task(void *arg, int start, int end)
+{
+  shade_job_t *job = (shade_job_t *)arg;
+  shade_canvas_t *canvas = job->canvas;
+  int n = job->lines ? job->n - 1 : job->n;
+  int task, first, last;
+  unsigned int *count;
+  double *value;
+
+  for (task = start; task < end; task++)
+    {
+      first = (int)((double)n * task / job->num_tasks);
+      last = (int)((double)n * (task + 1) / job->num_tasks);
+      count = task == 0 ? canvas->count : canvas->partial_count[task - 1];
+      value = task == 0 ? canvas->value : canvas->partial_value[task - 1];
+      if (job->lines)
+        accumulate_lines(canvas, count, value, first, last, job->x, job->y, job->weights);
+      else
+        accumulate_points(canvas, count, value, last - first, job->x + first, job->y + first,
+                          job->weights ? job->weights + first : NULL);
+    }
+}
+
+static void merge_task(void *arg, int start, int end)
+{
+  shade_job_t *job = (shade_job_t *)arg;
+  shade_canvas_t *canvas = job->canvas;
+  int task, i;
+
+  for (task = 1; task < job->num_tasks; task++)
+    {
+      unsigned int *count = canvas->partial_count[task - 1];
+      double *value = canvas->partial_value[task - 1];
+      for (i = start; i < end; i++)
+        {
+          if (count[i] == 0) continue;
+          if (canvas->reduction == GR_SHADE_MAX)
+            {
+              if (value[i] > canvas->value[i]) canvas->value[i] = value[i];
+            }
+          else if (canvas->reduction != GR_SHADE_COUNT)
+            canvas->value[i] += value[i];
+          canvas->count[i] += count[i];
+          count[i] = 0;
+        }
+      if (value) reset_values(canvas, value, start, end);
+    }
+}
+
+shade_canvas_t *shade_canvas_create(const double *roi, int w, int h, int reduction)
+{
+  shade_canvas_t *canvas;
+  int i;
+
+  canvas = (shade_canvas_t *)xcalloc(1, sizeof(shade_canvas_t));
+  for (i = 0; i < 4; i++) canvas->roi[i] = roi[i];
+  canvas->w = w;
+  canvas->h = h;
+  canvas->reduction = reduction;
+  canvas->count = (unsigned int *)xcalloc(w * h + 1, sizeof(unsigned int));
+  if (reduction != GR_SHADE_COUNT)
+    {
+      canvas->value = (double *)xcalloc(w * h + 1, sizeof(double));
+      reset_values(canvas, canvas->value, 0, w * h);
+    }
+
+  return canvas;
+}
+
+void shade_canvas_delete(shade_canvas_t *canvas)
+{
+  int i;
+
+  for (i = 0; i < canvas->num_partials; i++)
+    {
+      free(canvas->partial_count[i]);
+      free(canvas->partial_value[i]);
+    }
+  free(canvas->partial_count);
+  free(canvas->partial_value);
+  free(canvas->count);
+  free(canvas->count_base);
+  free(canvas->value);
+  free(canvas);
+}
+
+void shade_canvas_clear(shade_canvas_t *canvas)
+{
+  int i, num_bins = canvas->w * canvas->h;
+
+  for (i = 0; i < num_bins; i++) canvas->count[i] = 0;
+  free(canvas->count_base);
+  canvas->count_base = NULL;
+  canvas->pending = 0;
+  if (canvas->value) reset_values(canvas, canvas->value, 0, num_bins);
+}
+
+void shade_canvas_add(shade_canvas_t *canvas, int n, const double *x, const double *y, const double *weights,
+                      int lines)
+{
+  /*
+   * Aggregate a batch of points (or the line segments between them if `lines` is 1) into the canvas. Large batches
+   * are split between threads.
+   */
+  shade_job_t job;
+  int num_bins = canvas->w * canvas->h;
+
+  if (n < 1 || (lines && n < 2)) return;
+
+  /* every point or segment adds at most 1 to a bin */
+  if (canvas->pending + n > UINT32_MAX)
+    {
+      int i;
+
+      if (canvas->count_base == NULL) canvas->count_base = (double *)xcalloc(num_bins, sizeof(double));
+      for (i = 0; i < num_bins; i++)
+        {
+          canvas->count_base[i] += canvas->count[i];
+          canvas->count[i] = 0;
+        }
+      canvas->pending = 0;
+    }
+  canvas->pending += n;
+
+  job.canvas = canvas;
+  job.n = n;
+  job.x = x;
+  job.y = y;
+  job.weights = weights;
+  job.lines = lines;
+  job.num_tasks = gr_parallel_threads(n, SHADE_MIN_POINTS_PER_THREAD);
+
+  if (job.num_tasks - 1 > canvas->num_partials)
+    {
+      canvas->partial_count =
+          (unsigned int **)xrealloc(canvas->partial_count, (job.num_tasks - 1) * sizeof(unsigned int *));
+      canvas->partial_value = (double **)xrealloc(canvas->partial_value, (job.num_tasks - 1) * sizeof(double *));
+      while (canvas->num_partials < job.num_tasks - 1)
         {
-          ix = (int)((x[i] - xl) / (xr - xl) * (w - 1) + 0.5);
-          iy = (int)((y[i] - yb) / (yt - yb) * (h - 1) + 0.5);
-          bins[(h - iy - 1) * w + ix] += 1;
+          canvas->partial_count[canvas->num_partials] = (unsigned int *)xcalloc(num_bins + 1, sizeof(unsigned int));
+          canvas->partial_value[canvas->num_partials] = NULL;
+          if (canvas->value)
+            {
+              canvas->partial_value[canvas->num_partials] = (double *)xcalloc(num_bins + 1, sizeof(double));
+              reset_values(canvas, canvas->partial_value[canvas->num_partials], 0, num_bins);
+            }
+          canvas->num_partials++;
         }
     }
+
+  gr_parallel_for(job.num_tasks, 1, accumulate_task, &job);
+  if (job.num_tasks > 1) gr_parallel_for(num_bins, SHADE_MIN_BINS_PER_THREAD, merge_task, &job);
+}
+
+void shade_canvas_size(const shade_canvas_t *canvas, double *roi, int *w, int *h)
+{
+  int i;
+
+  for (i = 0; i < 4; i++) roi[i] = canvas->roi[i];
+  *w = canvas->w;
+  *h = canvas->h;
+}
+
+void shade_canvas_values(const shade_canvas_t *canvas, double *values)
+{
+  /*
+   * Store the reduced value of each bin in `values`. Bins without any points have the value 0 (NaN for the mean
+   * and the maximum).
+   */
+  int i, num_bins = canvas->w * canvas->h;
+
+  for (i = 0; i < num_bins; i++)
+    {
+      if (canvas->reduction == GR_SHADE_COUNT)
+        values[i] = bin_count(canvas, i);
+      else if (canvas->reduction == GR_SHADE_SUM)
+        values[i] = canvas->value[i];
+      else if (bin_count(canvas, i) == 0)
+        values[i] = NAN;
+      else if (canvas->reduction == GR_SHADE_MEAN)
+        values[i] = canvas->value[i] / bin_count(canvas, i);
+      else
+        values[i] = canvas->value[i];
+    }
 }
 
 static void equalize(int w, int h, int *bins, int bmin, int bmax)
@@ -128,120 +563,227 @@ static void shade(int w, int h, int *bins, int xform)
   for (i = 0; i < num_bins; i++) bins[i] += 1000;
 }
 
-static void lineLow(int x0, int y0, int x1, int y1, int w, int h, int *bins)
+void shade_canvas_render(const shade_canvas_t *canvas, int xform, int *bins)
 {
-  int dx = x1 - x0;
-  int dy = y1 - y0;
-  int yi = 1;
-  int y = y0;
-  int D, x;
-
-  if (dy < 0)
-    {
-      yi = -1;
-      dy = -dy;
-    }
-  D = 2 * dy - dx;
+  /*
+   * Shade the canvas with the transformation `xform` into the color indices `bins`. Counts are used as they are,
+   * other reductions (and counts too large for the histogram equalization) are quantized to SHADE_LEVELS levels
+   * with 0 for empty bins.
+   */
+  int i, num_bins = canvas->w * canvas->h, quantize = 1;
+  double vmin = DBL_MAX, vmax = -DBL_MAX, v;
+  double *values;
+
+  values = (double *)xcalloc(num_bins, sizeof(double));
+  shade_canvas_values(canvas, values);
+  for (i = 0; i < num_bins; i++)
+    if (bin_count(canvas, i) > 0)
+      {
+        if (values[i] < vmin) vmin = values[i];
+        if (values[i] > vmax) vmax = values[i];
+      }
+  if (canvas->reduction == GR_SHADE_COUNT)
+    quantize = xform == XFORM_EQUALIZED ? vmax >= SHADE_LEVELS : vmax >= INT32_MAX;
 
-  for (x = x0; x <= x1; x++)
+  for (i = 0; i < num_bins; i++)
     {
-      bins[(h - y - 1) * w + x] += 1;
-      if (D > 0)
+      if (bin_count(canvas, i) == 0)
+        bins[i] = 0;
+      else if (!quantize)
+        bins[i] = (int)values[i];
+      else
         {
-          y += yi;
-          D -= 2 * dx;
+          v = vmax > vmin ? (values[i] - vmin) / (vmax - vmin) : 1;
+          bins[i] = 1 + (int)(v * (SHADE_LEVELS - 1));
         }
-      D += 2 * dy;
     }
+  free(values);
+
+  shade(canvas->w, canvas->h, bins, xform);
 }
 
-static void lineHigh(int x0, int y0, int x1, int y1, int w, int h, int *bins)
+uint64_t shade_checksum(int n, const double *x, const double *y)
 {
-  int dx = x1 - x0;
-  int dy = y1 - y0;
-  int xi = 1;
-  int x = x0;
-  int D, y;
+  /*
+   * Compute a Fletcher-style checksum of the bit patterns of the coordinates, which also changes if points are
+   * reordered. It is used to detect modified data much faster than it could be aggregated again.
+   */
+  uint64_t a = (uint64_t)n, b = 0, bits;
+  int i;
 
-  if (dx < 0)
+  for (i = 0; i < n; i++)
     {
-      xi = -1;
-      dx = -dx;
+      memcpy(&bits, x + i, sizeof(uint64_t));
+      a += bits;
+      b += a;
+      memcpy(&bits, y + i, sizeof(uint64_t));
+      a += bits;
+      b += a;
     }
-  D = 2 * dx - dy;
+  return a ^ (b << 1 | b >> 63);
+}
 
-  for (y = y0; y <= y1; y++)
+shade_pyramid_t *shade_pyramid_create(int n, const double *x, const double *y)
+{
+  /*
+   * Sort the points into the cells of the finest level with a counting sort and sum up the coarser levels. Points
+   * with NaN or infinite coordinates are left out, they are never inside a region of interest.
+   */
+  shade_pyramid_t *pyramid;
+  double x1 = -DBL_MAX, y1 = -DBL_MAX;
+  int *cell, *offset, i, l, size, num_cells, num_points = 0;
+
+  pyramid = (shade_pyramid_t *)xcalloc(1, sizeof(shade_pyramid_t));
+  pyramid->x0 = DBL_MAX;
+  pyramid->y0 = DBL_MAX;
+  for (i = 0; i < n; i++)
+    if (x[i] >= -DBL_MAX && x[i] <= DBL_MAX && y[i] >= -DBL_MAX && y[i] <= DBL_MAX)
+      {
+        if (x[i] < pyramid->x0) pyramid->x0 = x[i];
+        if (x[i] > x1) x1 = x[i];
+        if (y[i] < pyramid->y0) pyramid->y0 = y[i];
+        if (y[i] > y1) y1 = y[i];
+        num_points++;
+      }
+  if (num_points == 0)
     {
-      bins[(h - y - 1) * w + x] += 1;
-      if (D > 0)
-        {
-          x += xi;
-          D -= 2 * dy;
-        }
-      D += 2 * dx;
+      pyramid->x0 = pyramid->y0 = x1 = y1 = 0;
     }
-}
 
-static void line(int x0, int y0, int x1, int y1, int w, int h, int *bins)
-{
-  if (abs(y1 - y0) < abs(x1 - x0))
+  while (pyramid->depth < PYRAMID_MAX_DEPTH &&
+         (double)(1 << (2 * pyramid->depth + 2)) * PYRAMID_POINTS_PER_CELL <= num_points)
+    pyramid->depth++;
+  size = 1 << pyramid->depth;
+  num_cells = size * size;
+  pyramid->cell_width = x1 > pyramid->x0 ? (x1 - pyramid->x0) / size : 1;
+  pyramid->cell_height = y1 > pyramid->y0 ? (y1 - pyramid->y0) / size : 1;
+
+  pyramid->x = (double *)xcalloc(num_points > 0 ? num_points : 1, sizeof(double));
+  pyramid->y = (double *)xcalloc(num_points > 0 ? num_points : 1, sizeof(double));
+  pyramid->offset = (int *)xcalloc(num_cells + 1, sizeof(int));
+  pyramid->count = (int **)xcalloc(pyramid->depth + 1, sizeof(int *));
+  for (l = 0; l <= pyramid->depth; l++) pyramid->count[l] = (int *)xcalloc(1 << (2 * l), sizeof(int));
+
+  cell = (int *)xcalloc(n > 0 ? n : 1, sizeof(int));
+  for (i = 0; i < n; i++)
     {
-      if (x0 > x1)
-        lineLow(x1, y1, x0, y0, w, h, bins);
+      if (x[i] >= -DBL_MAX && x[i] <= DBL_MAX && y[i] >= -DBL_MAX && y[i] <= DBL_MAX)
+        {
+          int cx = (int)((x[i] - pyramid->x0) / pyramid->cell_width);
+          int cy = (int)((y[i] - pyramid->y0) / pyramid->cell_height);
+          if (cx >= size) cx = size - 1;
+          if (cy >= size) cy = size - 1;
+          cell[i] = cy * size + cx;
+          pyramid->count[pyramid->depth][cell[i]]++;
+        }
       else
-        lineLow(x0, y0, x1, y1, w, h, bins);
+        cell[i] = -1;
     }
-  else
+  offset = (int *)xcalloc(num_cells, sizeof(int));
+  for (i = 0; i < num_cells; i++)
     {
-      if (y0 > y1)
-        lineHigh(x1, y1, x0, y0, w, h, bins);
-      else
-        lineHigh(x0, y0, x1, y1, w, h, bins);
+      pyramid->offset[i + 1] = pyramid->offset[i] + pyramid->count[pyramid->depth][i];
+      offset[i] = pyramid->offset[i];
     }
+  for (i = 0; i < n; i++)
+    if (cell[i] >= 0)
+      {
+        int k = offset[cell[i]]++;
+        pyramid->x[k] = x[i];
+        pyramid->y[k] = y[i];
+      }
+  free(offset);
+  free(cell);
+
+  for (l = pyramid->depth - 1; l >= 0; l--)
+    {
+      int s = 1 << l, cx, cy;
+      for (cy = 0; cy < s; cy++)
+        for (cx = 0; cx < s; cx++)
+          {
+            int *fine = pyramid->count[l + 1] + 2 * cy * 2 * s + 2 * cx;
+            pyramid->count[l][cy * s + cx] = fine[0] + fine[1] + fine[2 * s] + fine[2 * s + 1];
+          }
+    }
+
+  return pyramid;
 }
 
-void gr_shade(int n, double *x, double *y, int lines, int xform, double *roi, int w, int h, int *bins)
+void shade_pyramid_delete(shade_pyramid_t *pyramid)
 {
-  double xl, xr, yb, yt;
-  int i, j, x0, y0, x1, y1, num_bins = w * h;
+  int l;
+
+  for (l = 0; l <= pyramid->depth; l++) free(pyramid->count[l]);
+  free(pyramid->count);
+  free(pyramid->offset);
+  free(pyramid->x);
+  free(pyramid->y);
+  free(pyramid);
+}
 
-  if (lines == 1)
+static void pyramid_aggregate(const shade_pyramid_t *pyramid, shade_canvas_t *canvas, int level, int cx, int cy)
+{
+  /*
+   * Aggregate the points of a cell of level `level` into the canvas. The bin coordinate computed by `gr_shade` is
+   * monotonic in the point coordinate (every floating point operation involved is), so if both corners of a cell
+   * are inside of the region of interest and fall into the same bin, all of its points do and the cell is counted
+   * as a whole. Otherwise it is split up, and the points of split up cells of the finest level are aggregated one
+   * by one. The cell bounds are widened slightly to include points that were sorted into a neighboring cell by
+   * rounding errors.
+   */
+  double xl = canvas->roi[0], xr = canvas->roi[1], yb = canvas->roi[2], yt = canvas->roi[3];
+  int w = canvas->w, h = canvas->h, s = 1 << (pyramid->depth - level), size = 1 << level;
+  double ex = 1e-6 * pyramid->cell_width, ey = 1e-6 * pyramid->cell_height;
+  double lo_x = pyramid->x0 + cx * s * pyramid->cell_width - ex;
+  double hi_x = pyramid->x0 + (cx + 1) * s * pyramid->cell_width + ex;
+  double lo_y = pyramid->y0 + cy * s * pyramid->cell_height - ey;
+  double hi_y = pyramid->y0 + (cy + 1) * s * pyramid->cell_height + ey;
+  int count = pyramid->count[level][cy * size + cx];
+
+  if (count == 0 || hi_x < xl || lo_x > xr || hi_y < yb || lo_y > yt) return;
+
+  if (lo_x >= xl && hi_x <= xr && lo_y >= yb && hi_y <= yt)
     {
-      xl = roi[0];
-      xr = roi[1];
-      yb = roi[2];
-      yt = roi[3];
-
-      for (i = 0; i < num_bins; i++) bins[i] = 0;
-
-      i = 0;
-      while (i < n)
+      int ix = (int)((lo_x - xl) / (xr - xl) * (w - 1) + 0.5), iy = (int)((lo_y - yb) / (yt - yb) * (h - 1) + 0.5);
+      if (ix == (int)((hi_x - xl) / (xr - xl) * (w - 1) + 0.5) &&
+          iy == (int)((hi_y - yb) / (yt - yb) * (h - 1) + 0.5))
         {
-          j = i + 1;
-          while (j < n && !is_nan(x[j]) && !is_nan(y[j])) j++;
-          j--;
-
-          while (i < j)
-            {
-              if (x[i] >= xl && x[i] <= xr && y[i] >= yb && y[i] <= yt && x[i + 1] >= xl && x[i + 1] <= xr &&
-                  y[i + 1] >= yb && y[i + 1] <= yt)
-                {
-                  x0 = (int)((x[i] - xl) / (xr - xl) * (w - 1) + 0.5);
-                  y0 = (int)((y[i] - yb) / (yt - yb) * (h - 1) + 0.5);
-                  x1 = (int)((x[i + 1] - xl) / (xr - xl) * (w - 1) + 0.5);
-                  y1 = (int)((y[i + 1] - yb) / (yt - yb) * (h - 1) + 0.5);
-                  line(x0, y0, x1, y1, w, h, bins);
-                }
-              i++;
-            }
-
-          i += 2;
+          canvas->count[(h - iy - 1) * w + ix] += count;
+          return;
         }
     }
+
+  if (level < pyramid->depth)
+    {
+      pyramid_aggregate(pyramid, canvas, level + 1, 2 * cx, 2 * cy);
+      pyramid_aggregate(pyramid, canvas, level + 1, 2 * cx + 1, 2 * cy);
+      pyramid_aggregate(pyramid, canvas, level + 1, 2 * cx, 2 * cy + 1);
+      pyramid_aggregate(pyramid, canvas, level + 1, 2 * cx + 1, 2 * cy + 1);
+    }
   else
     {
-      rasterize(n, x, y, roi, w, h, bins);
+      int start = pyramid->offset[cy * size + cx];
+      accumulate_points(canvas, canvas->count, canvas->value, count, pyramid->x + start, pyramid->y + start, NULL);
     }
+}
+
+void shade_pyramid_aggregate(const shade_pyramid_t *pyramid, shade_canvas_t *canvas)
+{
+  /*
+   * Aggregate all points of the pyramid into an empty canvas counting points. Only the cells at the edges of the
+   * bins have to be split up, so the cost depends on the number of bins rather than on the number of points unless
+   * the bins are smaller than the cells of the finest level.
+   */
+  pyramid_aggregate(pyramid, canvas, 0, 0, 0);
+  canvas->pending = pyramid->offset[1 << (2 * pyramid->depth)];
+}
+
+void gr_shade(int n, double *x, double *y, int lines, int xform, double *roi, int w, int h, int *bins)
+{
+  shade_canvas_t *canvas;
 
-  shade(w, h, bins, xform);
+  canvas = shade_canvas_create(roi, w, h, GR_SHADE_COUNT);
+  shade_canvas_add(canvas, n, x, y, NULL, lines == 1);
+  shade_canvas_render(canvas, xform, bins);
+  shade_canvas_delete(canvas);
 }
@@ -0,0 +1,31 @@
+#ifndef _SHADE_H_
+#define _SHADE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shade_canvas_t shade_canvas_t;
+typedef struct shade_pyramid_t shade_pyramid_t;
+
+shade_canvas_t *shade_canvas_create(const double *roi, int w, int h, int reduction);
+void shade_canvas_delete(shade_canvas_t *canvas);
+void shade_canvas_clear(shade_canvas_t *canvas);
+void shade_canvas_add(shade_canvas_t *canvas, int n, const double *x, const double *y, const double *weights,
+                      int lines);
+void shade_canvas_size(const shade_canvas_t *canvas, double *roi, int *w, int *h);
+void shade_canvas_values(const shade_canvas_t *canvas, double *values);
+void shade_canvas_render(const shade_canvas_t *canvas, int xform, int *bins);
+
+uint64_t shade_checksum(int n, const double *x, const double *y);
+shade_pyramid_t *shade_pyramid_create(int n, const double *x, const double *y);
+void shade_pyramid_delete(shade_pyramid_t *pyramid);
+void shade_pyramid_aggregate(const shade_pyramid_t *pyramid, shade_canvas_t *canvas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gr.h"
+
+#define N 2000
+
+static double x[2 * N], y[2 * N];
+static int contour[4 * N + 1], duplicated_contour[4 * N + 1];
+
+static double random_number(void)
+{
+  static unsigned long state = 1;
+
+  state = (state * 1103515245 + 12345) & 0x7fffffff;
+  return state / 2147483648.0;
+}
+
+static int test_duplicated_points(void)
+{
+  int i, n, m, failures = 0;
+
+  for (i = 0; i < N; i++)
+    {
+      x[i] = x[N + i] = random_number();
+      y[i] = y[N + i] = random_number();
+    }
+
+  n = gr_findboundary(N, x, y, 0.05, NULL, 4 * N + 1, contour);
+  m = gr_findboundary(2 * N, x, y, 0.05, NULL, 4 * N + 1, duplicated_contour);
+  if (n <= 0 || m != n)
+    {
+      printf("duplicated points: %d instead of %d boundary points\n", m, n);
+      return 1;
+    }
+  for (i = 0; i <= n; i++)
+    {
+      /* only the first of the coincident points is used */
+      if (duplicated_contour[i] != contour[i])
+        {
+          printf("duplicated points: boundary point %d is %d instead of %d\n", i, duplicated_contour[i], contour[i]);
+          failures++;
+        }
+    }
+
+  /* the contour needs room for the repeated first index */
+  if (gr_findboundary(N, x, y, 0.05, NULL, n + 1, contour) != n)
+    {
+      printf("contour of %d indices is too small\n", n + 1);
+      failures++;
+    }
+  if (gr_findboundary(N, x, y, 0.05, NULL, n, contour) != 0)
+    {
+      printf("contour of %d indices is large enough\n", n);
+      failures++;
+    }
+
+  return failures;
+}
+
+static int test_coincident_points(void)
+{
+  int i;
+
+  for (i = 0; i < 10; i++)
+    {
+      x[i] = 0.5;
+      y[i] = 0.5;
+    }
+  if (gr_findboundary(10, x, y, 0, NULL, 21, contour) != 0)
+    {
+      printf("coincident points: boundary found\n");
+      return 1;
+    }
+  return 0;
+}
+
+int main(void)
+{
+  int failures;
+
+  failures = test_duplicated_points() + test_coincident_points();
+  printf("%d failures\n", failures);
+
+  return failures != 0;
+}
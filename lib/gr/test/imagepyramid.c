@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gr.h"
+
+#define STREAM "imagepyramid.xml"
+
+#define OPTION_X_LOG (1 << 0)
+#define OPTION_Y_LOG (1 << 1)
+
+typedef struct
+{
+  double xmin, xmax, ymin, ymax;
+  int width, height;
+  unsigned long checksum;
+} drawn_image_t;
+
+static int *create_image(int width, int height)
+{
+  int *data = (int *)malloc(width * height * sizeof(int)), i;
+
+  for (i = 0; i < width * height; i++)
+    {
+      data[i] = (255 << 24) | ((i % width * 255 / width) << 16) | ((i / width * 255 / height) << 8) | (i * 7 & 0xff);
+    }
+  return data;
+}
+
+/* Read the n-th drawimage element of the graphics stream */
+static int read_image(int n, drawn_image_t *image)
+{
+  FILE *fp = fopen(STREAM, "r");
+  char tag[11];
+  int c, found = 0, i = 0;
+
+  if (fp == NULL) return 0;
+  while (!found && (c = fgetc(fp)) != EOF)
+    {
+      if (c != '<') continue;
+      if (fgets(tag, sizeof(tag), fp) == NULL) break;
+      if (strcmp(tag, "drawimage ") != 0 || i++ < n) continue;
+      if (fscanf(fp, "xmin=\"%lg\" xmax=\"%lg\" ymin=\"%lg\" ymax=\"%lg\" width=\"%d\" height=\"%d\"", &image->xmin,
+                 &image->xmax, &image->ymin, &image->ymax, &image->width, &image->height) != 6)
+        break;
+      image->checksum = 0;
+      while ((c = fgetc(fp)) != EOF && c != '>')
+        {
+          image->checksum = image->checksum * 31 + c;
+        }
+      found = 1;
+    }
+  fclose(fp);
+  return found;
+}
+
+static int same_image(const drawn_image_t *a, const drawn_image_t *b)
+{
+  return a->xmin == b->xmin && a->xmax == b->xmax && a->ymin == b->ymin && a->ymax == b->ymax &&
+         a->width == b->width && a->height == b->height && a->checksum == b->checksum;
+}
+
+static int test_orientations(int log_axes)
+{
+  static const double rects[4][4] = {{2, 90, 3, 80}, {90, 2, 3, 80}, {2, 90, 80, 3}, {90, 2, 80, 3}};
+  int width = 40, height = 30, *data = create_image(width, height), pyramid, i, failures = 0;
+  drawn_image_t direct, reduced;
+
+  pyramid = gr_createimagepyramid(width, height, data, 0);
+  gr_setviewport(0.1, 0.9, 0.1, 0.9);
+  gr_setwindow(1, 100, 1, 100);
+  gr_setscale(log_axes ? OPTION_X_LOG | OPTION_Y_LOG : 0);
+  for (i = 0; i < 4; i++)
+    {
+      /* a small image is drawn completely at full resolution, so it must be passed on unchanged */
+      gr_begingraphics(STREAM);
+      gr_drawimage(rects[i][0], rects[i][1], rects[i][2], rects[i][3], width, height, data, 0);
+      gr_drawimagepyramid(pyramid, rects[i][0], rects[i][1], rects[i][2], rects[i][3]);
+      gr_endgraphics();
+      if (!read_image(0, &direct) || !read_image(1, &reduced) || !same_image(&direct, &reduced))
+        {
+          printf("%s axes, rectangle %d: pyramid differs from gr_drawimage\n", log_axes ? "log" : "linear", i);
+          failures++;
+        }
+    }
+  gr_setscale(0);
+  gr_destroyimagepyramid(pyramid);
+  free(data);
+  return failures;
+}
+
+static int test_crop(int log_axes)
+{
+  int width = 4000, height = 3000, *data = create_image(width, height), pyramid, failures = 0;
+  drawn_image_t image;
+
+  pyramid = gr_createimagepyramid(width, height, data, 0);
+  gr_setviewport(0.1, 0.9, 0.1, 0.9);
+  gr_setwindow(30, 60, 30, 60);
+  gr_setscale(log_axes ? OPTION_X_LOG | OPTION_Y_LOG : 0);
+  gr_begingraphics(STREAM);
+  gr_drawimagepyramid(pyramid, 100, 0, 100, 0);
+  gr_endgraphics();
+  gr_setscale(0);
+  if (!read_image(0, &image))
+    {
+      printf("%s crop: no image drawn\n", log_axes ? "log" : "linear");
+      failures++;
+    }
+  else
+    {
+      /* the mirrored part covering the window is drawn, at a reduced resolution */
+      if (!(image.xmin > image.xmax && image.ymin > image.ymax))
+        {
+          printf("%s crop: mirrored image is no longer mirrored\n", log_axes ? "log" : "linear");
+          failures++;
+        }
+      if (image.xmax > 30 || image.xmin < 60 || image.ymax > 30 || image.ymin < 60)
+        {
+          printf("%s crop: drawn part [%g, %g] x [%g, %g] does not cover the window\n", log_axes ? "log" : "linear",
+                 image.xmax, image.xmin, image.ymax, image.ymin);
+          failures++;
+        }
+      if (image.width >= width * 0.3 + 2 || image.height >= height * 0.3 + 2)
+        {
+          printf("%s crop: %d x %d pixels drawn\n", log_axes ? "log" : "linear", image.width, image.height);
+          failures++;
+        }
+    }
+  gr_destroyimagepyramid(pyramid);
+  free(data);
+  return failures;
+}
+
+int main(void)
+{
+  int failures;
+
+  failures = test_orientations(0) + test_orientations(1) + test_crop(0) + test_crop(1);
+  remove(STREAM);
+  printf("%d failures\n", failures);
+
+  return failures != 0;
+}
@@ -6,6 +6,8 @@
 #include <assert.h>
 #include <math.h>
 
+#include "gkscore.h"
+
 #define MAX(a, b) (a) > (b) ? (a) : (b)
 
 typedef enum
@@ -201,8 +203,8 @@ static void increaseNominator(formula_t **formula, formula_t *denom, int font, i
 */
 
 
-static token_t token;
-static char *chin;
+static GKS_THREAD_LOCAL token_t token;
+static GKS_THREAD_LOCAL char *chin;
 
 static bool Expression(formula_t **, int font, int prec);
 static bool simpleExpression(formula_t **, int font, int prec);
@@ -701,7 +703,7 @@ static bool Expression(formula_t **formula, int font, int prec)
 #define FRAC_WIDTH_FACTOR (1. / 10.)
 #define FRAC_PAINT FRAC_THICK *PAINT_FAC
 
-static double sinphi, cosphi;
+static GKS_THREAD_LOCAL double sinphi, cosphi;
 
 static double scales[] = {
     1.0,       /* SUB_LEVEL */
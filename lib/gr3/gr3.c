@@ -389,6 +389,7 @@ static int gr3_extensionsupported_(const char *extension_name)
  */
 GR3API void gr3_terminate(void)
 {
+  gr3_terminatepick_();
   if (context_struct_.gl_is_initialized)
     {
 #ifdef GR3_CAN_USE_VBO
@@ -468,6 +469,7 @@ GR3API int gr3_clear(void)
   if (context_struct_.is_initialized)
     {
       GR3_DrawList_t_ *draw;
+      gr3_invalidatepick_();
       while (context_struct_.draw_list_)
         {
           draw = context_struct_.draw_list_;
@@ -568,6 +570,7 @@ static void gr3_getfirstfreemesh(int *mesh)
           context_struct_.mesh_list_[context_struct_.mesh_list_capacity_].data.number_of_vertices = 0;
           context_struct_.mesh_list_[context_struct_.mesh_list_capacity_].data.number_of_indices = 0;
           context_struct_.mesh_list_[context_struct_.mesh_list_capacity_].data.vertices_fp = NULL;
+          context_struct_.mesh_list_[context_struct_.mesh_list_capacity_].data.bvh = NULL;
           context_struct_.mesh_list_capacity_++;
         }
     }
@@ -1032,6 +1035,7 @@ GR3API void gr3_drawmesh(int mesh, int n, const float *positions, const float *d
   draw->object_id = current_object_id;
   draw->next = NULL;
   gr3_meshaddreference_(mesh);
+  gr3_invalidatepick_();
   if (context_struct_.draw_list_ == NULL)
     {
       context_struct_.draw_list_ = draw;
@@ -1286,6 +1290,7 @@ static void gr3_meshremovereference_(int mesh)
       free(context_struct_.mesh_list_[mesh].data.vertices);
       free(context_struct_.mesh_list_[mesh].data.normals);
       free(context_struct_.mesh_list_[mesh].data.colors);
+      gr3_deletemeshbvh_(mesh);
       context_struct_.mesh_list_[mesh].data.data.display_list_id = 0;
       context_struct_.mesh_list_[mesh].refcount = 0;
       context_struct_.mesh_list_[mesh].marked_for_deletion = 0;
@@ -1561,6 +1566,63 @@ static void gr3_projectionmatrix_(float left, float right, float bottom, float t
     }
 }
 
+/*!
+ * Invert a 4x4 matrix using Gauss-Jordan elimination with partial pivoting. Returns 0 if the matrix is singular.
+ */
+int gr3_invertmatrix_(const float *matrix, double *inverse)
+{
+  double a[4][8], factor, tmp;
+  int i, j, k, pivot;
+
+  for (i = 0; i < 4; i++)
+    {
+      for (j = 0; j < 4; j++)
+        {
+          a[i][j] = matrix[i + j * 4];
+          a[i][j + 4] = (i == j);
+        }
+    }
+  for (i = 0; i < 4; i++)
+    {
+      pivot = i;
+      for (j = i + 1; j < 4; j++)
+        {
+          if (fabs(a[j][i]) > fabs(a[pivot][i])) pivot = j;
+        }
+      if (a[pivot][i] == 0) return 0;
+      for (k = 0; k < 8; k++)
+        {
+          tmp = a[i][k];
+          a[i][k] = a[pivot][k];
+          a[pivot][k] = tmp;
+        }
+      factor = a[i][i];
+      for (k = 0; k < 8; k++)
+        {
+          a[i][k] /= factor;
+        }
+      for (j = 0; j < 4; j++)
+        {
+          if (j != i && a[j][i] != 0)
+            {
+              factor = a[j][i];
+              for (k = 0; k < 8; k++)
+                {
+                  a[j][k] -= factor * a[i][k];
+                }
+            }
+        }
+    }
+  for (i = 0; i < 4; i++)
+    {
+      for (j = 0; j < 4; j++)
+        {
+          inverse[i + j * 4] = a[i][j + 4];
+        }
+    }
+  return 1;
+}
+
 /*!
  * This function iterates over the draw list and draws the image using OpenGL.
  */
@@ -2336,38 +2398,27 @@ GR3API void gr3_setobjectid(int id)
   current_object_id = id;
 }
 
-static int gr3_selectiondraw_(int px, int py, GLuint width, GLuint height);
-#ifndef NO_GL
+/*!
+ * This function returns the object id of the frontmost object drawn at the
+ * pixel (px, py) of a width x height image of the scene, with the origin in
+ * the lower left corner. The pick ray is intersected with the drawn meshes
+ * on the CPU using bounding volume hierarchies (see gr3_select.c), so it
+ * works independent of the render path and the framebuffer size.
+ * \param [in] px         x coordinate of the pixel
+ * \param [in] py         y coordinate of the pixel
+ * \param [in] width      the width of the image
+ * \param [in] height     the height of the image
+ * \param [out] object_id the object id set with gr3_setobjectid() for the
+ *                        hit object or 0 if no object was hit
+ */
 GR3API int gr3_selectid(int px, int py, int width, int height, int *object_id)
 {
   int x, y;
-  int fb_width, fb_height;
-  int dx, dy;
-  int x_patches, y_patches;
   int view_matrix_all_zeros;
 
-  GLfloat zNear = context_struct_.zNear;
-  GLfloat zFar = context_struct_.zFar;
-  GLfloat left, right, bottom, top;
+  float zNear = context_struct_.zNear;
+  float left, right, bottom, top;
 
-  if (context_struct_.projection_type == GR3_PROJECTION_ORTHOGRAPHIC)
-    {
-      left = context_struct_.left;
-      right = context_struct_.right;
-      bottom = context_struct_.bottom;
-      top = context_struct_.top;
-    }
-  else
-    {
-      GLfloat fovy = context_struct_.vertical_field_of_view;
-      GLfloat tan_halffovy = tan(fovy * M_PI / 360.0);
-      GLfloat aspect = (GLfloat)width / height;
-      right = zNear * tan_halffovy * aspect;
-      left = -right;
-      top = zNear * tan_halffovy;
-      bottom = -top;
-    }
-  int id;
   GR3_DO_INIT;
   if (gr3_geterror(0, NULL, NULL)) return gr3_geterror(0, NULL, NULL);
 
@@ -2375,7 +2426,7 @@ GR3API int gr3_selectid(int px, int py, int width, int height, int *object_id)
 
   if (context_struct_.is_initialized)
     {
-      if (width == 0 || height == 0)
+      if (width <= 0 || height <= 0)
         {
           RETURN_ERROR(GR3_ERROR_INVALID_VALUE);
         }
@@ -2405,191 +2456,35 @@ GR3API int gr3_selectid(int px, int py, int width, int height, int *object_id)
           /* gr3_setcameraprojectionparameters or gr3_setorthographicprojection has not been called */
           RETURN_ERROR(GR3_ERROR_CAMERA_NOT_INITIALIZED);
         }
-
-      fb_width = context_struct_.init_struct.framebuffer_width;
-      fb_height = context_struct_.init_struct.framebuffer_height;
-
-#if GL_ARB_framebuffer_object
-      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-#else
-      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, framebuffer);
-#endif
-
-      x_patches = width / fb_width + (width / fb_width * fb_width < width);
-      y_patches = height / fb_height + (height / fb_height * fb_height < height);
-      for (y = 0; y < y_patches; y++)
+      if (px < 0 || px >= width || py < 0 || py >= height)
         {
-          for (x = 0; x < x_patches; x++)
-            {
-              if ((x + 1) * fb_width <= width)
-                {
-                  dx = fb_width;
-                }
-              else
-                {
-                  dx = width - fb_width * x;
-                }
-              if ((y + 1) * fb_height <= height)
-                {
-                  dy = fb_height;
-                }
-              else
-                {
-                  dy = height - fb_height * y;
-                }
-              if (px >= x * fb_width && px < x * fb_width + dx && py >= y * fb_height && py < y * fb_height + dy)
-                {
-                  {
-                    GLfloat projection_matrix[4][4] = {{0}};
-                    GLfloat l = left + 1.0f * (right - left) * (x * fb_width) / width;
-                    GLfloat r = left + 1.0f * (right - left) * (x * fb_width + dx) / width;
-                    GLfloat b = bottom + 1.0f * (top - bottom) * (y * fb_height) / height;
-                    GLfloat t = bottom + 1.0f * (top - bottom) * (y * fb_height + dy) / height;
-
-                    gr3_projectionmatrix_(l, r, b, t, zNear, zFar, &(projection_matrix[0][0]));
-                    context_struct_.projection_matrix = &projection_matrix[0][0];
-                    glViewport(0, 0, dx, dy);
-                    id = gr3_selectiondraw_(px - x * fb_width, py - y * fb_height, width, height);
-                    context_struct_.projection_matrix = NULL;
-                    if (id != 0)
-                      {
-                        *object_id = id;
-                      }
-                  }
-                }
-            }
+          RETURN_ERROR(GR3_ERROR_NONE);
         }
-      if (glGetError() == GL_NO_ERROR)
+
+      if (context_struct_.projection_type == GR3_PROJECTION_ORTHOGRAPHIC)
         {
-          RETURN_ERROR(GR3_ERROR_NONE);
+          left = context_struct_.left;
+          right = context_struct_.right;
+          bottom = context_struct_.bottom;
+          top = context_struct_.top;
         }
       else
         {
-          RETURN_ERROR(GR3_ERROR_OPENGL_ERR);
+          float fovy = context_struct_.vertical_field_of_view;
+          float tan_halffovy = tan(fovy * M_PI / 360.0);
+          float aspect = (float)width / height;
+          right = zNear * tan_halffovy * aspect;
+          left = -right;
+          top = zNear * tan_halffovy;
+          bottom = -top;
         }
+      return gr3_selectid_raycast_(px, py, width, height, left, right, bottom, top, object_id);
     }
   else
     {
       RETURN_ERROR(GR3_ERROR_NOT_INITIALIZED);
     }
 }
-#endif
-
-#ifndef NO_GL
-static int gr3_selectiondraw_(int px, int py, GLuint width, GLuint height)
-{
-  int object_id = 0;
-  unsigned int color;
-
-#ifdef GR3_CAN_USE_VBO
-  if (context_struct_.use_vbo)
-    {
-      glUseProgram(context_struct_.program);
-    }
-#endif
-  gr3_log_("gr3_draw_();");
-  {
-    GLfloat projection_matrix[4][4] = {{0}};
-    GLfloat *pm;
-    if (context_struct_.projection_matrix != NULL)
-      {
-        pm = context_struct_.projection_matrix;
-      }
-    else
-      {
-        GLfloat fovy = context_struct_.vertical_field_of_view;
-        GLfloat zNear = context_struct_.zNear;
-        GLfloat zFar = context_struct_.zFar;
-
-
-        {
-          /* Source: http://www.opengl.org/sdk/docs/man/xhtml/gluPerspective.xml */
-          GLfloat aspect = (GLfloat)width / height;
-          GLfloat f = 1 / tan(fovy * M_PI / 360.0);
-          projection_matrix[0][0] = f / aspect;
-          projection_matrix[1][1] = f;
-          projection_matrix[2][2] = (zFar + zNear) / (zNear - zFar);
-          projection_matrix[3][2] = 2 * zFar * zNear / (zNear - zFar);
-          projection_matrix[2][3] = -1;
-        }
-        pm = &projection_matrix[0][0];
-      }
-#ifdef GR3_CAN_USE_VBO
-    if (context_struct_.use_vbo)
-      {
-        glUniformMatrix4fv(glGetUniformLocation(context_struct_.program, "ProjectionMatrix"), 1, GL_FALSE, pm);
-      }
-    else
-#endif
-      {
-        glMatrixMode(GL_PROJECTION);
-        glLoadMatrixf(pm);
-      }
-
-#ifdef GR3_CAN_USE_VBO
-    if (context_struct_.use_vbo)
-      {
-        glUniformMatrix4fv(glGetUniformLocation(context_struct_.program, "ViewMatrix"), 1, GL_FALSE,
-                           &(context_struct_.view_matrix[0][0]));
-      }
-    else
-#endif
-      {
-        glMatrixMode(GL_MODELVIEW);
-        if (context_struct_.light_dir[0] == 0 && context_struct_.light_dir[1] == 0 && context_struct_.light_dir[2] == 0)
-          {
-            GLfloat def[4] = {0, 0, 1, 0};
-            glLoadIdentity();
-            glLightfv(GL_LIGHT0, GL_POSITION, &def[0]);
-          }
-        glLoadMatrixf(&(context_struct_.view_matrix[0][0]));
-      }
-#ifdef GR3_CAN_USE_VBO
-    if (context_struct_.use_vbo)
-      {
-        glUniform3f(glGetUniformLocation(context_struct_.program, "LightDirection"), context_struct_.light_dir[0],
-                    context_struct_.light_dir[1], context_struct_.light_dir[2]);
-      }
-#endif
-  }
-  glEnable(GL_NORMALIZE);
-  if (!context_struct_.use_vbo)
-    {
-      glEnable(GL_LIGHTING);
-      glEnable(GL_LIGHT0);
-      if (context_struct_.light_dir[0] != 0 || context_struct_.light_dir[1] != 0 || context_struct_.light_dir[2] != 0)
-        {
-          glLightfv(GL_LIGHT0, GL_POSITION, &context_struct_.light_dir[0]);
-        }
-    }
-  glClearColor(0, 0, 0, 0);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  {
-    GR3_DrawList_t_ *draw;
-    draw = context_struct_.draw_list_;
-    while (draw)
-      {
-        glClear(GL_COLOR_BUFFER_BIT);
-        gr3_dodrawmesh_(draw->mesh, draw->n, draw->positions, draw->directions, draw->ups, draw->colors, draw->scales);
-        color = 0;
-        glReadPixels(px, py, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &color);
-        if (color != 0)
-          {
-
-            object_id = draw->object_id;
-          }
-        draw = draw->next;
-      }
-  }
-#ifdef GR3_CAN_USE_VBO
-  if (context_struct_.use_vbo)
-    {
-      glUseProgram(0);
-    }
-#endif
-  return object_id;
-}
-#endif
 
 /*!
  * \param [out] m the 4x4 column major view matrix
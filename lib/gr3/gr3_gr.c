@@ -1,8 +1,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "gr.h"
 #include "gr3.h"
 #include "gr3_internals.h"
@@ -872,48 +874,147 @@ GR3API void gr3_drawtrianglesurface(int n, const float *positions)
   if (gr3_geterror(0, NULL, NULL)) return;
 }
 
+/* edge length of the macro-cells used for empty space skipping in the software volume renderer */
+#define VOLUME_CELL_SIZE 8
+/* edge length of the image tiles the software volume renderer distributes among its threads */
+#define VOLUME_TILE_SIZE 32
+/* transmittance below which 1 + transmittance equals 1 in single precision */
+#define VOLUME_MIN_TRANSMITTANCE 5.9604645e-08
+
+typedef struct
+{
+  int nx, ny, nz;
+  const float *data;
+  int gx, gy, gz;
+  float *cell_max;
+  float data_max;
+  int algorithm;
+  int width, height;
+  double inverse[16];
+  double camera_direction[3];
+  int perspective;
+  int n_samples;
+  float *pixel_data;
+  int next_tile, num_tiles;
+  pthread_mutex_t lock;
+} volume_job_t;
+
 /*!
- * Draw volume data using the given algorithm and apply the current GR colormap.
- *
- * \param [in]     nx         number of points in x-direction
- * \param [in]     ny         number of points in y-direction
- * \param [in]     nz         number of points in z-direction
- * \param [in]     data       an array of shape nx * ny * nz containing the intensities for each point
- * \param [in]     algorithm  the algorithm to reduce the volume data
- * \param [in,out] dmin_ptr   The variable this parameter points at will be used as minimum data value when applying the
- *                            colormap. If it is negative, the variable will be set to the actual occuring minimum and
- *                            that value will be used instead. If dmin_ptr is NULL, it will be ignored.
- * \param [in,out] dmax_ptr   The variable this parameter points at will be used as maximum data value when applying the
- *                            colormap. If it is negative, the variable will be set to the actual occuring maximum and
- *                            that value will be used instead. If dmax_ptr is NULL, it will be ignored.
- *
- * \verbatim embed:rst:leading-asterisk
- *
- * Available algorithms are:
- *
- * +---------------------+---+-----------------------------+
- * |GR_VOLUME_EMISSION   |  0|emission model               |
- * +---------------------+---+-----------------------------+
- * |GR_VOLUME_ABSORPTION |  1|absorption model             |
- * +---------------------+---+-----------------------------+
- * |GR_VOLUME_MIP        |  2|maximum intensity projection |
- * +---------------------+---+-----------------------------+
- *
- * \endverbatim
+ * Set up the projection and view matrices used to render the volume, following the current GR projection type.
  */
-GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, double *dmin_ptr, double *dmax_ptr)
+static void gr3_volume_matrices_(int width, int height, float *projection_matrix, float *view_matrix)
 {
+  double zmin, zmax;
+  int rotation, tilt, projection_type, i;
+  float fovy, zNear, zFar, aspect, tfov2;
+  float grmatrix[16];
+
+  gr_inqprojectiontype(&projection_type);
+
+  memset(projection_matrix, 0, 16 * sizeof(float));
+  if (projection_type == GR_PROJECTION_DEFAULT)
+    {
+      /* Set projection parameter like in `gr3_drawmesh_grlike` and create (orthographic) projection matrix */
+      fovy = 90.0f;
+      zNear = 1.0f;
+      zFar = 200.0f;
+      aspect = 1.0f * width / height;
+      tfov2 = (float)tan(fovy * M_PI / 360.0);
+      float right = zNear * aspect * tfov2;
+      float top = zNear * tfov2;
+
+      projection_matrix[0 + 0 * 4] = (float)1.0 / right; /* left = -right */
+      projection_matrix[0 + 3 * 4] = 0.0;
+      projection_matrix[1 + 1 * 4] = (float)1.0 / top; /* bottom = -top */
+      projection_matrix[1 + 3 * 4] = 0.0;
+      projection_matrix[2 + 2 * 4] = (float)-2.0 / (zFar - zNear);
+      projection_matrix[2 + 3 * 4] = -(zFar + zNear) / (zFar - zNear);
+      projection_matrix[3 + 3 * 4] = 1.0;
+    }
+  else if (projection_type == GR_PROJECTION_ORTHOGRAPHIC)
+    {
+      double near, far, left, right, bottom, top;
+      gr_inqorthographicprojection(&left, &right, &bottom, &top, &near, &far);
+
+      projection_matrix[0 + 0 * 4] = (float)(2. / (right - left));
+      projection_matrix[0 + 3 * 4] = (float)(-(left + right) / (right - left));
+      projection_matrix[1 + 1 * 4] = (float)(2. / (top - bottom));
+      projection_matrix[1 + 3 * 4] = (float)(-(bottom + top) / (top - bottom));
+      projection_matrix[2 + 2 * 4] = (float)(-2. / (far - near));
+      projection_matrix[2 + 3 * 4] = (float)(-(far + near) / (far - near));
+      projection_matrix[3 + 3 * 4] = 1;
+    }
+  else if (projection_type == GR_PROJECTION_PERSPECTIVE)
+    {
+      double near, far, fov;
+      gr_inqperspectiveprojection(&near, &far, &fov);
+
+      aspect = (float)width / height;
+      projection_matrix[0 + 0 * 4] = (float)(cos(fov * M_PI / 180 / 2) / sin(fov * M_PI / 180 / 2) / aspect);
+      projection_matrix[1 + 1 * 4] = (float)(cos(fov * M_PI / 180 / 2) / sin(fov * M_PI / 180 / 2));
+      projection_matrix[2 + 2 * 4] = (float)((far + near) / (near - far));
+      projection_matrix[2 + 3 * 4] = (float)(2 * far * near / (near - far));
+      projection_matrix[3 + 2 * 4] = -1;
+    }
+
+  /* Create view matrix */
+  if (projection_type == GR_PROJECTION_DEFAULT)
+    {
+      gr_inqspace(&zmin, &zmax, &rotation, &tilt);
+      gr3_grtransformation_(grmatrix, rotation, tilt);
+      gr3_identity_(view_matrix);
+      view_matrix[2 + 3 * 4] = -4;
+      gr3_matmul_(view_matrix, grmatrix);
+    }
+  else if (projection_type == GR_PROJECTION_PERSPECTIVE || projection_type == GR_PROJECTION_ORTHOGRAPHIC)
+    {
+      memset(view_matrix, 0, 16 * sizeof(float));
+
+      double camera_pos[3];
+      double up[3];
+      double focus_point[3];
+
+      gr_inqtransformationparameters(&camera_pos[0], &camera_pos[1], &camera_pos[2], &up[0], &up[1], &up[2],
+                                     &focus_point[0], &focus_point[1], &focus_point[2]);
+
+      /* direction between camera and focus point */
+      double F[3] = {focus_point[0] - camera_pos[0], focus_point[1] - camera_pos[1], focus_point[2] - camera_pos[2]};
+      double norm_func = sqrt(F[0] * F[0] + F[1] * F[1] + F[2] * F[2]);
+      double f[3] = {F[0] / norm_func, F[1] / norm_func, F[2] / norm_func};
+      double s_deri[3];
+      for (i = 0; i < 3; i++) /*  f cross up */
+        {
+          s_deri[i] = f[(i + 1) % 3] * up[(i + 2) % 3] - up[(i + 1) % 3] * f[(i + 2) % 3];
+        }
+      double s_norm = sqrt(s_deri[0] * s_deri[0] + s_deri[1] * s_deri[1] + s_deri[2] * s_deri[2]);
+      double s[3] = {s_deri[0] / s_norm, s_deri[1] / s_norm, s_deri[2] / s_norm};
+
+      /* transformation matrix */
+      view_matrix[0 + 0 * 4] = (float)s[0];
+      view_matrix[0 + 1 * 4] = (float)s[1];
+      view_matrix[0 + 2 * 4] = (float)s[2];
+      view_matrix[0 + 3 * 4] = (float)(-camera_pos[0] * s[0] - camera_pos[1] * s[1] - camera_pos[2] * s[2]);
+      view_matrix[1 + 0 * 4] = (float)up[0];
+      view_matrix[1 + 1 * 4] = (float)up[1];
+      view_matrix[1 + 2 * 4] = (float)up[2];
+      view_matrix[1 + 3 * 4] = (float)(-camera_pos[0] * up[0] - camera_pos[1] * up[1] - camera_pos[2] * up[2]);
+      view_matrix[2 + 0 * 4] = (float)-f[0];
+      view_matrix[2 + 1 * 4] = (float)-f[1];
+      view_matrix[2 + 2 * 4] = (float)-f[2];
+      view_matrix[2 + 3 * 4] = (float)(camera_pos[0] * f[0] + camera_pos[1] * f[1] + camera_pos[2] * f[2]);
+      view_matrix[3 + 3 * 4] = 1;
+    }
+}
+
 #if defined(GR3_CAN_USE_VBO) && (defined(GL_ARB_framebuffer_object) || defined(GL_EXT_framebuffer_object))
-  double xmin, ymin, xmax, ymax, zmin, zmax;
-  int rotation, tilt, scale;
-  double min, max;
+/*!
+ * Ray-march the volume in a GLSL fragment shader and read back the result. Returns 0 on success.
+ */
+static int gr3_volume_gl_(int nx, int ny, int nz, const float *fdata, int algorithm, int width, int height,
+                          float *projection_matrix, float *view_matrix, float *pixel_data)
+{
   int i;
-  int *color_data, *colormap;
-  GLfloat fovy, zNear, zFar, aspect, tfov2;
-  GLfloat *pixel_data, *fdata;
   GLsizei vertex_shader_source_lines, fragment_shader_source_lines;
-  GLfloat grmatrix[16], grviewmatrix[16], projection_matrix[16];
-  GLint width, height;
   GLfloat camera_direction[3];
   GLint nmax, success;
   GLuint vertex_shader, fragment_shader, program;
@@ -1011,38 +1112,6 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
       "   return max(current_value, tex_value);\n"
       "}\n"};
 
-  if (nx <= 0 || ny <= 0 || nz <= 0)
-    {
-      fprintf(stderr, "Invalid dimensions in gr_volume.\n");
-      return;
-    }
-
-  if (algorithm < 0 || algorithm > 2)
-    {
-      fprintf(stderr, "Invalid algorithm for gr_volume\n");
-      return;
-    }
-
-  /* TODO: inquire the required resolution */
-  width = 1000;
-  height = 1000;
-
-  pixel_data = malloc(width * height * sizeof(float));
-  assert(pixel_data);
-  fdata = malloc(nx * ny * nz * sizeof(float));
-  assert(fdata);
-  colormap = malloc(256 * sizeof(int));
-  assert(colormap);
-  color_data = malloc(width * height * sizeof(int));
-  assert(color_data);
-
-  for (i = 0; i < nx * ny * nz; i++)
-    {
-      fdata[i] = (float)data[i];
-    }
-
-  gr3_getrenderpathstring(); /* Initializes GR3 if it is not initialized yet */
-
   /* Add transfer function implementation to fragment shader source */
   vertex_shader_source_lines = sizeof(vertex_shader_source) / sizeof(vertex_shader_source[0]);
   fragment_shader_source_lines = sizeof(fragment_shader_source) / sizeof(fragment_shader_source[0]);
@@ -1057,7 +1126,7 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
   if (!success)
     {
       fprintf(stderr, "Failed to compile vertex shader in gr_volume.\n");
-      return;
+      return -1;
     }
   glShaderSource(fragment_shader, fragment_shader_source_lines, fragment_shader_source, NULL);
   glCompileShader(fragment_shader);
@@ -1065,7 +1134,7 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
   if (!success)
     {
       fprintf(stderr, "Failed to compile fragment shader in gr_volume.\n");
-      return;
+      return -1;
     }
   program = glCreateProgram();
   glAttachShader(program, vertex_shader);
@@ -1075,109 +1144,12 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
   if (!success)
     {
       fprintf(stderr, "Failed to link shader program in gr_volume.\n");
-      return;
+      return -1;
     }
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
   glUseProgram(program);
 
-  int projection_type;
-  gr_inqprojectiontype(&projection_type);
-
-  memset(projection_matrix, 0, 16 * sizeof(GLfloat));
-  if (projection_type == GR_PROJECTION_DEFAULT)
-    {
-      /* Set projection parameter like in `gr3_drawmesh_grlike` and create (orthographic) projection matrix */
-      fovy = 90.0f;
-      zNear = 1.0f;
-      zFar = 200.0f;
-      aspect = 1.0f * width / height;
-      tfov2 = (GLfloat)tan(fovy * M_PI / 360.0);
-      GLfloat right = zNear * aspect * tfov2;
-      GLfloat top = zNear * tfov2;
-
-      projection_matrix[0 + 0 * 4] = (GLfloat)1.0 / right; /* left = -right */
-      projection_matrix[0 + 3 * 4] = 0.0;
-      projection_matrix[1 + 1 * 4] = (GLfloat)1.0 / top; /* bottom = -top */
-      projection_matrix[1 + 3 * 4] = 0.0;
-      projection_matrix[2 + 2 * 4] = (GLfloat)-2.0 / (zFar - zNear);
-      projection_matrix[2 + 3 * 4] = -(zFar + zNear) / (zFar - zNear);
-      projection_matrix[3 + 3 * 4] = 1.0;
-    }
-  else if (projection_type == GR_PROJECTION_ORTHOGRAPHIC)
-    {
-      double near, far, left, right, bottom, top;
-      gr_inqorthographicprojection(&left, &right, &bottom, &top, &near, &far);
-
-      projection_matrix[0 + 0 * 4] = (GLfloat)(2. / (right - left));
-      projection_matrix[0 + 3 * 4] = (GLfloat)(-(left + right) / (right - left));
-      projection_matrix[1 + 1 * 4] = (GLfloat)(2. / (top - bottom));
-      projection_matrix[1 + 3 * 4] = (GLfloat)(-(bottom + top) / (top - bottom));
-      projection_matrix[2 + 2 * 4] = (GLfloat)(-2. / (far - near));
-      projection_matrix[2 + 3 * 4] = (GLfloat)(-(far + near) / (far - near));
-      projection_matrix[3 + 3 * 4] = 1;
-    }
-  else if (projection_type == GR_PROJECTION_PERSPECTIVE)
-    {
-      double near, far, fov;
-      gr_inqperspectiveprojection(&near, &far, &fov);
-
-      aspect = (float)width / height;
-      projection_matrix[0 + 0 * 4] = (GLfloat)(cos(fov * M_PI / 180 / 2) / sin(fov * M_PI / 180 / 2) / aspect);
-      projection_matrix[1 + 1 * 4] = (GLfloat)(cos(fov * M_PI / 180 / 2) / sin(fov * M_PI / 180 / 2));
-      projection_matrix[2 + 2 * 4] = (GLfloat)((far + near) / (near - far));
-      projection_matrix[2 + 3 * 4] = (GLfloat)(2 * far * near / (near - far));
-      projection_matrix[3 + 2 * 4] = -1;
-    }
-
-  /* Create view matrix */
-  if (projection_type == GR_PROJECTION_DEFAULT)
-    {
-      gr_inqspace(&zmin, &zmax, &rotation, &tilt);
-      gr3_grtransformation_(grmatrix, rotation, tilt);
-      gr3_identity_(grviewmatrix);
-      grviewmatrix[2 + 3 * 4] = -4;
-      gr3_matmul_(grviewmatrix, grmatrix);
-    }
-  else if (projection_type == GR_PROJECTION_PERSPECTIVE || projection_type == GR_PROJECTION_ORTHOGRAPHIC)
-    {
-      memset(grviewmatrix, 0, 16 * sizeof(GLfloat));
-
-      double camera_pos[3];
-      double up[3];
-      double focus_point[3];
-
-      gr_inqtransformationparameters(&camera_pos[0], &camera_pos[1], &camera_pos[2], &up[0], &up[1], &up[2],
-                                     &focus_point[0], &focus_point[1], &focus_point[2]);
-
-      /* direction between camera and focus point */
-      double F[3] = {focus_point[0] - camera_pos[0], focus_point[1] - camera_pos[1], focus_point[2] - camera_pos[2]};
-      double norm_func = sqrt(F[0] * F[0] + F[1] * F[1] + F[2] * F[2]);
-      double f[3] = {F[0] / norm_func, F[1] / norm_func, F[2] / norm_func};
-      double s_deri[3];
-      for (i = 0; i < 3; i++) /*  f cross up */
-        {
-          s_deri[i] = f[(i + 1) % 3] * up[(i + 2) % 3] - up[(i + 1) % 3] * f[(i + 2) % 3];
-        }
-      double s_norm = sqrt(s_deri[0] * s_deri[0] + s_deri[1] * s_deri[1] + s_deri[2] * s_deri[2]);
-      double s[3] = {s_deri[0] / s_norm, s_deri[1] / s_norm, s_deri[2] / s_norm};
-
-      /* transformation matrix */
-      grviewmatrix[0 + 0 * 4] = (GLfloat)s[0];
-      grviewmatrix[0 + 1 * 4] = (GLfloat)s[1];
-      grviewmatrix[0 + 2 * 4] = (GLfloat)s[2];
-      grviewmatrix[0 + 3 * 4] = (GLfloat)(-camera_pos[0] * s[0] - camera_pos[1] * s[1] - camera_pos[2] * s[2]);
-      grviewmatrix[1 + 0 * 4] = (GLfloat)up[0];
-      grviewmatrix[1 + 1 * 4] = (GLfloat)up[1];
-      grviewmatrix[1 + 2 * 4] = (GLfloat)up[2];
-      grviewmatrix[1 + 3 * 4] = (GLfloat)(-camera_pos[0] * up[0] - camera_pos[1] * up[1] - camera_pos[2] * up[2]);
-      grviewmatrix[2 + 0 * 4] = (GLfloat)-f[0];
-      grviewmatrix[2 + 1 * 4] = (GLfloat)-f[1];
-      grviewmatrix[2 + 2 * 4] = (GLfloat)-f[2];
-      grviewmatrix[2 + 3 * 4] = (GLfloat)(camera_pos[0] * f[0] + camera_pos[1] * f[1] + camera_pos[2] * f[2]);
-      grviewmatrix[3 + 3 * 4] = 1;
-    }
-
   /* Buffer Vertices */
   glGenBuffers(1, &vbo);
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -1192,7 +1164,6 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
   glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
   glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, nx, ny, nz, 0, GL_RED, GL_FLOAT, fdata);
-  free(fdata);
 
   /* Create framebuffer object and bind 2D float texture as COLOR_ATTACHMENT0 to it */
   glGenTextures(1, &framebuffer_texture);
@@ -1244,7 +1215,7 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
   camera_direction[1] = context_struct_.center_y - context_struct_.camera_y;
   camera_direction[2] = context_struct_.center_z - context_struct_.camera_z;
 
-  glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, grviewmatrix);
+  glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, view_matrix);
   glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, projection_matrix);
   glUniform3f(glGetUniformLocation(program, "camera_direction"), camera_direction[0], camera_direction[1],
               camera_direction[2]);
@@ -1254,8 +1225,373 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
   for (i = 0; i < height; i++)
     {
       glPixelStorei(GL_PACK_ROW_LENGTH, width);
-      glReadPixels(0, i, width, 1, GL_RED, GL_FLOAT, pixel_data + i * height);
+      glReadPixels(0, i, width, 1, GL_RED, GL_FLOAT, pixel_data + i * width);
+    }
+
+  /* Cleanup and restore previous GL state */
+  glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+  if (!previous_cull_face_state)
+    {
+      glDisable(GL_CULL_FACE);
+    }
+  glCullFace(previous_cull_face_mode);
+  glClearColor(previous_clear_color[0], previous_clear_color[1], previous_clear_color[2], previous_clear_color[3]);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_3D, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+#ifdef GL_ARB_framebuffer_object
+  glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer_binding);
+  glDeleteFramebuffers(1, &framebuffer);
+#else
+  glBindFramebufferEXT(GL_FRAMEBUFFER, previous_framebuffer_binding);
+  glDeleteFramebuffersEXT(1, &framebuffer);
+#endif
+  glDeleteBuffers(1, &vbo);
+  glDeleteTextures(1, &framebuffer_texture);
+  glDeleteTextures(1, &texture);
+  glDeleteProgram(program);
+
+  return 0;
+}
+#endif
+
+/*!
+ * Sample the volume with trilinear interpolation and clamp-to-edge addressing like a GL_LINEAR 3D texture. The
+ * coordinates are given in voxel units, so that voxel centers lie on integer positions.
+ */
+static float gr3_volume_sample_(const volume_job_t *job, double u, double v, double w)
+{
+  int i0, i1, j0, j1, k0, k1, nx = job->nx, nxy = job->nx * job->ny;
+  float fu, fv, fw, c00, c01, c10, c11, c0, c1;
+  const float *d = job->data;
+
+  i0 = (int)floor(u);
+  j0 = (int)floor(v);
+  k0 = (int)floor(w);
+  fu = (float)(u - i0);
+  fv = (float)(v - j0);
+  fw = (float)(w - k0);
+  i1 = i0 + 1;
+  j1 = j0 + 1;
+  k1 = k0 + 1;
+  i0 = i0 < 0 ? 0 : (i0 >= job->nx ? job->nx - 1 : i0);
+  i1 = i1 < 0 ? 0 : (i1 >= job->nx ? job->nx - 1 : i1);
+  j0 = (j0 < 0 ? 0 : (j0 >= job->ny ? job->ny - 1 : j0)) * nx;
+  j1 = (j1 < 0 ? 0 : (j1 >= job->ny ? job->ny - 1 : j1)) * nx;
+  k0 = (k0 < 0 ? 0 : (k0 >= job->nz ? job->nz - 1 : k0)) * nxy;
+  k1 = (k1 < 0 ? 0 : (k1 >= job->nz ? job->nz - 1 : k1)) * nxy;
+
+  c00 = d[i0 + j0 + k0] + fu * (d[i1 + j0 + k0] - d[i0 + j0 + k0]);
+  c10 = d[i0 + j1 + k0] + fu * (d[i1 + j1 + k0] - d[i0 + j1 + k0]);
+  c01 = d[i0 + j0 + k1] + fu * (d[i1 + j0 + k1] - d[i0 + j0 + k1]);
+  c11 = d[i0 + j1 + k1] + fu * (d[i1 + j1 + k1] - d[i0 + j1 + k1]);
+  c0 = c00 + fv * (c10 - c00);
+  c1 = c01 + fv * (c11 - c01);
+
+  return c0 + fw * (c1 - c0);
+}
+
+/*!
+ * Return the number of further samples for which the voxel coordinate u certainly stays inside macro-cell c of a
+ * grid with g cells. At least one sample (the current one) is always skipped.
+ */
+static int gr3_volume_cell_steps_(double u, double du, int c, int g)
+{
+  double steps;
+
+  if (du > 0 && c < g - 1)
+    {
+      steps = ((c + 1) * VOLUME_CELL_SIZE - u) / du;
+    }
+  else if (du < 0 && c > 0)
+    {
+      steps = (u - c * VOLUME_CELL_SIZE) / -du;
+    }
+  else
+    {
+      return INT_MAX;
+    }
+  return steps < 2 ? 1 : (steps > INT_MAX ? INT_MAX : (int)steps);
+}
+
+/*!
+ * Cast the ray for the pixel (px, py) and return its result in the same encoding as the fragment shader, i.e. 0 if
+ * the ray misses the volume and 1 + the value of the transfer function otherwise.
+ */
+static float gr3_volume_ray_(const volume_job_t *job, int px, int py)
+{
+  double x, y, z, q[4], p[2][3], r[3], pos[3], dir[3], norm;
+  double t_enter = -HUGE_VAL, t_exit = HUGE_VAL, ta, tb;
+  double u, v, w, u0, v0, w0, du, dv, dw, step_length, result, threshold;
+  float value;
+  int i, k, ci, cj, ck, skip, steps;
+  const double *inv = job->inverse;
+
+  /* unproject the pixel center on the near and the far plane */
+  x = 2.0 * (px + 0.5) / job->width - 1;
+  y = 2.0 * (py + 0.5) / job->height - 1;
+  for (k = 0; k < 2; k++)
+    {
+      z = k ? 1 : -1;
+      for (i = 0; i < 4; i++)
+        {
+          q[i] = inv[i] * x + inv[i + 4] * y + inv[i + 8] * z + inv[i + 12];
+        }
+      if (q[3] == 0) return 0;
+      for (i = 0; i < 3; i++)
+        {
+          p[k][i] = q[i] / q[3];
+        }
+    }
+
+  /* intersect the ray with the cube [-1, 1]^3 */
+  for (i = 0; i < 3; i++)
+    {
+      r[i] = p[1][i] - p[0][i];
+      if (r[i] == 0)
+        {
+          if (p[0][i] < -1 || p[0][i] > 1) return 0;
+        }
+      else
+        {
+          ta = (-1 - p[0][i]) / r[i];
+          tb = (1 - p[0][i]) / r[i];
+          if (ta > tb)
+            {
+              double tmp = ta;
+              ta = tb;
+              tb = tmp;
+            }
+          if (ta > t_enter) t_enter = ta;
+          if (tb < t_exit) t_exit = tb;
+        }
+    }
+  /* front faces outside of the clipping volume are not rasterized, back faces are culled */
+  if (t_enter > t_exit || t_enter < 0 || t_enter > 1) return 0;
+
+  for (i = 0; i < 3; i++)
+    {
+      pos[i] = p[0][i] + t_enter * r[i];
+      dir[i] = job->camera_direction[i] + job->perspective * pos[i];
+    }
+  norm = sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+  if (norm == 0) return 0;
+
+  /* march in voxel coordinates, the texture coordinate range [0, 1] maps to [-0.5, n - 0.5] */
+  step_length = sqrt(3.0) / job->n_samples;
+  u0 = (pos[0] * 0.5 + 0.5) * job->nx - 0.5;
+  v0 = (pos[1] * 0.5 + 0.5) * job->ny - 0.5;
+  w0 = (pos[2] * 0.5 + 0.5) * job->nz - 0.5;
+  du = dir[0] / norm * step_length * job->nx;
+  dv = dir[1] / norm * step_length * job->ny;
+  dw = dir[2] / norm * step_length * job->nz;
+
+  result = job->algorithm == GR_VOLUME_ABSORPTION ? 1.0 : 0.0;
+  for (k = 0; k <= job->n_samples; k += skip)
+    {
+      u = u0 + k * du;
+      v = v0 + k * dv;
+      w = w0 + k * dw;
+      if (k > 0 && (u < -0.5 || v < -0.5 || w < -0.5 || u > job->nx - 0.5 || v > job->ny - 0.5 || w > job->nz - 0.5))
+        {
+          break;
+        }
+
+      /* skip samples inside of macro-cells which cannot change the result */
+      ci = (int)floor(u);
+      cj = (int)floor(v);
+      ck = (int)floor(w);
+      ci = (ci < 0 ? 0 : (ci >= job->nx ? job->nx - 1 : ci)) / VOLUME_CELL_SIZE;
+      cj = (cj < 0 ? 0 : (cj >= job->ny ? job->ny - 1 : cj)) / VOLUME_CELL_SIZE;
+      ck = (ck < 0 ? 0 : (ck >= job->nz ? job->nz - 1 : ck)) / VOLUME_CELL_SIZE;
+      threshold = job->algorithm == GR_VOLUME_MIP ? result : 0;
+      if (job->cell_max[ci + job->gx * (cj + job->gy * ck)] <= threshold)
+        {
+          skip = gr3_volume_cell_steps_(u, du, ci, job->gx);
+          steps = gr3_volume_cell_steps_(v, dv, cj, job->gy);
+          if (steps < skip) skip = steps;
+          steps = gr3_volume_cell_steps_(w, dw, ck, job->gz);
+          if (steps < skip) skip = steps;
+          if (skip > job->n_samples - k + 1) skip = job->n_samples - k + 1;
+          continue;
+        }
+      skip = 1;
+
+      value = gr3_volume_sample_(job, u, v, w);
+      if (value < 0) value = 0;
+      if (job->algorithm == GR_VOLUME_EMISSION)
+        {
+          result += step_length * value;
+        }
+      else if (job->algorithm == GR_VOLUME_ABSORPTION)
+        {
+          result *= exp(-step_length * value);
+          /* early ray termination, the remaining transmittance is not representable anymore */
+          if (result < VOLUME_MIN_TRANSMITTANCE) break;
+        }
+      else
+        {
+          if (value > result) result = value;
+          /* early ray termination, the maximum of the data has been reached */
+          if (result >= job->data_max) break;
+        }
+    }
+
+  return (float)(1 + result);
+}
+
+static void *gr3_volume_worker_(void *arg)
+{
+  volume_job_t *job = (volume_job_t *)arg;
+  int tile, tiles_x, x0, y0, x1, y1, px, py;
+
+  tiles_x = (job->width + VOLUME_TILE_SIZE - 1) / VOLUME_TILE_SIZE;
+  for (;;)
+    {
+      pthread_mutex_lock(&job->lock);
+      tile = job->next_tile++;
+      pthread_mutex_unlock(&job->lock);
+      if (tile >= job->num_tiles) break;
+
+      x0 = (tile % tiles_x) * VOLUME_TILE_SIZE;
+      y0 = (tile / tiles_x) * VOLUME_TILE_SIZE;
+      x1 = x0 + VOLUME_TILE_SIZE < job->width ? x0 + VOLUME_TILE_SIZE : job->width;
+      y1 = y0 + VOLUME_TILE_SIZE < job->height ? y0 + VOLUME_TILE_SIZE : job->height;
+      for (py = y0; py < y1; py++)
+        {
+          for (px = x0; px < x1; px++)
+            {
+              job->pixel_data[py * job->width + px] = gr3_volume_ray_(job, px, py);
+            }
+        }
+    }
+  return NULL;
+}
+
+/*!
+ * Ray-march the volume on the CPU with the same geometry and transfer functions as the fragment shader used by
+ * gr3_volume_gl_. The image is split into tiles which are processed by the software renderer threads. Macro-cells
+ * that cannot contribute to a ray are skipped and rays are terminated as soon as their result cannot change anymore.
+ */
+static int gr3_volume_sr_(int nx, int ny, int nz, const float *fdata, int algorithm, int width, int height,
+                          float *projection_matrix, float *view_matrix, float *pixel_data)
+{
+  volume_job_t job;
+  float matrix[16], m;
+  pthread_t threads[MAX_NUM_THREADS];
+  int num_threads, started, i, j, x, y, z, ci, cj, ck, nmax;
+  double camera_direction[3];
+
+  memcpy(matrix, projection_matrix, 16 * sizeof(float));
+  gr3_matmul_(matrix, view_matrix);
+  if (!gr3_invertmatrix_(matrix, job.inverse))
+    {
+      fprintf(stderr, "Invalid projection in gr_volume.\n");
+      return -1;
+    }
+
+  job.nx = nx;
+  job.ny = ny;
+  job.nz = nz;
+  job.data = fdata;
+  job.algorithm = algorithm;
+  job.width = width;
+  job.height = height;
+  job.pixel_data = pixel_data;
+
+  nmax = nx > ny ? nx : ny;
+  if (nz > nmax) nmax = nz;
+  job.n_samples = (int)(sqrt(3.0) * nmax);
+  if (job.n_samples < 1000) job.n_samples = 1000;
+
+  /* transform the camera direction into model space like the vertex shader does */
+  camera_direction[0] = context_struct_.center_x - context_struct_.camera_x;
+  camera_direction[1] = context_struct_.center_y - context_struct_.camera_y;
+  camera_direction[2] = context_struct_.center_z - context_struct_.camera_z;
+  for (i = 0; i < 3; i++)
+    {
+      job.camera_direction[i] = 0;
+      for (j = 0; j < 3; j++)
+        {
+          job.camera_direction[i] += view_matrix[j + i * 4] * camera_direction[j];
+        }
+    }
+  job.perspective = fabs(projection_matrix[3 + 2 * 4]) > 0.5;
+
+  /* build the macro-cell grid, each cell also covers the first voxel layer of its successor */
+  job.gx = (nx + VOLUME_CELL_SIZE - 1) / VOLUME_CELL_SIZE;
+  job.gy = (ny + VOLUME_CELL_SIZE - 1) / VOLUME_CELL_SIZE;
+  job.gz = (nz + VOLUME_CELL_SIZE - 1) / VOLUME_CELL_SIZE;
+  job.cell_max = (float *)malloc(job.gx * job.gy * job.gz * sizeof(float));
+  if (!job.cell_max)
+    {
+      fprintf(stderr, "Failed to allocate memory in gr_volume.\n");
+      return -1;
+    }
+  job.data_max = -FLT_MAX;
+  for (ck = 0; ck < job.gz; ck++)
+    {
+      for (cj = 0; cj < job.gy; cj++)
+        {
+          for (ci = 0; ci < job.gx; ci++)
+            {
+              m = -FLT_MAX;
+              for (z = ck * VOLUME_CELL_SIZE; z <= (ck + 1) * VOLUME_CELL_SIZE && z < nz; z++)
+                {
+                  for (y = cj * VOLUME_CELL_SIZE; y <= (cj + 1) * VOLUME_CELL_SIZE && y < ny; y++)
+                    {
+                      for (x = ci * VOLUME_CELL_SIZE; x <= (ci + 1) * VOLUME_CELL_SIZE && x < nx; x++)
+                        {
+                          if (fdata[x + nx * (y + ny * z)] > m) m = fdata[x + nx * (y + ny * z)];
+                        }
+                    }
+                }
+              job.cell_max[ci + job.gx * (cj + job.gy * ck)] = m;
+              if (m > job.data_max) job.data_max = m;
+            }
+        }
+    }
+
+  job.next_tile = 0;
+  job.num_tiles = ((width + VOLUME_TILE_SIZE - 1) / VOLUME_TILE_SIZE) *
+                  ((height + VOLUME_TILE_SIZE - 1) / VOLUME_TILE_SIZE);
+  pthread_mutex_init(&job.lock, NULL);
+
+  num_threads = context_struct_.num_threads;
+  if (num_threads < 1) num_threads = 1;
+  if (num_threads > MAX_NUM_THREADS) num_threads = MAX_NUM_THREADS;
+  for (started = 0; started < num_threads - 1; started++)
+    {
+      if (pthread_create(&threads[started], NULL, gr3_volume_worker_, &job) != 0) break;
     }
+  gr3_volume_worker_(&job);
+  for (i = 0; i < started; i++)
+    {
+      pthread_join(threads[i], NULL);
+    }
+
+  pthread_mutex_destroy(&job.lock);
+  free(job.cell_max);
+
+  return 0;
+}
+
+/*!
+ * Apply the current GR colormap to the ray-marching result and draw it into the current GR window.
+ */
+static void gr3_volume_drawimage_(int width, int height, float *pixel_data, double *dmin_ptr, double *dmax_ptr)
+{
+  double xmin, ymin, xmax, ymax;
+  int scale;
+  double min, max;
+  int i;
+  int *color_data, *colormap;
+
+  colormap = malloc(256 * sizeof(int));
+  assert(colormap);
+  color_data = malloc(width * height * sizeof(int));
+  assert(color_data);
 
   if (dmin_ptr && *dmin_ptr >= 0)
     {
@@ -1324,7 +1660,6 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
           color_data[i] = (255 << 24) + colormap[val];
         }
     }
-  free(pixel_data);
   free(colormap);
 
   gr_inqwindow(&xmin, &xmax, &ymin, &ymax);
@@ -1345,31 +1680,91 @@ GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, doubl
   gr_drawimage(xmin, xmax, ymax, ymin, width, height, color_data, 0);
 
   free(color_data);
+}
 
-  /* Cleanup and restore previous GL state */
-  glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
-  if (!previous_cull_face_state)
+/*!
+ * Draw volume data using the given algorithm and apply the current GR colormap.
+ *
+ * \param [in]     nx         number of points in x-direction
+ * \param [in]     ny         number of points in y-direction
+ * \param [in]     nz         number of points in z-direction
+ * \param [in]     data       an array of shape nx * ny * nz containing the intensities for each point
+ * \param [in]     algorithm  the algorithm to reduce the volume data
+ * \param [in,out] dmin_ptr   The variable this parameter points at will be used as minimum data value when applying the
+ *                            colormap. If it is negative, the variable will be set to the actual occuring minimum and
+ *                            that value will be used instead. If dmin_ptr is NULL, it will be ignored.
+ * \param [in,out] dmax_ptr   The variable this parameter points at will be used as maximum data value when applying the
+ *                            colormap. If it is negative, the variable will be set to the actual occuring maximum and
+ *                            that value will be used instead. If dmax_ptr is NULL, it will be ignored.
+ *
+ * \verbatim embed:rst:leading-asterisk
+ *
+ * Available algorithms are:
+ *
+ * +---------------------+---+-----------------------------+
+ * |GR_VOLUME_EMISSION   |  0|emission model               |
+ * +---------------------+---+-----------------------------+
+ * |GR_VOLUME_ABSORPTION |  1|absorption model             |
+ * +---------------------+---+-----------------------------+
+ * |GR_VOLUME_MIP        |  2|maximum intensity projection |
+ * +---------------------+---+-----------------------------+
+ *
+ * If GR3 uses the software renderer (e.g. because no OpenGL context could be created), the volume is ray-marched on
+ * the CPU instead of in a fragment shader.
+ *
+ * \endverbatim
+ */
+GR3API void gr_volume(int nx, int ny, int nz, double *data, int algorithm, double *dmin_ptr, double *dmax_ptr)
+{
+  int i, width, height, error;
+  float *pixel_data, *fdata;
+  float projection_matrix[16], view_matrix[16];
+
+  if (nx <= 0 || ny <= 0 || nz <= 0)
     {
-      glDisable(GL_CULL_FACE);
+      fprintf(stderr, "Invalid dimensions in gr_volume.\n");
+      return;
     }
-  glCullFace(previous_cull_face_mode);
-  glClearColor(previous_clear_color[0], previous_clear_color[1], previous_clear_color[2], previous_clear_color[3]);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindTexture(GL_TEXTURE_3D, 0);
-  glBindTexture(GL_TEXTURE_2D, 0);
 
-#ifdef GL_ARB_framebuffer_object
-  glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer_binding);
-  glDeleteFramebuffers(1, &framebuffer);
-#else
-  glBindFramebufferEXT(GL_FRAMEBUFFER, previous_framebuffer_binding);
-  glDeleteFramebuffersEXT(1, &framebuffer);
-#endif
-  glDeleteBuffers(1, &vbo);
-  glDeleteTextures(1, &framebuffer_texture);
-  glDeleteTextures(1, &texture);
-  glDeleteProgram(program);
-#else
-  fprintf(stderr, "gr_volume support not compiled in.\n");
+  if (algorithm < 0 || algorithm > 2)
+    {
+      fprintf(stderr, "Invalid algorithm for gr_volume\n");
+      return;
+    }
+
+  /* TODO: inquire the required resolution */
+  width = 1000;
+  height = 1000;
+
+  pixel_data = malloc(width * height * sizeof(float));
+  assert(pixel_data);
+  fdata = malloc(nx * ny * nz * sizeof(float));
+  assert(fdata);
+
+  for (i = 0; i < nx * ny * nz; i++)
+    {
+      fdata[i] = (float)data[i];
+    }
+
+  gr3_getrenderpathstring(); /* Initializes GR3 if it is not initialized yet */
+
+  gr3_volume_matrices_(width, height, projection_matrix, view_matrix);
+
+#if defined(GR3_CAN_USE_VBO) && (defined(GL_ARB_framebuffer_object) || defined(GL_EXT_framebuffer_object))
+  if (!context_struct_.use_software_renderer)
+    {
+      error = gr3_volume_gl_(nx, ny, nz, fdata, algorithm, width, height, projection_matrix, view_matrix, pixel_data);
+    }
+  else
 #endif
+    {
+      error = gr3_volume_sr_(nx, ny, nz, fdata, algorithm, width, height, projection_matrix, view_matrix, pixel_data);
+    }
+  free(fdata);
+
+  if (!error)
+    {
+      gr3_volume_drawimage_(width, height, pixel_data, dmin_ptr, dmax_ptr);
+    }
+  free(pixel_data);
 }
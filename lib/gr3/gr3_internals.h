@@ -95,6 +95,7 @@ typedef struct _GR3_MeshData_t_
   int number_of_vertices;
   int number_of_indices;
   vertex_fp *vertices_fp;
+  struct _GR3_MeshBVH_t_ *bvh; /*!< Triangle hierarchy used for picking, built on demand by gr3_selectid() */
 } GR3_MeshData_t_;
 
 
@@ -289,4 +290,10 @@ int gr3_readpngtomemory_(int *pixels, const char *pngfile, int width, int height
 int gr3_export_jpeg_(const char *filename, int width, int height);
 int gr3_drawimage_gks_(float xmin, float xmax, float ymin, float ymax, int width, int height);
 void gr3_sortindexedmeshdata(int mesh);
+int gr3_invertmatrix_(const float *matrix, double *inverse);
+int gr3_selectid_raycast_(int px, int py, int width, int height, float left, float right, float bottom, float top,
+                          int *object_id);
+void gr3_invalidatepick_(void);
+void gr3_deletemeshbvh_(int mesh);
+void gr3_terminatepick_(void);
 #endif
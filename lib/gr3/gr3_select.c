@@ -0,0 +1,696 @@
+/*!\file gr3_select.c
+ *
+ * CPU ray casting for gr3_selectid(). The drawn mesh instances are organized in a bounding volume hierarchy (BVH)
+ * whose leaves refer to a BVH over the triangles of the instantiated mesh, so a pick only tests the few triangles
+ * close to the pick ray. Mesh hierarchies are built once per mesh, the instance hierarchy is refitted if the draw
+ * list changed but still contains the same number of instances and rebuilt otherwise.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gr3.h"
+#include "gr3_internals.h"
+
+#define BVH_LEAF_SIZE 4
+#define BVH_STACK_SIZE 64
+
+typedef struct
+{
+  float min[3], max[3];
+  int first; /* first primitive (in order) of a leaf or left child of an inner node, the right child follows it */
+  int count; /* number of primitives of a leaf, 0 for inner nodes */
+} gr3_bvhnode_t;
+
+typedef struct
+{
+  gr3_bvhnode_t *nodes;
+  int num_nodes;
+  int *order; /* primitive indices sorted by leaves */
+  int num_primitives;
+} gr3_bvh_t;
+
+struct _GR3_MeshBVH_t_
+{
+  gr3_bvh_t bvh;
+  float *triangles; /* 9 floats per triangle */
+};
+
+typedef struct
+{
+  float basis[3][3]; /* -left, up and forward of the model matrix */
+  float scales[3];
+  float position[3];
+  int mesh;
+  int object_id;
+} gr3_pickinstance_t;
+
+typedef struct
+{
+  double origin[3], direction[3];
+  double t_min, t_max;
+} gr3_ray_t;
+
+typedef struct
+{
+  const float *triangles;
+  int accept_equal;
+  int hit;
+} gr3_meshhit_t;
+
+typedef struct
+{
+  int instance;
+  int object_id;
+} gr3_scenehit_t;
+
+static struct
+{
+  gr3_bvh_t bvh;
+  gr3_pickinstance_t *instances;
+  int num_instances;
+  int valid;
+} scene_ = {{NULL, 0, NULL, 0}, NULL, 0, 0};
+
+static void gr3_bvhfree_(gr3_bvh_t *bvh)
+{
+  free(bvh->nodes);
+  free(bvh->order);
+  bvh->nodes = NULL;
+  bvh->order = NULL;
+  bvh->num_nodes = 0;
+  bvh->num_primitives = 0;
+}
+
+/*!
+ * Recompute the node bounds bottom-up from the primitive bounds (6 floats per primitive: minimum and maximum). As
+ * children are always stored behind their parents, a single backwards pass suffices.
+ */
+static void gr3_bvhrefit_(gr3_bvh_t *bvh, const float *bounds)
+{
+  int i, j, k;
+  gr3_bvhnode_t *node, *left, *right;
+  const float *b;
+
+  for (i = bvh->num_nodes - 1; i >= 0; i--)
+    {
+      node = bvh->nodes + i;
+      if (node->count > 0)
+        {
+          b = bounds + 6 * bvh->order[node->first];
+          for (k = 0; k < 3; k++)
+            {
+              node->min[k] = b[k];
+              node->max[k] = b[k + 3];
+            }
+          for (j = 1; j < node->count; j++)
+            {
+              b = bounds + 6 * bvh->order[node->first + j];
+              for (k = 0; k < 3; k++)
+                {
+                  if (b[k] < node->min[k]) node->min[k] = b[k];
+                  if (b[k + 3] > node->max[k]) node->max[k] = b[k + 3];
+                }
+            }
+        }
+      else
+        {
+          left = bvh->nodes + node->first;
+          right = left + 1;
+          for (k = 0; k < 3; k++)
+            {
+              node->min[k] = left->min[k] < right->min[k] ? left->min[k] : right->min[k];
+              node->max[k] = left->max[k] > right->max[k] ? left->max[k] : right->max[k];
+            }
+        }
+    }
+}
+
+/*!
+ * Partition order[first, first + count) so that the element with rank count / 2 regarding the primitive centroids
+ * along the given axis is at its sorted position (quickselect).
+ */
+static void gr3_bvhselect_(int *order, const float *bounds, int first, int count, int axis)
+{
+  int lo = first, hi = first + count - 1, mid = first + count / 2, i, j, tmp;
+  float pivot;
+
+#define CENTROID(p) (bounds[6 * (p) + axis] + bounds[6 * (p) + axis + 3])
+  while (lo < hi)
+    {
+      pivot = CENTROID(order[(lo + hi) / 2]);
+      i = lo;
+      j = hi;
+      while (i <= j)
+        {
+          while (CENTROID(order[i]) < pivot) i++;
+          while (CENTROID(order[j]) > pivot) j--;
+          if (i <= j)
+            {
+              tmp = order[i];
+              order[i] = order[j];
+              order[j] = tmp;
+              i++;
+              j--;
+            }
+        }
+      if (mid <= j)
+        {
+          hi = j;
+        }
+      else if (mid >= i)
+        {
+          lo = i;
+        }
+      else
+        {
+          break;
+        }
+    }
+#undef CENTROID
+}
+
+/*!
+ * Build a BVH over n primitives by recursive median splits along the largest centroid extent. Returns 0 if memory
+ * could not be allocated or the tree would be too deep to be traversed.
+ */
+static int gr3_bvhbuild_(gr3_bvh_t *bvh, const float *bounds, int n)
+{
+  int *stack, sp = 0, i, k, node, first, count, axis, depth;
+  float cmin[3], cmax[3], c;
+
+  gr3_bvhfree_(bvh);
+  if (n <= 0) return 1;
+  /* the larger half of a median split determines the depth; a traversal holds at most one node per level */
+  for (depth = 0, count = n; count > BVH_LEAF_SIZE; depth++)
+    {
+      count -= count / 2;
+    }
+  if (depth + 1 > BVH_STACK_SIZE) return 0;
+  bvh->nodes = (gr3_bvhnode_t *)malloc(2 * n * sizeof(gr3_bvhnode_t));
+  bvh->order = (int *)malloc(n * sizeof(int));
+  stack = (int *)malloc(2 * n * sizeof(int));
+  if (bvh->nodes == NULL || bvh->order == NULL || stack == NULL)
+    {
+      free(stack);
+      gr3_bvhfree_(bvh);
+      return 0;
+    }
+  for (i = 0; i < n; i++)
+    {
+      bvh->order[i] = i;
+    }
+  bvh->num_primitives = n;
+  bvh->num_nodes = 1;
+  bvh->nodes[0].first = 0;
+  bvh->nodes[0].count = n;
+  stack[sp++] = 0;
+  while (sp > 0)
+    {
+      node = stack[--sp];
+      first = bvh->nodes[node].first;
+      count = bvh->nodes[node].count;
+      if (count <= BVH_LEAF_SIZE) continue;
+
+      for (k = 0; k < 3; k++)
+        {
+          cmin[k] = cmax[k] = bounds[6 * bvh->order[first] + k] + bounds[6 * bvh->order[first] + k + 3];
+        }
+      for (i = first + 1; i < first + count; i++)
+        {
+          for (k = 0; k < 3; k++)
+            {
+              c = bounds[6 * bvh->order[i] + k] + bounds[6 * bvh->order[i] + k + 3];
+              if (c < cmin[k]) cmin[k] = c;
+              if (c > cmax[k]) cmax[k] = c;
+            }
+        }
+      axis = 0;
+      for (k = 1; k < 3; k++)
+        {
+          if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) axis = k;
+        }
+      gr3_bvhselect_(bvh->order, bounds, first, count, axis);
+
+      bvh->nodes[node].first = bvh->num_nodes;
+      bvh->nodes[node].count = 0;
+      bvh->nodes[bvh->num_nodes].first = first;
+      bvh->nodes[bvh->num_nodes].count = count / 2;
+      bvh->nodes[bvh->num_nodes + 1].first = first + count / 2;
+      bvh->nodes[bvh->num_nodes + 1].count = count - count / 2;
+      stack[sp++] = bvh->num_nodes;
+      stack[sp++] = bvh->num_nodes + 1;
+      bvh->num_nodes += 2;
+    }
+  free(stack);
+  gr3_bvhrefit_(bvh, bounds);
+  return 1;
+}
+
+/*!
+ * Slab test of a ray against a node. On a hit, t_enter is set to the ray parameter where the box is entered.
+ */
+static int gr3_rayhitsnode_(const gr3_ray_t *ray, const gr3_bvhnode_t *node, double *t_enter)
+{
+  double t0 = ray->t_min, t1 = ray->t_max, ta, tb, tmp;
+  int k;
+
+  for (k = 0; k < 3; k++)
+    {
+      if (ray->direction[k] == 0)
+        {
+          if (ray->origin[k] < node->min[k] || ray->origin[k] > node->max[k]) return 0;
+        }
+      else
+        {
+          ta = (node->min[k] - ray->origin[k]) / ray->direction[k];
+          tb = (node->max[k] - ray->origin[k]) / ray->direction[k];
+          if (ta > tb)
+            {
+              tmp = ta;
+              ta = tb;
+              tb = tmp;
+            }
+          if (ta > t0) t0 = ta;
+          if (tb < t1) t1 = tb;
+          if (t0 > t1) return 0;
+        }
+    }
+  *t_enter = t0;
+  return 1;
+}
+
+/*!
+ * Visit all leaves of the BVH hit by the ray, nearest first. The callback may shorten the ray by lowering t_max.
+ */
+static void gr3_bvhtraverse_(const gr3_bvh_t *bvh, gr3_ray_t *ray,
+                             void (*visit)(void *context, gr3_ray_t *ray, int primitive), void *context)
+{
+  int stack[BVH_STACK_SIZE], sp = 0, k, hit_left, hit_right;
+  const gr3_bvhnode_t *node, *left;
+  double t, t_left, t_right;
+
+  if (bvh->num_nodes == 0) return;
+  stack[sp++] = 0;
+  while (sp > 0)
+    {
+      node = bvh->nodes + stack[--sp];
+      if (!gr3_rayhitsnode_(ray, node, &t)) continue;
+      if (node->count > 0)
+        {
+          for (k = 0; k < node->count; k++)
+            {
+              visit(context, ray, bvh->order[node->first + k]);
+            }
+          continue;
+        }
+      left = bvh->nodes + node->first;
+      hit_left = gr3_rayhitsnode_(ray, left, &t_left);
+      hit_right = gr3_rayhitsnode_(ray, left + 1, &t_right);
+      if (hit_left && hit_right)
+        {
+          /* push the farther child first, so the nearer one is visited next */
+          stack[sp++] = t_left <= t_right ? node->first + 1 : node->first;
+          stack[sp++] = t_left <= t_right ? node->first : node->first + 1;
+        }
+      else if (hit_left)
+        {
+          stack[sp++] = node->first;
+        }
+      else if (hit_right)
+        {
+          stack[sp++] = node->first + 1;
+        }
+    }
+}
+
+/*!
+ * Moeller-Trumbore ray/triangle test without backface culling.
+ */
+static void gr3_visittriangle_(void *context, gr3_ray_t *ray, int primitive)
+{
+  gr3_meshhit_t *hit = (gr3_meshhit_t *)context;
+  const float *v = hit->triangles + 9 * primitive;
+  double e1[3], e2[3], p[3], s[3], q[3], det, u, w, t;
+  int k;
+
+  for (k = 0; k < 3; k++)
+    {
+      e1[k] = v[3 + k] - v[k];
+      e2[k] = v[6 + k] - v[k];
+      s[k] = ray->origin[k] - v[k];
+    }
+  p[0] = ray->direction[1] * e2[2] - ray->direction[2] * e2[1];
+  p[1] = ray->direction[2] * e2[0] - ray->direction[0] * e2[2];
+  p[2] = ray->direction[0] * e2[1] - ray->direction[1] * e2[0];
+  det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+  if (det == 0) return;
+  u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+  if (u < 0 || u > 1) return;
+  q[0] = s[1] * e1[2] - s[2] * e1[1];
+  q[1] = s[2] * e1[0] - s[0] * e1[2];
+  q[2] = s[0] * e1[1] - s[1] * e1[0];
+  w = (ray->direction[0] * q[0] + ray->direction[1] * q[1] + ray->direction[2] * q[2]) / det;
+  if (w < 0 || u + w > 1) return;
+  t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+  if (t < ray->t_min || t > ray->t_max || (t == ray->t_max && !hit->accept_equal)) return;
+  ray->t_max = t;
+  hit->hit = 1;
+}
+
+/*!
+ * Return the triangle hierarchy of a mesh, building it on first use.
+ */
+static struct _GR3_MeshBVH_t_ *gr3_getmeshbvh_(int mesh)
+{
+  GR3_MeshData_t_ *data = &context_struct_.mesh_list_[mesh].data;
+  struct _GR3_MeshBVH_t_ *mesh_bvh;
+  float *bounds, *triangle;
+  int indexed, n, i, j, k, index;
+
+  if (data->bvh != NULL) return data->bvh;
+  if (data->vertices == NULL) return NULL;
+
+  indexed = data->type == kMTIndexedMesh && data->indices != NULL;
+  n = indexed ? data->number_of_indices / 3 : data->number_of_vertices / 3;
+  mesh_bvh = (struct _GR3_MeshBVH_t_ *)calloc(1, sizeof(struct _GR3_MeshBVH_t_));
+  if (mesh_bvh == NULL) return NULL;
+  mesh_bvh->triangles = (float *)malloc((n > 0 ? n : 1) * 9 * sizeof(float));
+  bounds = (float *)malloc((n > 0 ? n : 1) * 6 * sizeof(float));
+  if (mesh_bvh->triangles == NULL || bounds == NULL)
+    {
+      free(bounds);
+      free(mesh_bvh->triangles);
+      free(mesh_bvh);
+      return NULL;
+    }
+  for (i = 0; i < n; i++)
+    {
+      triangle = mesh_bvh->triangles + 9 * i;
+      for (j = 0; j < 3; j++)
+        {
+          index = indexed ? data->indices[3 * i + j] : 3 * i + j;
+          for (k = 0; k < 3; k++)
+            {
+              triangle[3 * j + k] = data->vertices[3 * index + k];
+            }
+        }
+      for (k = 0; k < 3; k++)
+        {
+          bounds[6 * i + k] = bounds[6 * i + k + 3] = triangle[k];
+          for (j = 1; j < 3; j++)
+            {
+              if (triangle[3 * j + k] < bounds[6 * i + k]) bounds[6 * i + k] = triangle[3 * j + k];
+              if (triangle[3 * j + k] > bounds[6 * i + k + 3]) bounds[6 * i + k + 3] = triangle[3 * j + k];
+            }
+        }
+    }
+  if (!gr3_bvhbuild_(&mesh_bvh->bvh, bounds, n))
+    {
+      free(bounds);
+      free(mesh_bvh->triangles);
+      free(mesh_bvh);
+      return NULL;
+    }
+  free(bounds);
+  data->bvh = mesh_bvh;
+  return mesh_bvh;
+}
+
+/*!
+ * Set up the model transformation of an instance the same way gr3_dodrawmesh_ does. Returns 0 for degenerate
+ * instances which cannot be hit.
+ */
+static int gr3_setupinstance_(gr3_pickinstance_t *instance, const GR3_DrawList_t_ *draw, int i)
+{
+  float forward[3], up[3], left[3], norm;
+  int k;
+
+  for (k = 0; k < 3; k++)
+    {
+      forward[k] = draw->directions[3 * i + k];
+      up[k] = draw->ups[3 * i + k];
+      instance->scales[k] = draw->scales[3 * i + k];
+      instance->position[k] = draw->positions[3 * i + k];
+      if (instance->scales[k] == 0) return 0;
+    }
+  norm = (float)sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+  if (norm == 0) return 0;
+  for (k = 0; k < 3; k++) forward[k] /= norm;
+  norm = (float)sqrt(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+  if (norm == 0) return 0;
+  for (k = 0; k < 3; k++) up[k] /= norm;
+  for (k = 0; k < 3; k++)
+    {
+      left[k] = forward[(k + 1) % 3] * up[(k + 2) % 3] - up[(k + 1) % 3] * forward[(k + 2) % 3];
+    }
+  norm = (float)sqrt(left[0] * left[0] + left[1] * left[1] + left[2] * left[2]);
+  if (norm == 0) return 0;
+  for (k = 0; k < 3; k++) left[k] /= norm;
+  for (k = 0; k < 3; k++)
+    {
+      up[k] = left[(k + 1) % 3] * forward[(k + 2) % 3] - forward[(k + 1) % 3] * left[(k + 2) % 3];
+    }
+  for (k = 0; k < 3; k++)
+    {
+      instance->basis[0][k] = -left[k];
+      instance->basis[1][k] = up[k];
+      instance->basis[2][k] = forward[k];
+    }
+  instance->mesh = draw->mesh;
+  instance->object_id = draw->object_id;
+  return 1;
+}
+
+/*!
+ * Collect all pickable instances of the draw list and update the instance hierarchy. Returns 0 if memory could not
+ * be allocated.
+ */
+static int gr3_updatescene_(void)
+{
+  GR3_DrawList_t_ *draw;
+  struct _GR3_MeshBVH_t_ *mesh_bvh;
+  gr3_pickinstance_t *instances, *instance;
+  const gr3_bvhnode_t *root;
+  float *bounds, c[3], e[3], a;
+  int n = 0, i, j, k;
+
+  for (draw = context_struct_.draw_list_; draw; draw = draw->next)
+    {
+      n += draw->n;
+    }
+  instances = (gr3_pickinstance_t *)malloc((n > 0 ? n : 1) * sizeof(gr3_pickinstance_t));
+  bounds = (float *)malloc((n > 0 ? n : 1) * 6 * sizeof(float));
+  if (instances == NULL || bounds == NULL)
+    {
+      free(instances);
+      free(bounds);
+      return 0;
+    }
+
+  n = 0;
+  for (draw = context_struct_.draw_list_; draw; draw = draw->next)
+    {
+      mesh_bvh = gr3_getmeshbvh_(draw->mesh);
+      if (mesh_bvh == NULL || mesh_bvh->bvh.num_nodes == 0) continue;
+      root = mesh_bvh->bvh.nodes;
+      for (k = 0; k < 3; k++)
+        {
+          c[k] = (root->min[k] + root->max[k]) / 2;
+          e[k] = (root->max[k] - root->min[k]) / 2;
+        }
+      for (i = 0; i < draw->n; i++)
+        {
+          instance = instances + n;
+          if (!gr3_setupinstance_(instance, draw, i)) continue;
+          /* world space bounds of the transformed mesh bounds */
+          for (k = 0; k < 3; k++)
+            {
+              bounds[6 * n + k] = instance->position[k];
+              bounds[6 * n + k + 3] = 0;
+              for (j = 0; j < 3; j++)
+                {
+                  a = instance->basis[j][k] * instance->scales[j];
+                  bounds[6 * n + k] += a * c[j];
+                  bounds[6 * n + k + 3] += (float)fabs(a) * e[j];
+                }
+              bounds[6 * n + k + 3] = bounds[6 * n + k] + bounds[6 * n + k + 3];
+              bounds[6 * n + k] = 2 * bounds[6 * n + k] - bounds[6 * n + k + 3];
+            }
+          n++;
+        }
+    }
+
+  free(scene_.instances);
+  scene_.instances = instances;
+  scene_.num_instances = n;
+  if (n > 0 && scene_.bvh.num_primitives == n)
+    {
+      gr3_bvhrefit_(&scene_.bvh, bounds);
+    }
+  else if (!gr3_bvhbuild_(&scene_.bvh, bounds, n))
+    {
+      free(bounds);
+      return 0;
+    }
+  free(bounds);
+  scene_.valid = 1;
+  return 1;
+}
+
+/*!
+ * Intersect the world space ray with one instance by transforming the ray into the model space of the mesh. The ray
+ * parameter is invariant under this affine transformation, so hits of different instances can be compared directly.
+ */
+static void gr3_visitinstance_(void *context, gr3_ray_t *ray, int primitive)
+{
+  gr3_scenehit_t *hit = (gr3_scenehit_t *)context;
+  const gr3_pickinstance_t *instance = scene_.instances + primitive;
+  struct _GR3_MeshBVH_t_ *mesh_bvh = context_struct_.mesh_list_[instance->mesh].data.bvh;
+  gr3_ray_t model_ray;
+  gr3_meshhit_t mesh_hit;
+  double d[3];
+  int j, k;
+
+  for (k = 0; k < 3; k++)
+    {
+      d[k] = ray->origin[k] - instance->position[k];
+    }
+  for (j = 0; j < 3; j++)
+    {
+      model_ray.origin[j] = 0;
+      model_ray.direction[j] = 0;
+      for (k = 0; k < 3; k++)
+        {
+          model_ray.origin[j] += instance->basis[j][k] * d[k];
+          model_ray.direction[j] += instance->basis[j][k] * ray->direction[k];
+        }
+      model_ray.origin[j] /= instance->scales[j];
+      model_ray.direction[j] /= instance->scales[j];
+    }
+  model_ray.t_min = ray->t_min;
+  model_ray.t_max = ray->t_max;
+
+  /* on equal depth the instance drawn first wins like with the depth test */
+  mesh_hit.triangles = mesh_bvh->triangles;
+  mesh_hit.accept_equal = hit->instance < 0 || primitive < hit->instance;
+  mesh_hit.hit = 0;
+  gr3_bvhtraverse_(&mesh_bvh->bvh, &model_ray, gr3_visittriangle_, &mesh_hit);
+  if (mesh_hit.hit)
+    {
+      ray->t_max = model_ray.t_max;
+      hit->instance = primitive;
+      hit->object_id = instance->object_id;
+    }
+}
+
+/*!
+ * Cast a ray through the center of pixel (px, py) of a width x height image (origin in the lower left corner) into
+ * the scene and return the object id of the nearest hit, or 0 if nothing was hit. left, right, bottom and top
+ * describe the near plane (perspective projection) or the view volume (parallel and orthographic projection).
+ */
+int gr3_selectid_raycast_(int px, int py, int width, int height, float left, float right, float bottom, float top,
+                          int *object_id)
+{
+  double inverse_view[16], origin[4], direction[4];
+  gr3_ray_t ray;
+  gr3_scenehit_t hit;
+  float x, y;
+  int i, k;
+
+  *object_id = 0;
+  if (!scene_.valid && !gr3_updatescene_())
+    {
+      RETURN_ERROR(GR3_ERROR_OUT_OF_MEM);
+    }
+  if (scene_.num_instances == 0 || !gr3_invertmatrix_(&context_struct_.view_matrix[0][0], inverse_view))
+    {
+      RETURN_ERROR(GR3_ERROR_NONE);
+    }
+
+  /* pick ray in eye space, parametrized so that t is within [t_min, t_max] between the clipping planes */
+  x = left + (right - left) * (px + 0.5f) / width;
+  y = bottom + (top - bottom) * (py + 0.5f) / height;
+  if (context_struct_.projection_type == GR3_PROJECTION_PARALLEL ||
+      context_struct_.projection_type == GR3_PROJECTION_ORTHOGRAPHIC)
+    {
+      origin[0] = x;
+      origin[1] = y;
+      direction[0] = 0;
+      direction[1] = 0;
+      direction[2] = -1;
+      ray.t_min = context_struct_.zNear;
+      ray.t_max = context_struct_.zFar;
+    }
+  else
+    {
+      origin[0] = 0;
+      origin[1] = 0;
+      direction[0] = x;
+      direction[1] = y;
+      direction[2] = -context_struct_.zNear;
+      ray.t_min = 1;
+      ray.t_max = context_struct_.zFar / context_struct_.zNear;
+    }
+  origin[2] = 0;
+  origin[3] = 1;
+  direction[3] = 0;
+  for (i = 0; i < 3; i++)
+    {
+      ray.origin[i] = 0;
+      ray.direction[i] = 0;
+      for (k = 0; k < 4; k++)
+        {
+          ray.origin[i] += inverse_view[i + k * 4] * origin[k];
+          ray.direction[i] += inverse_view[i + k * 4] * direction[k];
+        }
+    }
+
+  hit.instance = -1;
+  hit.object_id = 0;
+  gr3_bvhtraverse_(&scene_.bvh, &ray, gr3_visitinstance_, &hit);
+  *object_id = hit.object_id;
+  RETURN_ERROR(GR3_ERROR_NONE);
+}
+
+/*!
+ * Mark the instance hierarchy as outdated, it is refitted or rebuilt on the next pick.
+ */
+void gr3_invalidatepick_(void)
+{
+  scene_.valid = 0;
+}
+
+/*!
+ * Release the triangle hierarchy of a mesh.
+ */
+void gr3_deletemeshbvh_(int mesh)
+{
+  struct _GR3_MeshBVH_t_ *mesh_bvh = context_struct_.mesh_list_[mesh].data.bvh;
+
+  if (mesh_bvh != NULL)
+    {
+      gr3_bvhfree_(&mesh_bvh->bvh);
+      free(mesh_bvh->triangles);
+      free(mesh_bvh);
+      context_struct_.mesh_list_[mesh].data.bvh = NULL;
+    }
+}
+
+/*!
+ * Release all picking data structures.
+ */
+void gr3_terminatepick_(void)
+{
+  int i;
+
+  for (i = 0; i < context_struct_.mesh_list_capacity_; i++)
+    {
+      gr3_deletemeshbvh_(i);
+    }
+  gr3_bvhfree_(&scene_.bvh);
+  free(scene_.instances);
+  scene_.instances = NULL;
+  scene_.num_instances = 0;
+  scene_.valid = 0;
+}
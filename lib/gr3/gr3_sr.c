@@ -1013,6 +1013,7 @@ static color calc_colors(color_float col_one, color_float col_two, color_float c
 GR3API void gr3_getpixmap_softwarerendered(char *pixmap, int width, int height, int ssaa_factor)
 {
   int i, iy, ix;
+  GR3_DrawList_t_ *draw;
   unsigned char b_r = (unsigned char)(context_struct_.background_color[0] * 255);
   unsigned char b_g = (unsigned char)(context_struct_.background_color[1] * 255);
   unsigned char b_b = (unsigned char)(context_struct_.background_color[2] * 255);
@@ -1066,6 +1067,20 @@ GR3API void gr3_getpixmap_softwarerendered(char *pixmap, int width, int height,
     }
   pthread_mutex_unlock(&lock_main);
 
+  /* the post-transform vertex caches are only needed while the threads are drawing */
+  for (draw = context_struct_.draw_list_; draw; draw = draw->next)
+    {
+      if (draw->vertices_fp)
+        {
+          for (i = 0; i < draw->n; i++)
+            {
+              free(draw->vertices_fp[i]);
+            }
+          free(draw->vertices_fp);
+          draw->vertices_fp = NULL;
+        }
+    }
+
   if (ssaa_factor != 1)
     {
       downsample(context_struct_.pixmaps[0], (unsigned char *)pixmap, width, height, ssaa_factor);
@@ -1233,7 +1248,6 @@ static int draw_mesh_softwarerendered(queue *queues[MAX_NUM_THREADS], int mesh,
   matrix model_mat, view_mat, view_model, perspective, perspective_view_model, viewport;
   matrix3x3 model_mat_3x3, view_mat_3x3, model_view_mat_3x3;
   vector light_dir;
-  color_float c_tmp;
   vertex_fp *vertices_fp;
 
   /* initialize transformation matrices */
@@ -1280,41 +1294,35 @@ static int draw_mesh_softwarerendered(queue *queues[MAX_NUM_THREADS], int mesh,
       float *colors = context_struct_.mesh_list_[mesh].data.colors;
       float *normals = context_struct_.mesh_list_[mesh].data.normals;
       float *vertices = context_struct_.mesh_list_[mesh].data.vertices;
-      int index = 0;
-      vertex_fp tmp_v;
-      vector normal_vector;
-      draw->vertices_fp[draw_id] = malloc(sizeof(vertex_fp) * context_struct_.mesh_list_[mesh].data.number_of_indices);
+      /* post-transform vertex cache: every vertex is transformed exactly once, the worker threads assemble the
+       * triangles from it using the index buffer */
+      draw->vertices_fp[draw_id] = malloc(sizeof(vertex_fp) * num_vertices);
       vertices_fp = draw->vertices_fp[draw_id];
-      for (i = 0; i < num_vertices * 3; i += 3)
-        {
-          c_tmp.r = colors[i];
-          c_tmp.g = colors[i + 1];
-          c_tmp.b = colors[i + 2];
-          c_tmp.a = 1.0f;
-          tmp_v.x = vertices[i];
-          tmp_v.y = vertices[i + 1];
-          tmp_v.z = vertices[i + 2];
-          tmp_v.w = 1.0;
-          tmp_v.w_div = 1.0;
-          tmp_v.c = c_tmp;
-          normal_vector.x = normals[i] / scales[0];
-          normal_vector.y = normals[i + 1] / scales[1];
-          normal_vector.z = normals[i + 2] / scales[2];
-          tmp_v.normal = normal_vector;
-          index = (int)(i / 3);
-          vertices_fp[index] = tmp_v;
-        }
-      for (i = 0; i < num_vertices; i++)
+      for (i = 0; vertices_fp != NULL && i < num_vertices; i++)
         {
-          mat_vec_mul_4x1(&perspective_view_model, &vertices_fp[i]);
-          divide_by_w(&vertices_fp[i]);
-          mat_vec_mul_4x1(&viewport, &vertices_fp[i]);
-          mat_vec_mul_3x1(&model_view_mat_3x3, &vertices_fp[i].normal);
+          vertex_fp *v = &vertices_fp[i];
+          v->c.r = colors[i * 3];
+          v->c.g = colors[i * 3 + 1];
+          v->c.b = colors[i * 3 + 2];
+          v->c.a = 1.0f;
+          v->x = vertices[i * 3];
+          v->y = vertices[i * 3 + 1];
+          v->z = vertices[i * 3 + 2];
+          v->w = 1.0;
+          v->w_div = 1.0;
+          v->normal.x = normals[i * 3] / scales[0];
+          v->normal.y = normals[i * 3 + 1] / scales[1];
+          v->normal.z = normals[i * 3 + 2] / scales[2];
+          mat_vec_mul_4x1(&perspective_view_model, v);
+          divide_by_w(v);
+          mat_vec_mul_4x1(&viewport, v);
+          mat_vec_mul_3x1(&model_view_mat_3x3, &v->normal);
         }
-      numtri = context_struct_.mesh_list_[mesh].data.number_of_indices / 3;
+      /* without a vertex cache the threads still have to receive their (empty) jobs */
+      numtri = vertices_fp != NULL ? context_struct_.mesh_list_[mesh].data.number_of_indices / 3 : 0;
       tri_per_thread = numtri / context_struct_.num_threads;
       index_start_end[0] = 0;
-      index_start_end[context_struct_.num_threads] = context_struct_.mesh_list_[mesh].data.number_of_indices / 3;
+      index_start_end[context_struct_.num_threads] = numtri;
     }
   else
     {
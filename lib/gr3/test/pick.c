@@ -0,0 +1,76 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "gr3.h"
+
+#define SIDE 24
+#define WIDTH 800
+#define HEIGHT 800
+#define FOVY 45.0
+
+static float positions[SIDE * SIDE * SIDE * 3], colors[SIDE * SIDE * SIDE * 3], radii[SIDE * SIDE * SIDE];
+
+static void project(const float *position, int *px, int *py)
+{
+  float m[16], v[4];
+  double f = tan(FOVY * 3.14159265358979323846 / 360);
+  int k;
+
+  gr3_getviewmatrix(m);
+  for (k = 0; k < 4; k++)
+    {
+      v[k] = m[k] * position[0] + m[4 + k] * position[1] + m[8 + k] * position[2] + m[12 + k];
+    }
+  *px = (int)((-v[0] / v[2] / f + 1) / 2 * WIDTH);
+  *py = (int)((-v[1] / v[2] / f + 1) / 2 * HEIGHT);
+}
+
+static int test_pick(void)
+{
+  int n = SIDE * SIDE * SIDE, front = SIDE * SIDE * (SIDE - 1), attrib_list[] = {GR3_IA_END_OF_LIST};
+  int i, id, px, py, mismatches = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      positions[3 * i] = (float)(i % SIDE) - SIDE / 2.0f;
+      positions[3 * i + 1] = (float)(i / SIDE % SIDE) - SIDE / 2.0f;
+      positions[3 * i + 2] = (float)(i / SIDE / SIDE) - SIDE / 2.0f;
+      colors[3 * i] = colors[3 * i + 1] = colors[3 * i + 2] = 1;
+      radii[i] = 0.3f;
+    }
+  if (gr3_init(attrib_list) != GR3_ERROR_NONE)
+    {
+      printf("gr3_init failed: %s\n", gr3_geterrorstring(gr3_geterror(1, NULL, NULL)));
+      return 1;
+    }
+  gr3_cameralookat(0.3f, 0.2f, SIDE * 2.0f, 0, 0, 0, 0, 1, 0);
+  gr3_setcameraprojectionparameters((float)FOVY, 1, SIDE * 10.0f);
+
+  /* one instance per sphere, so that the instance hierarchy is several levels deep */
+  for (i = 0; i < n; i++)
+    {
+      gr3_setobjectid(i + 1);
+      gr3_drawspheremesh(1, positions + 3 * i, colors + 3 * i, radii + i);
+    }
+
+  /* the spheres of the layer closest to the camera must be picked at their projected centers */
+  for (i = front; i < n; i++)
+    {
+      project(positions + 3 * i, &px, &py);
+      gr3_selectid(px, py, WIDTH, HEIGHT, &id);
+      if (id != i + 1) mismatches++;
+    }
+  printf("picked %d spheres, %d mismatches\n", n - front, mismatches);
+
+  gr3_selectid(0, 0, WIDTH, HEIGHT, &id);
+  printf("background id: %d\n", id);
+  if (id != 0) mismatches++;
+
+  gr3_terminate();
+  return mismatches != 0;
+}
+
+int main(void)
+{
+  return test_pick();
+}
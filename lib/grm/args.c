@@ -33,6 +33,10 @@ static int argparse_static_variables_initialized = 0;
 static const char *const ARGS_VALID_FORMAT_SPECIFIERS = "niIdDcCsSaA";
 static const char *const ARGS_VALID_DATA_FORMAT_SPECIFIERS = "idcsa"; /* Each specifier is also valid in upper case */
 
+/* Source of the generations of all argument containers. Every creation or modification of a container draws a new,
+ * never used value, so an unchanged generation means unchanged contents. */
+static unsigned int args_generation_counter = 0;
+
 
 /* ========================= functions ============================================================================== */
 
@@ -668,8 +672,64 @@ arg_t *args_create_args(const char *key, const char *value_format, const void *b
       return NULL;
     }
   arg->priv->reference_count = 1;
+  arg->priv->is_reference = 0;
+  arg->priv->release = NULL;
+
+  return arg;
+}
+
+arg_t *args_create_reference_arg(const char *key, const char *value_format, size_t length, void *buffer,
+                                 grm_args_release_t release)
+{
+  /* Create an array argument which stores `buffer` itself instead of a copy. The value buffer has the same layout as
+   * a parsed `nD` / `nI` value, so all readers of the argument are unaware of the difference. */
+  arg_t *arg;
+  size_t *size_t_typed_buffer;
+
+  if (value_format == NULL || strlen(value_format) != 1 || strchr("DI", *value_format) == NULL)
+    {
+      debug_print_error(("Only \"D\" and \"I\" arrays can be pushed as references.\n"));
+      return NULL;
+    }
+
+  arg = malloc(sizeof(arg_t));
+  if (arg == NULL)
+    {
+      debug_print_malloc_error();
+      return NULL;
+    }
+  arg->key = NULL;
+  arg->value_format = NULL;
+  arg->value_ptr = NULL;
+  arg->priv = NULL;
+  if (key != NULL)
+    {
+      arg->key = gks_strdup(key);
+      error_cleanup_if(arg->key == NULL);
+    }
+  arg->value_format = malloc(2 * strlen(value_format) + 1);
+  error_cleanup_if(arg->value_format == NULL);
+  args_copy_format_string_for_arg((char *)arg->value_format, value_format);
+  arg->value_ptr = malloc(sizeof(size_t) + sizeof(void *));
+  error_cleanup_if(arg->value_ptr == NULL);
+  size_t_typed_buffer = arg->value_ptr;
+  *size_t_typed_buffer = length;
+  *(void **)(size_t_typed_buffer + 1) = buffer;
+  arg->priv = malloc(sizeof(arg_private_t));
+  error_cleanup_if(arg->priv == NULL);
+  arg->priv->reference_count = 1;
+  arg->priv->is_reference = 1;
+  arg->priv->release = release;
 
   return arg;
+
+error_cleanup:
+  debug_print_malloc_error();
+  free((char *)arg->key);
+  free((char *)arg->value_format);
+  free(arg->value_ptr);
+  free(arg);
+  return NULL;
 }
 
 int args_validate_format_string(const char *format)
@@ -921,8 +981,21 @@ void args_decrease_arg_reference_count(args_node_t *args_node)
 {
   if (--(args_node->arg->priv->reference_count) == 0)
     {
-      args_value_iterator_t *value_it = arg_value_iter(args_node->arg);
-      while (value_it->next(value_it) != NULL)
+      args_value_iterator_t *value_it;
+      if (args_node->arg->priv->is_reference)
+        {
+          /* The referenced buffer is owned by the caller, hand it back instead of freeing it */
+          if (args_node->arg->priv->release != NULL)
+            {
+              args_node->arg->priv->release(*(void **)((size_t *)args_node->arg->value_ptr + 1));
+            }
+          value_it = NULL;
+        }
+      else
+        {
+          value_it = arg_value_iter(args_node->arg);
+        }
+      while (value_it != NULL && value_it->next(value_it) != NULL)
         {
           /* use a char pointer since chars have no memory alignment restrictions */
           if (value_it->is_array)
@@ -945,7 +1018,10 @@ void args_decrease_arg_reference_count(args_node_t *args_node)
               argparse_format_to_delete_callback[(int)value_it->format](*(char **)value_it->value_ptr);
             }
         }
-      args_value_iterator_delete(value_it);
+      if (value_it != NULL)
+        {
+          args_value_iterator_delete(value_it);
+        }
       free((char *)args_node->arg->key);
       free((char *)args_node->arg->value_format);
       free(args_node->arg->priv);
@@ -971,6 +1047,8 @@ error_t arg_increase_array(arg_t *arg, size_t increment)
   int has_array_terminator;
 
   return_error_if(arg->value_format[0] != 'n', ERROR_ARGS_INCREASING_NON_ARRAY_VALUE);
+  /* A referenced buffer is owned by the caller and must not be reallocated */
+  return_error_if(arg->priv->is_reference, ERROR_UNSUPPORTED_OPERATION);
   /* Currently, only one dimensional arrays can be increased */
   return_error_if(strlen(arg->value_format) != 2, ERROR_ARGS_INCREASING_MULTI_DIMENSIONAL_ARRAY);
 
@@ -1203,6 +1281,7 @@ void args_init(grm_args_t *args)
   args->kwargs_head = NULL;
   args->kwargs_tail = NULL;
   args->count = 0;
+  args->generation = ++args_generation_counter;
 }
 
 void args_finalize(grm_args_t *args)
@@ -1433,6 +1512,7 @@ error_t args_push_common(grm_args_t *args, const char *key, const char *value_fo
         }
       ++(args->count);
     }
+  args->generation = ++args_generation_counter;
 
   return NO_ERROR;
 }
@@ -1490,10 +1570,12 @@ error_t args_push_arg(grm_args_t *args, arg_t *arg)
       args->kwargs_tail = args_node;
       ++(args->count);
     }
+  args->generation = ++args_generation_counter;
 
   return NO_ERROR;
 
 error_cleanup:
+  --(arg->priv->reference_count);
   if (args_node != NULL)
     {
       free(args_node);
@@ -1663,6 +1745,7 @@ void args_clear(grm_args_t *args, const char **exclude_keys)
     {
       args->kwargs_tail->next = NULL;
     }
+  args->generation = ++args_generation_counter;
 }
 
 error_t args_increase_array(grm_args_t *args, const char *key, size_t increment)
@@ -1671,6 +1754,7 @@ error_t args_increase_array(grm_args_t *args, const char *key, size_t increment)
 
   arg = args_at(args, key);
   return_error_if(arg == NULL, ERROR_ARGS_INVALID_KEY);
+  args->generation = ++args_generation_counter;
   return arg_increase_array(arg, increment);
 }
 
@@ -1679,6 +1763,60 @@ unsigned int args_count(const grm_args_t *args)
   return args->count;
 }
 
+unsigned int args_generation(const grm_args_t *args)
+{
+  return args->generation;
+}
+
+unsigned int args_nested_generation(const grm_args_t *args)
+{
+  /* Return the newest generation of `args` and all argument containers stored in it, so changes of nested containers
+   * are noticed without touching their parents. If the nested containers cannot be inspected, a new generation is
+   * returned which does not match any earlier one. */
+  args_node_t *current_node;
+  args_value_iterator_t *value_it;
+  grm_args_t **current_args;
+  unsigned int generation = args->generation;
+
+  for (current_node = args->kwargs_head; current_node != NULL; current_node = current_node->next)
+    {
+      if (strncmp(current_node->arg->value_format, "a", 1) != 0 &&
+          strncmp(current_node->arg->value_format, "nA", 2) != 0)
+        {
+          continue;
+        }
+      value_it = arg_value_iter(current_node->arg);
+      if (value_it == NULL || value_it->next(value_it) == NULL)
+        {
+          if (value_it != NULL)
+            {
+              args_value_iterator_delete(value_it);
+            }
+          return ++args_generation_counter;
+        }
+      if (value_it->is_array)
+        {
+          for (current_args = *(grm_args_t ***)value_it->value_ptr; *current_args != NULL; ++current_args)
+            {
+              generation = max(generation, args_nested_generation(*current_args));
+            }
+        }
+      else
+        {
+          generation = max(generation, args_nested_generation(*(grm_args_t **)value_it->value_ptr));
+        }
+      args_value_iterator_delete(value_it);
+    }
+
+  return generation;
+}
+
+void args_touch(grm_args_t *args)
+{
+  /* Give `args` a new generation after a value stored in it was modified in place */
+  args->generation = ++args_generation_counter;
+}
+
 arg_t *args_at(const grm_args_t *args, const char *keyword)
 {
   args_node_t *current_node;
@@ -1999,6 +2137,35 @@ int grm_args_push_buf(grm_args_t *args, const char *key, const char *value_forma
   return error == NO_ERROR;
 }
 
+int grm_args_push_ref(grm_args_t *args, const char *key, const char *value_format, size_t length, void *buffer,
+                      grm_args_release_t release)
+{
+  /* Push the array `buffer` without copying it. The argument container and all containers it is merged into share
+   * the buffer; `release` is called with `buffer` when the last of them drops the value. If `release` is NULL, the
+   * buffer is only borrowed and the caller must keep it alive as long as it is referenced. A referenced buffer must
+   * not be modified in place; push it again to announce new contents. On failure, the caller keeps the ownership. */
+  args_node_t node;
+  arg_t *arg;
+  error_t error;
+
+  arg = args_create_reference_arg(key, value_format, length, buffer, release);
+  if (arg == NULL)
+    {
+      return 0;
+    }
+  error = args_push_arg(args, arg);
+  if (error != NO_ERROR)
+    {
+      arg->priv->release = NULL;
+    }
+  /* `args_push_arg` holds its own reference, so drop the initial one */
+  node.arg = arg;
+  node.next = NULL;
+  args_decrease_arg_reference_count(&node);
+
+  return error == NO_ERROR;
+}
+
 int grm_args_contains(const grm_args_t *args, const char *keyword)
 {
   return args_at(args, keyword) != NULL;
@@ -2038,5 +2205,6 @@ void grm_args_remove(grm_args_t *args, const char *key)
             }
         }
       --(args->count);
+      args->generation = ++args_generation_counter;
     }
 }
@@ -40,6 +40,8 @@ typedef struct _grm_args_t grm_args_t;
 
 typedef grm_args_t *grm_args_ptr_t;
 
+typedef void (*grm_args_release_t)(void *);
+
 /* ------------------------- argument iterator ---------------------------------------------------------------------- */
 
 struct _args_iterator_private_t;
@@ -76,6 +78,7 @@ EXPORT grm_args_t *grm_args_new(void);
 EXPORT void grm_args_delete(grm_args_t *);
 EXPORT int grm_args_push(grm_args_t *, const char *, const char *, ...);
 EXPORT int grm_args_push_buf(grm_args_t *, const char *, const char *, const void *, int);
+EXPORT int grm_args_push_ref(grm_args_t *, const char *, const char *, size_t, void *, grm_args_release_t);
 EXPORT int grm_args_contains(const grm_args_t *, const char *);
 EXPORT void grm_args_clear(grm_args_t *);
 EXPORT void grm_args_remove(grm_args_t *, const char *);
@@ -21,6 +21,9 @@
 struct _arg_private_t
 {
   unsigned int reference_count;
+  /* Set for arrays which reference a caller owned buffer instead of a copy (-> see `grm_args_push_ref`) */
+  int is_reference;
+  grm_args_release_t release;
 };
 
 
@@ -58,6 +61,7 @@ struct _grm_args_t
   args_node_t *kwargs_head;
   args_node_t *kwargs_tail;
   unsigned int count;
+  unsigned int generation;
 };
 
 /* ------------------------- argument iterator ---------------------------------------------------------------------- */
@@ -100,6 +104,8 @@ char *argparse_convert_to_array(argparse_state_t *state);
 /* ------------------------- argument container --------------------------------------------------------------------- */
 
 arg_t *args_create_args(const char *key, const char *value_format, const void *buffer, va_list *vl, int apply_padding);
+arg_t *args_create_reference_arg(const char *key, const char *value_format, size_t length, void *buffer,
+                                 grm_args_release_t release);
 int args_validate_format_string(const char *format);
 const char *args_skip_option(const char *format);
 void args_copy_format_string_for_arg(char *dst, const char *format);
@@ -148,6 +154,9 @@ void args_clear(grm_args_t *args, const char **exclude_keys);
 error_t args_increase_array(grm_args_t *args, const char *key, size_t increment) UNUSED;
 
 unsigned int args_count(const grm_args_t *args) UNUSED;
+unsigned int args_generation(const grm_args_t *args);
+unsigned int args_nested_generation(const grm_args_t *args);
+void args_touch(grm_args_t *args);
 
 arg_t *args_at(const grm_args_t *args, const char *keyword);
 int args_first_value(const grm_args_t *args, const char *keyword, const char *first_value_format, void *first_value,
@@ -7,6 +7,7 @@
 #include <float.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "dump.h"
@@ -14,6 +15,7 @@
 #include "gks.h"
 #include "gr.h"
 #include "logging_int.h"
+#include "parallel.h"
 #include "plot_int.h"
 
 #include "datatype/string_map_int.h"
@@ -95,6 +97,41 @@ static int plot_scatter_markertypes[] = {
     GKS_K_MARKERTYPE_HLINE,          GKS_K_MARKERTYPE_OMARK,        INT_MAX};
 
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ heatmap ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Buffers are kept between redraws of a heatmap. The logarithms of `z` belong to the recorded series container, they
+ * are valid as long as its generation does not change. */
+static struct
+{
+  const grm_args_t *series;
+  unsigned int series_generation;
+  const double *z;
+  unsigned int log_values_length;
+  double *log_values;
+  unsigned int data_length;
+  int *data;
+} heatmap_cache = {NULL, 0, NULL, 0, NULL, 0, NULL};
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ segment cache ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* If a plot has `cache_subplots` and `clear` set, subplot `i` of the last drawn plot is recorded into the GKS segment
+ * `i + 1` on a workstation independent segment storage (workstation `PLOT_SEGMENT_WORKSTATION_ID`). The recorded
+ * generation is the newest generation of the subplot and all containers nested in it after drawing, so a subplot with
+ * the same arguments container and generation is redrawn by copying its segment. Only the plot container itself is
+ * compared for the plot level, as its subplots are checked one by one. */
+static struct
+{
+  int unavailable;
+  const grm_args_t *plot_args;
+  unsigned int plot_generation;
+  double wswindow[4];
+  double wsviewport[4];
+  unsigned int capacity;
+  plot_segment_t *segments;
+} segment_cache = {0, NULL, 0, {0.0, 0.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 0.0}, 0, NULL};
+
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~ args ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 static grm_args_t *global_root_args = NULL;
@@ -108,7 +145,7 @@ event_queue_t *event_queue = NULL;
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~ kind to fmt ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-/* TODO: Check format of: "hist", "isosurface", "imshow"  */
+/* TODO: Check format of: "isosurface", "imshow"  */
 static string_map_entry_t kind_to_fmt[] = {{"line", "xys"},      {"hexbin", "xys"},
                                            {"polar", "xys"},     {"shade", "xys"},
                                            {"stem", "xys"},      {"step", "xys"},
@@ -117,7 +154,7 @@ static string_map_entry_t kind_to_fmt[] = {{"line", "xys"},      {"hexbin", "xys
                                            {"surface", "xyzc"},  {"wireframe", "xyzc"},
                                            {"plot3", "xyzc"},    {"scatter", "xyzc"},
                                            {"scatter3", "xyzc"}, {"quiver", "xyuv"},
-                                           {"heatmap", "xyzc"},  {"hist", "x"},
+                                           {"heatmap", "xyzc"},  {"hist", "xy"},
                                            {"barplot", "xy"},    {"isosurface", "x"},
                                            {"imshow", ""},       {"nonuniformheatmap", "xyzc"}};
 
@@ -166,6 +203,8 @@ const char *plot_clear_exclude_keys[] = {"array_index", "in_use", NULL};
 
 const char *plot_merge_ignore_keys[] = {"id", "series_id", "subplot_id", "plot_id", "array_index", "in_use", NULL};
 const char *plot_merge_clear_keys[] = {"series", NULL};
+/* histogram bins survive the series clear of a held merge, so that new samples are added to them */
+const char *plot_merge_series_exclude_keys[] = {"array_index", "in_use", "bin_counts", "bin_edges", "bin_log", NULL};
 
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~ valid keys ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -174,9 +213,10 @@ const char *plot_merge_clear_keys[] = {"series", NULL};
  * flat object that mixes keys of different hierarchies */
 
 const char *valid_root_keys[] = {"plots", "append_plots", "hold_plots", NULL};
-const char *valid_plot_keys[] = {"clear", "figsize", "size", "subplots", "update", NULL};
+const char *valid_plot_keys[] = {"cache_subplots", "clear", "figsize", "size", "subplots", "update", NULL};
 const char *valid_subplot_keys[] = {"adjust_xlim",  "adjust_ylim",
                                     "adjust_zlim",  "backgroundcolor",
+                                    "bin_rule",     "bin_width",
                                     "colormap",     "keep_aspect_ratio",
                                     "kind",         "labels",
                                     "levels",       "location",
@@ -192,7 +232,8 @@ const char *valid_subplot_keys[] = {"adjust_xlim",  "adjust_ylim",
                                     "ylog",         "zflip",
                                     "zlim",         "zlog",
                                     "clim",         NULL};
-const char *valid_series_keys[] = {"a", "c", "markertype", "s", "spec", "step_where", "u", "v", "x", "y", "z", NULL};
+const char *valid_series_keys[] = {"a", "c", "markertype", "s", "spec", "step_where", "u", "v", "weights", "x", "y",
+                                   "z", NULL};
 
 /* ========================= functions ============================================================================== */
 
@@ -395,7 +436,7 @@ error_t plot_merge_args(grm_args_t *args, const grm_args_t *merge_args, const ch
           if (clear_args)
             {
               logger((stderr, "Perform a clear on the current args container\n"));
-              grm_args_clear(current_args);
+              args_clear(current_args, plot_merge_series_exclude_keys);
               if (cleared_args == NULL)
                 {
                   cleared_args = args_set_new(10); /* FIXME: do not use a magic number, use a growbable set instead! */
@@ -629,6 +670,7 @@ void plot_set_attribute_defaults(grm_args_t *plot_args)
 
   args_setdefault(plot_args, "clear", "i", PLOT_DEFAULT_CLEAR);
   args_setdefault(plot_args, "update", "i", PLOT_DEFAULT_UPDATE);
+  args_setdefault(plot_args, "cache_subplots", "i", PLOT_DEFAULT_CACHE_SUBPLOTS);
   if (!grm_args_contains(plot_args, "figsize"))
     {
       args_setdefault(plot_args, "size", "dd", PLOT_DEFAULT_WIDTH, PLOT_DEFAULT_HEIGHT);
@@ -777,6 +819,10 @@ void plot_pre_subplot(grm_args_t *subplot_args)
   else
     {
       plot_process_viewport(subplot_args);
+      if (strcmp(kind, "hist") == 0)
+        {
+          plot_process_hist_bins(subplot_args);
+        }
       plot_store_coordinate_ranges(subplot_args);
       plot_process_window(subplot_args);
       if (str_equals_any(kind, 1, "polar"))
@@ -1187,7 +1233,13 @@ void plot_store_coordinate_ranges(grm_args_t *subplot_args)
           args_first_value(subplot_args, "series", "A", &current_series, &series_count);
           while (*current_series != NULL)
             {
-              if (args_first_value(*current_series, *current_component_name, "D", &current_component, &point_count))
+              const char *series_component_name = *current_component_name;
+              if (strcmp(kind, "hist") == 0 && !grm_args_contains(*current_series, "y"))
+                {
+                  /* histograms of raw samples are bounded by their bins */
+                  series_component_name = (strcmp(series_component_name, "x") == 0) ? "bin_edges" : "bin_counts";
+                }
+              if (args_first_value(*current_series, series_component_name, "D", &current_component, &point_count))
                 {
                   for (i = 0; i < point_count; i++)
                     {
@@ -1197,6 +1249,10 @@ void plot_store_coordinate_ranges(grm_args_t *subplot_args)
                 }
               ++current_series;
             }
+          if (strcmp(kind, "hist") == 0 && strcmp("y", *current_component_name) == 0)
+            {
+              min_component = 0;
+            }
           if (strcmp(kind, "quiver") == 0)
             {
               step = max(find_max_step(point_count, current_component), step);
@@ -1260,6 +1316,69 @@ void plot_store_coordinate_ranges(grm_args_t *subplot_args)
     }
 }
 
+error_t plot_process_hist_bins(grm_args_t *subplot_args)
+{
+  const char *bin_rule = PLOT_DEFAULT_HIST_BIN_RULE;
+  double bin_width = 0.0;
+  int nbins = 0;
+  int ranges_changed = 0;
+  grm_args_t **current_series;
+  error_t error = NO_ERROR;
+
+  args_values(subplot_args, "bin_rule", "s", &bin_rule);
+  args_values(subplot_args, "bin_width", "d", &bin_width);
+  args_values(subplot_args, "nbins", "i", &nbins);
+  args_values(subplot_args, "series", "A", &current_series);
+  while (*current_series != NULL)
+    {
+      double *x, *weights = NULL, *edges, *counts;
+      unsigned int x_length, weights_length, edges_length, counts_length;
+      int bin_log = 0;
+      /* Series with precomputed counts and samples which were already binned are left untouched. The
+       * `samples_binned` flag is removed with the samples when a merge replaces the series data. */
+      if (grm_args_contains(*current_series, "y") || grm_args_contains(*current_series, "samples_binned") ||
+          !args_first_value(*current_series, "x", "D", &x, &x_length))
+        {
+          ++current_series;
+          continue;
+        }
+      if (args_first_value(*current_series, "weights", "D", &weights, &weights_length) && weights_length != x_length)
+        {
+          logger((stderr, "The number of weights (%u) does not match the number of samples (%u)\n", weights_length,
+                  x_length));
+          return ERROR_PLOT_COMPONENT_LENGTH_MISMATCH;
+        }
+      if (args_first_value(*current_series, "bin_edges", "D", &edges, &edges_length) &&
+          args_first_value(*current_series, "bin_counts", "D", &counts, &counts_length) &&
+          edges_length == counts_length + 1)
+        {
+          /* Held series keep their bins, so appended samples are added to the existing counts */
+          args_values(*current_series, "bin_log", "i", &bin_log);
+          error = hist_accumulate(*current_series, x_length, x, weights, bin_log, counts_length, edges, counts);
+        }
+      else
+        {
+          error = hist_bin(*current_series, x_length, x, weights, bin_rule, nbins, bin_width);
+        }
+      if (error != NO_ERROR)
+        {
+          logger((stderr, "Binning the histogram samples failed with error \"%d\" (\"%s\")\n", error,
+                  error_names[error]));
+          return error;
+        }
+      grm_args_push(*current_series, "samples_binned", "i", 1);
+      ranges_changed = 1;
+      ++current_series;
+    }
+  if (ranges_changed)
+    {
+      grm_args_remove(subplot_args, "xrange");
+      grm_args_remove(subplot_args, "yrange");
+    }
+
+  return NO_ERROR;
+}
+
 void plot_post_plot(grm_args_t *plot_args)
 {
   int update;
@@ -1336,7 +1455,7 @@ error_t plot_get_args_in_hierarchy(grm_args_t *args, const char **hierarchy_name
           current_args = args_array[current_id - 1];
           if (strcmp(*current_hierarchy_name_ptr, "plots") == 0)
             {
-              int in_use;
+              int in_use = 0;
               error_t error = NO_ERROR;
               args_values(current_args, "in_use", "i", &in_use);
               if (in_use)
@@ -1348,7 +1467,11 @@ error_t plot_get_args_in_hierarchy(grm_args_t *args, const char **hierarchy_name
                   error = event_queue_enqueue_new_plot_event(event_queue, current_id - 1);
                 }
               return_if_error;
-              grm_args_push(current_args, "in_use", "i", 1);
+              if (!in_use)
+                {
+                  /* Pushing changes the generation of the plot, so only mark it once */
+                  grm_args_push(current_args, "in_use", "i", 1);
+                }
             }
           if (strcmp(*current_hierarchy_name_ptr, key_hierarchy_name) == 0)
             {
@@ -1661,20 +1784,35 @@ error_t plot_hist(grm_args_t *subplot_args)
   args_values(subplot_args, "series", "A", &current_series);
   while (*current_series != NULL)
     {
-      double *x, *y;
-      unsigned int x_length, y_length;
+      double *edges, *counts;
+      unsigned int edges_length, counts_length, bar_count;
       unsigned int i;
-      return_error_if(!args_first_value(*current_series, "x", "D", &x, &x_length), ERROR_PLOT_MISSING_DATA);
-      return_error_if(!args_first_value(*current_series, "y", "D", &y, &y_length), ERROR_PLOT_MISSING_DATA);
-      return_error_if(x_length != y_length, ERROR_PLOT_COMPONENT_LENGTH_MISMATCH);
-      for (i = 0; i <= y_length; ++i)
+      if (args_first_value(*current_series, "y", "D", &counts, &counts_length))
+        {
+          /* precomputed counts with bin edges in `x` (one edge per count is accepted for compatibility) */
+          return_error_if(!args_first_value(*current_series, "x", "D", &edges, &edges_length),
+                          ERROR_PLOT_MISSING_DATA);
+          return_error_if(edges_length != counts_length + 1 && edges_length != counts_length,
+                          ERROR_PLOT_COMPONENT_LENGTH_MISMATCH);
+          bar_count = (edges_length > 0) ? edges_length - 1 : 0;
+        }
+      else
+        {
+          return_error_if(!args_first_value(*current_series, "bin_edges", "D", &edges, &edges_length),
+                          ERROR_PLOT_MISSING_DATA);
+          return_error_if(!args_first_value(*current_series, "bin_counts", "D", &counts, &counts_length),
+                          ERROR_PLOT_MISSING_DATA);
+          return_error_if(edges_length != counts_length + 1, ERROR_PLOT_COMPONENT_LENGTH_MISMATCH);
+          bar_count = counts_length;
+        }
+      for (i = 0; i < bar_count; ++i)
         {
           gr_setfillcolorind(989);
           gr_setfillintstyle(GKS_K_INTSTYLE_SOLID);
-          gr_fillrect(x[i - 1], x[i], y_min, y[i - 1]);
+          gr_fillrect(edges[i], edges[i + 1], y_min, counts[i]);
           gr_setfillcolorind(1);
           gr_setfillintstyle(GKS_K_INTSTYLE_HOLLOW);
-          gr_fillrect(x[i - 1], x[i], y_min, y[i - 1]);
+          gr_fillrect(edges[i], edges[i + 1], y_min, counts[i]);
         }
       ++current_series;
     }
@@ -1913,9 +2051,10 @@ error_t plot_heatmap(grm_args_t *subplot_args)
 {
   const char *kind = NULL;
   grm_args_t **current_series;
-  int i, zlim_set, icmap[256], *rgba, *data, zlog;
-  unsigned int width, height, z_length;
-  double *x, *y, *z, z_min, z_max, c_min, c_max, tmp, zv;
+  int i, is_heatmap, zlog, colors[256], invalid_color, *data;
+  unsigned int width, height, z_length, n;
+  double *x, *y, *z, *values, *log_values = NULL, z_min, z_max, c_min, c_max;
+  error_t error = NO_ERROR;
 
   args_values(subplot_args, "series", "A", &current_series);
   args_values(subplot_args, "kind", "s", &kind);
@@ -1928,12 +2067,6 @@ error_t plot_heatmap(grm_args_t *subplot_args)
       zlog = 0;
     }
 
-  if (zlog)
-    {
-      z_min = log(z_min);
-      z_max = log(z_max);
-    }
-
   if (!args_values(subplot_args, "crange", "dd", &c_min, &c_max))
     {
       c_min = z_min;
@@ -1941,94 +2074,92 @@ error_t plot_heatmap(grm_args_t *subplot_args)
     }
   if (zlog)
     {
+      z_min = log(z_min);
+      z_max = log(z_max);
       c_min = log(c_min);
       c_max = log(c_max);
     }
 
-  if (str_equals_any(kind, 1, "nonuniformheatmap"))
+  is_heatmap = str_equals_any(kind, 1, "heatmap");
+  if (!is_heatmap)
     {
       --width;
       --height;
     }
+  n = width * height;
+  return_error_if(z_length < n, ERROR_PLOT_COMPONENT_LENGTH_MISMATCH);
+
+  /* The colors are read from GR on every redraw, as they can also be changed with GR functions directly */
   for (i = 0; i < 256; i++)
     {
-      gr_inqcolor(1000 + i, icmap + i);
+      if (is_heatmap)
+        {
+          gr_inqcolor(1000 + i, colors + i);
+          colors[i] += 255 << 24;
+        }
+      else
+        {
+          colors[i] = 1000 + i;
+        }
+    }
+  /* Values outside of the z range are transparent: for `gr_nonuniformcellarray`, 1257 is an invalid color index */
+  invalid_color = is_heatmap ? 0 : 1256 + 1;
+
+  if (heatmap_cache.data_length < n)
+    {
+      data = realloc(heatmap_cache.data, n * sizeof(int));
+      return_error_if(data == NULL, ERROR_MALLOC);
+      heatmap_cache.data = data;
+      heatmap_cache.data_length = n;
     }
+  data = heatmap_cache.data;
 
-  data = malloc(height * width * sizeof(int));
   if (z_max > z_min)
     {
-      for (i = 0; i < width * height; i++)
+      values = z;
+      if (zlog)
         {
-          if (zlog)
+          /* The logarithms are valid until a merge changes the series, so changing the color range does not need to
+           * recompute them. */
+          if (heatmap_cache.series == *current_series &&
+              heatmap_cache.series_generation == args_generation(*current_series) && heatmap_cache.z == z &&
+              heatmap_cache.log_values_length == n)
             {
-              zv = log(z[i]);
+              values = heatmap_cache.log_values;
             }
           else
             {
-              zv = z[i];
-            }
-
-          if (zv > z_max || zv < z_min)
-            {
-              data[i] = -1;
-            }
-          else
-            {
-              data[i] = (int)((zv - c_min) / (c_max - c_min) * 255);
-              if (data[i] >= 255)
-                {
-                  data[i] = 255;
-                }
-              else if (data[i] < 0)
-                {
-                  data[i] = 0;
-                }
+              log_values = realloc(heatmap_cache.log_values, n * sizeof(double));
+              return_error_if(log_values == NULL, ERROR_MALLOC);
+              heatmap_cache.log_values = log_values;
+              heatmap_cache.log_values_length = n;
+              heatmap_cache.series = *current_series;
+              heatmap_cache.series_generation = args_generation(*current_series);
+              heatmap_cache.z = z;
             }
         }
+      error = heatmap_colorize(n, values, log_values, z_min, z_max, c_min, c_max, colors, invalid_color, data);
+      return_if_error;
     }
   else
     {
-      for (i = 0; i < width * height; i++)
+      for (i = 0; i < n; i++)
         {
-          data[i] = 0;
+          data[i] = colors[0];
         }
     }
-  rgba = malloc(height * width * sizeof(int));
-  if (str_equals_any(kind, 1, "heatmap"))
+
+  if (is_heatmap)
     {
-      for (i = 0; i < height * width; i++)
-        {
-          if (data[i] == -1)
-            {
-              rgba[i] = 0;
-            }
-          else
-            {
-              rgba[i] = (255 << 24) + icmap[data[i]];
-            }
-        }
-      gr_drawimage(0.5, width + 0.5, height + 0.5, 0.5, width, height, rgba, 0);
+      gr_drawimage(0.5, width + 0.5, height + 0.5, 0.5, width, height, data, 0);
     }
   else
     {
-      for (i = 0; i < height * width; i++)
-        {
-          if (data[i] == -1)
-            {
-              rgba[i] = 1256 + 1; /* Invalid color index -> gr_nonuniformcellarray draws a transparent rectangle */
-            }
-          else
-            {
-              rgba[i] = data[i] + 1000;
-            }
-        }
-      gr_nonuniformcellarray(x, y, width, height, 1, 1, width, height, rgba);
+      gr_nonuniformcellarray(x, y, width, height, 1, 1, width, height, data);
     }
-  free(rgba);
-  free(data);
 
   plot_draw_colorbar(subplot_args, 0.0, 256);
+
   return NO_ERROR;
 }
 
@@ -2726,6 +2857,617 @@ error_t plot_draw_colorbar(grm_args_t *args, double off, unsigned int colors)
 }
 
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ histogram ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+ * Histogram bins are equally spaced in "bin space", which is either the sample space or, for logarithmic bins, its
+ * decadic logarithm. They are described by the bin space origin, the bin width and the number of bins and are stored
+ * as `bin_edges`, `bin_counts` and `bin_log` in the series args. These keys survive the clear performed by a held
+ * merge, so samples which are sent later are accumulated into the existing counts.
+ */
+
+#define hist_to_bin_space(value, bin_log) ((bin_log) ? log10(value) : (value))
+#define hist_is_finite(value) ((value) >= -DBL_MAX && (value) <= DBL_MAX)
+
+void *hist_count_worker(void *arg)
+{
+  hist_count_job_t *job = (hist_count_job_t *)arg;
+  double value, bin;
+  unsigned int i;
+
+  for (i = job->start; i < job->end; ++i)
+    {
+      value = job->samples[i];
+      if (job->bin_log)
+        {
+          if (!(value > 0.0))
+            {
+              continue;
+            }
+          value = log10(value);
+        }
+      if (!hist_is_finite(value))
+        {
+          continue;
+        }
+      /* the bins cover all samples, clamping only catches rounding errors at the outermost edges */
+      bin = floor((value - job->origin) / job->width);
+      if (bin < 0.0)
+        {
+          bin = 0.0;
+        }
+      else if (bin >= job->nbins)
+        {
+          bin = job->nbins - 1;
+        }
+      job->counts[(unsigned int)bin] += (job->weights != NULL) ? job->weights[i] : 1.0;
+    }
+
+  return NULL;
+}
+
+error_t hist_count(unsigned int n, const double *samples, const double *weights, int bin_log, double origin,
+                   double width, unsigned int nbins, double *counts)
+{
+  hist_count_job_t jobs[PLOT_MAX_THREADS];
+  pthread_t threads[PLOT_MAX_THREADS];
+  int thread_started[PLOT_MAX_THREADS];
+  unsigned int thread_count, i, j;
+  error_t error = NO_ERROR;
+
+  thread_count = min((unsigned int)gr_parallel_threads((int)n, PLOT_HIST_MIN_SAMPLES_PER_THREAD), PLOT_MAX_THREADS);
+  for (i = 0; i < thread_count; ++i)
+    {
+      jobs[i].samples = samples;
+      jobs[i].weights = weights;
+      jobs[i].start = (unsigned int)((double)n * i / thread_count);
+      jobs[i].end = (unsigned int)((double)n * (i + 1) / thread_count);
+      jobs[i].bin_log = bin_log;
+      jobs[i].origin = origin;
+      jobs[i].width = width;
+      jobs[i].nbins = nbins;
+      /* The calling thread counts into the result directly, all other threads use private counts which are summed up
+       * afterwards. */
+      jobs[i].counts = (i == 0) ? counts : calloc(nbins, sizeof(double));
+      thread_started[i] = 0;
+    }
+  for (i = 1; i < thread_count; ++i)
+    {
+      cleanup_and_set_error_if(jobs[i].counts == NULL, ERROR_MALLOC);
+    }
+  for (i = 1; i < thread_count; ++i)
+    {
+      thread_started[i] = (pthread_create(&threads[i], NULL, hist_count_worker, &jobs[i]) == 0);
+    }
+  hist_count_worker(&jobs[0]);
+  for (i = 1; i < thread_count; ++i)
+    {
+      if (thread_started[i])
+        {
+          pthread_join(threads[i], NULL);
+        }
+      else
+        {
+          hist_count_worker(&jobs[i]);
+        }
+      for (j = 0; j < nbins; ++j)
+        {
+          counts[j] += jobs[i].counts[j];
+        }
+    }
+
+cleanup:
+  for (i = 1; i < thread_count; ++i)
+    {
+      free(jobs[i].counts);
+    }
+
+  return error;
+}
+
+unsigned int hist_sample_range(unsigned int n, const double *samples, int bin_log, double *sample_min,
+                               double *sample_max)
+{
+  unsigned int count = 0;
+  unsigned int i;
+  double value;
+
+  *sample_min = DBL_MAX;
+  *sample_max = -DBL_MAX;
+  for (i = 0; i < n; ++i)
+    {
+      value = samples[i];
+      if (bin_log)
+        {
+          if (!(value > 0.0))
+            {
+              continue;
+            }
+          value = log10(value);
+        }
+      if (!hist_is_finite(value))
+        {
+          continue;
+        }
+      *sample_min = min(value, *sample_min);
+      *sample_max = max(value, *sample_max);
+      ++count;
+    }
+
+  return count;
+}
+
+double hist_select(unsigned int n, double *values, unsigned int k)
+{
+  unsigned int left = 0, right = n - 1, i, j;
+  double pivot, tmp;
+
+  while (left < right)
+    {
+      pivot = values[left + (right - left) / 2];
+      i = left;
+      j = right;
+      while (i <= j)
+        {
+          while (values[i] < pivot)
+            {
+              ++i;
+            }
+          while (values[j] > pivot)
+            {
+              --j;
+            }
+          if (i <= j)
+            {
+              tmp = values[i];
+              values[i] = values[j];
+              values[j] = tmp;
+              ++i;
+              if (j == 0)
+                {
+                  break;
+                }
+              --j;
+            }
+        }
+      if (k <= j)
+        {
+          right = j;
+        }
+      else if (k >= i)
+        {
+          left = i;
+        }
+      else
+        {
+          break;
+        }
+    }
+
+  return values[k];
+}
+
+error_t hist_freedman_diaconis_width(unsigned int n, const double *samples, unsigned int count, double *width)
+{
+  double *values;
+  double q1, q3;
+  unsigned int i, j;
+
+  values = malloc(count * sizeof(double));
+  return_error_if(values == NULL, ERROR_MALLOC);
+  for (i = 0, j = 0; i < n; ++i)
+    {
+      if (hist_is_finite(samples[i]))
+        {
+          values[j++] = samples[i];
+        }
+    }
+  q1 = hist_select(count, values, (count - 1) / 4);
+  q3 = hist_select(count, values, 3 * (count - 1) / 4);
+  free(values);
+  *width = 2.0 * (q3 - q1) / pow(count, 1.0 / 3.0);
+
+  return NO_ERROR;
+}
+
+error_t hist_store_bins(grm_args_t *series_args, int bin_log, double origin, double width, unsigned int nbins,
+                        const double *counts)
+{
+  double *edges;
+  unsigned int i;
+
+  edges = malloc((nbins + 1) * sizeof(double));
+  return_error_if(edges == NULL, ERROR_MALLOC);
+  for (i = 0; i <= nbins; ++i)
+    {
+      edges[i] = bin_log ? pow(10.0, origin + i * width) : origin + i * width;
+    }
+  grm_args_push(series_args, "bin_edges", "nD", nbins + 1, edges);
+  grm_args_push(series_args, "bin_counts", "nD", nbins, counts);
+  grm_args_push(series_args, "bin_log", "i", bin_log);
+  free(edges);
+
+  return NO_ERROR;
+}
+
+error_t hist_bin(grm_args_t *series_args, unsigned int n, const double *samples, const double *weights,
+                 const char *bin_rule, int nbins, double bin_width)
+{
+  double sample_min, sample_max, origin, width = 0.0, bin_count = 0.0;
+  double *counts = NULL;
+  unsigned int count;
+  int bin_log;
+  error_t error = NO_ERROR;
+
+  if (!str_equals_any(bin_rule, 5, "auto", "fd", "sturges", "width", "log") ||
+      (strcmp(bin_rule, "width") == 0 && !(bin_width > 0.0)))
+    {
+      logger((stderr, "Unknown bin rule \"%s\" or invalid bin width, using \"auto\"\n", bin_rule));
+      bin_rule = "auto";
+    }
+  bin_log = (strcmp(bin_rule, "log") == 0);
+  count = hist_sample_range(n, samples, bin_log, &sample_min, &sample_max);
+  if (count == 0)
+    {
+      /* no valid samples: store a single empty bin */
+      sample_min = sample_max = bin_log ? 0.5 : 0.0;
+    }
+
+  if (strcmp(bin_rule, "width") == 0 || (strcmp(bin_rule, "auto") == 0 && nbins <= 0 && bin_width > 0.0))
+    {
+      width = bin_width;
+    }
+  else if (nbins > 0 && !str_equals_any(bin_rule, 2, "fd", "sturges"))
+    {
+      bin_count = nbins;
+    }
+  else if (!bin_log && strcmp(bin_rule, "sturges") != 0 && count > 1)
+    {
+      error = hist_freedman_diaconis_width(n, samples, count, &width);
+      cleanup_if_error;
+    }
+  if (!(width > 0.0) && !(bin_count > 0.0))
+    {
+      /* Sturges' rule, also the fallback if the interquartile range is zero */
+      bin_count = ceil(log(max(count, 1)) / log(2.0)) + 1;
+    }
+
+  if (sample_max > sample_min)
+    {
+      if (width > 0.0)
+        {
+          bin_count = max(ceil((sample_max - sample_min) / width), 1.0);
+        }
+      else
+        {
+          width = (sample_max - sample_min) / bin_count;
+        }
+      if (bin_count > PLOT_HIST_MAX_BINS)
+        {
+          bin_count = PLOT_HIST_MAX_BINS;
+          width = (sample_max - sample_min) / bin_count;
+        }
+      origin = sample_min;
+    }
+  else
+    {
+      /* all samples are equal: center a single bin on them */
+      if (!(width > 0.0))
+        {
+          width = 1.0;
+        }
+      bin_count = 1.0;
+      origin = sample_min - width / 2;
+    }
+
+  counts = calloc((size_t)bin_count, sizeof(double));
+  cleanup_and_set_error_if(counts == NULL, ERROR_MALLOC);
+  error = hist_count(n, samples, weights, bin_log, origin, width, (unsigned int)bin_count, counts);
+  cleanup_if_error;
+  error = hist_store_bins(series_args, bin_log, origin, width, (unsigned int)bin_count, counts);
+
+cleanup:
+  free(counts);
+
+  return error;
+}
+
+error_t hist_accumulate(grm_args_t *series_args, unsigned int n, const double *samples, const double *weights,
+                        int bin_log, unsigned int nbins, const double *edges, double *counts)
+{
+  double sample_min, sample_max, origin, width, first_bin, last_bin, extended_count, factor;
+  double *extended_counts = NULL;
+  unsigned int i;
+  error_t error = NO_ERROR;
+
+  origin = hist_to_bin_space(edges[0], bin_log);
+  width = (hist_to_bin_space(edges[nbins], bin_log) - origin) / nbins;
+  if (hist_sample_range(n, samples, bin_log, &sample_min, &sample_max) == 0)
+    {
+      return NO_ERROR;
+    }
+  first_bin = min(floor((sample_min - origin) / width), 0.0);
+  last_bin = floor((sample_max - origin) / width);
+  if (last_bin == nbins && sample_max <= origin + nbins * width)
+    {
+      /* the last bin includes its upper edge */
+      last_bin = nbins - 1;
+    }
+  last_bin = max(last_bin, nbins - 1.0);
+  if (first_bin == 0.0 && last_bin == nbins - 1)
+    {
+      /* all samples fall into the existing bins, so the stored counts can be updated in place */
+      args_touch(series_args);
+      return hist_count(n, samples, weights, bin_log, origin, width, nbins, counts);
+    }
+
+  /* Extend the bins to cover the new samples. If this leads to too many bins, adjacent bins are merged by doubling
+   * the bin width until the bin count is within the limit. */
+  extended_count = last_bin - first_bin + 1;
+  factor = 1.0;
+  while (ceil(extended_count / factor) > PLOT_HIST_MAX_BINS)
+    {
+      factor *= 2.0;
+    }
+  origin += first_bin * width;
+  width *= factor;
+  extended_count = ceil(extended_count / factor);
+  extended_counts = calloc((size_t)extended_count, sizeof(double));
+  cleanup_and_set_error_if(extended_counts == NULL, ERROR_MALLOC);
+  for (i = 0; i < nbins; ++i)
+    {
+      extended_counts[(unsigned int)floor((i - first_bin) / factor)] += counts[i];
+    }
+  error = hist_count(n, samples, weights, bin_log, origin, width, (unsigned int)extended_count, extended_counts);
+  cleanup_if_error;
+  error = hist_store_bins(series_args, bin_log, origin, width, (unsigned int)extended_count, extended_counts);
+
+cleanup:
+  free(extended_counts);
+
+  return error;
+}
+
+#undef hist_to_bin_space
+#undef hist_is_finite
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ heatmap ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void heatmap_color_worker(void *arg, int start, int end)
+{
+  heatmap_color_job_t *job = (heatmap_color_job_t *)arg;
+  const double *values = job->values;
+  const int *colors = job->colors;
+  int *data = job->data;
+  double z_min = job->z_min, z_max = job->z_max, c_min = job->c_min;
+  double scale = 255.0 / (job->c_max - job->c_min);
+  double value, f;
+  int i;
+
+  if (job->log_values != NULL)
+    {
+      for (i = start; i < end; ++i)
+        {
+          job->log_values[i] = log(values[i]);
+        }
+      values = job->log_values;
+    }
+  /* The loop body has no early exits, so the compiler can vectorize the mapping to color indices. NaN values fail both
+   * comparisons and get the invalid color. */
+  for (i = start; i < end; ++i)
+    {
+      value = values[i];
+      f = (value - c_min) * scale;
+      f = (f >= 255.0) ? 255.0 : ((f > 0.0) ? f : 0.0);
+      data[i] = (value >= z_min && value <= z_max) ? colors[(int)f] : job->invalid_color;
+    }
+}
+
+error_t heatmap_colorize(unsigned int n, const double *values, double *log_values, double z_min, double z_max,
+                         double c_min, double c_max, const int *colors, int invalid_color, int *data)
+{
+  heatmap_color_job_t job;
+
+  job.values = values;
+  job.log_values = log_values;
+  job.z_min = z_min;
+  job.z_max = z_max;
+  job.c_min = c_min;
+  job.c_max = c_max;
+  job.colors = colors;
+  job.invalid_color = invalid_color;
+  job.data = data;
+  gr_parallel_for((int)n, PLOT_HEATMAP_MIN_CELLS_PER_THREAD, heatmap_color_worker, &job);
+
+  return NO_ERROR;
+}
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ segment cache ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int segments_storage_is_active(void)
+{
+  int errind, count, n, wkid;
+
+  gks_inq_active_ws(1, &errind, &count, &wkid);
+  for (n = 1; n <= count; ++n)
+    {
+      gks_inq_active_ws(n, &errind, &count, &wkid);
+      if (wkid == PLOT_SEGMENT_WORKSTATION_ID)
+        {
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+int segments_open_storage(void)
+{
+  int errind, conid, wtype;
+
+  if (segment_cache.unavailable)
+    {
+      return 0;
+    }
+  gks_inq_ws_conntype(PLOT_SEGMENT_WORKSTATION_ID, &errind, &conid, &wtype);
+  if (errind != GKS_K_NO_ERROR)
+    {
+      segments_invalidate();
+      gr_openws(PLOT_SEGMENT_WORKSTATION_ID, NULL, GKS_K_WSTYPE_WISS);
+      gks_inq_ws_conntype(PLOT_SEGMENT_WORKSTATION_ID, &errind, &conid, &wtype);
+    }
+  if (errind != GKS_K_NO_ERROR || wtype != GKS_K_WSTYPE_WISS)
+    {
+      /* Another workstation uses the id or a segment storage is already open */
+      logger((stderr, "No segment storage available, all subplots will be redrawn\n"));
+      segment_cache.unavailable = 1;
+      return 0;
+    }
+  if (!segments_storage_is_active())
+    {
+      /* Nothing was recorded while the storage was inactive */
+      segments_invalidate();
+      gr_activatews(PLOT_SEGMENT_WORKSTATION_ID);
+    }
+
+  return 1;
+}
+
+void segments_close_storage(void)
+{
+  int errind, conid, wtype;
+
+  gks_inq_ws_conntype(PLOT_SEGMENT_WORKSTATION_ID, &errind, &conid, &wtype);
+  if (errind == GKS_K_NO_ERROR && wtype == GKS_K_WSTYPE_WISS && !segment_cache.unavailable)
+    {
+      if (segments_storage_is_active())
+        {
+          gr_deactivatews(PLOT_SEGMENT_WORKSTATION_ID);
+        }
+      gr_closews(PLOT_SEGMENT_WORKSTATION_ID);
+    }
+  free(segment_cache.segments);
+  segment_cache.unavailable = 0;
+  segment_cache.plot_args = NULL;
+  segment_cache.capacity = 0;
+  segment_cache.segments = NULL;
+}
+
+void segments_invalidate(void)
+{
+  int errind, conid, wtype;
+  unsigned int i;
+
+  segment_cache.plot_args = NULL;
+  for (i = 0; i < segment_cache.capacity; ++i)
+    {
+      segment_cache.segments[i].subplot_args = NULL;
+    }
+  gks_inq_ws_conntype(PLOT_SEGMENT_WORKSTATION_ID, &errind, &conid, &wtype);
+  if (errind == GKS_K_NO_ERROR && wtype == GKS_K_WSTYPE_WISS && !segment_cache.unavailable)
+    {
+      /* Dropping all segments at once is cheaper than deleting them one by one */
+      gks_clear_ws(PLOT_SEGMENT_WORKSTATION_ID, GKS_K_CLEAR_ALWAYS);
+    }
+}
+
+int segments_check(grm_args_t *plot_args, int plot_changed)
+{
+  int clear, cache_subplots;
+  const double *wswindow, *wsviewport;
+
+  args_values(plot_args, "clear", "i", &clear);
+  args_values(plot_args, "cache_subplots", "i", &cache_subplots);
+  if (!clear || !cache_subplots || !segments_open_storage())
+    {
+      segments_invalidate();
+      return 0;
+    }
+  args_values(plot_args, "wswindow", "D", &wswindow);
+  args_values(plot_args, "wsviewport", "D", &wsviewport);
+  if (plot_changed || memcmp(wswindow, segment_cache.wswindow, sizeof(segment_cache.wswindow)) != 0 ||
+      memcmp(wsviewport, segment_cache.wsviewport, sizeof(segment_cache.wsviewport)) != 0)
+    {
+      logger((stderr, "Plot or figure size changed, all subplots will be redrawn\n"));
+      segments_invalidate();
+    }
+
+  return 1;
+}
+
+int segments_plot_changed(const grm_args_t *plot_args)
+{
+  return plot_args != segment_cache.plot_args || args_generation(plot_args) != segment_cache.plot_generation;
+}
+
+unsigned int segments_subplot_generation(const grm_args_t *subplot_args)
+{
+  return args_nested_generation(subplot_args);
+}
+
+int segments_is_valid(unsigned int index, const grm_args_t *subplot_args)
+{
+  return index < segment_cache.capacity && segment_cache.segments[index].subplot_args == subplot_args &&
+         segment_cache.segments[index].generation == segments_subplot_generation(subplot_args);
+}
+
+error_t segments_begin(unsigned int index)
+{
+  plot_segment_t *segments;
+  unsigned int capacity, i;
+
+  if (index >= segment_cache.capacity)
+    {
+      capacity = max(2 * segment_cache.capacity, index + 1);
+      segments = realloc(segment_cache.segments, capacity * sizeof(plot_segment_t));
+      if (segments == NULL)
+        {
+          debug_print_malloc_error();
+          return ERROR_MALLOC;
+        }
+      for (i = segment_cache.capacity; i < capacity; ++i)
+        {
+          segments[i].subplot_args = NULL;
+          segments[i].generation = 0;
+        }
+      segment_cache.segments = segments;
+      segment_cache.capacity = capacity;
+    }
+  if (segment_cache.segments[index].subplot_args != NULL)
+    {
+      gks_delete_seg(index + 1);
+      segment_cache.segments[index].subplot_args = NULL;
+    }
+  gr_createseg(index + 1);
+
+  return NO_ERROR;
+}
+
+void segments_end(unsigned int index, const grm_args_t *subplot_args)
+{
+  gr_closeseg();
+  if (subplot_args != NULL)
+    {
+      segment_cache.segments[index].subplot_args = subplot_args;
+      segment_cache.segments[index].generation = segments_subplot_generation(subplot_args);
+    }
+}
+
+void segments_store_plot(const grm_args_t *plot_args)
+{
+  const double *wswindow, *wsviewport;
+
+  segment_cache.plot_args = plot_args;
+  segment_cache.plot_generation = args_generation(plot_args);
+  args_values(plot_args, "wswindow", "D", &wswindow);
+  args_values(plot_args, "wsviewport", "D", &wsviewport);
+  memcpy(segment_cache.wswindow, wswindow, sizeof(segment_cache.wswindow));
+  memcpy(segment_cache.wsviewport, wsviewport, sizeof(segment_cache.wsviewport));
+}
+
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~ util ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 double find_max_step(unsigned int n, const double *x)
@@ -3125,6 +3867,15 @@ void grm_finalize(void)
       plot_func_map = NULL;
       string_map_delete(plot_valid_keys_map);
       plot_valid_keys_map = NULL;
+      free(heatmap_cache.log_values);
+      free(heatmap_cache.data);
+      heatmap_cache.series = NULL;
+      heatmap_cache.z = NULL;
+      heatmap_cache.log_values_length = 0;
+      heatmap_cache.log_values = NULL;
+      heatmap_cache.data_length = 0;
+      heatmap_cache.data = NULL;
+      segments_close_storage();
       plot_static_variables_initialized = 0;
     }
 }
@@ -3197,33 +3948,67 @@ int grm_plot(const grm_args_t *args)
   grm_args_t **current_subplot_args;
   plot_func_t plot_func;
   const char *kind = NULL;
+  unsigned int subplot_index = 0;
+  int plot_changed, use_segments;
   if (!grm_merge(args))
     {
       return 0;
     }
 
+  /* Compare before `plot_pre_plot` stores the workstation window and viewport in the plot arguments */
+  plot_changed = segments_plot_changed(active_plot_args);
   plot_set_attribute_defaults(active_plot_args);
   plot_pre_plot(active_plot_args);
+  use_segments = segments_check(active_plot_args, plot_changed);
   args_values(active_plot_args, "subplots", "A", &current_subplot_args);
   while (*current_subplot_args != NULL)
     {
+      /* Every subplot starts from the same GR state, no matter if its predecessors are drawn or copied from their
+       * segments */
+      gr_savestate();
+      if (use_segments && segments_is_valid(subplot_index, *current_subplot_args))
+        {
+          logger((stderr, "Subplot %u is unchanged, copy its segment\n", subplot_index));
+          gr_copysegws(subplot_index + 1);
+          gr_restorestate();
+          ++current_subplot_args;
+          ++subplot_index;
+          continue;
+        }
+      if (use_segments && segments_begin(subplot_index) != NO_ERROR)
+        {
+          segments_invalidate();
+          use_segments = 0;
+        }
       plot_pre_subplot(*current_subplot_args);
       args_values(*current_subplot_args, "kind", "s", &kind);
       logger((stderr, "Got keyword \"kind\" with value \"%s\"\n", kind));
-      if (!plot_func_map_at(plot_func_map, kind, &plot_func))
+      if (!plot_func_map_at(plot_func_map, kind, &plot_func) || plot_func(*current_subplot_args) != NO_ERROR)
         {
+          if (use_segments)
+            {
+              segments_end(subplot_index, NULL);
+              segments_invalidate();
+            }
+          gr_restorestate();
           return 0;
         }
-      if (plot_func(*current_subplot_args) != NO_ERROR)
-        {
-          return 0;
-        };
       plot_post_subplot(*current_subplot_args);
+      if (use_segments)
+        {
+          segments_end(subplot_index, *current_subplot_args);
+        }
+      gr_restorestate();
       ++current_subplot_args;
+      ++subplot_index;
     }
   plot_post_plot(active_plot_args);
 
   process_events();
+  if (use_segments)
+    {
+      segments_store_plot(active_plot_args);
+    }
 
 #ifndef NDEBUG
   logger((stderr, "root args after \"grm_plot\" (active_plot_index: %d):\n", active_plot_index - 1));
@@ -42,6 +42,7 @@ extern const char *plot_clear_exclude_keys[];
 #define PLOT_DEFAULT_SPEC ""
 #define PLOT_DEFAULT_CLEAR 1
 #define PLOT_DEFAULT_UPDATE 1
+#define PLOT_DEFAULT_CACHE_SUBPLOTS 0
 #define PLOT_DEFAULT_LOCATION 1
 #define PLOT_DEFAULT_SUBPLOT_MIN_X 0.0
 #define PLOT_DEFAULT_SUBPLOT_MAX_X 1.0
@@ -67,11 +68,17 @@ extern const char *plot_clear_exclude_keys[];
 #define PLOT_DEFAULT_CONTOUR_LEVELS 20
 #define PLOT_DEFAULT_HEXBIN_NBINS 40
 #define PLOT_DEFAULT_TRICONT_LEVELS 20
+#define PLOT_DEFAULT_HIST_BIN_RULE "auto"
 #define SERIES_DEFAULT_SPEC ""
 #define PLOT_POLAR_AXES_TEXT_BUFFER 40
 #define PLOT_CONTOUR_GRIDIT_N 200
 #define PLOT_WIREFRAME_GRIDIT_N 50
 #define PLOT_SURFACE_GRIDIT_N 200
+#define PLOT_MAX_THREADS 64
+#define PLOT_HIST_MAX_BINS 100000
+#define PLOT_HIST_MIN_SAMPLES_PER_THREAD 100000
+#define PLOT_HEATMAP_MIN_CELLS_PER_THREAD 250000
+#define PLOT_SEGMENT_WORKSTATION_ID 16
 
 
 /* ========================= datatypes ============================================================================== */
@@ -83,6 +90,47 @@ extern const char *plot_clear_exclude_keys[];
 typedef error_t (*plot_func_t)(grm_args_t *args);
 
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ histogram ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct
+{
+  const double *samples;
+  const double *weights;
+  unsigned int start;
+  unsigned int end;
+  int bin_log;
+  double origin;
+  double width;
+  unsigned int nbins;
+  double *counts;
+} hist_count_job_t;
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ heatmap ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct
+{
+  const double *values;
+  double *log_values;
+  double z_min;
+  double z_max;
+  double c_min;
+  double c_max;
+  const int *colors;
+  int invalid_color;
+  int *data;
+} heatmap_color_job_t;
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ segment cache ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+typedef struct
+{
+  const grm_args_t *subplot_args;
+  unsigned int generation;
+} plot_segment_t;
+
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~ options ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 typedef enum
@@ -126,6 +174,7 @@ void plot_process_colormap(grm_args_t *subplot_args);
 void plot_process_viewport(grm_args_t *subplot_args);
 void plot_process_window(grm_args_t *subplot_args);
 void plot_store_coordinate_ranges(grm_args_t *subplot_args);
+error_t plot_process_hist_bins(grm_args_t *subplot_args);
 void plot_post_plot(grm_args_t *plot_args);
 void plot_post_subplot(grm_args_t *subplot_args);
 error_t plot_get_args_in_hierarchy(grm_args_t *args, const char **hierarchy_name_start_ptr, const char *key,
@@ -166,6 +215,45 @@ error_t plot_draw_legend(grm_args_t *args);
 error_t plot_draw_colorbar(grm_args_t *args, double off, unsigned int colors);
 
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ histogram ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void *hist_count_worker(void *arg);
+error_t hist_count(unsigned int n, const double *samples, const double *weights, int bin_log, double origin,
+                   double width, unsigned int nbins, double *counts);
+unsigned int hist_sample_range(unsigned int n, const double *samples, int bin_log, double *sample_min,
+                               double *sample_max);
+double hist_select(unsigned int n, double *values, unsigned int k);
+error_t hist_freedman_diaconis_width(unsigned int n, const double *samples, unsigned int count, double *width);
+error_t hist_store_bins(grm_args_t *series_args, int bin_log, double origin, double width, unsigned int nbins,
+                        const double *counts);
+error_t hist_bin(grm_args_t *series_args, unsigned int n, const double *samples, const double *weights,
+                 const char *bin_rule, int nbins, double bin_width);
+error_t hist_accumulate(grm_args_t *series_args, unsigned int n, const double *samples, const double *weights,
+                        int bin_log, unsigned int nbins, const double *edges, double *counts);
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ heatmap ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void heatmap_color_worker(void *arg, int start, int end);
+error_t heatmap_colorize(unsigned int n, const double *values, double *log_values, double z_min, double z_max,
+                         double c_min, double c_max, const int *colors, int invalid_color, int *data);
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~ segment cache ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int segments_storage_is_active(void);
+int segments_open_storage(void);
+void segments_close_storage(void);
+void segments_invalidate(void);
+int segments_check(grm_args_t *plot_args, int plot_changed);
+int segments_plot_changed(const grm_args_t *plot_args);
+unsigned int segments_subplot_generation(const grm_args_t *subplot_args);
+int segments_is_valid(unsigned int index, const grm_args_t *subplot_args);
+error_t segments_begin(unsigned int index);
+void segments_end(unsigned int index, const grm_args_t *subplot_args);
+void segments_store_plot(const grm_args_t *plot_args);
+
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~ util ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 double find_max_step(unsigned int n, const double *x);
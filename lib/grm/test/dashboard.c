@@ -0,0 +1,97 @@
+#ifdef __unix__
+#define _XOPEN_SOURCE 500
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "grm.h"
+
+#define PANELS 16
+#define POINTS 1000
+#define UPDATES 20
+
+static double wall_time(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void fill_panel(double *x, double *y, double *z, int panel, int frame)
+{
+  int j;
+
+  srand(panel + 1);
+  for (j = 0; j < POINTS; ++j)
+    {
+      x[j] = 8.0 * rand() / RAND_MAX - 4.0;
+      y[j] = 8.0 * rand() / RAND_MAX - 4.0;
+      z[j] = sin((1 + 0.1 * panel) * x[j] + 0.1 * frame) * cos(y[j]);
+    }
+}
+
+static void test_dashboard(void)
+{
+  double x[POINTS], y[POINTS], z[POINTS];
+  grm_args_t *args, *update, *subplots[PANELS];
+  int i, frame;
+  double start;
+
+  printf("filling argument container...\n");
+
+  for (i = 0; i < PANELS; ++i)
+    {
+      fill_panel(x, y, z, i, 0);
+      subplots[i] = grm_args_new();
+      grm_args_push(subplots[i], "x", "nD", POINTS, x);
+      grm_args_push(subplots[i], "y", "nD", POINTS, y);
+      grm_args_push(subplots[i], "z", "nD", POINTS, z);
+      grm_args_push(subplots[i], "kind", "s", "contourf");
+      grm_args_push(subplots[i], "subplot", "dddd", 0.25 * (i % 4), 0.25 * (i % 4 + 1), 0.25 * (i / 4),
+                    0.25 * (i / 4 + 1));
+    }
+
+  args = grm_args_new();
+  grm_args_push(args, "subplots", "nA", PANELS, subplots);
+  grm_args_push(args, "cache_subplots", "i", 1);
+
+  printf("plotting data...\n");
+
+  start = wall_time();
+  grm_plot(args);
+  printf("initial plot of %d panels: %.3f s\n", PANELS, wall_time() - start);
+
+  /* Stream new data into one panel per update, the other panels are copied from their segments */
+  start = wall_time();
+  for (frame = 1; frame <= UPDATES; ++frame)
+    {
+      fill_panel(x, y, z, frame % PANELS, frame);
+      update = grm_args_new();
+      grm_args_push(update, "x", "nD", POINTS, x);
+      grm_args_push(update, "y", "nD", POINTS, y);
+      grm_args_push(update, "z", "nD", POINTS, z);
+      grm_args_push(update, "subplot_id", "i", frame % PANELS + 1);
+      grm_merge_hold(update);
+      grm_plot(NULL);
+      grm_args_delete(update);
+    }
+  printf("%d updates of one panel: %.3f s per update\n", UPDATES, (wall_time() - start) / UPDATES);
+
+  grm_args_delete(args);
+}
+
+static void test_plot(void)
+{
+  test_dashboard();
+  grm_finalize();
+}
+
+int main(void)
+{
+  test_plot();
+
+  return 0;
+}
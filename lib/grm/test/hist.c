@@ -0,0 +1,89 @@
+#ifdef __unix__
+#define _XOPEN_SOURCE 500
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "grm.h"
+
+
+static double normal_sample(double mean, double sigma)
+{
+  double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+  return mean + sigma * sqrt(-2 * log(u1)) * cos(2 * 3.14159265358979323846 * u2);
+}
+
+static void test_hist(void)
+{
+  double samples[10000], weights[10000];
+  int n = sizeof(samples) / sizeof(samples[0]);
+  grm_args_t *args;
+  int i, j;
+
+  printf("filling argument container...\n");
+
+  for (i = 0; i < n; ++i)
+    {
+      samples[i] = normal_sample(0.0, 1.0);
+    }
+
+  args = grm_args_new();
+  grm_args_push(args, "kind", "s", "hist");
+  grm_args_push(args, "x", "nD", n, samples);
+  printf("plotting data (automatic bins)...\n");
+  grm_plot(args);
+  printf("Press any key to continue...\n");
+  getchar();
+  grm_args_delete(args);
+
+  /* Held merges add new samples to the existing counts, the bins are extended if necessary */
+  for (j = 0; j < 5; ++j)
+    {
+      for (i = 0; i < n; ++i)
+        {
+          samples[i] = normal_sample(j + 1.0, 1.0);
+        }
+      args = grm_args_new();
+      grm_args_push(args, "x", "nD", n, samples);
+      grm_merge_hold(args);
+      grm_args_delete(args);
+      printf("plotting data (%d appended samples)...\n", (j + 1) * n);
+      grm_plot(NULL);
+      printf("Press any key to continue...\n");
+      getchar();
+    }
+
+  for (i = 0; i < n; ++i)
+    {
+      samples[i] = exp(normal_sample(0.0, 1.5));
+      weights[i] = 1.0 / samples[i];
+    }
+  args = grm_args_new();
+  grm_args_push(args, "kind", "s", "hist");
+  grm_args_push(args, "bin_rule", "s", "log");
+  grm_args_push(args, "nbins", "i", 30);
+  grm_args_push(args, "xlog", "i", 1);
+  grm_args_push(args, "x", "nD", n, samples);
+  grm_args_push(args, "weights", "nD", n, weights);
+  printf("plotting data (weighted samples in logarithmic bins)...\n");
+  grm_plot(args);
+  printf("Press any key to continue...\n");
+  getchar();
+  grm_args_delete(args);
+}
+
+static void test_plot(void)
+{
+  test_hist();
+  grm_finalize();
+}
+
+int main(void)
+{
+  test_plot();
+
+  return 0;
+}
@@ -24,6 +24,7 @@
 static void test_merge(void)
 {
   double plots[4][2][3];
+  double *x = NULL, *y = NULL;
   grm_args_t *subplot = NULL, *series = NULL;
   int i, j, k;
 
@@ -94,7 +95,28 @@ static void test_merge(void)
   grm_args_delete(series);
   series = NULL;
 
+  /* Hand over heap buffers without copying them, they are freed when the merged plot releases them */
+  x = malloc(3 * sizeof(double));
+  y = malloc(3 * sizeof(double));
+  cleanup_if(x == NULL || y == NULL);
+  for (k = 0; k < 3; ++k)
+    {
+      x[k] = plots[3][0][k];
+      y[k] = plots[3][1][k];
+    }
+  series = grm_args_new();
+  cleanup_if(!grm_args_push_ref(series, "x", "D", 3, x, free));
+  x = NULL;
+  cleanup_if(!grm_args_push_ref(series, "y", "D", 3, y, free));
+  y = NULL;
+  grm_args_push(series, "id", "s", "2.2");
+  cleanup_if(!grm_merge(series));
+  grm_args_delete(series);
+  series = NULL;
+
 cleanup:
+  free(x);
+  free(y);
   if (subplot != NULL)
     {
       grm_args_delete(subplot);